@@ -0,0 +1,506 @@
+/*
+ * bench_main.c
+ *
+ *      Author: Felix Paetow
+ */
+
+// Throughput benchmark of the renderers. It renders a fixed set of scenes at
+// several resolutions and iteration budgets with the CPU backend and every
+// kernel variant on every OpenCL device, and prints the frame times, the
+// pixels and the iterations per second as JSON on stdout. Everything else the
+// renderers print goes to stderr. The frames go through the renderer of the
+// video program, so a frame time includes the read back of the image.
+//
+// Built from the root of the repository, like the video program:
+//
+//     gcc -std=gnu99 -O2 bench/bench_main.c resources/*.c -lOpenCL -lm
+//         -lpthread -o mandelbrot_bench
+//
+// Options: --backend=all|cpu|opencl, --frames=N timed frames per result,
+// --quick for one small resolution and budget.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __APPLE__
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "../resources/iteration_values.h"
+#include "../resources/precision.h"
+#include "../resources/renderer.h"
+
+//backends to measure
+#define BENCH_ALL 0
+#define BENCH_CPU 1
+#define BENCH_OPENCL 2
+
+//maximum number of timed frames of a result
+#define BENCH_MAX_FRAMES 1000
+
+//maximum number of OpenCL devices measured
+#define BENCH_MAX_DEVICES 16
+
+//a plane section, given as its center and its width. The map is z^2 - c,
+//so the set is mirrored against the usual pictures.
+typedef struct bench_scene {
+	const char * name;
+	double center_real;
+	double center_imaginary;
+	double span;
+} bench_scene_t;
+
+typedef struct bench_resolution {
+	long x_mon;
+	long y_mon;
+} bench_resolution_t;
+
+//the build options of a kernel variant, or the options of the CPU backend
+typedef struct bench_variant {
+	const char * name;
+	int unroll;
+	int magnitude_squared;
+	int interior_check;
+	int precision;
+} bench_variant_t;
+
+//the times of the frames of one result
+typedef struct bench_result {
+	const char * backend;
+	const char * device;
+	const char * variant;
+	const bench_scene_t * scene;
+	long x_mon;
+	long y_mon;
+	long itr;
+	double frame_ms[BENCH_MAX_FRAMES];
+	int frames;
+
+	//iterations a frame calculates, without the ones the interior check
+	//skipped
+	double iterations;
+} bench_result_t;
+
+static const bench_scene_t scenes[] = {
+		{ "full", 0.5, 0.0, 3.0 },
+		{ "seahorse-valley", 0.7453, -0.1127, 0.01 },
+		{ "deep-interior", 0.15, 0.0, 0.3 },
+		{ "boundary", -0.2825, -0.01, 0.02 } };
+
+static const bench_resolution_t resolutions[] = { { 320, 240 },
+		{ 640, 480 }, { 1280, 720 } };
+
+static const long budgets[] = { 100, 1000, 10000 };
+
+static const bench_variant_t cpu_variants[] = {
+		{ "float", 1, 0, 1, PRECISION_FLOAT },
+		{ "float-no-interior-check", 1, 0, 0, PRECISION_FLOAT } };
+
+static const bench_variant_t opencl_variants[] = {
+		{ "float", 4, 0, 1, PRECISION_FLOAT },
+		{ "float-unroll-1", 1, 0, 1, PRECISION_FLOAT },
+		{ "float-magnitude-squared", 4, 1, 1, PRECISION_FLOAT },
+		{ "float-no-interior-check", 4, 0, 0, PRECISION_FLOAT },
+		{ "df64", 4, 0, 1, PRECISION_DF64 },
+		{ "double", 4, 0, 1, PRECISION_DOUBLE } };
+
+#define BENCH_COUNT(array) ((int) (sizeof(array) / sizeof((array)[0])))
+
+//the abort value of the video program
+static const float abort_value = 2;
+
+//the JSON output and the number of results printed so far, for the
+//separating commas
+static FILE * json = NULL;
+static long printed_results = 0;
+
+/**
+ * Returns the time of a monotonic clock.
+ *
+ * @return The time in milliseconds.
+ */
+static double bench_now_ms(void) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec * 1000.0 + now.tv_nsec / 1000000.0;
+}
+
+/**
+ * Returns the plane section of a scene at a resolution.
+ *
+ * @param scene The scene.
+ * @param x_mon Resolution of the monitor on the horizontal axis.
+ * @param y_mon Resolution of the monitor on the vertical axis.
+ * @param bounds Set to x_min, x_max, y_min and y_max.
+ */
+static void bench_bounds(const bench_scene_t * scene, const long x_mon,
+		const long y_mon, double * bounds) {
+	double height = scene->span * y_mon / x_mon;
+
+	bounds[0] = scene->center_real - scene->span / 2;
+	bounds[1] = scene->center_real + scene->span / 2;
+	bounds[2] = scene->center_imaginary - height / 2;
+	bounds[3] = scene->center_imaginary + height / 2;
+}
+
+/**
+ * Orders frame times.
+ *
+ * @param a The first time.
+ * @param b The second time.
+ * @return A negative value if a is shorter, otherwise a positive value or 0.
+ */
+static int bench_compare(const void * a, const void * b) {
+	double time_a = *(const double *) a;
+	double time_b = *(const double *) b;
+
+	return (time_a > time_b) - (time_a < time_b);
+}
+
+/**
+ * Prints a string as JSON string.
+ *
+ * @param s The string.
+ */
+static void bench_print_string(const char * s) {
+	fputc('"', json);
+	for (; *s != '\0'; ++s) {
+		if (*s == '"' || *s == '\\') {
+			fputc('\\', json);
+			fputc(*s, json);
+		} else if ((unsigned char) *s >= 0x20) {
+			fputc(*s, json);
+		}
+	}
+	fputc('"', json);
+}
+
+/**
+ * Prints a result as JSON object: the median and the 95th percentile of the
+ * frame times, and the pixels and iterations per second of the median
+ * frame.
+ *
+ * @param result The result, whose frame times are sorted.
+ */
+static void bench_print_result(bench_result_t * result) {
+	qsort(result->frame_ms, result->frames, sizeof(double), bench_compare);
+
+	int n = result->frames;
+	double median = (n % 2 == 1) ? result->frame_ms[n / 2] :
+			(result->frame_ms[n / 2 - 1] + result->frame_ms[n / 2]) / 2;
+	double p95 = result->frame_ms[(int) ceil(0.95 * n) - 1];
+	double pixels = (double) result->x_mon * result->y_mon;
+
+	fprintf(json, "%s\n    {\"backend\": ", printed_results > 0 ? "," : "");
+	bench_print_string(result->backend);
+	fprintf(json, ", \"device\": ");
+	bench_print_string(result->device);
+	fprintf(json, ", \"variant\": ");
+	bench_print_string(result->variant);
+	fprintf(json, ", \"scene\": ");
+	bench_print_string(result->scene->name);
+	fprintf(json, ", \"width\": %ld, \"height\": %ld, \"itr\": %ld, "
+			"\"frames\": %d, \"median_ms\": %.4f, \"p95_ms\": %.4f, "
+			"\"mpixel_per_s\": %.3f, \"giter_per_s\": %.4f}", result->x_mon,
+			result->y_mon, result->itr, n, median, p95,
+			pixels / median / 1000.0, result->iterations / median / 1000000.0);
+	fflush(json);
+	printed_results++;
+
+	fprintf(stderr, "%s %s %s %s %ldx%ld itr %ld: %.3f ms\n",
+			result->backend, result->device, result->variant,
+			result->scene->name, result->x_mon, result->y_mon, result->itr,
+			median);
+}
+
+/**
+ * Measures a renderer at every scene, resolution and iteration budget: one
+ * frame that exports the iteration values to count them, then the timed
+ * frames. Each timed frame is rendered and read back before the next one
+ * starts.
+ *
+ * @param renderer The renderer.
+ * @param backend The name of the backend.
+ * @param variant The name of the variant the renderer was created with.
+ * @param frames The number of timed frames.
+ * @param number_resolutions The number of resolutions measured.
+ * @param number_budgets The number of iteration budgets measured.
+ * @return CL_SUCCESS or the error code of the failed call.
+ */
+static cl_int bench_renderer(renderer_t * renderer, const char * backend,
+		const char * variant, const int frames, const int number_resolutions,
+		const int number_budgets) {
+	const bench_resolution_t * largest = &resolutions[number_resolutions - 1];
+	unsigned char * image = (unsigned char *) malloc(
+			largest->x_mon * largest->y_mon * 3);
+	bench_result_t result;
+	char device[128];
+	cl_int err = CL_SUCCESS;
+
+	if (image == NULL) {
+		return CL_OUT_OF_HOST_MEMORY;
+	}
+	renderer_device_name(renderer, device, sizeof(device));
+
+	for (int s = 0; s < BENCH_COUNT(scenes) && err == CL_SUCCESS; ++s) {
+		for (int r = 0; r < number_resolutions && err == CL_SUCCESS; ++r) {
+			for (int b = 0; b < number_budgets && err == CL_SUCCESS; ++b) {
+				long x_mon = resolutions[r].x_mon;
+				long y_mon = resolutions[r].y_mon;
+				renderer_frame_t frame;
+				frame_slot_t slot;
+				double bounds[4];
+
+				bench_bounds(&scenes[s], x_mon, y_mon, bounds);
+				result.backend = backend;
+				result.device = device;
+				result.variant = variant;
+				result.scene = &scenes[s];
+				result.x_mon = x_mon;
+				result.y_mon = y_mon;
+				result.itr = budgets[b];
+				result.frames = frames;
+				result.iterations = 0;
+
+				// The untimed first frame also builds the variant and
+				// counts the iterations. The values of the points the
+				// interior check stopped early hold iterations that were
+				// never calculated, which the renderer reports as saved.
+				memset(&frame, 0, sizeof(frame));
+				memset(&slot, 0, sizeof(slot));
+				frame.x_min = bounds[0];
+				frame.x_max = bounds[1];
+				frame.y_min = bounds[2];
+				frame.y_max = bounds[3];
+				frame.x_mon = x_mon;
+				frame.y_mon = y_mon;
+				frame.itr = budgets[b];
+				frame.image = image;
+				frame.export_values = 1;
+				slot.frame = -1;
+
+				err = renderer_enqueue_frame(renderer, &frame, &slot);
+				if (err == CL_SUCCESS) {
+					err = renderer_wait_frame(renderer, &slot);
+				} else {
+					frame_pipeline_wait(&slot);
+				}
+				if (err != CL_SUCCESS) {
+					break;
+				}
+				for (long i = 0; i < x_mon * y_mon; ++i) {
+					result.iterations += iteration_values_get(frame.values,
+							frame.value_bits, i);
+				}
+				result.iterations -= (double) slot.saved_iterations;
+
+				for (int f = 0; f < frames && err == CL_SUCCESS; ++f) {
+					double start = bench_now_ms();
+					err = renderer_render(renderer, bounds[0], bounds[1],
+							bounds[2], bounds[3], x_mon, y_mon, budgets[b],
+							image);
+					result.frame_ms[f] = bench_now_ms() - start;
+				}
+				if (err == CL_SUCCESS) {
+					bench_print_result(&result);
+				}
+			}
+		}
+	}
+
+	free(image);
+
+	return err;
+}
+
+/**
+ * Measures the CPU backend with each of its variants.
+ *
+ * @param frames The number of timed frames.
+ * @param number_resolutions The number of resolutions measured.
+ * @param number_budgets The number of iteration budgets measured.
+ * @return 0 on success, otherwise -1.
+ */
+static int bench_cpu(const int frames, const int number_resolutions,
+		const int number_budgets) {
+	renderer_options_t options;
+	cl_int err;
+
+	for (int v = 0; v < BENCH_COUNT(cpu_variants); ++v) {
+		renderer_options_init(&options);
+		options.backend = RENDERER_BACKEND_CPU;
+		options.abort_value = abort_value;
+		options.interior_check = cpu_variants[v].interior_check;
+		options.precision = cpu_variants[v].precision;
+
+		renderer_t * renderer = renderer_create(&options, &err);
+		if (renderer == NULL) {
+			fprintf(stderr, "Error: Failed to create the CPU backend: %d\n",
+					err);
+			return -1;
+		}
+		err = bench_renderer(renderer, "cpu", cpu_variants[v].name, frames,
+				number_resolutions, number_budgets);
+		renderer_release(renderer);
+		if (err != CL_SUCCESS) {
+			fprintf(stderr, "Error: Failed to measure the CPU backend: %d\n",
+					err);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Measures every kernel variant on one OpenCL device, each with a renderer
+ * of its own. The variants load from the program cache after the first
+ * run.
+ *
+ * @param device_id The device.
+ * @param frames The number of timed frames.
+ * @param number_resolutions The number of resolutions measured.
+ * @param number_budgets The number of iteration budgets measured.
+ * @return CL_SUCCESS or the error code of the failed call.
+ */
+static cl_int bench_opencl_device(cl_device_id device_id, const int frames,
+		const int number_resolutions, const int number_budgets) {
+	int has_double = precision_device_has_double(device_id);
+	renderer_options_t options;
+	cl_int err = CL_SUCCESS;
+
+	for (int v = 0; v < BENCH_COUNT(opencl_variants) && err == CL_SUCCESS;
+			++v) {
+		const bench_variant_t * bench_variant = &opencl_variants[v];
+
+		if (bench_variant->precision == PRECISION_DOUBLE && !has_double) {
+			continue;
+		}
+
+		renderer_options_init(&options);
+		options.device_id = device_id;
+		options.abort_value = abort_value;
+		options.unroll = bench_variant->unroll;
+		options.magnitude_squared = bench_variant->magnitude_squared;
+		options.interior_check = bench_variant->interior_check;
+		options.precision = bench_variant->precision;
+
+		renderer_t * renderer = renderer_create(&options, &err);
+		if (renderer == NULL) {
+			break;
+		}
+		err = bench_renderer(renderer, "opencl", bench_variant->name,
+				frames, number_resolutions, number_budgets);
+		renderer_release(renderer);
+	}
+
+	return err;
+}
+
+/**
+ * Measures every OpenCL device of every platform.
+ *
+ * @param frames The number of timed frames.
+ * @param number_resolutions The number of resolutions measured.
+ * @param number_budgets The number of iteration budgets measured.
+ * @return 0 on success, otherwise -1.
+ */
+static int bench_opencl(const int frames, const int number_resolutions,
+		const int number_budgets) {
+	cl_uint number_platforms = 0;
+	int result = 0;
+
+	if (clGetPlatformIDs(0, NULL, &number_platforms) != CL_SUCCESS
+			|| number_platforms == 0) {
+		fprintf(stderr, "Found no OpenCL platform\n");
+		return 0;
+	}
+
+	cl_platform_id platforms[number_platforms];
+	if (clGetPlatformIDs(number_platforms, platforms, NULL) != CL_SUCCESS) {
+		return -1;
+	}
+
+	for (cl_uint p = 0; p < number_platforms; ++p) {
+		cl_device_id devices[BENCH_MAX_DEVICES];
+		cl_uint number_devices = 0;
+
+		if (clGetDeviceIDs(platforms[p], CL_DEVICE_TYPE_ALL,
+				BENCH_MAX_DEVICES, devices, &number_devices) != CL_SUCCESS) {
+			continue;
+		}
+		if (number_devices > BENCH_MAX_DEVICES) {
+			number_devices = BENCH_MAX_DEVICES;
+		}
+		for (cl_uint d = 0; d < number_devices; ++d) {
+			cl_int err = bench_opencl_device(devices[d], frames,
+					number_resolutions, number_budgets);
+			if (err != CL_SUCCESS) {
+				fprintf(stderr, "Error: Failed to measure device %u of "
+						"platform %u: %d\n", d, p, err);
+				result = -1;
+			}
+		}
+	}
+
+	return result;
+}
+
+int main(int argc, char *argv[]) {
+	int backends = BENCH_ALL;
+	int frames = 10;
+	int number_resolutions = BENCH_COUNT(resolutions);
+	int number_budgets = BENCH_COUNT(budgets);
+	int failed = 0;
+
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--backend=all") == 0) {
+			backends = BENCH_ALL;
+		} else if (strcmp(argv[i], "--backend=cpu") == 0) {
+			backends = BENCH_CPU;
+		} else if (strcmp(argv[i], "--backend=opencl") == 0) {
+			backends = BENCH_OPENCL;
+		} else if (strncmp(argv[i], "--frames=", 9) == 0
+				&& atoi(argv[i] + 9) > 0
+				&& atoi(argv[i] + 9) <= BENCH_MAX_FRAMES) {
+			frames = atoi(argv[i] + 9);
+		} else if (strcmp(argv[i], "--quick") == 0) {
+			number_resolutions = 1;
+			number_budgets = 1;
+		} else {
+			fprintf(stderr, "Unknown option %s\n", argv[i]);
+			fprintf(stderr, "Usage: %s [--backend=all|cpu|opencl] "
+					"[--frames=N] [--quick]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	// Keep stdout for the JSON; what the renderers print goes to stderr
+	json = fdopen(dup(STDOUT_FILENO), "w");
+	if (json == NULL || dup2(STDERR_FILENO, STDOUT_FILENO) < 0) {
+		fprintf(stderr, "Failed to redirect output\n");
+		return EXIT_FAILURE;
+	}
+
+	fprintf(json, "{\n  \"benchmark\": \"mandelbrot\",\n  \"frames\": %d,\n"
+			"  \"results\": [", frames);
+
+	if (backends != BENCH_OPENCL) {
+		failed |= bench_cpu(frames, number_resolutions, number_budgets);
+	}
+	if (backends != BENCH_CPU) {
+		failed |= bench_opencl(frames, number_resolutions, number_budgets);
+	}
+
+	fprintf(json, "\n  ]\n}\n");
+	fclose(json);
+
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
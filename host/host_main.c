@@ -19,12 +19,211 @@
 #define DEVICE CL_DEVICE_TYPE_DEFAULT
 #endif
 
+#include "../resources/coloring.h"
 #include "../resources/error_code.h"
+#include "../resources/exp_map.h"
+#include "../resources/frame_pipeline.h"
+#include "../resources/image_writer.h"
+#include "../resources/mapped_bmp.h"
+#include "../resources/multi_device.h"
 #include "../resources/my_complex.h"
 #include "../resources/mybmpwriter.h"
+#include "../resources/perturbation.h"
+#include "../resources/precision.h"
+#include "../resources/renderer.h"
+#include "../resources/tile_server.h"
+#include "../resources/trace.h"
+#include "../resources/y4m_writer.h"
 #include "../resources/zoom.h"
 
-int main(void) {
+//backends a video can be rendered with
+#define BACKEND_AUTO 0
+#define BACKEND_OPENCL 1
+#define BACKEND_CPU 2
+
+//center of a deep zoom if --center isn't given, a point at the border of the
+//set in the valley between the main cardioid and the period-2 bulb
+#define DEEP_ZOOM_CENTER "0.743643887037158704752191506114774," \
+		"-0.131825904205311970493132056385139"
+
+//where the previews of a progressively rendered frame go
+typedef struct preview_context {
+	image_writer_t * writer;
+	long x_mon;
+	long y_mon;
+	long frame;
+} preview_context_t;
+
+/**
+ * Hands a frame that has been read back to the image writer, which writes it
+ * to its bmp file in the background, or appends it to the video stream.
+ *
+ * @param writer The image writer.
+ * @param stream The video stream or NULL to write bmp files.
+ * @param x_mon Resolution of the monitor on the horizontal axis.
+ * @param y_mon Resolution of the monitor on the vertical axis.
+ * @param frame The number of the frame.
+ * @param image The image values, or NULL if the frame has been read back
+ *        into its mapped bmp file already.
+ * @param yuv The frame converted for the stream by the device, or NULL to
+ *        convert the image on the host.
+ * @param statistic The number of iterations the interior check saved or, in
+ *        a deep zoom, the number of rebases.
+ * @param statistic_name What the statistic counts.
+ * @param tier How the frame was calculated, like its precision tier.
+ * @param compute_ms The device time of the frame or a negative value if it
+ *        isn't known.
+ */
+static void write_frame(image_writer_t * writer, y4m_writer_t * stream,
+		const long x_mon, const long y_mon, const long frame,
+		unsigned char * image, const unsigned char * yuv,
+		const unsigned long statistic, const char * statistic_name,
+		const char * tier, const double compute_ms) {
+	char filename[50];
+	sprintf(filename, "img-%ld.bmp", frame);
+
+	if (stream != NULL) {
+		// The frames go to the stream in order, on this thread
+		int failed = (yuv != NULL) ? y4m_writer_write(stream, yuv) :
+				y4m_writer_write_image(stream, image);
+		if (failed) {
+			fprintf(stderr, "Error: Failed to write frame %ld\n", frame);
+		}
+	} else if (image != NULL
+			&& image_writer_submit(writer, x_mon, y_mon, image, filename)
+					!= 0) {
+		// no memory to encode the image, write it on this thread
+		safe_image_to_bmp(x_mon, y_mon, image, filename);
+	}
+
+	printf("%ld (%lu %s, %s", frame + 1, statistic, statistic_name, tier);
+	if (compute_ms >= 0) {
+		printf(", %.2f ms", compute_ms);
+	}
+	printf(")\n");
+	fflush(stdout);
+}
+
+/**
+ * Waits for the last frames, closes the image writer and the video stream
+ * and prints what was written.
+ *
+ * @param writer The image writer.
+ * @param stream The video stream or NULL.
+ */
+static void close_outputs(image_writer_t * writer, y4m_writer_t * stream) {
+	image_writer_close(writer);
+
+	if (stream != NULL) {
+		y4m_writer_close(stream);
+		printf("Video stream: %ld frames written, %ld failed\n",
+				stream->frames, stream->errors);
+	} else {
+		printf("Image writer: %ld images written, %ld failed, %ld stalls\n",
+				writer->written, writer->errors, writer->stalls);
+	}
+}
+
+/**
+ * Unmaps the bmp file a frame has been read back into, if it has one.
+ *
+ * @param output The mapped file of the frame.
+ * @param frame The number of the frame.
+ */
+static void close_output(mapped_bmp_t * output, const long frame) {
+	if (output->map != NULL && mapped_bmp_close(output) != 0) {
+		fprintf(stderr, "Error: Failed to write img-%ld.bmp\n", frame);
+	}
+}
+
+/**
+ * Hands the preview of a progressively rendered frame to the image writer,
+ * which writes it as img-FRAME-preview-PASS.bmp.
+ *
+ * @param context The preview_context_t of the frame.
+ * @param pass The number of the pass, from 0.
+ * @param step The distance of the calculated pixels of the preview.
+ * @param image The preview.
+ * @param elapsed_ms The time since the frame was started.
+ */
+static void write_preview(void * context, const int pass, const int step,
+		const unsigned char * image, const double elapsed_ms) {
+	preview_context_t * preview = (preview_context_t *) context;
+	char filename[50];
+	sprintf(filename, "img-%ld-preview-%d.bmp", preview->frame, pass);
+
+	if (image_writer_submit(preview->writer, preview->x_mon, preview->y_mon,
+			image, filename) != 0) {
+		fprintf(stderr, "Error: Failed to write %s\n", filename);
+	}
+
+	printf("%ld preview of 1/%d of the pixels after %.2f ms\n",
+			preview->frame + 1, step * step, elapsed_ms);
+}
+
+/**
+ * Calculates the number of iterations of the next frame, which rises with
+ * the zoom.
+ *
+ * @param itr The number of iterations of the current frame.
+ * @param reduction The zoom speed in percentage.
+ * @param max_iterations The greatest number of iterations, 0 for no limit.
+ * @return The number of iterations of the next frame.
+ */
+static long next_iterations(const long itr, const float reduction,
+		const long max_iterations) {
+	long next = (long) (itr + itr * reduction / 100);
+
+	if (max_iterations > 0 && next > max_iterations) {
+		next = max_iterations;
+	}
+
+	return next;
+}
+
+/**
+ * Follows the zoom from the first frame to the last one and plans the
+ * exponential map all frames after the first are taken from.
+ *
+ * @param map The map, initialized for the number of frames.
+ * @param x_min Smallest X-value of the plane section of the first frame.
+ * @param x_max Greatest X-value of the plane section of the first frame.
+ * @param y_min Smallest Y-value of the plane section of the first frame.
+ * @param y_max Greatest Y-value of the plane section of the first frame.
+ * @param x_mon Resolution of the monitor on the horizontal axis.
+ * @param y_mon Resolution of the monitor on the vertical axis.
+ * @param itr The number of iterations of the first frame.
+ * @param reduction The zoom speed in percentage.
+ * @param max_iterations The greatest number of iterations, 0 for no limit.
+ * @param zoom_dot The dot the video zooms into.
+ * @return 0 on success, -1 if the map is too large or saves nothing.
+ */
+static int plan_exp_map(exp_map_t * map, double x_min, double x_max,
+		double y_min, double y_max, const long x_mon, const long y_mon,
+		long itr, const float reduction, const long max_iterations,
+		const my_complex_t zoom_dot) {
+	for (long n = 0; n < map->number_frames; ++n) {
+		double * plane = map->planes + n * 4;
+		plane[0] = x_min;
+		plane[1] = x_max;
+		plane[2] = y_min;
+		plane[3] = y_max;
+		map->iterations[n] = itr;
+
+		reduce_plane_section_focus_dot(&x_min, &x_max, &y_min, &y_max,
+				reduction, zoom_dot);
+		itr = next_iterations(itr, reduction, max_iterations);
+	}
+
+	if (exp_map_plan(map, x_mon, y_mon, zoom_dot) != 0
+			|| map->samples >= map->frame_samples) {
+		return -1;
+	}
+
+	return 0;
+}
+
+int main(int argc, char **argv) {
 	//###############################################
 	//
 	// Declare variables for OpenCL
@@ -32,17 +231,21 @@ int main(void) {
 	//###############################################
 	int err;               // error code returned from OpenCL calls
 
-	size_t global;                  // global domain size
-
-	cl_device_id device_id;     // compute device id
-	cl_context context;       // compute context
-	cl_command_queue commands;      // compute command queue
-	cl_program program;       // compute program
-	cl_kernel ko_calculate_imagerowdots_iterations;       // compute kernel
-	cl_kernel ko_calculate_colorrow;       // compute kernel
-
-	cl_mem d_a;                    // device memory used for the input  a vector
-	cl_mem d_b;                    // device memory
+	cl_device_id device_id = NULL;     // compute device id
+	renderer_t * renderer;          // device, context and kernel variants
+	renderer_frame_t frame;         // what the current frame calculates
+
+	frame_pipeline_t pipeline;     // frames computed or read back right now
+	frame_slot_t * slot;           // pipeline slot of the current frame
+	image_writer_t writer;         // writes the finished frames
+	y4m_writer_t y4m;              // video stream, with --y4m
+	y4m_writer_t * stream = NULL;  // the video stream or NULL for bmp files
+	mapped_bmp_t outputs[FRAME_PIPELINE_MAX_DEPTH]; // with --mmap-output
+	perturbation_t perturbation;   // reference orbit, with --deep-zoom
+	exp_map_t map = { 0 };         // exponential map, with --exp-map
+	int map_ready = 0;             // 1 once the map has been calculated
+	int failed = 0;                // 1 once a frame failed
+	trace_t trace;                 // timeline of the frames, with --trace
 
 	int i;
 
@@ -52,11 +255,12 @@ int main(void) {
 	//
 	//###############################################
 
-	//plane section values
-	float x_ebene_min = -1;
-	float y_ebene_min = -1;
-	float x_ebene_max = 2;
-	float y_ebene_max = 1;
+	//plane section values, in double so the precise tiers can zoom deeper
+	//than float
+	double x_ebene_min = -1;
+	double y_ebene_min = -1;
+	double x_ebene_max = 2;
+	double y_ebene_max = 1;
 
 	//monitor resolution values
 	const long x_mon = 640;
@@ -74,340 +278,573 @@ int main(void) {
 	//video duration in seconds
 	long video_duration = 3;
 
+	//Number of frames of the video, set with --frames=N
+	long number_frames = fps * video_duration;
+
+	//Greatest number of iterations of a frame, 0 for no limit. Set with
+	//--max-iterations=N, as deep zooms need long videos.
+	long max_iterations = 0;
+
 	//zoom speed in percentage
 	float reduction = 5;
 
 	//zoom dot
 	my_complex_t zoom_dot;
 
-	//###############################################
-	//
-	// Set up platform and GPU device
-	//
-	//###############################################
-
-	cl_uint numPlatforms;
+	//1 to calculate iterations and colors in one fused kernel, 0 to use
+	//separate kernels for them
+	short fused_kernel = 1;
+
+	//Number of frames the device may work on while finished frames are
+	//read back and written, set with --frames-in-flight=N
+	int frames_in_flight = 3;
+
+	//Number of threads writing the image files, set with --io-threads=N
+	int io_threads = 2;
+
+	//Number of finished frames that may wait for the image writer before
+	//the render loop is stalled, set with --write-queue=N
+	int write_queue_capacity = 4;
+
+	//Backend to render with: --backend=opencl, --backend=cpu or
+	//--backend=auto, which uses the CPU if there is no OpenCL device
+	int backend = BACKEND_AUTO;
+
+	//Number of iterations the kernel calculates between two branches
+	int unroll = 4;
+
+	//1 to test |z|^2 against the squared abort value in the kernel. Saves
+	//the square root, but the results may differ from the CPU backend.
+	int magnitude_squared = 0;
+
+	//1 to end the iteration early for points in the main cardioid or the
+	//period-2 bulb and for periodic orbits
+	int interior_check = 1;
+
+	//1 to render with the Mariani-Silver subdivision, which only calculates
+	//the borders of uniform rectangles; --brute-force also renders every
+	//point and prints where the two differ
+	int subdivide = 0;
+	int brute_force = 0;
+
+	//1 to zoom beyond the precision of float with perturbation around the
+	//center set with --center=RE,IM
+	int deep_zoom = 0;
+	const char *center = DEEP_ZOOM_CENTER;
+
+	//1 to calculate the float frames with the persistent kernel, whose
+	//work-groups take tiles from a tile counter until the image is done
+	int persistent = 0;
+
+	//1 to calculate only the first frame and an exponential map around the
+	//zoom dot, which all following frames are taken from
+	int exp_map = 0;
+
+	//1 to spread every frame over all OpenCL devices, which may be split
+	//into sub-devices with --sub-devices=numa or --sub-devices=N, N compute
+	//units each
+	int multi_device = 0;
+	int sub_devices = MULTI_DEVICE_SPLIT_NONE;
+
+	//File to write all frames to as one YUV4MPEG2 stream, "-" for stdout,
+	//set with --y4m=PATH. Without it every frame is written as bmp file.
+	const char *y4m_path = NULL;
+
+	//1 to read the frames back from the device straight into their mapped
+	//bmp files, instead of into host memory the image writer copies from
+	int mmap_output = 0;
+
+	//Coloring of the frames: --coloring=linear for the gray steps of the
+	//iteration kernels, smooth for the palette run through with the
+	//fractional iterations, histogram for the palette spread evenly over
+	//the points of each frame
+	int coloring = COLORING_LINEAR;
+
+	//1 to render the float frames coarse to fine, writing a preview after
+	//1/16 and 1/4 of the pixels, before the frame itself
+	int progressive = 0;
+
+	//unix socket to serve tiles on instead of rendering a video, set with
+	//--serve=PATH, and the number of encoded tiles the server keeps, set
+	//with --tile-cache=N
+	const char *serve_path = NULL;
+	long tile_cache = 256;
+
+	//directory of the iteration cache, set with --iteration-cache=DIR, which
+	//keeps the iteration values of the frames across runs, and its size in
+	//megabytes, set with --iteration-cache-size=MB
+	const char *iteration_cache_dir = NULL;
+	long iteration_cache_mb = 512;
+
+	//file to write a timeline of the host and device stages of every frame
+	//to, set with --trace=PATH, for the Chrome trace viewer or Perfetto
+	const char *trace_path = NULL;
+
+	//Precision tier of the kernels: --precision=auto picks float, df64 or
+	//double for each frame from its pixel spacing
+	int precision = PRECISION_AUTO;
+
+	//1 to keep compiled programs in the program cache directory, which is
+	//set with --program-cache=DIR or chosen by program_cache_init
+	int use_program_cache = 1;
+	const char *program_cache_dir = NULL;
+
+	for (i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--backend=auto") == 0) {
+			backend = BACKEND_AUTO;
+		} else if (strcmp(argv[i], "--backend=opencl") == 0) {
+			backend = BACKEND_OPENCL;
+		} else if (strcmp(argv[i], "--backend=cpu") == 0) {
+			backend = BACKEND_CPU;
+		} else if (strncmp(argv[i], "--unroll=", 9) == 0) {
+			unroll = atoi(argv[i] + 9);
+		} else if (strcmp(argv[i], "--magnitude-squared") == 0) {
+			magnitude_squared = 1;
+		} else if (strcmp(argv[i], "--no-interior-check") == 0) {
+			interior_check = 0;
+		} else if (strcmp(argv[i], "--subdivide") == 0) {
+			subdivide = 1;
+		} else if (strcmp(argv[i], "--brute-force") == 0) {
+			brute_force = 1;
+		} else if (strcmp(argv[i], "--deep-zoom") == 0) {
+			deep_zoom = 1;
+		} else if (strcmp(argv[i], "--persistent") == 0) {
+			persistent = 1;
+		} else if (strcmp(argv[i], "--progressive") == 0) {
+			progressive = 1;
+		} else if (strcmp(argv[i], "--exp-map") == 0) {
+			exp_map = 1;
+		} else if (strcmp(argv[i], "--multi-device") == 0) {
+			multi_device = 1;
+		} else if (strcmp(argv[i], "--sub-devices=numa") == 0) {
+			sub_devices = MULTI_DEVICE_SPLIT_NUMA;
+		} else if (strncmp(argv[i], "--sub-devices=", 14) == 0
+				&& atoi(argv[i] + 14) > 0) {
+			sub_devices = atoi(argv[i] + 14);
+		} else if (strcmp(argv[i], "--mmap-output") == 0) {
+			mmap_output = 1;
+		} else if (strncmp(argv[i], "--y4m=", 6) == 0) {
+			y4m_path = argv[i] + 6;
+		} else if (strncmp(argv[i], "--coloring=", 11) == 0
+				&& coloring_parse(argv[i] + 11) >= 0) {
+			coloring = coloring_parse(argv[i] + 11);
+		} else if (strncmp(argv[i], "--serve=", 8) == 0) {
+			serve_path = argv[i] + 8;
+		} else if (strncmp(argv[i], "--tile-cache=", 13) == 0
+				&& atol(argv[i] + 13) > 0) {
+			tile_cache = atol(argv[i] + 13);
+		} else if (strncmp(argv[i], "--iteration-cache=", 18) == 0) {
+			iteration_cache_dir = argv[i] + 18;
+		} else if (strncmp(argv[i], "--iteration-cache-size=", 23) == 0
+				&& atol(argv[i] + 23) > 0) {
+			iteration_cache_mb = atol(argv[i] + 23);
+		} else if (strncmp(argv[i], "--trace=", 8) == 0) {
+			trace_path = argv[i] + 8;
+		} else if (strncmp(argv[i], "--center=", 9) == 0) {
+			center = argv[i] + 9;
+		} else if (strncmp(argv[i], "--frames=", 9) == 0) {
+			number_frames = atol(argv[i] + 9);
+		} else if (strncmp(argv[i], "--frames-in-flight=", 19) == 0
+				&& atoi(argv[i] + 19) >= 1
+				&& atoi(argv[i] + 19) <= FRAME_PIPELINE_MAX_DEPTH) {
+			frames_in_flight = atoi(argv[i] + 19);
+		} else if (strncmp(argv[i], "--io-threads=", 13) == 0
+				&& atoi(argv[i] + 13) >= 1
+				&& atoi(argv[i] + 13) <= IMAGE_WRITER_MAX_THREADS) {
+			io_threads = atoi(argv[i] + 13);
+		} else if (strncmp(argv[i], "--write-queue=", 14) == 0
+				&& atoi(argv[i] + 14) >= 1) {
+			write_queue_capacity = atoi(argv[i] + 14);
+		} else if (strncmp(argv[i], "--max-iterations=", 17) == 0) {
+			max_iterations = atol(argv[i] + 17);
+		} else if (strncmp(argv[i], "--precision=", 12) == 0
+				&& precision_parse(argv[i] + 12) >= PRECISION_AUTO) {
+			precision = precision_parse(argv[i] + 12);
+		} else if (strncmp(argv[i], "--program-cache=", 16) == 0) {
+			program_cache_dir = argv[i] + 16;
+		} else if (strcmp(argv[i], "--no-program-cache") == 0) {
+			use_program_cache = 0;
+		} else {
+			printf("Unknown option %s\n", argv[i]);
+			printf("Usage: %s [--backend=auto|opencl|cpu] [--unroll=N] "
+					"[--magnitude-squared] [--no-interior-check] "
+					"[--persistent] [--progressive] "
+					"[--subdivide [--brute-force]] "
+					"[--deep-zoom [--center=RE,IM]] [--exp-map] "
+					"[--multi-device [--sub-devices=numa|N]] [--frames=N] "
+					"[--frames-in-flight=1..%d] [--io-threads=1..%d] "
+					"[--write-queue=N] "
+					"[--max-iterations=N] [--precision=auto|float|df64|double] "
+					"[--y4m=PATH|-] [--mmap-output] "
+					"[--coloring=linear|smooth|histogram] "
+					"[--serve=PATH [--tile-cache=N]] "
+					"[--iteration-cache=DIR [--iteration-cache-size=MB]] "
+					"[--trace=PATH] "
+					"[--program-cache=DIR] "
+					"[--no-program-cache]\n", argv[0],
+					FRAME_PIPELINE_MAX_DEPTH, IMAGE_WRITER_MAX_THREADS);
+			return EXIT_FAILURE;
+		}
+	}
 
-	// Find number of platforms
-	err = clGetPlatformIDs(0, NULL, &numPlatforms);
-	checkError(err, "Finding platforms");
-	if (numPlatforms == 0) {
-		printf("Found 0 platforms!\n");
+	// The exponential map is float and needs the zoom dot of the first frame
+	if (exp_map && (deep_zoom || subdivide)) {
+		printf("--exp-map can't be combined with --deep-zoom or "
+				"--subdivide\n");
 		return EXIT_FAILURE;
 	}
 
-	// Get all platforms
-	cl_platform_id Platform[numPlatforms];
-	err = clGetPlatformIDs(numPlatforms, Platform, NULL);
-	checkError(err, "Getting platforms");
+	// The devices only share the float frames of the plain renderer
+	if (multi_device && (deep_zoom || exp_map || subdivide || persistent)) {
+		printf("--multi-device can't be combined with --deep-zoom, "
+				"--exp-map, --subdivide or --persistent\n");
+		return EXIT_FAILURE;
+	}
 
-	// Secure a GPU
-	for (i = 0; i < numPlatforms; i++) {
-		err = clGetDeviceIDs(Platform[i], DEVICE, 1, &device_id, NULL);
-		if (err == CL_SUCCESS) {
-			break;
+	// The deep zoom starts with the pixel spacing of the plane section
+	if (deep_zoom) {
+		if (subdivide) {
+			printf("--deep-zoom can't be combined with --subdivide\n");
+			return EXIT_FAILURE;
+		}
+		perturbation_init(&perturbation, 0, 0,
+				delta(x_ebene_min, x_ebene_max, x_mon));
+		if (perturbation_set_center(&perturbation, center) != 0) {
+			printf("Invalid center %s\n", center);
+			return EXIT_FAILURE;
 		}
 	}
 
-	if (device_id == NULL)
-		checkError(err, "Finding a device");
+	// The tiles are rendered in the context of one device
+	if (serve_path != NULL && multi_device) {
+		printf("--serve can't be combined with --multi-device\n");
+		return EXIT_FAILURE;
+	}
+
+	// The passes are a variant of the fused kernel
+	if (progressive && (deep_zoom || exp_map || subdivide || persistent
+			|| multi_device || coloring != COLORING_LINEAR)) {
+		printf("--progressive can't be combined with --deep-zoom, "
+				"--exp-map, --subdivide, --persistent, --multi-device or "
+				"--coloring\n");
+		return EXIT_FAILURE;
+	}
+
+	// The frames of the map are colored inside the map kernel
+	if (exp_map && coloring != COLORING_LINEAR) {
+		printf("--exp-map can't be combined with --coloring\n");
+		return EXIT_FAILURE;
+	}
+
+	if (mmap_output && y4m_path != NULL) {
+		printf("--mmap-output can't be combined with --y4m\n");
+		return EXIT_FAILURE;
+	}
+
+	// Opened before anything is printed, as printing goes to stderr when
+	// the stream is written to stdout
+	if (y4m_path != NULL) {
+		if (y4m_writer_open(&y4m, y4m_path, x_mon, y_mon, fps) != 0) {
+			fprintf(stderr, "Failed to open the video stream %s\n",
+					y4m_path);
+			return EXIT_FAILURE;
+		}
+		stream = &y4m;
+	}
 
-	err = output_device_info(device_id);
-	checkError(err, "Printing device output");
+	if (image_writer_init(&writer, io_threads, write_queue_capacity) != 0) {
+		printf("Error: Failed to start the image writer!\n");
+		return EXIT_FAILURE;
+	}
 
 	//###############################################
 	//
-	// Create context, command queue and kernel
+	// Set up platform and GPU device
 	//
 	//###############################################
 
-	// Create a compute context
-	context = clCreateContext(0, 1, &device_id, NULL, NULL, &err);
-	checkError(err, "Creating context");
-
-	// Create a command queue
-	commands = clCreateCommandQueue(context, device_id, 0, &err);
-	checkError(err, "Creating command queue");
-
-	//Read Kernel source
-	FILE *fp;
-	char *source_str;
-	size_t source_size, program_size;
+	if (backend != BACKEND_CPU) {
+		device_id = renderer_find_device(DEVICE, &err);
 
-	fp = fopen("./kernel/calculate_iterations.cl", "r");
-	if (!fp) {
-		printf("Failed to load kernel\n");
-		return 1;
+		if (device_id == NULL) {
+			if (backend == BACKEND_OPENCL) {
+				checkError(err, "Finding a device");
+			}
+			printf("Found no OpenCL device, using the CPU backend\n");
+			backend = BACKEND_CPU;
+		}
 	}
 
-	fseek(fp, 0, SEEK_END);
-	program_size = ftell(fp);
-	rewind(fp);
-	source_str = (char*) malloc(program_size + 1);
-	source_str[program_size] = '\0';
-	fread(source_str, sizeof(char), program_size, fp);
-	fclose(fp);
-
-	// Create the compute program from the source buffer
-	program = clCreateProgramWithSource(context, 1, (const char **) &source_str,
-	NULL, &err);
-
-	checkError(err, "Creating program");
+	// The palette coloring and the iteration cache only run in the single
+	// device renderer
+	if ((backend == BACKEND_CPU || multi_device)
+			&& coloring != COLORING_LINEAR) {
+		printf("--coloring=%s needs a single OpenCL device, coloring "
+				"linearly\n", coloring_name(coloring));
+		coloring = COLORING_LINEAR;
+	}
+	if ((backend == BACKEND_CPU || multi_device)
+			&& iteration_cache_dir != NULL) {
+		printf("--iteration-cache needs a single OpenCL device, rendering "
+				"every frame\n");
+	}
 
-	// Build the program
-	err = clBuildProgram(program, 0, NULL, NULL, NULL, NULL);
-	if (err != CL_SUCCESS) {
-		size_t len;
-		char buffer[2048];
+	if (backend == BACKEND_CPU && serve_path != NULL) {
+		printf("--serve needs an OpenCL device\n");
+		return EXIT_FAILURE;
+	}
 
-		printf("Error: Failed to build program executable!\n%s\n",
-				err_code(err));
-		clGetProgramBuildInfo(program, device_id, CL_PROGRAM_BUILD_LOG,
-				sizeof(buffer), buffer, &len);
-		printf("%s\n", buffer);
+	if (backend == BACKEND_CPU && progressive) {
+		printf("--progressive needs the OpenCL backend, rendering whole "
+				"frames\n");
+	}
 
-		// Determine the size of the log
-		size_t log_size;
-		clGetProgramBuildInfo(program, device_id, CL_PROGRAM_BUILD_LOG, 0, NULL,
-				&log_size);
+	// The other renderers write their frames through the image writer
+	if ((backend == BACKEND_CPU || multi_device) && mmap_output) {
+		printf("--mmap-output needs a single OpenCL device, writing the "
+				"images through the image writer\n");
+		mmap_output = 0;
+	}
 
-		// Allocate memory for the log
-		char *log = (char *) malloc(log_size);
+	// Only the frames of the single device renderer are traced
+	if ((backend == BACKEND_CPU || multi_device || serve_path != NULL)
+			&& trace_path != NULL) {
+		printf("--trace needs a single OpenCL device rendering a video, "
+				"tracing nothing\n");
+		trace_path = NULL;
+	}
 
-		// Get the log
-		clGetProgramBuildInfo(program, device_id, CL_PROGRAM_BUILD_LOG,
-				log_size, log, NULL);
+	if (backend != BACKEND_CPU && !multi_device) {
+		err = output_device_info(device_id);
+		checkError(err, "Printing device output");
+	}
 
-		// Print the log
-		printf("%s\n", log);
+	//###############################################
+	//
+	// Create the renderer
+	//
+	//###############################################
 
+	if (trace_init(&trace, trace_path) != 0) {
+		printf("Error: Failed to open the trace %s!\n", trace_path);
 		return EXIT_FAILURE;
 	}
+	image_writer_set_trace(&writer, trace.enabled ? &trace : NULL);
+
+	// The renderer owns the context, the command queues, the program cache,
+	// the kernel variants, the frame buffers and the state of the modes.
+	// Each kernel variant is built the first time a frame needs it. The
+	// CPU backend and the multi-device renderer take the same frames.
+	renderer_options_t renderer_options;
+	renderer_options_init(&renderer_options);
+	renderer_options.backend = (backend == BACKEND_CPU) ?
+			RENDERER_BACKEND_CPU :
+			multi_device ? RENDERER_BACKEND_MULTI_DEVICE :
+			RENDERER_BACKEND_OPENCL;
+	renderer_options.sub_devices = sub_devices;
+	renderer_options.device_id = device_id;
+	renderer_options.abort_value = abort_value;
+	renderer_options.unroll = unroll;
+	renderer_options.magnitude_squared = magnitude_squared;
+	renderer_options.interior_check = interior_check;
+	renderer_options.precision = precision;
+	renderer_options.use_program_cache = use_program_cache;
+	renderer_options.program_cache_dir = program_cache_dir;
+	renderer_options.fused_kernel = fused_kernel;
+	renderer_options.subdivide = subdivide;
+	renderer_options.brute_force = brute_force;
+	renderer_options.persistent = persistent;
+	renderer_options.progressive = progressive;
+	renderer_options.coloring = coloring;
+	renderer_options.iteration_cache_dir = iteration_cache_dir;
+	renderer_options.iteration_cache_bytes = iteration_cache_mb * 1024LL
+			* 1024LL;
+	renderer_options.trace = &trace;
+	renderer = renderer_create(&renderer_options, &err);
+	checkError(err, "Creating renderer");
+
+	// The server renders all its tiles with the renderer, instead of
+	// rendering a video
+	if (serve_path != NULL) {
+		tile_server_t server;
+
+		if (tile_server_init(&server, serve_path, renderer, tile_cache)
+				!= 0) {
+			printf("Error: Failed to serve tiles on %s!\n", serve_path);
+			return EXIT_FAILURE;
+		}
+		int result = tile_server_run(&server);
 
-	// Create the compute kernel from the program
-	ko_calculate_imagerowdots_iterations = clCreateKernel(program,
-			"calculate_imagerowdots_iterations", &err);
-	checkError(err, "Creating kernel");
-
-	// Create the compute kernel from the program
-	ko_calculate_colorrow = clCreateKernel(program, "calculate_colorrow", &err);
-	checkError(err, "Creating kernel");
-
-	int number_images = 0;
-	do {
-		//Get memory for image
-		long* h_image = (long*) calloc(x_mon * y_mon, sizeof(long));
-		unsigned char* h_image_pixel = (unsigned char*) calloc(
-				x_mon * y_mon * 3, sizeof(unsigned char));
-
-		//###############################################
-		//###############################################
-		//
-		// Loop to calculate image dot iterations
-		//
-		//###############################################
-		//###############################################
+		tile_server_print_stats(&server);
+		tile_server_release(&server);
+		close_outputs(&writer, stream);
+		renderer_print_stats(renderer);
+		renderer_release(renderer);
 
-		float y_value = y_ebene_max;
-		float delta_y = delta(y_ebene_min, y_ebene_max, y_mon);
+		return (result == 0) ? 0 : EXIT_FAILURE;
+	}
 
-		for (int row = 0; row < y_mon; ++row) {
-			//###############################################
-			//
-			// Create and write buffer
-			//
-			//###############################################
+	// Only a single device converts the frames for the stream
+	int device_yuv = (stream != NULL
+			&& renderer_options.backend == RENDERER_BACKEND_OPENCL);
 
-			//Get memory for row
-			long* h_image_row = (long*) calloc(x_mon, sizeof(long)); // a vector
+	frame_pipeline_init(&pipeline, frames_in_flight);
+	for (i = 0; i < FRAME_PIPELINE_MAX_DEPTH; ++i) {
+		mapped_bmp_init(&outputs[i]);
+	}
 
-			d_a = clCreateBuffer(context, CL_MEM_READ_WRITE,
-					sizeof(long) * x_mon,
-					NULL, &err);
-			checkError(err, "Creating buffer d_a");
+	for (long number_images = 0; number_images < number_frames;
+			++number_images) {
+		// The slot still holds an earlier frame: write it out first
+		slot = frame_pipeline_slot(&pipeline, number_images);
+		if (slot->frame >= 0) {
+			double waited = trace_begin(&trace);
+			err = renderer_wait_frame(renderer, slot);
+			checkError(err, "Waiting for frame");
+			trace_host_span(&trace, "wait for frame", slot->frame,
+					TRACE_TRACK_HOST, waited);
+			trace_collect(&trace);
+			close_output(&outputs[slot->index], slot->frame);
+
+			// With a stream the device converted the frame to YUV already
+			int from_map = (map_ready && slot->frame > 0);
+			double written = trace_begin(&trace);
+			write_frame(&writer, stream, x_mon, y_mon, slot->frame,
+					mmap_output ? NULL : slot->h_image_pixel,
+					device_yuv ? slot->h_image_pixel : NULL,
+					(unsigned long) slot->saved_iterations,
+					deep_zoom ? "rebases" : "iterations saved",
+					multi_device ? "multi-device" :
+					deep_zoom ? "perturbation" :
+					from_map ? "exp-map" : precision_name(slot->precision),
+					slot->compute_ms);
+			trace_host_span(&trace, "write frame", slot->frame,
+					TRACE_TRACK_HOST, written);
+			frame_pipeline_retire(&pipeline, slot);
+		}
 
-			// Write a vector into compute device memory
-			err = clEnqueueWriteBuffer(commands, d_a, CL_TRUE, 0,
-					sizeof(long) * x_mon, h_image_row, 0, NULL, NULL);
-			checkError(err, "Copying h_a to device at d_a");
+		double enqueued = trace_begin(&trace);
+
+		// The iteration values are only needed to find the zoom dot
+		memset(&frame, 0, sizeof(frame));
+		frame.number = number_images;
+		frame.x_min = x_ebene_min;
+		frame.x_max = x_ebene_max;
+		frame.y_min = y_ebene_min;
+		frame.y_max = y_ebene_max;
+		frame.x_mon = x_mon;
+		frame.y_mon = y_mon;
+		frame.itr = itr;
+		frame.perturbation = deep_zoom ? &perturbation : NULL;
+		frame.map = map_ready ? &map : NULL;
+		frame.yuv = device_yuv;
+		frame.export_values = (number_images == 0 && !deep_zoom);
+
+		preview_context_t preview_context = { &writer, x_mon, y_mon,
+				number_images };
+		if (progressive) {
+			frame.preview = write_preview;
+			frame.preview_context = &preview_context;
+		}
 
-			//###############################################
-			//
-			// Set the arguments to our compute kernel
-			//
-			//###############################################
+		if (mmap_output) {
+			mapped_bmp_t * output = &outputs[slot->index];
+			char filename[50];
+			sprintf(filename, "img-%ld.bmp", number_images);
 
-			err = clSetKernelArg(ko_calculate_imagerowdots_iterations, 0,
-					sizeof(float), &x_ebene_min);
-			err |= clSetKernelArg(ko_calculate_imagerowdots_iterations, 1,
-					sizeof(float), &x_ebene_max);
-			err |= clSetKernelArg(ko_calculate_imagerowdots_iterations, 2,
-					sizeof(float), &y_value);
-			err |= clSetKernelArg(ko_calculate_imagerowdots_iterations, 3,
-					sizeof(long), &x_mon);
-			err |= clSetKernelArg(ko_calculate_imagerowdots_iterations, 4,
-					sizeof(float), &abort_value);
-			err |= clSetKernelArg(ko_calculate_imagerowdots_iterations, 5,
-					sizeof(long), &itr);
-			err |= clSetKernelArg(ko_calculate_imagerowdots_iterations, 6,
-					sizeof(cl_mem), &d_a);
-			checkError(err, "Setting kernel arguments");
-
-			/*__kernel void calculate_imagerowdots_iterations(const float x_min, const float x_max,
-			 const float y_value, const long x_mon, const float abort_value, const long itr,
-			 __global long * imagerow)*/
-
-			// Execute the kernel over the entire range of our 1d input data set
-			// letting the OpenCL runtime choose the work-group size
-			global = x_mon;
-			err = clEnqueueNDRangeKernel(commands,
-					ko_calculate_imagerowdots_iterations, 1, NULL, &global,
-					NULL, 0,
-					NULL, NULL);
-			checkError(err, "Enqueueing kernel");
-
-			// Wait for the commands to complete
-			err = clFinish(commands);
-			checkError(err, "Waiting for kernel to finish");
-
-			// Read back the results from the compute device
-			err = clEnqueueReadBuffer(commands, d_a, CL_TRUE, 0,
-					sizeof(long) * x_mon, h_image_row, 0, NULL, NULL);
-			if (err != CL_SUCCESS) {
-				printf("Error: Failed to read output array!\n%s\n",
-						err_code(err));
-				exit(1);
+			if (mapped_bmp_create(output, filename, x_mon, y_mon) != 0) {
+				printf("Error: Failed to map %s!\n", filename);
+				return EXIT_FAILURE;
 			}
-
-			//reduce y
-			y_value -= delta_y;
-
-			//cope row to image
-			memcpy(h_image + row * x_mon, h_image_row, sizeof(long) * x_mon);
-
-			free(h_image_row);
+			frame.output = output;
 		}
 
-//		for (i = 0; i < x_mon * y_mon; ++i) {
-//			printf("%ld ", h_image[i]);
-//		}
-//		fflush(stdout);
-
-		//###############################################
-		//###############################################
-		//
-		// End of loop to calculate image dot iterations
-		//
-		//###############################################
-		//###############################################
-
-		//###############################################
-		//###############################################
-		//
-		// Beginn color calculation
-		//
-		//###############################################
-		//###############################################
-
-		for (int row = 0; row < y_mon; ++row) {
-			//Get memory for row
-			long* h_image_row = (long*) calloc(x_mon, sizeof(long)); // a vector
-			memcpy(h_image_row, h_image + row * x_mon, sizeof(long) * x_mon);
-
-			d_a = clCreateBuffer(context, CL_MEM_READ_ONLY,
-					sizeof(long) * x_mon,
-					NULL, &err);
-			checkError(err, "Creating buffer d_a");
-
-			// Write a vector into compute device memory
-			err = clEnqueueWriteBuffer(commands, d_a, CL_TRUE, 0,
-					sizeof(long) * x_mon, h_image_row, 0, NULL, NULL);
-			checkError(err, "Copying h_image_row to device at d_a");
-
-			unsigned char* h_imagepixel_row = (unsigned char*) calloc(x_mon * 3,
-					sizeof(unsigned char));     // a vector
-
-			d_b = clCreateBuffer(context, CL_MEM_READ_WRITE,
-					sizeof(unsigned char) * x_mon * 3,
-					NULL, &err);
-			checkError(err, "Creating buffer d_b");
-
-			// Write a vector into compute device memory
-			err = clEnqueueWriteBuffer(commands, d_b, CL_TRUE, 0,
-					sizeof(unsigned char) * x_mon * 3, h_imagepixel_row, 0,
-					NULL, NULL);
-			checkError(err, "Copying h_imagepixel_row to device at d_b");
+		err = renderer_enqueue_frame(renderer, &frame, slot);
+		if (err != CL_SUCCESS) {
+			printf("Error: Failed to render frame %ld! %s\n", number_images,
+					err_code(err));
+			frame_pipeline_wait(slot);
+			close_output(&outputs[slot->index], number_images);
+			failed = 1;
+			break;
+		}
+		frame_pipeline_submit(slot, number_images);
+		trace_host_span(&trace, "enqueue frame", number_images,
+				TRACE_TRACK_HOST, enqueued);
+
+		// The zoom dot is the only value of a frame the following frames
+		// depend on, so only the first frame is waited for
+		if (frame.export_values) {
+			double found = trace_begin(&trace);
+			zoom_dot = find_dot_to_zoom((float) x_ebene_min,
+					(float) x_ebene_max, (float) y_ebene_min,
+					(float) y_ebene_max, frame.values, frame.value_bits,
+					y_mon, x_mon, itr);
+			trace_host_span(&trace, "find zoom dot", number_images,
+					TRACE_TRACK_HOST, found);
+		}
 
+		if (exp_map && number_images == 0 && number_frames > 1) {
 			//###############################################
 			//
-			// Set the arguments to our compute kernel
+			// Calculate the exponential map and the last frame
 			//
 			//###############################################
 
-			err = clSetKernelArg(ko_calculate_colorrow, 0, sizeof(long),
-					&x_mon);
-			err |= clSetKernelArg(ko_calculate_colorrow, 1, sizeof(long), &itr);
-			err |= clSetKernelArg(ko_calculate_colorrow, 2, sizeof(cl_mem),
-					&d_a);
-			err |= clSetKernelArg(ko_calculate_colorrow, 3, sizeof(cl_mem),
-					&d_b);
-			checkError(err, "Setting kernel arguments");
-
-			/*__kernel void calculate_colorrow(const long width, long itr, long * imagerowvalues,
-			 unsigned char * imagerow)*/
-
-			// Execute the kernel over the entire range of our 1d input data set
-			// letting the OpenCL runtime choose the work-group size
-			global = x_mon;
-			err = clEnqueueNDRangeKernel(commands, ko_calculate_colorrow, 1,
-			NULL, &global, NULL, 0,
-			NULL, NULL);
-			checkError(err, "Enqueueing kernel");
-
-			// Wait for the commands to complete
-			err = clFinish(commands);
-			checkError(err, "Waiting for kernel to finish");
-
-			// Read back the results from the compute device
-			err = clEnqueueReadBuffer(commands, d_b, CL_TRUE, 0,
-					sizeof(unsigned char) * x_mon * 3, h_imagepixel_row, 0,
-					NULL, NULL);
-			if (err != CL_SUCCESS) {
-				printf("Error: Failed to read output array!\n%s\n",
-						err_code(err));
-				exit(1);
+			if (exp_map_init(&map, number_frames) != 0) {
+				printf("Error: Failed to allocate host memory!\n");
+				return EXIT_FAILURE;
+			}
+			if (plan_exp_map(&map, x_ebene_min, x_ebene_max, y_ebene_min,
+					y_ebene_max, x_mon, y_mon, itr, reduction, max_iterations,
+					zoom_dot) != 0) {
+				printf("The exponential map saves nothing, "
+						"calculating every frame\n");
+			} else {
+				double mapped = trace_begin(&trace);
+				err = renderer_render_exp_map(renderer, &map);
+				checkError(err, "Calculating the exponential map");
+				trace_host_span(&trace, "exponential map", number_images,
+						TRACE_TRACK_HOST, mapped);
+				map_ready = 1;
 			}
-
-			memcpy(h_image_pixel + row * x_mon * 3, h_imagepixel_row,
-					sizeof(unsigned char) * x_mon * 3);
-
-			free(h_image_row);
-			free(h_imagepixel_row);
 		}
 
-		if (number_images == 0) {
-			zoom_dot = find_dot_to_zoom(x_ebene_min, x_ebene_max, y_ebene_min,
-					y_ebene_max, h_image, y_mon, x_mon, itr);
+		if (deep_zoom) {
+			perturbation_zoom(&perturbation, reduction);
+		} else {
+			reduce_plane_section_focus_dot(&x_ebene_min, &x_ebene_max,
+					&y_ebene_min, &y_ebene_max, reduction, zoom_dot);
 		}
 
-		reduce_plane_section_focus_dot(&x_ebene_min, &x_ebene_max, &y_ebene_min,
-				&y_ebene_max, reduction, zoom_dot);
-
-
-		// save the image
-		char filename[50];
-		sprintf(filename, "img-%d.bmp", number_images);
-
-		safe_image_to_bmp(x_mon, y_mon, h_image_pixel, filename);
-
-		free(h_image);
-		free(h_image_pixel);
+		itr = next_iterations(itr, reduction, max_iterations);
+	}
 
-		number_images++;
-		itr = (long) (itr + itr * reduction / 100);
-		printf("%d\n", number_images);
-		fflush(stdout);
-	} while (number_images < (fps * video_duration));
+	// Write the frames still in flight
+	while ((slot = frame_pipeline_oldest(&pipeline)) != NULL) {
+		double waited = trace_begin(&trace);
+		err = renderer_wait_frame(renderer, slot);
+		checkError(err, "Waiting for frame");
+		trace_host_span(&trace, "wait for frame", slot->frame,
+				TRACE_TRACK_HOST, waited);
+		trace_collect(&trace);
+		close_output(&outputs[slot->index], slot->frame);
+
+		int from_map = (map_ready && slot->frame > 0);
+		double written = trace_begin(&trace);
+		write_frame(&writer, stream, x_mon, y_mon, slot->frame,
+				mmap_output ? NULL : slot->h_image_pixel,
+				device_yuv ? slot->h_image_pixel : NULL,
+				(unsigned long) slot->saved_iterations,
+				deep_zoom ? "rebases" : "iterations saved",
+				multi_device ? "multi-device" :
+				deep_zoom ? "perturbation" :
+				from_map ? "exp-map" : precision_name(slot->precision),
+				slot->compute_ms);
+		trace_host_span(&trace, "write frame", slot->frame,
+				TRACE_TRACK_HOST, written);
+		frame_pipeline_retire(&pipeline, slot);
+	}
 
 	//###############################################
 	//
@@ -415,12 +852,18 @@ int main(void) {
 	//
 	//###############################################
 
-	clReleaseMemObject(d_a);
-	clReleaseMemObject(d_b);
-	clReleaseProgram(program);
-	clReleaseKernel(ko_calculate_imagerowdots_iterations);
-	clReleaseCommandQueue(commands);
-	clReleaseContext(context);
+	close_outputs(&writer, stream);
+	trace_close(&trace);
 
-	return 0;
+	if (deep_zoom) {
+		perturbation_release(&perturbation);
+	}
+	if (map_ready) {
+		exp_map_print_stats(&map);
+	}
+	exp_map_release(&map);
+	renderer_print_stats(renderer);
+	renderer_release(renderer);
+
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
 }
@@ -1,3 +1,92 @@
+// Every multiplication and addition is rounded on its own, so the kernels
+// calculate exactly the same values as the CPU backend, as long as the
+// device also rounds divisions and square roots correctly
+#pragma OPENCL FP_CONTRACT OFF
+
+//###############################################
+//
+// Variant defines, set by the host with -D
+//
+//###############################################
+
+// ESCAPE_RADIUS: compile-time abort value, replaces the abort_value argument
+// ITER_T: type of the iteration counter, int or long
+#ifndef ITER_T
+#define ITER_T long
+#endif
+
+// VALUE_T: type of the stored iteration values of an image, ushort, uint or
+// long. The host picks the narrowest type that holds itr.
+#ifndef VALUE_T
+#define VALUE_T long
+#endif
+
+// UNROLL: number of iterations calculated between two branches
+#ifndef UNROLL
+#define UNROLL 1
+#endif
+
+// MAGNITUDE_SQUARED: compare |z|^2 with the squared radius instead of
+// calculating |z| with a square root. Faster, but the results may differ
+// from the CPU backend in the last bit of the escape test.
+#ifdef MAGNITUDE_SQUARED
+#define ESCAPED(z, radius) !((z).real * (z).real \
+		+ (z).imaginary * (z).imaginary < (radius) * (radius))
+#else
+#define ESCAPED(z, radius) !(sum_complex(z) < (radius))
+#endif
+
+// INTERIOR_CHECK: end the iteration early for points in the main cardioid
+// or the period-2 bulb and for orbits that became periodic
+
+// PRECISION_DF64, PRECISION_DOUBLE: also build calculate_image_pixels_precise,
+// which calculates with double-float (two floats) or double coordinates
+#ifdef PRECISION_DOUBLE
+#pragma OPENCL EXTENSION cl_khr_fp64 : enable
+#endif
+
+// 64 bit atomics for the statistics counters, if the device has them.
+// Otherwise the counter is added to as two 32 bit words, with the carry of
+// the low word added to the high word.
+#ifdef cl_khr_int64_base_atomics
+#pragma OPENCL EXTENSION cl_khr_int64_base_atomics : enable
+#define ADD_COUNTER(counter, value) \
+		atom_add((counter), (ulong) (value))
+#else
+#ifdef __ENDIAN_LITTLE__
+#define COUNTER_LOW 0
+#else
+#define COUNTER_LOW 1
+#endif
+
+void add_counter(__global ulong * counter, const ulong value);
+
+/**
+ * Adds to a 64 bit counter with 32 bit atomics. Each add to the low word
+ * that wraps around adds 1 to the high word, so the counter is exact once
+ * all adds are done.
+ *
+ * @param counter The counter.
+ * @param value The value to add.
+ */
+void add_counter(__global ulong * counter, const ulong value) {
+	__global uint * words = (__global uint *) counter;
+	uint low = (uint) value;
+	uint high = (uint) (value >> 32);
+
+	uint old = atomic_add(&words[COUNTER_LOW], low);
+	if (old + low < old) {
+		high++;
+	}
+	if (high != 0) {
+		atomic_add(&words[1 - COUNTER_LOW], high);
+	}
+}
+
+#define ADD_COUNTER(counter, value) \
+		add_counter((counter), (ulong) (value))
+#endif
+
 //###############################################
 //
 // my_complex functions
@@ -95,7 +184,7 @@ my_complex_t mul_complex(const my_complex_t a, const my_complex_t b) {
 float sum_complex(const my_complex_t a) {
 	float result = -1;
 
-	result = sqrt(pow((float)a.real, 2) + pow((float)a.imaginary, 2));
+	result = sqrt(a.real * a.real + a.imaginary * a.imaginary);
 
 	return result;
 }
@@ -107,13 +196,31 @@ float sum_complex(const my_complex_t a) {
 //###############################################
 
 my_complex_t calculate_dot(const my_complex_t z, const my_complex_t c);
+int is_interior(const my_complex_t c);
+int is_periodic(const my_complex_t z, my_complex_t * z_period,
+		const ITER_T i, ITER_T * next_period);
+long iterate_dot_z(const my_complex_t c, const float abort_value,
+		const long itr, long * saved, my_complex_t * z_last);
 long iterate_dot(const my_complex_t c, const float abort_value,
-		const long itr);
-__kernel void calculate_imagerowdots_iterations(const float x_min, const float x_max,
-		const float y_value, const long x_mon, const float abort_value, const long itr,
-		__global long * imagerow);
-__kernel void calculate_colorrow(const long width, long itr, __global long * imagerowvalues,
-		__global unsigned char * imagerow);
+		const long itr, long * saved);
+__kernel void calculate_image_iterations(const float x_min, const float x_max,
+		const float y_min, const float y_max, const long x_mon, const long y_mon,
+		const float abort_value, const long itr, __global VALUE_T * image,
+		__global ulong * saved_iterations);
+__kernel void calculate_points_iterations(const float x_min,
+		const float x_max, const float y_min, const float y_max,
+		const long x_mon, const long y_mon, const float abort_value,
+		const long itr, __global const int * points, __global long * values,
+		__global ulong * saved_iterations);
+void calculate_color(const long iterations, const long itr,
+		__global unsigned char * pixel);
+__kernel void calculate_image_colors(const long x_mon, const long itr,
+		__global VALUE_T * imagevalues, __global unsigned char * image);
+__kernel void calculate_image_pixels(const float x_min, const float x_max,
+		const float y_min, const float y_max, const long x_mon, const long y_mon,
+		const float abort_value, const long itr, const int export_values,
+		__global VALUE_T * imagevalues, __global unsigned char * image,
+		__global ulong * saved_iterations);
 
 /**
  *  Calculate z(n+1) = z(n)^2 - c
@@ -132,6 +239,63 @@ my_complex_t calculate_dot(const my_complex_t z, const my_complex_t c) {
 	return result;
 }
 
+/**
+ * Tests if a point lies in the main cardioid or in the period-2 bulb. These
+ * points belong to the Mandelbrot set, so they don't have to be iterated.
+ *
+ * The formula here is z^2 - c, so the point c is the point -c of the usual
+ * z^2 + c. The imaginary part only appears squared.
+ *
+ * @param c The test point.
+ * @return 1 if the point lies in the cardioid or the bulb, otherwise 0.
+ */
+int is_interior(const my_complex_t c) {
+	float x = -c.real;
+	float y2 = c.imaginary * c.imaginary;
+
+	//main cardioid: q * (q + (x - 1/4)) < y^2 / 4
+	float xq = x - 0.25f;
+	float q = xq * xq + y2;
+	if (q * (q + xq) < 0.25f * y2) {
+		return 1;
+	}
+
+	//period-2 bulb: (x + 1)^2 + y^2 < 1/16
+	float xb = x + 1.0f;
+	if (xb * xb + y2 < 0.0625f) {
+		return 1;
+	}
+
+	return 0;
+}
+
+/**
+ * Brent's cycle check: compares z with the value saved at the last power of
+ * two iterations and saves z again at the next power of two.
+ *
+ * If z comes back to the saved value, the orbit repeats forever without
+ * escaping, so the point belongs to the Mandelbrot set.
+ *
+ * @param z The current value.
+ * @param z_period The saved value.
+ * @param i The number of iterations done for z.
+ * @param next_period The iteration at which z is saved next.
+ * @return 1 if the orbit is periodic, otherwise 0.
+ */
+int is_periodic(const my_complex_t z, my_complex_t * z_period,
+		const ITER_T i, ITER_T * next_period) {
+	if (z.real == z_period->real && z.imaginary == z_period->imaginary) {
+		return 1;
+	}
+
+	if (i >= *next_period) {
+		*z_period = z;
+		*next_period *= 2;
+	}
+
+	return 0;
+}
+
 /**
  * Calculates and validates whether a point belongs to the Mandelbrot set or
  * not.
@@ -142,45 +306,122 @@ my_complex_t calculate_dot(const my_complex_t z, const my_complex_t c) {
  * If the abort condition was fullfilled, the point does not belong to the
  * Mandelbrot set. If not, then most likely.
  *
+ * With UNROLL > 1 the iterations are calculated in blocks of UNROLL without a
+ * branch in between. If the point escaped somewhere in a block, z is reset
+ * to the start of the block and the block is calculated again one iteration
+ * after the other, so the result is the same as without unrolling.
+ *
+ * With INTERIOR_CHECK the iteration ends early for points that can't
+ * escape. Their result is itr, like without the check.
+ *
  * @param c The test point.
  * @param abort_value The value of the abort condition. Normally 2.
  * @param itr The number of required iterations.
+ * @param saved Set to the number of iterations the interior check saved.
+ * @param z_last Set to the last z, for an escaped point the first z beyond
+ *        the abort value.
  * @return The number of iterations for that point.
  */
-long iterate_dot(const my_complex_t c, const float abort_value,
-		const long itr) {
-	float sum = -1;
+long iterate_dot_z(const my_complex_t c, const float abort_value,
+		const long itr, long * saved, my_complex_t * z_last) {
+#ifdef ESCAPE_RADIUS
+	const float radius = ESCAPE_RADIUS;
+#else
+	const float radius = abort_value;
+#endif
+	const ITER_T n = (ITER_T) itr;
+
+	*saved = 0;
 
 	//define z
 	my_complex_t z;
 	z.real = 0;
 	z.imaginary = 0;
 
-	long i = 0;
-	while (i < itr && sum < abort_value) {
-		my_complex_t z_neu;
+#ifdef INTERIOR_CHECK
+	if (is_interior(c)) {
+		*saved = itr;
+		*z_last = z;
+		return itr;
+	}
+
+	my_complex_t z_period = z;
+	ITER_T next_period = 1;
+#endif
+
+	ITER_T i = 0;
+#if UNROLL > 1
+	while (n - i >= UNROLL) {
+		my_complex_t z_block = z;
+		int escaped = 0;
+
+		for (int u = 0; u < UNROLL; ++u) {
+			z = calculate_dot(z, c);	//calculate z(n+1) = z(n) - c
+			escaped |= ESCAPED(z, radius);
+		}
+
+		if (escaped) {
+			z = z_block;
+			break;
+		}
+		i += UNROLL;
+
+#ifdef INTERIOR_CHECK
+		if (is_periodic(z, &z_period, i, &next_period)) {
+			*saved = itr - i;
+			*z_last = z;
+			return itr;
+		}
+#endif
+	}
+#endif
+	while (i < n) {
+		z = calculate_dot(z, c);	//calculate z(n+1) = z(n) - c
 
-		z_neu = calculate_dot(z, c);	//calculate z(n+1) = z(n) - c
-		sum = sum_complex(z_neu);		//calculate |z|
-		z = z_neu;
+		if (ESCAPED(z, radius)) {
+			break;
+		}
+		++i;
 
-		if (sum < abort_value) {
-			++i;
+#ifdef INTERIOR_CHECK
+		if (is_periodic(z, &z_period, i, &next_period)) {
+			*saved = itr - i;
+			*z_last = z;
+			return itr;
 		}
+#endif
 	}
 
+	*z_last = z;
 	return i;
 }
 
 /**
- * Calculates a Mandelbrot imagerow without colors.
+ * Same as iterate_dot_z, for the callers that only need the iterations.
+ *
+ * @param c The test point.
+ * @param abort_value The value of the abort condition. Normally 2.
+ * @param itr The number of required iterations.
+ * @param saved Set to the number of iterations the interior check saved.
+ * @return The number of iterations for that point.
+ */
+long iterate_dot(const my_complex_t c, const float abort_value,
+		const long itr, long * saved) {
+	my_complex_t z_last;
+
+	return iterate_dot_z(c, abort_value, itr, saved, &z_last);
+}
+
+/**
+ * Calculates a whole Mandelbrot image without colors.
  *
- * For each point of the imagerow it calculates the points and saves the number of
- * iterations for it. From the number of iterations you can say i a point
- * belongs to a Mandelbrot set or not.
+ * The kernel is launched once per frame over a 2D range of x_mon * y_mon
+ * work-items. Every work-item calculates one point of the image and saves
+ * the number of iterations for it at its (x, y) position in the frame
+ * buffer. From the number of iterations you can say if a point belongs to
+ * a Mandelbrot set or not.
  *
  * Based on the number of iterations the color is choosen later.
-
  *
  * @param x_min Smallest X-value of the plane section.
  * @param x_max Greatest X-value of the plane section.
@@ -191,58 +432,1354 @@ long iterate_dot(const my_complex_t c, const float abort_value,
  * @param abort_value The value of the abort condition. Normally 2.
  * @param itr The number of required iterations.
  * @param image The image as a set of iteration values.
+ * @param saved_iterations Counter of the iterations the interior check
+ *                         saved.
  */
-__kernel void calculate_imagerowdots_iterations(const float x_min, const float x_max,
-		const float y_value, const long x_mon, const float abort_value, const long itr,
-		__global long * imagerow) {
+__kernel void calculate_image_iterations(const float x_min, const float x_max,
+		const float y_min, const float y_max, const long x_mon, const long y_mon,
+		const float abort_value, const long itr, __global VALUE_T * image,
+		__global ulong * saved_iterations) {
 	float delta_x = delta(x_min, x_max, x_mon);
-	int j = get_global_id(0);	//the position in the row
+	float delta_y = delta(y_min, y_max, y_mon);
+	int x = get_global_id(0);	//the position in the row
+	int y = get_global_id(1);	//the row, counted from the top
 
-	//set to top left corner
+	//the top left corner is (x_min, y_max)
 	my_complex_t c;
-	c.real = x_min + j * delta_x;
-	c.imaginary = y_value;
+	c.real = x_min + x * delta_x;
+	c.imaginary = y_max - y * delta_y;
 
-	//for each dot in the column
-	j = get_global_id(0);
-	imagerow[j] = iterate_dot(c, abort_value, itr);
+	long saved;
+	image[y * x_mon + x] = (VALUE_T) iterate_dot(c, abort_value, itr, &saved);
 
+	if (saved > 0) {
+		ADD_COUNTER(saved_iterations, saved);
+	}
 }
+
 /**
- * Calculates the color from the iteration values.
+ * Calculates the iterations of a list of points of the image.
  *
- * @param imagevalues The calculated iteration values.
- * @param image The final imagerow.
- * @param width The width.
+ * The kernel is launched over a 1D range with one work-item per point. A
+ * point is given by its position y * x_mon + x in the frame buffer and gets
+ * the same value as in calculate_image_iterations.
+ *
+ * @param x_min Smallest X-value of the plane section.
+ * @param x_max Greatest X-value of the plane section.
+ * @param y_min Smallest Y-value of the plane section.
+ * @param y_max Greatest Y-value of the plane section.
+ * @param x_mon Resolution of the monitor on the horizontal axis.
+ * @param y_mon Resolution of the monitor on the vertical axis.
+ * @param abort_value The value of the abort condition. Normally 2.
+ * @param itr The number of required iterations.
+ * @param points The positions of the points.
+ * @param values The iteration values, in the order of the points.
+ * @param saved_iterations Counter of the iterations the interior check
+ *                         saved.
+ */
+__kernel void calculate_points_iterations(const float x_min,
+		const float x_max, const float y_min, const float y_max,
+		const long x_mon, const long y_mon, const float abort_value,
+		const long itr, __global const int * points, __global long * values,
+		__global ulong * saved_iterations) {
+	float delta_x = delta(x_min, x_max, x_mon);
+	float delta_y = delta(y_min, y_max, y_mon);
+	int i = get_global_id(0);
+	int x = points[i] % x_mon;	//the position in the row
+	int y = points[i] / x_mon;	//the row, counted from the top
+
+	//the top left corner is (x_min, y_max)
+	my_complex_t c;
+	c.real = x_min + x * delta_x;
+	c.imaginary = y_max - y * delta_y;
+
+	long saved;
+	values[i] = iterate_dot(c, abort_value, itr, &saved);
+
+	if (saved > 0) {
+		ADD_COUNTER(saved_iterations, saved);
+	}
+}
+
+/**
+ * Calculates the color of one pixel from its iteration value.
+ *
+ * @param iterations The calculated iteration value of the pixel.
+ * @param itr The number of required iterations.
+ * @param pixel The 3 bytes of the pixel in the final image.
  */
-__kernel void calculate_colorrow(const long width, long itr, __global long * imagerowvalues,
-		__global unsigned char * imagerow) {
+void calculate_color(const long iterations, const long itr,
+		__global unsigned char * pixel) {
 
-	float color_steps = (float) 255.0 / (float) itr;
+	float color_steps = 255.0f / (float) itr;
 	float red = color_steps;
 	float green = color_steps;
 	float blue = color_steps;
 
-	int i = get_global_id(0);
-	long value = imagerowvalues[i];
-	value = itr - value;
+	long value = itr - iterations;
 
-	float myred = (float) value * red / 1.1;
-	float mygreen = (float) value * green / 1.05;
+	float myred = (float) value * red / 1.1f;
+	float mygreen = (float) value * green / 1.05f;
 	float myblue = (float) value * blue;
 
-	if (myred > 255.0) {
+	if (myred > 255.0f) {
 		myred = 255;
 	}
-	if (mygreen > 255.0) {
+	if (mygreen > 255.0f) {
 		mygreen = 255;
 	}
-	if (myblue > 255.0) {
+	if (myblue > 255.0f) {
 		myblue = 255;
 	}
 
-	imagerow[i * 3 - 3] = (unsigned char) myred;
-	imagerow[i * 3 - 2] = (unsigned char) mygreen;
-	imagerow[i * 3 - 1] = (unsigned char) myblue;
+	pixel[0] = (unsigned char) myred;
+	pixel[1] = (unsigned char) mygreen;
+	pixel[2] = (unsigned char) myblue;
+}
+
+/**
+ * Calculates the colors of a whole image from the iteration values.
+ *
+ * The kernel is launched over a 2D range of x_mon * y_mon work-items, one
+ * per pixel.
+ *
+ * @param x_mon Resolution of the monitor on the horizontal axis.
+ * @param itr The number of required iterations.
+ * @param imagevalues The calculated iteration values.
+ * @param image The final image, 3 bytes per pixel.
+ */
+__kernel void calculate_image_colors(const long x_mon, const long itr,
+		__global VALUE_T * imagevalues, __global unsigned char * image) {
+	long i = get_global_id(1) * x_mon + get_global_id(0);
+
+	calculate_color((long) imagevalues[i], itr, image + i * 3);
+}
+
+/**
+ * Calculates a whole colored Mandelbrot image in one pass.
+ *
+ * Fuses calculate_image_iterations and calculate_image_colors: every
+ * work-item iterates its point and writes the final pixel bytes directly.
+ * The iteration values are only written to imagevalues if export_values is
+ * set, so they don't cost any memory traffic on frames where the host
+ * doesn't need them.
+ *
+ * @param x_min Smallest X-value of the plane section.
+ * @param x_max Greatest X-value of the plane section.
+ * @param y_min Smallest Y-value of the plane section.
+ * @param y_max Greatest Y-value of the plane section.
+ * @param x_mon Resolution of the monitor on the horizontal axis.
+ * @param y_mon Resolution of the monitor on the vertical axis.
+ * @param abort_value The value of the abort condition. Normally 2.
+ * @param itr The number of required iterations.
+ * @param export_values 1 if the iteration values shall be written.
+ * @param imagevalues The image as a set of iteration values.
+ * @param image The final image, 3 bytes per pixel.
+ * @param saved_iterations Counter of the iterations the interior check
+ *                         saved.
+ */
+__kernel void calculate_image_pixels(const float x_min, const float x_max,
+		const float y_min, const float y_max, const long x_mon, const long y_mon,
+		const float abort_value, const long itr, const int export_values,
+		__global VALUE_T * imagevalues, __global unsigned char * image,
+		__global ulong * saved_iterations) {
+	float delta_x = delta(x_min, x_max, x_mon);
+	float delta_y = delta(y_min, y_max, y_mon);
+	int x = get_global_id(0);	//the position in the row
+	int y = get_global_id(1);	//the row, counted from the top
+	long i = y * x_mon + x;
+
+	//the top left corner is (x_min, y_max)
+	my_complex_t c;
+	c.real = x_min + x * delta_x;
+	c.imaginary = y_max - y * delta_y;
+
+	long saved;
+	long iterations = iterate_dot(c, abort_value, itr, &saved);
+
+	if (saved > 0) {
+		ADD_COUNTER(saved_iterations, saved);
+	}
+
+	if (export_values) {
+		imagevalues[i] = (VALUE_T) iterations;
+	}
+
+	calculate_color(iterations, itr, image + i * 3);
+}
+
+//###############################################
+//
+// persistent kernel functions
+//
+//###############################################
+
+// Size of the tiles taken from the tile counter, one work-item per pixel
+#define PERSISTENT_TILE_WIDTH 8
+#define PERSISTENT_TILE_HEIGHT 8
+#define PERSISTENT_TILE_SIZE (PERSISTENT_TILE_WIDTH * PERSISTENT_TILE_HEIGHT)
+
+__kernel void calculate_image_pixels_persistent(const float x_min,
+		const float x_max, const float y_min, const float y_max,
+		const long x_mon, const long y_mon, const float abort_value,
+		const long itr, const int export_values, __global VALUE_T * imagevalues,
+		__global unsigned char * image, __global ulong * saved_iterations,
+		__global int * next_tile, __global ulong * group_work);
+
+/**
+ * Calculates a whole colored Mandelbrot image with persistent work-groups.
+ *
+ * Same as calculate_image_pixels, but the kernel is launched with only as
+ * many work-groups as the compute units can run at once. Each work-group
+ * takes the next tile of PERSISTENT_TILE_WIDTH * PERSISTENT_TILE_HEIGHT
+ * pixels from next_tile until all tiles are taken, so groups that got
+ * cheap tiles take more of them and no compute unit waits behind a slow
+ * work-group.
+ *
+ * @param x_min Smallest X-value of the plane section.
+ * @param x_max Greatest X-value of the plane section.
+ * @param y_min Smallest Y-value of the plane section.
+ * @param y_max Greatest Y-value of the plane section.
+ * @param x_mon Resolution of the monitor on the horizontal axis.
+ * @param y_mon Resolution of the monitor on the vertical axis.
+ * @param abort_value The value of the abort condition. Normally 2.
+ * @param itr The number of required iterations.
+ * @param export_values 1 if the iteration values shall be written.
+ * @param imagevalues The image as a set of iteration values.
+ * @param image The final image, 3 bytes per pixel.
+ * @param saved_iterations Counter of the iterations the interior check
+ *                         saved.
+ * @param next_tile The tile counter, 0 when the kernel starts.
+ * @param group_work Two counters of each work-group: its iterations and the
+ *                   tiles it took.
+ */
+__kernel __attribute__((reqd_work_group_size(PERSISTENT_TILE_SIZE, 1, 1)))
+void calculate_image_pixels_persistent(const float x_min,
+		const float x_max, const float y_min, const float y_max,
+		const long x_mon, const long y_mon, const float abort_value,
+		const long itr, const int export_values, __global VALUE_T * imagevalues,
+		__global unsigned char * image, __global ulong * saved_iterations,
+		__global int * next_tile, __global ulong * group_work) {
+	__local int tile;
+	float delta_x = delta(x_min, x_max, x_mon);
+	float delta_y = delta(y_min, y_max, y_mon);
+	int lid = get_local_id(0);
+	long tiles_per_row = (x_mon + PERSISTENT_TILE_WIDTH - 1)
+			/ PERSISTENT_TILE_WIDTH;
+	long number_tiles = tiles_per_row
+			* ((y_mon + PERSISTENT_TILE_HEIGHT - 1) / PERSISTENT_TILE_HEIGHT);
+	long work = 0;
+	long saved_total = 0;
+	long tiles = 0;
+
+	for (;;) {
+		if (lid == 0) {
+			tile = atomic_inc(next_tile);
+		}
+		barrier(CLK_LOCAL_MEM_FENCE);
+		int t = tile;
+		// Nobody may take the next tile before all have read this one
+		barrier(CLK_LOCAL_MEM_FENCE);
+
+		if (t >= number_tiles) {
+			break;
+		}
+		tiles++;
+
+		long x = (t % tiles_per_row) * PERSISTENT_TILE_WIDTH
+				+ lid % PERSISTENT_TILE_WIDTH;
+		long y = (t / tiles_per_row) * PERSISTENT_TILE_HEIGHT
+				+ lid / PERSISTENT_TILE_WIDTH;
+		if (x >= x_mon || y >= y_mon) {
+			continue;
+		}
+		long i = y * x_mon + x;
+
+		//the top left corner is (x_min, y_max)
+		my_complex_t c;
+		c.real = x_min + x * delta_x;
+		c.imaginary = y_max - y * delta_y;
+
+		long saved;
+		long iterations = iterate_dot(c, abort_value, itr, &saved);
+		work += iterations - saved;
+		saved_total += saved;
+
+		if (export_values) {
+			imagevalues[i] = (VALUE_T) iterations;
+		}
+
+		calculate_color(iterations, itr, image + i * 3);
+	}
+
+	if (saved_total > 0) {
+		ADD_COUNTER(saved_iterations, saved_total);
+	}
+	if (work > 0) {
+		ADD_COUNTER(group_work + 2 * get_group_id(0), work);
+	}
+	if (lid == 0 && tiles > 0) {
+		ADD_COUNTER(group_work + 2 * get_group_id(0) + 1, tiles);
+	}
+}
+
+//###############################################
+//
+// progressive rendering functions
+//
+//###############################################
+
+__kernel void calculate_image_pixels_progressive(const float x_min,
+		const float x_max, const float y_min, const float y_max,
+		const long x_mon, const long y_mon, const float abort_value,
+		const long itr, const int step, const int first_pass,
+		const int export_values, __global VALUE_T * imagevalues,
+		__global unsigned char * image, __global ulong * saved_iterations);
+
+/**
+ * Calculates one pass of a progressively rendered image: every step-th
+ * pixel of every step-th row, each filling its step * step block of the
+ * image, so the pass can be shown as a coarse preview.
+ *
+ * The passes halve the step down to 1. The pixels on the grid of the
+ * previous pass have been calculated by it, so they are skipped. Every pixel
+ * is calculated once and exactly as by calculate_image_pixels, so the image
+ * of the last pass is the same as the one of the fused kernel. The kernel
+ * is launched over a 2D range of one work-item per calculated pixel.
+ *
+ * @param x_min Smallest X-value of the plane section.
+ * @param x_max Greatest X-value of the plane section.
+ * @param y_min Smallest Y-value of the plane section.
+ * @param y_max Greatest Y-value of the plane section.
+ * @param x_mon Resolution of the monitor on the horizontal axis.
+ * @param y_mon Resolution of the monitor on the vertical axis.
+ * @param abort_value The value of the abort condition. Normally 2.
+ * @param itr The number of required iterations.
+ * @param step The distance of the pixels calculated in this pass.
+ * @param first_pass 1 if no pixels have been calculated before.
+ * @param export_values 1 to store the iteration values as well.
+ * @param imagevalues The image as a set of iteration values.
+ * @param image The final image, 3 bytes per pixel.
+ * @param saved_iterations Counter of the iterations the interior check
+ *                         saved.
+ */
+__kernel void calculate_image_pixels_progressive(const float x_min,
+		const float x_max, const float y_min, const float y_max,
+		const long x_mon, const long y_mon, const float abort_value,
+		const long itr, const int step, const int first_pass,
+		const int export_values, __global VALUE_T * imagevalues,
+		__global unsigned char * image, __global ulong * saved_iterations) {
+	float delta_x = delta(x_min, x_max, x_mon);
+	float delta_y = delta(y_min, y_max, y_mon);
+	int x = get_global_id(0) * step;	//the position in the row
+	int y = get_global_id(1) * step;	//the row, counted from the top
+	long i = y * x_mon + x;
+
+	if (x >= x_mon || y >= y_mon) {
+		return;
+	}
+	if (!first_pass && x % (2 * step) == 0 && y % (2 * step) == 0) {
+		return;
+	}
+
+	//the top left corner is (x_min, y_max)
+	my_complex_t c;
+	c.real = x_min + x * delta_x;
+	c.imaginary = y_max - y * delta_y;
+
+	long saved;
+	long iterations = iterate_dot(c, abort_value, itr, &saved);
+
+	if (saved > 0) {
+		ADD_COUNTER(saved_iterations, saved);
+	}
+
+	if (export_values) {
+		imagevalues[i] = (VALUE_T) iterations;
+	}
+
+	__global unsigned char * pixel = image + i * 3;
+	calculate_color(iterations, itr, pixel);
+
+	//the block up to the next calculated pixels shows the same color
+	for (int dy = 0; dy < step && y + dy < y_mon; ++dy) {
+		__global unsigned char * row = pixel + dy * x_mon * 3;
+
+		for (int dx = (dy == 0) ? 1 : 0; dx < step && x + dx < x_mon; ++dx) {
+			row[dx * 3] = pixel[0];
+			row[dx * 3 + 1] = pixel[1];
+			row[dx * 3 + 2] = pixel[2];
+		}
+	}
+}
+
+//###############################################
+//
+// perturbation functions
+//
+//###############################################
+
+// Deltas with an exponent above this are small enough for plain floats
+#define PERTURBATION_FLOAT_EXPONENT -60
+
+// Deltas are normalized when their exponent leaves -8..8
+#define PERTURBATION_NORMALIZE_EXPONENT 8
+
+my_complex_t scale_complex(const my_complex_t a, const int exponent);
+void normalize_delta(my_complex_t * d, int * e);
+long iterate_perturbation(const my_complex_t dc, const int dc_exponent,
+		const float abort_value, const long itr,
+		__global const my_complex_t * orbit, const long orbit_length,
+		long * rebases);
+__kernel void calculate_image_perturbation(const long x_mon,
+		const long y_mon, const float spacing, const int spacing_exponent,
+		const float abort_value, const long itr,
+		__global const my_complex_t * orbit, const long orbit_length,
+		const int export_values, __global VALUE_T * imagevalues,
+		__global unsigned char * image, __global ulong * rebases);
+
+/**
+ * Multiplies a complex number with a power of two.
+ *
+ * @param a The complex number.
+ * @param exponent The exponent of the power of two.
+ * @return a * 2^exponent
+ */
+my_complex_t scale_complex(const my_complex_t a, const int exponent) {
+	my_complex_t result;
+
+	result.real = ldexp(a.real, exponent);
+	result.imaginary = ldexp(a.imaginary, exponent);
+
+	return result;
+}
+
+/**
+ * Moves the binary exponent of a delta d * 2^e into e, if the mantissa d
+ * got too large or too small. The value doesn't change.
+ *
+ * @param d The mantissa.
+ * @param e The exponent.
+ */
+void normalize_delta(my_complex_t * d, int * e) {
+	float m = fmax(fabs(d->real), fabs(d->imaginary));
+
+	if (m != 0) {
+		int k = ilogb(m);
+		if (k > PERTURBATION_NORMALIZE_EXPONENT
+				|| k < -PERTURBATION_NORMALIZE_EXPONENT) {
+			*d = scale_complex(*d, -k);
+			*e += k;
+		}
+	}
+}
+
+/**
+ * Calculates the iterations of a point c = C + dc near the reference point
+ * C, whose orbit Z(n) is given.
+ *
+ * Only the distance d(n) = z(n) - Z(n) to the reference orbit is iterated:
+ *
+ *     d(n+1) = 2 Z(n) d(n) + d(n)^2 - dc
+ *
+ * At deep zooms d and dc are far below the range of float, so d is kept as
+ * a float mantissa with its own exponent until it has grown large enough
+ * for plain floats.
+ *
+ * If z(n) gets smaller than d(n), the reference orbit is no longer close
+ * enough to describe the point and the result would be glitched. The point
+ * is then rebased: z(n) becomes the new distance to Z(0) = 0. The same
+ * happens at the end of a reference orbit that escaped.
+ *
+ * @param dc Mantissa of the distance of the point to the reference point.
+ * @param dc_exponent Exponent of the distance.
+ * @param abort_value The value of the abort condition. Normally 2.
+ * @param itr The number of required iterations.
+ * @param orbit The reference orbit.
+ * @param orbit_length The number of values of the reference orbit.
+ * @param rebases Set to the number of rebases.
+ * @return The number of iterations for that point.
+ */
+long iterate_perturbation(const my_complex_t dc, const int dc_exponent,
+		const float abort_value, const long itr,
+		__global const my_complex_t * orbit, const long orbit_length,
+		long * rebases) {
+#ifdef ESCAPE_RADIUS
+	const float radius = ESCAPE_RADIUS;
+#else
+	const float radius = abort_value;
+#endif
+
+	my_complex_t d;
+	d.real = 0;
+	d.imaginary = 0;
+	int e = dc_exponent;
+
+	long n = 0;
+	long i = 0;
+	*rebases = 0;
+
+	//d = d_mantissa * 2^e
+	while (i < itr && e <= PERTURBATION_FLOAT_EXPONENT) {
+		my_complex_t t = mul_complex(orbit[n], d);
+		t = add_complex(t, t);
+		t = add_complex(t, scale_complex(mul_complex(d, d), e));
+		d = sub_complex(t, scale_complex(dc, dc_exponent - e));
+		++n;
+		normalize_delta(&d, &e);
+
+		my_complex_t z = add_complex(orbit[n], scale_complex(d, e));
+		if (ESCAPED(z, radius)) {
+			return i;
+		}
+		++i;
+
+		//z in units of 2^e, infinite if z is much larger than d
+		my_complex_t z_scaled = add_complex(scale_complex(orbit[n], -e), d);
+		float z_scaled_sum = sum_complex(z_scaled);
+		if (n == orbit_length - 1 || z_scaled_sum < sum_complex(d)) {
+			if (isinf(z_scaled_sum)) {
+				d = z;
+				e = 0;
+			} else {
+				d = z_scaled;
+			}
+			normalize_delta(&d, &e);
+			n = 0;
+			++*rebases;
+		}
+	}
+
+	//d is a plain float now, dc may be too small to matter
+	d = scale_complex(d, e);
+	my_complex_t dc_float = scale_complex(dc, dc_exponent);
+
+	while (i < itr) {
+		my_complex_t t = mul_complex(orbit[n], d);
+		t = add_complex(t, t);
+		t = add_complex(t, mul_complex(d, d));
+		d = sub_complex(t, dc_float);
+		++n;
+
+		my_complex_t z = add_complex(orbit[n], d);
+		if (ESCAPED(z, radius)) {
+			break;
+		}
+		++i;
+
+		if (n == orbit_length - 1 || sum_complex(z) < sum_complex(d)) {
+			d = z;
+			n = 0;
+			++*rebases;
+		}
+	}
+
+	return i;
+}
+
+/**
+ * Calculates a whole colored Mandelbrot image of a deep zoom in one pass.
+ *
+ * The image is centered on the reference point. Every work-item calculates
+ * its distance to the center from its position and the pixel spacing, and
+ * iterates it with iterate_perturbation.
+ *
+ * @param x_mon Resolution of the monitor on the horizontal axis.
+ * @param y_mon Resolution of the monitor on the vertical axis.
+ * @param spacing Mantissa of the distance between two pixels.
+ * @param spacing_exponent Exponent of the distance between two pixels.
+ * @param abort_value The value of the abort condition. Normally 2.
+ * @param itr The number of required iterations.
+ * @param orbit The reference orbit of the center.
+ * @param orbit_length The number of values of the reference orbit.
+ * @param export_values 1 to save the iteration values as well.
+ * @param imagevalues The image as a set of iteration values.
+ * @param image The final image, 3 bytes per pixel.
+ * @param rebases Counter of the rebased points.
+ */
+__kernel void calculate_image_perturbation(const long x_mon,
+		const long y_mon, const float spacing, const int spacing_exponent,
+		const float abort_value, const long itr,
+		__global const my_complex_t * orbit, const long orbit_length,
+		const int export_values, __global VALUE_T * imagevalues,
+		__global unsigned char * image, __global ulong * rebases) {
+	int x = get_global_id(0);	//the position in the row
+	int y = get_global_id(1);	//the row, counted from the top
+	long i = y * x_mon + x;
+
+	//the imaginary axis points up
+	my_complex_t dc;
+	dc.real = ((float) x - 0.5f * (float) (x_mon - 1)) * spacing;
+	dc.imaginary = (0.5f * (float) (y_mon - 1) - (float) y) * spacing;
+
+	long point_rebases;
+	long iterations = iterate_perturbation(dc, spacing_exponent, abort_value,
+			itr, orbit, orbit_length, &point_rebases);
+
+	if (point_rebases > 0) {
+		ADD_COUNTER(rebases, point_rebases);
+	}
+
+	if (export_values) {
+		imagevalues[i] = (VALUE_T) iterations;
+	}
+
+	calculate_color(iterations, itr, image + i * 3);
+}
+
+//###############################################
+//
+// exponential map functions
+//
+//###############################################
+
+__kernel void calculate_strip_iterations(const float center_real,
+		const float center_imaginary, const float rho_min,
+		const float delta_rho, const long columns, const float x_min,
+		const float x_max, const float y_min, const float y_max,
+		const float abort_value, __global const long * row_iterations,
+		__global long * strip, __global ulong * saved_iterations);
+__kernel void calculate_image_from_strip(const float offset_real,
+		const float offset_imaginary, const float delta_x, const float delta_y,
+		const float inner_x, const float inner_y, const float inner_delta_x,
+		const float inner_delta_y, const float rho_min, const float delta_rho,
+		const long columns, const long rows, const long x_mon,
+		const long y_mon, const long itr, __global const long * strip,
+		__global const VALUE_T * inner, __global unsigned char * image);
+
+/**
+ * Calculates the iteration values of an exponential map around a center.
+ *
+ * The sample in row j and column k lies at
+ *
+ *     center + e^(rho_min + j * delta_rho) * e^(i * k * delta_rho)
+ *
+ * so the rows are circles whose radius grows by the same factor from one
+ * row to the next, and the samples are about square at every radius. A
+ * zoom into the center only moves up the rows, so all frames of a zoom
+ * video can be taken from one map.
+ *
+ * The outer rows are only seen by the first frames, so each row has its
+ * own number of iterations: the one of the last frame that reaches it.
+ * Samples outside the first frame, which holds all others, are never seen
+ * and not calculated.
+ *
+ * @param center_real Real part of the center.
+ * @param center_imaginary Imaginary part of the center.
+ * @param rho_min Logarithm of the radius of the first row.
+ * @param delta_rho Distance between two rows and two columns.
+ * @param columns The number of samples of a row, 2 pi / delta_rho.
+ * @param x_min Smallest X-value of the first frame.
+ * @param x_max Greatest X-value of the first frame.
+ * @param y_min Smallest Y-value of the first frame.
+ * @param y_max Greatest Y-value of the first frame.
+ * @param abort_value The value of the abort condition. Normally 2.
+ * @param row_iterations The number of required iterations of each row.
+ * @param strip The iteration values, row after row.
+ * @param saved_iterations Counter of the iterations the interior check saved.
+ */
+__kernel void calculate_strip_iterations(const float center_real,
+		const float center_imaginary, const float rho_min,
+		const float delta_rho, const long columns, const float x_min,
+		const float x_max, const float y_min, const float y_max,
+		const float abort_value, __global const long * row_iterations,
+		__global long * strip, __global ulong * saved_iterations) {
+	int k = get_global_id(0);	//the column, the angle
+	int j = get_global_id(1);	//the row, the radius
+
+	float radius = exp(rho_min + (float) j * delta_rho);
+	float angle = (float) k * delta_rho;
+
+	my_complex_t c;
+	c.real = center_real + radius * cos(angle);
+	c.imaginary = center_imaginary + radius * sin(angle);
+
+	// A pixel at the border may take a sample up to one sample away
+	float margin = radius * delta_rho;
+	if (c.real < x_min - margin || c.real > x_max + margin
+			|| c.imaginary < y_min - margin || c.imaginary > y_max + margin) {
+		strip[j * columns + k] = 0;
+		return;
+	}
+
+	long saved;
+	strip[j * columns + k] = iterate_dot(c, abort_value, row_iterations[j],
+			&saved);
+
+	if (saved > 0) {
+		ADD_COUNTER(saved_iterations, saved);
+	}
+}
+
+/**
+ * Synthesizes a colored frame from an exponential map and the last frame of
+ * the zoom.
+ *
+ * Pixels inside the last frame take its nearest value, all others the
+ * nearest sample of the map. Both were calculated with at least the
+ * iterations of this frame, so values beyond itr are cut to itr, which
+ * gives the same value as calculating the point with itr iterations.
+ *
+ * @param offset_real Real part of the upper left pixel minus the center.
+ * @param offset_imaginary Imaginary part of the upper left pixel minus the
+ *        center.
+ * @param delta_x Distance between two pixels on the horizontal axis.
+ * @param delta_y Distance between two pixels on the vertical axis.
+ * @param inner_x Position of the upper left pixel in the last frame.
+ * @param inner_y Row of the upper left pixel in the last frame.
+ * @param inner_delta_x delta_x in pixels of the last frame.
+ * @param inner_delta_y delta_y in pixels of the last frame.
+ * @param rho_min Logarithm of the radius of the first row of the map.
+ * @param delta_rho Distance between two rows and two columns of the map.
+ * @param columns The number of samples of a row of the map.
+ * @param rows The number of rows of the map.
+ * @param x_mon Resolution of the monitor on the horizontal axis.
+ * @param y_mon Resolution of the monitor on the vertical axis.
+ * @param itr The number of required iterations of this frame.
+ * @param strip The iteration values of the map.
+ * @param inner The iteration values of the last frame.
+ * @param image The final image, 3 bytes per pixel.
+ */
+__kernel void calculate_image_from_strip(const float offset_real,
+		const float offset_imaginary, const float delta_x, const float delta_y,
+		const float inner_x, const float inner_y, const float inner_delta_x,
+		const float inner_delta_y, const float rho_min, const float delta_rho,
+		const long columns, const long rows, const long x_mon,
+		const long y_mon, const long itr, __global const long * strip,
+		__global const VALUE_T * inner, __global unsigned char * image) {
+	int x = get_global_id(0);	//the position in the row
+	int y = get_global_id(1);	//the row, counted from the top
+
+	long value;
+	long ix = (long) floor(inner_x + (float) x * inner_delta_x + 0.5f);
+	long iy = (long) floor(inner_y + (float) y * inner_delta_y + 0.5f);
+
+	if (ix >= 0 && ix < x_mon && iy >= 0 && iy < y_mon) {
+		value = inner[iy * x_mon + ix];
+	} else {
+		float w_real = offset_real + (float) x * delta_x;
+		float w_imaginary = offset_imaginary - (float) y * delta_y;
+
+		float rho = 0.5f * log(w_real * w_real + w_imaginary * w_imaginary);
+		float angle = atan2(w_imaginary, w_real);
+		if (angle < 0) {
+			angle += 2 * M_PI_F;
+		}
+
+		long j = (long) floor((rho - rho_min) / delta_rho + 0.5f);
+		long k = (long) floor(angle / delta_rho + 0.5f);
+		j = clamp(j, 0L, rows - 1);
+		if (k >= columns) {
+			k -= columns;
+		}
+
+		value = strip[j * columns + k];
+	}
+
+	calculate_color(min(value, itr), itr, image + (y * x_mon + x) * 3);
+}
+
+//###############################################
+//
+// coloring functions
+//
+//###############################################
+
+// Bins of the iteration histogram and entries of the palette, the same as
+// COLORING_BINS and COLORING_PALETTE_SIZE of the host
+#define COLORING_BINS 1024
+#define COLORING_PALETTE_SIZE 256
+
+// Coloring modes, the same as on the host
+#define COLORING_SMOOTH 1
+#define COLORING_HISTOGRAM 2
+
+// Iterations of one pass through the palette in the smooth coloring
+#define COLORING_PERIOD 64.0f
+
+__kernel void calculate_image_smooth(const float x_min, const float x_max,
+		const float y_min, const float y_max, const long x_mon,
+		const long y_mon, const float abort_value, const long itr,
+		__global VALUE_T * imagevalues, __global float * fractions,
+		__global ulong * saved_iterations);
+__kernel void calculate_histogram(const long pixels, const long itr,
+		__global const VALUE_T * imagevalues, __global uint * histogram);
+__kernel void calculate_palette(__global const uint * histogram,
+		__global float * cdf);
+__kernel void calculate_image_colors_lut(const long x_mon, const long itr,
+		const int coloring, const int has_fractions,
+		__global const VALUE_T * imagevalues,
+		__global const float * fractions, __constant float * cdf,
+		__constant uchar * palette, __global unsigned char * image);
+
+/**
+ * Calculates a whole Mandelbrot image without colors, with the fractional
+ * part of the iterations of each escaped point.
+ *
+ * The fraction is how far the last z got beyond the abort value, on a log
+ * scale: 0 just beyond it, near 1 close to its square. Added to the
+ * iterations it gives a value that changes smoothly from pixel to pixel,
+ * so the colors don't form bands. Points of the set get 0.
+ *
+ * @param x_min Smallest X-value of the plane section.
+ * @param x_max Greatest X-value of the plane section.
+ * @param y_min Smallest Y-value of the plane section.
+ * @param y_max Greatest Y-value of the plane section.
+ * @param x_mon Resolution of the monitor on the horizontal axis.
+ * @param y_mon Resolution of the monitor on the vertical axis.
+ * @param abort_value The value of the abort condition. Normally 2.
+ * @param itr The number of required iterations.
+ * @param imagevalues The image as a set of iteration values.
+ * @param fractions The fractional part of the iterations of each point.
+ * @param saved_iterations Counter of the iterations the interior check
+ *                         saved.
+ */
+__kernel void calculate_image_smooth(const float x_min, const float x_max,
+		const float y_min, const float y_max, const long x_mon,
+		const long y_mon, const float abort_value, const long itr,
+		__global VALUE_T * imagevalues, __global float * fractions,
+		__global ulong * saved_iterations) {
+	float delta_x = delta(x_min, x_max, x_mon);
+	float delta_y = delta(y_min, y_max, y_mon);
+	int x = get_global_id(0);	//the position in the row
+	int y = get_global_id(1);	//the row, counted from the top
+	long i = y * x_mon + x;
+
+	//the top left corner is (x_min, y_max)
+	my_complex_t c;
+	c.real = x_min + x * delta_x;
+	c.imaginary = y_max - y * delta_y;
+
+	long saved;
+	my_complex_t z;
+	long iterations = iterate_dot_z(c, abort_value, itr, &saved, &z);
+
+	if (saved > 0) {
+		ADD_COUNTER(saved_iterations, saved);
+	}
+
+	float fraction = 0;
+	if (iterations < itr) {
+		float log_z = 0.5f * log(z.real * z.real + z.imaginary * z.imaginary);
+		fraction = 1.0f - log2(log_z / log(abort_value));
+		fraction = clamp(fraction, 0.0f, 0.999f);
+	}
+
+	imagevalues[i] = (VALUE_T) iterations;
+	fractions[i] = fraction;
+}
+
+/**
+ * Counts how many escaped points of an image fall into each of the
+ * COLORING_BINS bins of iterations.
+ *
+ * Each work-group counts its points in local memory and adds its counts to
+ * the histogram at the end, so only a few atomics per bin reach global
+ * memory. The work-items step through the image by the global size, so the
+ * kernel is launched over any 1D range. The histogram has to be zero
+ * before.
+ *
+ * @param pixels The number of points of the image.
+ * @param itr The number of required iterations.
+ * @param imagevalues The image as a set of iteration values.
+ * @param histogram The number of points of each bin.
+ */
+__kernel void calculate_histogram(const long pixels, const long itr,
+		__global const VALUE_T * imagevalues, __global uint * histogram) {
+	__local uint local_histogram[COLORING_BINS];
+	int local_id = get_local_id(0);
+	int local_size = get_local_size(0);
+
+	for (int b = local_id; b < COLORING_BINS; b += local_size) {
+		local_histogram[b] = 0;
+	}
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	for (long i = get_global_id(0); i < pixels; i += get_global_size(0)) {
+		long value = (long) imagevalues[i];
+
+		if (value < itr) {
+			atomic_inc(&local_histogram[value * COLORING_BINS / itr]);
+		}
+	}
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	for (int b = local_id; b < COLORING_BINS; b += local_size) {
+		if (local_histogram[b] > 0) {
+			atomic_add(&histogram[b], local_histogram[b]);
+		}
+	}
+}
+
+/**
+ * Turns the histogram into the lookup table of the histogram coloring: the
+ * share of the escaped points below each bin, from 0 to 1.
+ *
+ * The kernel is launched as one work-group, whose size is a power of two
+ * up to COLORING_BINS. Each work-item sums a run of bins, the sums of the
+ * runs are prefix-summed in local memory, and each work-item then writes
+ * the table for its run.
+ *
+ * @param histogram The number of points of each bin.
+ * @param cdf COLORING_BINS + 1 values, cdf[b] is the share of the points
+ *        below bin b.
+ */
+__kernel void calculate_palette(__global const uint * histogram,
+		__global float * cdf) {
+	__local uint sums[COLORING_BINS];
+	int local_id = get_local_id(0);
+	int local_size = get_local_size(0);
+	int run = COLORING_BINS / local_size;
+	int first = local_id * run;
+
+	uint sum = 0;
+	for (int b = first; b < first + run; ++b) {
+		sum += histogram[b];
+	}
+	sums[local_id] = sum;
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	//inclusive scan of the sums of the runs
+	for (int offset = 1; offset < local_size; offset *= 2) {
+		uint value = (local_id >= offset) ? sums[local_id - offset] : 0;
+		barrier(CLK_LOCAL_MEM_FENCE);
+		sums[local_id] += value;
+		barrier(CLK_LOCAL_MEM_FENCE);
+	}
+
+	uint total = sums[local_size - 1];
+	float scale = (total > 0) ? 1.0f / (float) total : 0.0f;
+	uint below = sums[local_id] - sum;
+
+	for (int b = first; b < first + run; ++b) {
+		cdf[b] = (float) below * scale;
+		below += histogram[b];
+	}
+	if (local_id == local_size - 1) {
+		cdf[COLORING_BINS] = (total > 0) ? 1.0f : 0.0f;
+	}
+}
+
+/**
+ * Colors a whole image from its iteration values with the palette.
+ *
+ * The smooth coloring runs through the palette every COLORING_PERIOD
+ * iterations, so the colors keep their contrast however many iterations a
+ * frame has. The histogram coloring spreads the escaped points evenly over
+ * the palette, interpolating within a bin with the fraction of the point.
+ * Points of the set are black in both.
+ *
+ * The kernel is launched over a 2D range of x_mon * y_mon work-items, one
+ * per pixel.
+ *
+ * @param x_mon Resolution of the monitor on the horizontal axis.
+ * @param itr The number of required iterations.
+ * @param coloring COLORING_SMOOTH or COLORING_HISTOGRAM.
+ * @param has_fractions 1 if fractions holds the fractional iterations,
+ *        otherwise the iterations are taken as whole numbers.
+ * @param imagevalues The calculated iteration values.
+ * @param fractions The fractional part of the iterations of each point.
+ * @param cdf The lookup table of the histogram coloring.
+ * @param palette COLORING_PALETTE_SIZE colors, 3 bytes each in the order of
+ *        the image.
+ * @param image The final image, 3 bytes per pixel.
+ */
+__kernel void calculate_image_colors_lut(const long x_mon, const long itr,
+		const int coloring, const int has_fractions,
+		__global const VALUE_T * imagevalues,
+		__global const float * fractions, __constant float * cdf,
+		__constant uchar * palette, __global unsigned char * image) {
+	long i = get_global_id(1) * x_mon + get_global_id(0);
+	__global unsigned char * pixel = image + i * 3;
+	long value = (long) imagevalues[i];
+
+	if (value >= itr) {
+		pixel[0] = 0;
+		pixel[1] = 0;
+		pixel[2] = 0;
+		return;
+	}
+
+	float smooth = (float) value + (has_fractions ? fractions[i] : 0.0f);
+	float t;
+
+	if (coloring == COLORING_HISTOGRAM) {
+		float position = smooth * COLORING_BINS / (float) itr;
+		int bin = min((int) position, COLORING_BINS - 1);
+		t = mix(cdf[bin], cdf[bin + 1], position - (float) bin);
+	} else {
+		t = smooth / COLORING_PERIOD;
+		t -= floor(t);
+	}
+
+	float entry = t * (float) (COLORING_PALETTE_SIZE - 1);
+	int j = min((int) entry, COLORING_PALETTE_SIZE - 2);
+	float weight = entry - (float) j;
+
+	for (int k = 0; k < 3; ++k) {
+		float a = (float) palette[j * 3 + k];
+		float b = (float) palette[(j + 1) * 3 + k];
+		pixel[k] = (unsigned char) (a + (b - a) * weight + 0.5f);
+	}
+}
+
+//###############################################
+//
+// video stream functions
+//
+//###############################################
+
+uchar luma(const int blue, const int green, const int red);
+__kernel void convert_image_to_yuv(const long x_mon, const long y_mon,
+		__global const unsigned char * image, __global unsigned char * yuv);
+
+/**
+ * Calculates the luma of a color, full range BT.601 in 8 bit fixed point.
+ *
+ * @param blue The blue value, 0..255.
+ * @param green The green value, 0..255.
+ * @param red The red value, 0..255.
+ * @return The luma, 0..255.
+ */
+uchar luma(const int blue, const int green, const int red) {
+	return (uchar) ((77 * red + 150 * green + 29 * blue + 128) >> 8);
+}
+
+/**
+ * Converts a colored image to a YUV 4:2:0 frame of a YUV4MPEG2 stream.
+ *
+ * The image is stored the way the bmp files expect it: blue, green and red
+ * bytes, with the bottom row of the picture first. The frame has the top
+ * row first, so the video looks like the bmp files. The frame has a plane
+ * of y_mon * x_mon luma values followed by the planes of the blue and red
+ * chroma, one value per 2 x 2 pixels. The chroma of a block is taken from
+ * its average color.
+ *
+ * The kernel is launched over a 2D range of (x_mon + 1) / 2 *
+ * (y_mon + 1) / 2 work-items, one per block. Same integer arithmetic as
+ * y4m_convert on the host.
+ *
+ * @param x_mon Resolution of the monitor on the horizontal axis.
+ * @param y_mon Resolution of the monitor on the vertical axis.
+ * @param image The colored image, 3 bytes per pixel.
+ * @param yuv The frame, y4m_frame_size bytes.
+ */
+__kernel void convert_image_to_yuv(const long x_mon, const long y_mon,
+		__global const unsigned char * image, __global unsigned char * yuv) {
+	long chroma_width = (x_mon + 1) / 2;
+	long chroma_height = (y_mon + 1) / 2;
+	long bx = get_global_id(0);
+	long by = get_global_id(1);
+	int sum_blue = 0;
+	int sum_green = 0;
+	int sum_red = 0;
+	int count = 0;
+
+	for (long y = 2 * by; y < 2 * by + 2 && y < y_mon; ++y) {
+		__global const unsigned char * row = image + (y_mon - 1 - y) * x_mon
+				* 3;
+
+		for (long x = 2 * bx; x < 2 * bx + 2 && x < x_mon; ++x) {
+			int blue = row[x * 3];
+			int green = row[x * 3 + 1];
+			int red = row[x * 3 + 2];
+
+			yuv[y * x_mon + x] = luma(blue, green, red);
+			sum_blue += blue;
+			sum_green += green;
+			sum_red += red;
+			count++;
+		}
+	}
+
+	int blue = sum_blue / count;
+	int green = sum_green / count;
+	int red = sum_red / count;
+	long planes = x_mon * y_mon;
+	long i = by * chroma_width + bx;
+
+	yuv[planes + i] = (uchar) min((-43 * red - 85 * green + 128 * blue
+			+ 32896) >> 8, 255);
+	yuv[planes + chroma_width * chroma_height + i] = (uchar) min((128 * red
+			- 107 * green - 21 * blue + 32896) >> 8, 255);
+}
+
+//###############################################
+//
+// precision functions
+//
+//###############################################
+
+#if defined(PRECISION_DF64) || defined(PRECISION_DOUBLE)
+
+#ifdef PRECISION_DOUBLE
+typedef double precise_t;
+#else
+// Double-float: x is the value rounded to float, y the rest
+typedef float2 precise_t;
+#endif
+
+precise_t precise_from_float(const float a);
+float precise_to_float(const precise_t a);
+precise_t precise_add(const precise_t a, const precise_t b);
+precise_t precise_sub(const precise_t a, const precise_t b);
+precise_t precise_mul(const precise_t a, const precise_t b);
+int precise_equal(const precise_t a, const precise_t b);
+long iterate_dot_precise(const precise_t c_real, const precise_t c_imaginary,
+		const float abort_value, const long itr, long * saved);
+__kernel void calculate_image_pixels_precise(const precise_t x_min,
+		const precise_t y_max, const float delta_x, const float delta_y,
+		const long x_mon, const float abort_value, const long itr,
+		const int export_values, __global VALUE_T * imagevalues,
+		__global unsigned char * image, __global ulong * saved_iterations);
+
+#ifdef PRECISION_DOUBLE
+
+// With native double the precise operations are the plain ones
+
+precise_t precise_from_float(const float a) {
+	return (double) a;
+}
+
+float precise_to_float(const precise_t a) {
+	return (float) a;
+}
+
+precise_t precise_add(const precise_t a, const precise_t b) {
+	return a + b;
+}
+
+precise_t precise_sub(const precise_t a, const precise_t b) {
+	return a - b;
+}
+
+precise_t precise_mul(const precise_t a, const precise_t b) {
+	return a * b;
+}
+
+int precise_equal(const precise_t a, const precise_t b) {
+	return a == b;
+}
+
+#else
+
+precise_t quick_two_sum(const float a, const float b);
+precise_t two_sum(const float a, const float b);
+
+/**
+ * Adds two floats whose sum is known to be |a| >= |b| without losing the
+ * rounding error.
+ *
+ * @param a First float.
+ * @param b Second float.
+ * @return a + b as double-float.
+ */
+precise_t quick_two_sum(const float a, const float b) {
+	float s = a + b;
+	float e = b - (s - a);
+
+	return (float2) (s, e);
+}
+
+/**
+ * Adds two floats without losing the rounding error.
+ *
+ * @param a First float.
+ * @param b Second float.
+ * @return a + b as double-float.
+ */
+precise_t two_sum(const float a, const float b) {
+	float s = a + b;
+	float v = s - a;
+	float e = (a - (s - v)) + (b - v);
+
+	return (float2) (s, e);
+}
+
+/**
+ * Converts a float to a double-float.
+ *
+ * @param a The float.
+ * @return The double-float.
+ */
+precise_t precise_from_float(const float a) {
+	return (float2) (a, 0.0f);
+}
+
+/**
+ * Rounds a double-float to float.
+ *
+ * @param a The double-float.
+ * @return The float.
+ */
+float precise_to_float(const precise_t a) {
+	return a.x;
+}
+
+/**
+ * Adds two double-floats.
+ *
+ * @param a First number.
+ * @param b Second number.
+ * @return a + b
+ */
+precise_t precise_add(const precise_t a, const precise_t b) {
+	precise_t s = two_sum(a.x, b.x);
+	s.y += a.y + b.y;
+
+	return quick_two_sum(s.x, s.y);
+}
+
+/**
+ * Subtracts two double-floats.
+ *
+ * @param a First number.
+ * @param b Second number.
+ * @return a - b
+ */
+precise_t precise_sub(const precise_t a, const precise_t b) {
+	return precise_add(a, -b);
+}
+
+/**
+ * Multiplies two double-floats. The rounding error of the product of the
+ * high parts is taken from fma.
+ *
+ * @param a First number.
+ * @param b Second number.
+ * @return a * b
+ */
+precise_t precise_mul(const precise_t a, const precise_t b) {
+	float p = a.x * b.x;
+	float e = fma(a.x, b.x, -p);
+	e += a.x * b.y + a.y * b.x;
+
+	return quick_two_sum(p, e);
+}
+
+/**
+ * Compares two double-floats.
+ *
+ * @param a First number.
+ * @param b Second number.
+ * @return 1 if a and b are equal, otherwise 0.
+ */
+int precise_equal(const precise_t a, const precise_t b) {
+	return a.x == b.x && a.y == b.y;
+}
+
+#endif
+
+/**
+ * Calculates the iterations of a point like iterate_dot, but with the
+ * precision of the tier. The escape test only needs the value rounded to
+ * float. The interior check only looks for periodic orbits, as the
+ * cardioid test in float isn't exact enough at the zoom depths of these
+ * tiers.
+ *
+ * @param c_real Real part of the point.
+ * @param c_imaginary Imaginary part of the point.
+ * @param abort_value The value of the abort condition. Normally 2.
+ * @param itr The number of required iterations.
+ * @param saved Set to the number of iterations the interior check saved.
+ * @return The number of iterations for that point.
+ */
+long iterate_dot_precise(const precise_t c_real, const precise_t c_imaginary,
+		const float abort_value, const long itr, long * saved) {
+#ifdef ESCAPE_RADIUS
+	const float radius = ESCAPE_RADIUS;
+#else
+	const float radius = abort_value;
+#endif
+
+	precise_t z_real = precise_from_float(0);
+	precise_t z_imaginary = precise_from_float(0);
+#ifdef INTERIOR_CHECK
+	precise_t z_period_real = z_real;
+	precise_t z_period_imaginary = z_imaginary;
+	ITER_T next_period = 1;
+#endif
+
+	*saved = 0;
+
+	ITER_T i = 0;
+	while (i < itr) {
+		precise_t rr = precise_mul(z_real, z_real);
+		precise_t ii = precise_mul(z_imaginary, z_imaginary);
+		precise_t ri = precise_mul(z_real, z_imaginary);
+
+		z_real = precise_sub(precise_sub(rr, ii), c_real);
+		z_imaginary = precise_sub(precise_add(ri, ri), c_imaginary);
+
+		my_complex_t z;
+		z.real = precise_to_float(z_real);
+		z.imaginary = precise_to_float(z_imaginary);
+		if (ESCAPED(z, radius)) {
+			break;
+		}
+		++i;
+
+#ifdef INTERIOR_CHECK
+		if (precise_equal(z_real, z_period_real)
+				&& precise_equal(z_imaginary, z_period_imaginary)) {
+			*saved = itr - i;
+			return itr;
+		}
+		if (i >= next_period) {
+			z_period_real = z_real;
+			z_period_imaginary = z_imaginary;
+			next_period *= 2;
+		}
+#endif
+	}
+
+	return i;
+}
+
+/**
+ * Calculates a whole colored Mandelbrot image in one pass, with the
+ * coordinates in the precision of the tier. The host passes the pixel
+ * spacing, as float is precise enough for the distance between two pixels.
+ *
+ * @param x_min Smallest X-value of the plane section.
+ * @param y_max Greatest Y-value of the plane section.
+ * @param delta_x Distance between two pixels on the horizontal axis.
+ * @param delta_y Distance between two pixels on the vertical axis.
+ * @param x_mon Resolution of the monitor on the horizontal axis.
+ * @param abort_value The value of the abort condition. Normally 2.
+ * @param itr The number of required iterations.
+ * @param export_values 1 to save the iteration values as well.
+ * @param imagevalues The image as a set of iteration values.
+ * @param image The final image, 3 bytes per pixel.
+ * @param saved_iterations Counter of the iterations the interior check saved.
+ */
+__kernel void calculate_image_pixels_precise(const precise_t x_min,
+		const precise_t y_max, const float delta_x, const float delta_y,
+		const long x_mon, const float abort_value, const long itr,
+		const int export_values, __global VALUE_T * imagevalues,
+		__global unsigned char * image, __global ulong * saved_iterations) {
+	int x = get_global_id(0);	//the position in the row
+	int y = get_global_id(1);	//the row, counted from the top
+	long i = y * x_mon + x;
+
+	precise_t c_real = precise_add(x_min,
+			precise_from_float((float) x * delta_x));
+	precise_t c_imaginary = precise_sub(y_max,
+			precise_from_float((float) y * delta_y));
+
+	long saved;
+	long iterations = iterate_dot_precise(c_real, c_imaginary, abort_value,
+			itr, &saved);
+
+	if (saved > 0) {
+		ADD_COUNTER(saved_iterations, saved);
+	}
+
+	if (export_values) {
+		imagevalues[i] = (VALUE_T) iterations;
+	}
+
+	calculate_color(iterations, itr, image + i * 3);
 }
 
+#endif
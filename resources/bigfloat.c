@@ -0,0 +1,304 @@
+/*
+ * bigfloat.c
+ *
+ *      Author: Felix Paetow
+ */
+
+#include "bigfloat.h"
+
+/**
+ * Limits a number of limbs to the supported range.
+ *
+ * @param limbs The number of limbs.
+ * @return The number of limbs that will be used.
+ */
+static int bigfloat_clamp_limbs(const int limbs) {
+	if (limbs < BIGFLOAT_MIN_LIMBS) {
+		return BIGFLOAT_MIN_LIMBS;
+	}
+	if (limbs > BIGFLOAT_MAX_LIMBS) {
+		return BIGFLOAT_MAX_LIMBS;
+	}
+	return limbs;
+}
+
+/**
+ * Sets a number to zero.
+ *
+ * @param b The number.
+ * @param limbs The number of limbs.
+ */
+static void bigfloat_zero(bigfloat_t * b, const int limbs) {
+	b->negative = 0;
+	b->limbs = bigfloat_clamp_limbs(limbs);
+	memset(b->limb, 0, sizeof(b->limb));
+}
+
+/**
+ * Sets a number to the value of a double. The value is converted exactly as
+ * long as the limbs hold all its bits.
+ *
+ * @param b The number.
+ * @param value The value, |value| < 2^32.
+ * @param limbs The number of limbs.
+ */
+void bigfloat_set_double(bigfloat_t * b, const double value, const int limbs) {
+	bigfloat_zero(b, limbs);
+
+	double a = fabs(value);
+	b->negative = (value < 0);
+
+	for (int i = b->limbs - 1; i >= 0 && a > 0; --i) {
+		double part = floor(a);
+		b->limb[i] = (uint32_t) part;
+		a = (a - part) * 4294967296.0;
+	}
+}
+
+/**
+ * Divides the magnitude of a number by a small integer.
+ *
+ * @param b The number.
+ * @param divisor The divisor.
+ */
+static void bigfloat_div_small(bigfloat_t * b, const uint32_t divisor) {
+	uint64_t remainder = 0;
+
+	for (int i = b->limbs - 1; i >= 0; --i) {
+		uint64_t current = (remainder << 32) | b->limb[i];
+		b->limb[i] = (uint32_t) (current / divisor);
+		remainder = current % divisor;
+	}
+}
+
+/**
+ * Reads a number in decimal notation without exponent, like -1.25 or .5.
+ * The number isn't limited to the precision of a double.
+ *
+ * @param b The number.
+ * @param text The text.
+ * @param limbs The number of limbs.
+ * @param end Set to the first character after the number, if not NULL.
+ * @return 0 on success, -1 if the text doesn't start with a number.
+ */
+int bigfloat_parse(bigfloat_t * b, const char * text, const int limbs,
+		const char ** end) {
+	const char * p = text;
+	uint32_t integer = 0;
+	int digits = 0;
+
+	bigfloat_zero(b, limbs);
+
+	int negative = 0;
+	if (*p == '-' || *p == '+') {
+		negative = (*p == '-');
+		++p;
+	}
+
+	while (isdigit((unsigned char) *p)) {
+		integer = integer * 10 + (uint32_t) (*p - '0');
+		++digits;
+		++p;
+	}
+
+	if (*p == '.') {
+		const char * fraction = ++p;
+		while (isdigit((unsigned char) *p)) {
+			++digits;
+			++p;
+		}
+
+		// The fraction is built from its last digit: f = (d + f) / 10
+		for (const char * d = p - 1; d >= fraction; --d) {
+			b->limb[b->limbs - 1] = (uint32_t) (*d - '0');
+			bigfloat_div_small(b, 10);
+		}
+	}
+
+	if (end != NULL) {
+		*end = p;
+	}
+	if (digits == 0) {
+		return -1;
+	}
+
+	b->limb[b->limbs - 1] = integer;
+	b->negative = negative;
+
+	return 0;
+}
+
+/**
+ * Changes the number of limbs of a number. Fractional limbs are cut off or
+ * added as zero.
+ *
+ * @param b The number.
+ * @param limbs The new number of limbs.
+ */
+void bigfloat_set_precision(bigfloat_t * b, const int limbs) {
+	int n = bigfloat_clamp_limbs(limbs);
+
+	if (n < b->limbs) {
+		memmove(b->limb, b->limb + (b->limbs - n), sizeof(uint32_t) * n);
+		memset(b->limb + n, 0, sizeof(uint32_t) * (b->limbs - n));
+	} else if (n > b->limbs) {
+		memmove(b->limb + (n - b->limbs), b->limb,
+				sizeof(uint32_t) * b->limbs);
+		memset(b->limb, 0, sizeof(uint32_t) * (n - b->limbs));
+	}
+	b->limbs = n;
+}
+
+/**
+ * Rounds a number to the nearest double.
+ *
+ * @param b The number.
+ * @return The value.
+ */
+double bigfloat_to_double(const bigfloat_t * b) {
+	double value = 0;
+
+	for (int i = 0; i < b->limbs; ++i) {
+		value = value / 4294967296.0 + (double) b->limb[i];
+	}
+
+	return b->negative ? -value : value;
+}
+
+/**
+ * Compares the magnitudes of two numbers with the same number of limbs.
+ *
+ * @param a First number.
+ * @param b Second number.
+ * @return -1, 0 or 1 if |a| is less, equal or greater than |b|.
+ */
+static int bigfloat_compare_magnitude(const bigfloat_t * a,
+		const bigfloat_t * b) {
+	for (int i = a->limbs - 1; i >= 0; --i) {
+		if (a->limb[i] != b->limb[i]) {
+			return (a->limb[i] < b->limb[i]) ? -1 : 1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * Clears the sign of a number that is zero, so there is no -0.
+ *
+ * @param b The number.
+ */
+static void bigfloat_fix_zero(bigfloat_t * b) {
+	for (int i = 0; i < b->limbs; ++i) {
+		if (b->limb[i] != 0) {
+			return;
+		}
+	}
+	b->negative = 0;
+}
+
+/**
+ * Adds a number with the sign of b to a, or subtracts it if subtract is
+ * set. r may be a or b.
+ *
+ * @param r The result.
+ * @param a First number.
+ * @param b Second number.
+ * @param subtract 1 to subtract b.
+ */
+static void bigfloat_add_signed(bigfloat_t * r, const bigfloat_t * a,
+		const bigfloat_t * b, const int subtract) {
+	int b_negative = subtract ? !b->negative : b->negative;
+	int limbs = a->limbs;
+	bigfloat_t result;
+
+	result.limbs = limbs;
+
+	if (a->negative == b_negative) {
+		uint64_t carry = 0;
+		for (int i = 0; i < limbs; ++i) {
+			uint64_t sum = (uint64_t) a->limb[i] + b->limb[i] + carry;
+			result.limb[i] = (uint32_t) sum;
+			carry = sum >> 32;
+		}
+		result.negative = a->negative;
+	} else {
+		// Subtract the smaller magnitude from the greater one
+		const bigfloat_t * greater = a;
+		const bigfloat_t * smaller = b;
+		result.negative = a->negative;
+		if (bigfloat_compare_magnitude(a, b) < 0) {
+			greater = b;
+			smaller = a;
+			result.negative = b_negative;
+		}
+
+		int64_t borrow = 0;
+		for (int i = 0; i < limbs; ++i) {
+			int64_t difference = (int64_t) greater->limb[i] - smaller->limb[i]
+					- borrow;
+			borrow = (difference < 0);
+			result.limb[i] = (uint32_t) (difference + (borrow << 32));
+		}
+	}
+
+	*r = result;
+	bigfloat_fix_zero(r);
+}
+
+/**
+ * Adds two numbers with the same number of limbs. r may be a or b.
+ *
+ * @param r The sum.
+ * @param a First number.
+ * @param b Second number.
+ */
+void bigfloat_add(bigfloat_t * r, const bigfloat_t * a, const bigfloat_t * b) {
+	bigfloat_add_signed(r, a, b, 0);
+}
+
+/**
+ * Subtracts two numbers with the same number of limbs. r may be a or b.
+ *
+ * @param r The difference a - b.
+ * @param a First number.
+ * @param b Second number.
+ */
+void bigfloat_sub(bigfloat_t * r, const bigfloat_t * a, const bigfloat_t * b) {
+	bigfloat_add_signed(r, a, b, 1);
+}
+
+/**
+ * Multiplies two numbers with the same number of limbs. The product is cut
+ * off after the last fractional limb. r may be a or b.
+ *
+ * @param r The product.
+ * @param a First number.
+ * @param b Second number.
+ */
+void bigfloat_mul(bigfloat_t * r, const bigfloat_t * a, const bigfloat_t * b) {
+	int limbs = a->limbs;
+	uint32_t product[2 * BIGFLOAT_MAX_LIMBS];
+
+	memset(product, 0, sizeof(uint32_t) * 2 * limbs);
+
+	for (int i = 0; i < limbs; ++i) {
+		uint64_t carry = 0;
+		if (a->limb[i] == 0) {
+			continue;
+		}
+		for (int j = 0; j < limbs; ++j) {
+			uint64_t t = (uint64_t) a->limb[i] * b->limb[j] + product[i + j]
+					+ carry;
+			product[i + j] = (uint32_t) t;
+			carry = t >> 32;
+		}
+		product[i + limbs] = (uint32_t) carry;
+	}
+
+	// Both factors have limbs - 1 fractional limbs, the product twice as
+	// many, so the result starts limbs - 1 limbs up
+	r->negative = a->negative != b->negative;
+	r->limbs = limbs;
+	memcpy(r->limb, product + (limbs - 1), sizeof(uint32_t) * limbs);
+	bigfloat_fix_zero(r);
+}
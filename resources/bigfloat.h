@@ -0,0 +1,43 @@
+/*
+ * bigfloat.h
+ *
+ *      Author: Felix Paetow
+ */
+
+#ifndef BIGFLOAT_H_
+#define BIGFLOAT_H_
+
+#include <ctype.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+//maximum number of 32 bit limbs of a number, one of them for the integer
+//part; 40 limbs hold 1248 fractional bits, enough for zooms of about 1e-350
+#define BIGFLOAT_MAX_LIMBS 40
+
+//smallest useful number of limbs
+#define BIGFLOAT_MIN_LIMBS 2
+
+/*
+ * A fixed-point number with a sign and limbs - 1 fractional limbs. The
+ * limbs are stored least significant first, limb[limbs - 1] is the integer
+ * part.
+ */
+typedef struct bigfloat {
+	int negative;
+	int limbs;
+	uint32_t limb[BIGFLOAT_MAX_LIMBS];
+} bigfloat_t;
+
+void bigfloat_set_double(bigfloat_t * b, const double value, const int limbs);
+int bigfloat_parse(bigfloat_t * b, const char * text, const int limbs,
+		const char ** end);
+void bigfloat_set_precision(bigfloat_t * b, const int limbs);
+double bigfloat_to_double(const bigfloat_t * b);
+void bigfloat_add(bigfloat_t * r, const bigfloat_t * a, const bigfloat_t * b);
+void bigfloat_sub(bigfloat_t * r, const bigfloat_t * a, const bigfloat_t * b);
+void bigfloat_mul(bigfloat_t * r, const bigfloat_t * a, const bigfloat_t * b);
+
+#endif /* BIGFLOAT_H_ */
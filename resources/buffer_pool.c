@@ -0,0 +1,175 @@
+/*
+ * buffer_pool.c
+ *
+ *      Author: Felix Paetow
+ */
+
+#include "buffer_pool.h"
+
+/**
+ * Initializes an empty buffer pool.
+ *
+ * The pool owns every buffer it hands out. A buffer is kept in its slot and
+ * handed out again as long as the requested size doesn't change, so the
+ * buffers of a video are only allocated once per resolution.
+ *
+ * @param pool The pool.
+ * @param context The context the device buffers are created in.
+ */
+void buffer_pool_init(buffer_pool_t * pool, cl_context context) {
+	pool->context = context;
+
+	for (int i = 0; i < BUFFER_POOL_SLOTS; ++i) {
+		pool->device_slots[i].device = NULL;
+		pool->device_slots[i].host = NULL;
+		pool->device_slots[i].size = 0;
+		pool->device_slots[i].flags = 0;
+
+		pool->host_slots[i].device = NULL;
+		pool->host_slots[i].host = NULL;
+		pool->host_slots[i].size = 0;
+		pool->host_slots[i].flags = 0;
+	}
+
+	pool->stats.live_device_bytes = 0;
+	pool->stats.peak_device_bytes = 0;
+	pool->stats.live_host_bytes = 0;
+	pool->stats.peak_host_bytes = 0;
+	pool->stats.allocations = 0;
+	pool->stats.reuses = 0;
+}
+
+/**
+ * Returns the device buffer of a slot.
+ *
+ * If the slot already holds a buffer with the same size and flags it is
+ * reused, otherwise the old buffer is released and a new one is created.
+ *
+ * @param pool The pool.
+ * @param slot The slot of the buffer, 0 <= slot < BUFFER_POOL_SLOTS.
+ * @param flags The flags for clCreateBuffer.
+ * @param size The size of the buffer in bytes.
+ * @param err Set to the error code of clCreateBuffer or CL_SUCCESS.
+ * @return The buffer or NULL on error.
+ */
+cl_mem buffer_pool_device_buffer(buffer_pool_t * pool, const int slot,
+		const cl_mem_flags flags, const size_t size, cl_int * err) {
+	if (slot < 0 || slot >= BUFFER_POOL_SLOTS) {
+		*err = CL_INVALID_VALUE;
+		return NULL;
+	}
+
+	buffer_pool_slot_t * s = &pool->device_slots[slot];
+
+	if (s->device != NULL && s->size == size && s->flags == flags) {
+		pool->stats.reuses++;
+		*err = CL_SUCCESS;
+		return s->device;
+	}
+
+	if (s->device != NULL) {
+		clReleaseMemObject(s->device);
+		pool->stats.live_device_bytes -= s->size;
+		s->device = NULL;
+		s->size = 0;
+	}
+
+	s->device = clCreateBuffer(pool->context, flags, size, NULL, err);
+	if (*err != CL_SUCCESS) {
+		s->device = NULL;
+		return NULL;
+	}
+	s->size = size;
+	s->flags = flags;
+
+	pool->stats.allocations++;
+	pool->stats.live_device_bytes += size;
+	if (pool->stats.live_device_bytes > pool->stats.peak_device_bytes) {
+		pool->stats.peak_device_bytes = pool->stats.live_device_bytes;
+	}
+
+	return s->device;
+}
+
+/**
+ * Returns the host staging buffer of a slot.
+ *
+ * If the slot already holds a buffer with the same size it is reused,
+ * otherwise the old buffer is freed and a new one is allocated. The content
+ * of a new buffer is undefined.
+ *
+ * @param pool The pool.
+ * @param slot The slot of the buffer, 0 <= slot < BUFFER_POOL_SLOTS.
+ * @param size The size of the buffer in bytes.
+ * @return The buffer or NULL if it couldn't be allocated.
+ */
+void * buffer_pool_host_buffer(buffer_pool_t * pool, const int slot,
+		const size_t size) {
+	if (slot < 0 || slot >= BUFFER_POOL_SLOTS) {
+		return NULL;
+	}
+
+	buffer_pool_slot_t * s = &pool->host_slots[slot];
+
+	if (s->host != NULL && s->size == size) {
+		pool->stats.reuses++;
+		return s->host;
+	}
+
+	if (s->host != NULL) {
+		free(s->host);
+		pool->stats.live_host_bytes -= s->size;
+		s->host = NULL;
+		s->size = 0;
+	}
+
+	s->host = malloc(size);
+	if (s->host == NULL) {
+		return NULL;
+	}
+	s->size = size;
+
+	pool->stats.allocations++;
+	pool->stats.live_host_bytes += size;
+	if (pool->stats.live_host_bytes > pool->stats.peak_host_bytes) {
+		pool->stats.peak_host_bytes = pool->stats.live_host_bytes;
+	}
+
+	return s->host;
+}
+
+/**
+ * Releases all buffers of the pool. The pool can be used again afterwards.
+ *
+ * @param pool The pool.
+ */
+void buffer_pool_release(buffer_pool_t * pool) {
+	for (int i = 0; i < BUFFER_POOL_SLOTS; ++i) {
+		if (pool->device_slots[i].device != NULL) {
+			clReleaseMemObject(pool->device_slots[i].device);
+			pool->stats.live_device_bytes -= pool->device_slots[i].size;
+			pool->device_slots[i].device = NULL;
+			pool->device_slots[i].size = 0;
+		}
+		if (pool->host_slots[i].host != NULL) {
+			free(pool->host_slots[i].host);
+			pool->stats.live_host_bytes -= pool->host_slots[i].size;
+			pool->host_slots[i].host = NULL;
+			pool->host_slots[i].size = 0;
+		}
+	}
+}
+
+/**
+ * Prints the memory statistics of the pool.
+ *
+ * @param pool The pool.
+ */
+void buffer_pool_print_stats(const buffer_pool_t * pool) {
+	printf("Buffer pool: device %zu bytes live, %zu bytes peak; ",
+			pool->stats.live_device_bytes, pool->stats.peak_device_bytes);
+	printf("host %zu bytes live, %zu bytes peak; ",
+			pool->stats.live_host_bytes, pool->stats.peak_host_bytes);
+	printf("%ld allocations, %ld reuses\n", pool->stats.allocations,
+			pool->stats.reuses);
+}
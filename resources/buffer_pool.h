@@ -0,0 +1,52 @@
+/*
+ * buffer_pool.h
+ *
+ *      Author: Felix Paetow
+ */
+
+#ifndef BUFFER_POOL_H_
+#define BUFFER_POOL_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#ifdef __APPLE__
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+//maximum number of device and host buffers a pool can hold
+#define BUFFER_POOL_SLOTS 48
+
+typedef struct buffer_pool_slot {
+	cl_mem device;
+	void * host;
+	size_t size;
+	cl_mem_flags flags;
+} buffer_pool_slot_t;
+
+typedef struct buffer_pool_stats {
+	size_t live_device_bytes;
+	size_t peak_device_bytes;
+	size_t live_host_bytes;
+	size_t peak_host_bytes;
+	long allocations;
+	long reuses;
+} buffer_pool_stats_t;
+
+typedef struct buffer_pool {
+	cl_context context;
+	buffer_pool_slot_t device_slots[BUFFER_POOL_SLOTS];
+	buffer_pool_slot_t host_slots[BUFFER_POOL_SLOTS];
+	buffer_pool_stats_t stats;
+} buffer_pool_t;
+
+void buffer_pool_init(buffer_pool_t * pool, cl_context context);
+cl_mem buffer_pool_device_buffer(buffer_pool_t * pool, const int slot,
+		const cl_mem_flags flags, const size_t size, cl_int * err);
+void * buffer_pool_host_buffer(buffer_pool_t * pool, const int slot,
+		const size_t size);
+void buffer_pool_release(buffer_pool_t * pool);
+void buffer_pool_print_stats(const buffer_pool_t * pool);
+
+#endif /* BUFFER_POOL_H_ */
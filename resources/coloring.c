@@ -0,0 +1,276 @@
+/*
+ * coloring.c
+ *
+ *      Author: Felix Paetow
+ */
+
+#include "coloring.h"
+
+//colors the palette runs through, as red, green and blue. The last one
+//leads back to the first, so the smooth coloring has no seam.
+static const unsigned char palette_colors[][3] = {
+		{ 0, 7, 100 }, { 32, 107, 203 }, { 237, 255, 255 }, { 255, 170, 0 },
+		{ 0, 2, 0 } };
+
+/**
+ * Reads the name of a coloring.
+ *
+ * @param name linear, smooth or histogram.
+ * @return The coloring or -1 if the name is unknown.
+ */
+int coloring_parse(const char * name) {
+	for (int mode = COLORING_LINEAR; mode <= COLORING_HISTOGRAM; ++mode) {
+		if (strcmp(name, coloring_name(mode)) == 0) {
+			return mode;
+		}
+	}
+	return -1;
+}
+
+/**
+ * Returns the name of a coloring.
+ *
+ * @param mode The coloring.
+ * @return The name.
+ */
+const char * coloring_name(const int mode) {
+	switch (mode) {
+	case COLORING_SMOOTH:
+		return "smooth";
+	case COLORING_HISTOGRAM:
+		return "histogram";
+	default:
+		return "linear";
+	}
+}
+
+/**
+ * Fills the palette with a cyclic gradient through palette_colors.
+ *
+ * The colors are stored in the byte order of the images, which the bmp
+ * writer keeps as blue, green and red.
+ *
+ * @param palette COLORING_PALETTE_SIZE colors of 3 bytes each.
+ */
+void coloring_palette(unsigned char * palette) {
+	int colors = sizeof(palette_colors) / sizeof(palette_colors[0]);
+
+	for (int i = 0; i < COLORING_PALETTE_SIZE; ++i) {
+		double position = (double) i * colors / COLORING_PALETTE_SIZE;
+		int from = (int) position;
+		int to = (from + 1) % colors;
+		double weight = position - from;
+
+		for (int k = 0; k < 3; ++k) {
+			double value = palette_colors[from][k] * (1 - weight)
+					+ palette_colors[to][k] * weight;
+			palette[i * 3 + 2 - k] = (unsigned char) (value + 0.5);
+		}
+	}
+}
+
+/**
+ * Creates the device buffers of a coloring and uploads the palette.
+ *
+ * Nothing is created for the linear coloring, which calculate_color does
+ * inside the iteration kernels.
+ *
+ * @param coloring The coloring.
+ * @param mode COLORING_LINEAR, COLORING_SMOOTH or COLORING_HISTOGRAM.
+ * @param context The context of the buffers.
+ * @param device_id The device the kernels run on.
+ * @return CL_SUCCESS or the error code of the failed OpenCL call.
+ */
+cl_int coloring_init(coloring_t * coloring, const int mode,
+		cl_context context, cl_device_id device_id) {
+	unsigned char palette[COLORING_PALETTE_SIZE * 3];
+	cl_int err = CL_SUCCESS;
+
+	coloring->mode = mode;
+	coloring->device_id = device_id;
+	coloring->d_histogram = NULL;
+	coloring->d_cdf = NULL;
+	coloring->d_palette = NULL;
+
+	if (mode == COLORING_LINEAR) {
+		return CL_SUCCESS;
+	}
+
+	coloring_palette(palette);
+
+	coloring->d_histogram = clCreateBuffer(context, CL_MEM_READ_WRITE,
+			sizeof(cl_uint) * COLORING_BINS, NULL, &err);
+	if (err == CL_SUCCESS) {
+		coloring->d_cdf = clCreateBuffer(context, CL_MEM_READ_WRITE,
+				sizeof(cl_float) * (COLORING_BINS + 1), NULL, &err);
+	}
+	if (err == CL_SUCCESS) {
+		coloring->d_palette = clCreateBuffer(context,
+				CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(palette),
+				palette, &err);
+	}
+	if (err != CL_SUCCESS) {
+		coloring_release(coloring);
+	}
+
+	return err;
+}
+
+/**
+ * Returns the greatest power of two a kernel can run as work-group, up to a
+ * limit.
+ *
+ * @param kernel The kernel.
+ * @param device_id The device the kernel runs on.
+ * @param limit The greatest size wanted, a power of two.
+ * @return The work-group size.
+ */
+static size_t coloring_local_size(cl_kernel kernel, cl_device_id device_id,
+		const size_t limit) {
+	size_t max_size = 1;
+	size_t size = limit;
+
+	clGetKernelWorkGroupInfo(kernel, device_id, CL_KERNEL_WORK_GROUP_SIZE,
+			sizeof(max_size), &max_size, NULL);
+	while (size > max_size && size > 1) {
+		size /= 2;
+	}
+
+	return size;
+}
+
+/**
+ * Enqueues the coloring of an image from its iteration values.
+ *
+ * The histogram coloring counts the iterations into a histogram, which is
+ * turned into its lookup table, before the colors are looked up. All of it
+ * stays on the device, so the host never waits for a frame.
+ *
+ * @param coloring The coloring, not the linear one.
+ * @param commands The in-order queue the iteration values are calculated
+ *        in.
+ * @param kernels The kernels of the variant of the frame.
+ * @param x_mon Resolution of the monitor on the horizontal axis.
+ * @param y_mon Resolution of the monitor on the vertical axis.
+ * @param itr The number of required iterations.
+ * @param d_image The iteration values of the image.
+ * @param d_fractions The fractional part of the iterations of each point or
+ *        NULL if the iterations are whole numbers.
+ * @param d_image_pixel The colored image.
+ * @param colored Set to the event of the color kernel.
+ * @return CL_SUCCESS or the error code of the failed OpenCL call.
+ */
+cl_int coloring_enqueue(coloring_t * coloring, cl_command_queue commands,
+		const kernel_program_t * kernels, const long x_mon, const long y_mon,
+		const long itr, cl_mem d_image, cl_mem d_fractions,
+		cl_mem d_image_pixel, cl_event * colored) {
+	cl_int err = CL_SUCCESS;
+	long pixels = x_mon * y_mon;
+
+	if (coloring->mode == COLORING_HISTOGRAM) {
+		cl_kernel ko_calculate_histogram = kernels->ko_calculate_histogram;
+		cl_kernel ko_calculate_palette = kernels->ko_calculate_palette;
+		size_t local = coloring_local_size(ko_calculate_histogram,
+				coloring->device_id, 256);
+		size_t global = local * COLORING_HISTOGRAM_GROUPS;
+		cl_uint zero = 0;
+
+		err = clEnqueueFillBuffer(commands, coloring->d_histogram, &zero,
+				sizeof(zero), 0, sizeof(cl_uint) * COLORING_BINS, 0, NULL,
+				NULL);
+
+		err |= clSetKernelArg(ko_calculate_histogram, 0, sizeof(long),
+				&pixels);
+		err |= clSetKernelArg(ko_calculate_histogram, 1, sizeof(long), &itr);
+		err |= clSetKernelArg(ko_calculate_histogram, 2, sizeof(cl_mem),
+				&d_image);
+		err |= clSetKernelArg(ko_calculate_histogram, 3, sizeof(cl_mem),
+				&coloring->d_histogram);
+		if (err != CL_SUCCESS) {
+			return err;
+		}
+
+		/*__kernel void calculate_histogram(const long pixels, const long itr,
+		 __global const VALUE_T * imagevalues, __global uint * histogram)*/
+
+		err = clEnqueueNDRangeKernel(commands, ko_calculate_histogram, 1,
+				NULL, &global, &local, 0, NULL, NULL);
+
+		// One work-group scans the whole histogram
+		local = coloring_local_size(ko_calculate_palette, coloring->device_id,
+				256);
+
+		err |= clSetKernelArg(ko_calculate_palette, 0, sizeof(cl_mem),
+				&coloring->d_histogram);
+		err |= clSetKernelArg(ko_calculate_palette, 1, sizeof(cl_mem),
+				&coloring->d_cdf);
+		if (err != CL_SUCCESS) {
+			return err;
+		}
+
+		/*__kernel void calculate_palette(__global const uint * histogram,
+		 __global float * cdf)*/
+
+		err = clEnqueueNDRangeKernel(commands, ko_calculate_palette, 1, NULL,
+				&local, &local, 0, NULL, NULL);
+		if (err != CL_SUCCESS) {
+			return err;
+		}
+	}
+
+	cl_kernel ko_calculate_image_colors_lut =
+			kernels->ko_calculate_image_colors_lut;
+	size_t global[2] = { x_mon, y_mon };
+	int has_fractions = (d_fractions != NULL);
+
+	err = clSetKernelArg(ko_calculate_image_colors_lut, 0, sizeof(long),
+			&x_mon);
+	err |= clSetKernelArg(ko_calculate_image_colors_lut, 1, sizeof(long),
+			&itr);
+	err |= clSetKernelArg(ko_calculate_image_colors_lut, 2, sizeof(int),
+			&coloring->mode);
+	err |= clSetKernelArg(ko_calculate_image_colors_lut, 3, sizeof(int),
+			&has_fractions);
+	err |= clSetKernelArg(ko_calculate_image_colors_lut, 4, sizeof(cl_mem),
+			&d_image);
+	err |= clSetKernelArg(ko_calculate_image_colors_lut, 5, sizeof(cl_mem),
+			&d_fractions);
+	err |= clSetKernelArg(ko_calculate_image_colors_lut, 6, sizeof(cl_mem),
+			&coloring->d_cdf);
+	err |= clSetKernelArg(ko_calculate_image_colors_lut, 7, sizeof(cl_mem),
+			&coloring->d_palette);
+	err |= clSetKernelArg(ko_calculate_image_colors_lut, 8, sizeof(cl_mem),
+			&d_image_pixel);
+	if (err != CL_SUCCESS) {
+		return err;
+	}
+
+	/*__kernel void calculate_image_colors_lut(const long x_mon, const long itr,
+	 const int coloring, const int has_fractions,
+	 __global const VALUE_T * imagevalues,
+	 __global const float * fractions, __constant float * cdf,
+	 __constant uchar * palette, __global unsigned char * image)*/
+
+	return clEnqueueNDRangeKernel(commands, ko_calculate_image_colors_lut, 2,
+			NULL, global, NULL, 0, NULL, colored);
+}
+
+/**
+ * Releases the device buffers of a coloring.
+ *
+ * @param coloring The coloring.
+ */
+void coloring_release(coloring_t * coloring) {
+	if (coloring->d_histogram != NULL) {
+		clReleaseMemObject(coloring->d_histogram);
+		coloring->d_histogram = NULL;
+	}
+	if (coloring->d_cdf != NULL) {
+		clReleaseMemObject(coloring->d_cdf);
+		coloring->d_cdf = NULL;
+	}
+	if (coloring->d_palette != NULL) {
+		clReleaseMemObject(coloring->d_palette);
+		coloring->d_palette = NULL;
+	}
+}
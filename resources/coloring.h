@@ -0,0 +1,55 @@
+/*
+ * coloring.h
+ *
+ *      Author: Felix Paetow
+ */
+
+#ifndef COLORING_H_
+#define COLORING_H_
+
+#include <stdio.h>
+#include <string.h>
+#ifdef __APPLE__
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+#include "kernel_variants.h"
+
+//colorings of the images: the gray steps of calculate_color, the palette
+//run through smoothly, or the palette spread evenly over the points
+#define COLORING_LINEAR 0
+#define COLORING_SMOOTH 1
+#define COLORING_HISTOGRAM 2
+
+//bins of the iteration histogram and entries of the palette, the same as in
+//the kernel
+#define COLORING_BINS 1024
+#define COLORING_PALETTE_SIZE 256
+
+//work-groups of the histogram kernel, each counting in its local memory
+#define COLORING_HISTOGRAM_GROUPS 64
+
+typedef struct coloring {
+	int mode;
+	cl_device_id device_id;
+
+	//histogram of the iterations, its lookup table and the palette, all
+	//kept on the device from frame to frame
+	cl_mem d_histogram;
+	cl_mem d_cdf;
+	cl_mem d_palette;
+} coloring_t;
+
+int coloring_parse(const char * name);
+const char * coloring_name(const int mode);
+void coloring_palette(unsigned char * palette);
+cl_int coloring_init(coloring_t * coloring, const int mode,
+		cl_context context, cl_device_id device_id);
+cl_int coloring_enqueue(coloring_t * coloring, cl_command_queue commands,
+		const kernel_program_t * kernels, const long x_mon, const long y_mon,
+		const long itr, cl_mem d_image, cl_mem d_fractions,
+		cl_mem d_image_pixel, cl_event * colored);
+void coloring_release(coloring_t * coloring);
+
+#endif /* COLORING_H_ */
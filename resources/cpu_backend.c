@@ -0,0 +1,1443 @@
+/*
+ * cpu_backend.c
+ *
+ *      Author: Felix Paetow
+ */
+
+#include "cpu_backend.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CPU_BACKEND_X86 1
+#endif
+
+//number of points of the widest vector
+#define CPU_BACKEND_MAX_LANES 16
+
+//same as PERTURBATION_FLOAT_EXPONENT and PERTURBATION_NORMALIZE_EXPONENT in
+//the kernel
+#define CPU_BACKEND_FLOAT_EXPONENT -60
+#define CPU_BACKEND_NORMALIZE_EXPONENT 8
+
+/*
+ * The CPU backend must produce exactly the values of the OpenCL kernels, so
+ * every multiplication and addition has to be rounded on its own, like the
+ * kernel does with FP_CONTRACT OFF.
+ */
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize ("fp-contract=off")
+#endif
+
+/**
+ * Calculates the distance (delta) for a certain number of uniformly
+ * distributed points, spread over a line. Same as delta() in the kernel.
+ *
+ * @param min Smallest value of the line.
+ * @param max Greatest value of the line.
+ * @param size Number of Points.
+ * @return Distance between the points on the line
+ */
+static float cpu_delta(const float min, const float max, const long size) {
+	return (max - min) / (float) (size - 1);
+}
+
+/**
+ * Calculates the real part of the points of a row, like the kernel does.
+ *
+ * @param frame The frame.
+ * @param x The first position in the row.
+ * @param count The number of points.
+ * @param c_real The real parts.
+ */
+static void cpu_row_reals(const cpu_frame_t * frame, const long x,
+		const int count, float * c_real) {
+	float delta_x = cpu_delta(frame->x_min, frame->x_max, frame->x_mon);
+
+	for (int l = 0; l < count; ++l) {
+		float offset = (float) (x + l) * delta_x;
+		c_real[l] = frame->x_min + offset;
+	}
+}
+
+/**
+ * Calculates the imaginary part of the points of a row, like the kernel
+ * does.
+ *
+ * @param frame The frame.
+ * @param y The row, counted from the top.
+ * @return The imaginary part.
+ */
+static float cpu_row_imaginary(const cpu_frame_t * frame, const long y) {
+	float delta_y = cpu_delta(frame->y_min, frame->y_max, frame->y_mon);
+	float offset = (float) y * delta_y;
+
+	return frame->y_max - offset;
+}
+
+/**
+ * Tests if a point lies in the main cardioid or in the period-2 bulb. Same
+ * as is_interior in the kernel, which decides about the same points.
+ *
+ * @param c_real The real part of the point.
+ * @param c_imaginary The imaginary part of the point.
+ * @return 1 if the point lies in the cardioid or the bulb, otherwise 0.
+ */
+static int cpu_is_interior(const float c_real, const float c_imaginary) {
+	float x = -c_real;
+	float y2 = c_imaginary * c_imaginary;
+
+	float xq = x - 0.25f;
+	float q = xq * xq + y2;
+	if (q * (q + xq) < 0.25f * y2) {
+		return 1;
+	}
+
+	float xb = x + 1.0f;
+	if (xb * xb + y2 < 0.0625f) {
+		return 1;
+	}
+
+	return 0;
+}
+
+/**
+ * Marks the points that lie in the cardioid or the period-2 bulb.
+ *
+ * @param frame The frame.
+ * @param c_real The real parts.
+ * @param c_imaginary The imaginary parts.
+ * @param count The number of points.
+ * @param interior -1 for points inside, otherwise 0.
+ */
+static void cpu_points_interior(const cpu_frame_t * frame,
+		const float * c_real, const float * c_imaginary, const int count,
+		int * interior) {
+	for (int l = 0; l < count; ++l) {
+		interior[l] = (frame->interior_check
+				&& cpu_is_interior(c_real[l], c_imaginary[l])) ? -1 : 0;
+	}
+}
+
+/**
+ * Calculates the iterations of one point. Same as iterate_dot in the
+ * kernel.
+ *
+ * With the interior check, the values of z at powers of two iterations are
+ * kept. If z comes back to one of them, the orbit is periodic and the point
+ * gets itr iterations at once.
+ *
+ * @param frame The frame.
+ * @param c_real The real part of the point.
+ * @param c_imaginary The imaginary part of the point.
+ * @param interior 1 if the point lies in the cardioid or the bulb.
+ * @param saved Increased by the number of iterations the check saved.
+ * @return The number of iterations for that point.
+ */
+static long cpu_iterate_point(const cpu_frame_t * frame, const float c_real,
+		const float c_imaginary, const int interior, long * saved) {
+	float z_real = 0;
+	float z_imaginary = 0;
+	float z_period_real = 0;
+	float z_period_imaginary = 0;
+	long next_period = 1;
+	float sum = -1;
+
+	if (interior) {
+		*saved += frame->itr;
+		return frame->itr;
+	}
+
+	long i = 0;
+	while (i < frame->itr && sum < frame->abort_value) {
+		float rr = z_real * z_real;
+		float ii = z_imaginary * z_imaginary;
+		float ri = z_real * z_imaginary;
+
+		z_real = (rr - ii) - c_real;
+		z_imaginary = (ri + ri) - c_imaginary;
+
+		float sr = z_real * z_real;
+		float si = z_imaginary * z_imaginary;
+		sum = sqrtf(sr + si);
+
+		if (sum < frame->abort_value) {
+			++i;
+
+			if (frame->interior_check) {
+				if (z_real == z_period_real
+						&& z_imaginary == z_period_imaginary) {
+					*saved += frame->itr - i;
+					return frame->itr;
+				}
+				if (i >= next_period) {
+					z_period_real = z_real;
+					z_period_imaginary = z_imaginary;
+					next_period *= 2;
+				}
+			}
+		}
+	}
+
+	return i;
+}
+
+
+/**
+ * Calculates the iterations of a list of points one point after the other.
+ *
+ * @param frame The frame.
+ * @param c_real The real parts.
+ * @param c_imaginary The imaginary parts.
+ * @param interior -1 for points in the cardioid or the bulb, otherwise 0.
+ * @param count The number of points.
+ * @param values The iteration values.
+ * @return The number of iterations the interior check saved.
+ */
+static long cpu_iterate_scalar(const cpu_frame_t * frame,
+		const float * c_real, const float * c_imaginary, const int * interior,
+		const int count, long * values) {
+	long saved = 0;
+
+	for (int l = 0; l < count; ++l) {
+		values[l] = cpu_iterate_point(frame, c_real[l], c_imaginary[l],
+				interior[l], &saved);
+	}
+
+	return saved;
+}
+
+#ifdef CPU_BACKEND_X86
+/**
+ * Calculates the iterations of a list of points with 8 points per AVX2
+ * vector. Lanes of escaped points are masked out, the loop ends when all
+ * lanes escaped. Lanes of interior points and periodic orbits are masked
+ * out with itr iterations.
+ *
+ * @param frame The frame.
+ * @param c_real The real parts, padded to a multiple of 8.
+ * @param c_imaginary The imaginary parts, padded to a multiple of 8.
+ * @param interior -1 for points in the cardioid or the bulb and for the
+ *                 padding, otherwise 0.
+ * @param count The number of points.
+ * @param values The iteration values.
+ * @return The number of iterations the interior check saved.
+ */
+__attribute__((target("avx2")))
+static long cpu_iterate_avx2(const cpu_frame_t * frame,
+		const float * c_real, const float * c_imaginary, const int * interior,
+		const int count, long * values) {
+	int counts[8];
+	int saved_lanes[8];
+	long saved = 0;
+
+	const __m256 abort_value = _mm256_set1_ps(frame->abort_value);
+	const __m256i itr = _mm256_set1_epi32((int) frame->itr);
+
+	for (int x = 0; x < count; x += 8) {
+		__m256 c_re = _mm256_loadu_ps(c_real + x);
+		__m256 c_im = _mm256_loadu_ps(c_imaginary + x);
+		__m256 z_re = _mm256_setzero_ps();
+		__m256 z_im = _mm256_setzero_ps();
+		__m256 z_period_re = z_re;
+		__m256 z_period_im = z_im;
+		long next_period = 1;
+		__m256 inside = _mm256_castsi256_ps(
+				_mm256_loadu_si256((const __m256i *) (interior + x)));
+		__m256 active = _mm256_andnot_ps(inside,
+				_mm256_castsi256_ps(_mm256_set1_epi32(-1)));
+		__m256i count_lanes = _mm256_and_si256(itr,
+				_mm256_castps_si256(inside));
+		__m256i saved_count = count_lanes;
+
+		for (long i = 0; i < frame->itr; ++i) {
+			if (_mm256_movemask_ps(active) == 0) {
+				break;
+			}
+
+			__m256 rr = _mm256_mul_ps(z_re, z_re);
+			__m256 ii = _mm256_mul_ps(z_im, z_im);
+			__m256 ri = _mm256_mul_ps(z_re, z_im);
+
+			z_re = _mm256_sub_ps(_mm256_sub_ps(rr, ii), c_re);
+			z_im = _mm256_sub_ps(_mm256_add_ps(ri, ri), c_im);
+
+			__m256 sr = _mm256_mul_ps(z_re, z_re);
+			__m256 si = _mm256_mul_ps(z_im, z_im);
+			__m256 sum = _mm256_sqrt_ps(_mm256_add_ps(sr, si));
+
+			active = _mm256_and_ps(active,
+					_mm256_cmp_ps(sum, abort_value, _CMP_LT_OQ));
+			if (_mm256_movemask_ps(active) == 0) {
+				break;
+			}
+
+			//active lanes are -1
+			count_lanes = _mm256_sub_epi32(count_lanes,
+					_mm256_castps_si256(active));
+
+			if (frame->interior_check) {
+				__m256 periodic = _mm256_and_ps(active, _mm256_and_ps(
+						_mm256_cmp_ps(z_re, z_period_re, _CMP_EQ_OQ),
+						_mm256_cmp_ps(z_im, z_period_im, _CMP_EQ_OQ)));
+				if (_mm256_movemask_ps(periodic) != 0) {
+					__m256i left = _mm256_sub_epi32(itr, count_lanes);
+					saved_count = _mm256_blendv_epi8(saved_count, left,
+							_mm256_castps_si256(periodic));
+					count_lanes = _mm256_blendv_epi8(count_lanes, itr,
+							_mm256_castps_si256(periodic));
+					active = _mm256_andnot_ps(periodic, active);
+				}
+				if (i + 1 >= next_period) {
+					z_period_re = z_re;
+					z_period_im = z_im;
+					next_period *= 2;
+				}
+			}
+		}
+
+		_mm256_storeu_si256((__m256i *) counts, count_lanes);
+		_mm256_storeu_si256((__m256i *) saved_lanes, saved_count);
+		for (int l = 0; l < 8 && x + l < count; ++l) {
+			values[x + l] = counts[l];
+			saved += saved_lanes[l];
+		}
+	}
+
+	return saved;
+}
+
+/**
+ * Calculates the iterations of a list of points with 16 points per AVX-512
+ * vector. Lanes of escaped points are masked out, the loop ends when all
+ * lanes escaped. Lanes of interior points and periodic orbits are masked
+ * out with itr iterations.
+ *
+ * @param frame The frame.
+ * @param c_real The real parts, padded to a multiple of 16.
+ * @param c_imaginary The imaginary parts, padded to a multiple of 16.
+ * @param interior -1 for points in the cardioid or the bulb and for the
+ *                 padding, otherwise 0.
+ * @param count The number of points.
+ * @param values The iteration values.
+ * @return The number of iterations the interior check saved.
+ */
+__attribute__((target("avx512f")))
+static long cpu_iterate_avx512(const cpu_frame_t * frame,
+		const float * c_real, const float * c_imaginary, const int * interior,
+		const int count, long * values) {
+	int counts[16];
+	int saved_lanes[16];
+	long saved = 0;
+
+	const __m512 abort_value = _mm512_set1_ps(frame->abort_value);
+	const __m512i one = _mm512_set1_epi32(1);
+	const __m512i itr = _mm512_set1_epi32((int) frame->itr);
+
+	for (int x = 0; x < count; x += 16) {
+		__m512 c_re = _mm512_loadu_ps(c_real + x);
+		__m512 c_im = _mm512_loadu_ps(c_imaginary + x);
+		__m512 z_re = _mm512_setzero_ps();
+		__m512 z_im = _mm512_setzero_ps();
+		__m512 z_period_re = z_re;
+		__m512 z_period_im = z_im;
+		long next_period = 1;
+		__mmask16 inside = _mm512_test_epi32_mask(
+				_mm512_loadu_si512((const void *) (interior + x)),
+				_mm512_set1_epi32(-1));
+		__mmask16 active = (__mmask16) ~inside;
+		__m512i count_lanes = _mm512_maskz_mov_epi32(inside, itr);
+		__m512i saved_count = count_lanes;
+
+		for (long i = 0; i < frame->itr; ++i) {
+			if (active == 0) {
+				break;
+			}
+
+			__m512 rr = _mm512_mul_ps(z_re, z_re);
+			__m512 ii = _mm512_mul_ps(z_im, z_im);
+			__m512 ri = _mm512_mul_ps(z_re, z_im);
+
+			z_re = _mm512_sub_ps(_mm512_sub_ps(rr, ii), c_re);
+			z_im = _mm512_sub_ps(_mm512_add_ps(ri, ri), c_im);
+
+			__m512 sr = _mm512_mul_ps(z_re, z_re);
+			__m512 si = _mm512_mul_ps(z_im, z_im);
+			__m512 sum = _mm512_sqrt_ps(_mm512_add_ps(sr, si));
+
+			active = _mm512_mask_cmp_ps_mask(active, sum, abort_value,
+					_CMP_LT_OQ);
+			if (active == 0) {
+				break;
+			}
+
+			count_lanes = _mm512_mask_add_epi32(count_lanes, active,
+					count_lanes, one);
+
+			if (frame->interior_check) {
+				__mmask16 periodic = _mm512_mask_cmp_ps_mask(
+						_mm512_mask_cmp_ps_mask(active, z_re, z_period_re,
+								_CMP_EQ_OQ), z_im, z_period_im, _CMP_EQ_OQ);
+				if (periodic != 0) {
+					saved_count = _mm512_mask_sub_epi32(saved_count, periodic,
+							itr, count_lanes);
+					count_lanes = _mm512_mask_mov_epi32(count_lanes, periodic,
+							itr);
+					active &= (__mmask16) ~periodic;
+				}
+				if (i + 1 >= next_period) {
+					z_period_re = z_re;
+					z_period_im = z_im;
+					next_period *= 2;
+				}
+			}
+		}
+
+		_mm512_storeu_si512((void *) counts, count_lanes);
+		_mm512_storeu_si512((void *) saved_lanes, saved_count);
+		for (int l = 0; l < 16 && x + l < count; ++l) {
+			values[x + l] = counts[l];
+			saved += saved_lanes[l];
+		}
+	}
+
+	return saved;
+}
+#endif
+
+/**
+ * Calculates the iterations of a list of points with the widest vector
+ * instructions of the CPU.
+ *
+ * The arrays must have room for CPU_BACKEND_MAX_LANES - 1 more points, the
+ * padding of the last vector. Padding lanes are marked as interior, so they
+ * never keep a vector iterating.
+ *
+ * @param cpu The backend.
+ * @param frame The frame, which may differ from the one of the backend in
+ *        its number of iterations.
+ * @param c_real The real parts.
+ * @param c_imaginary The imaginary parts.
+ * @param interior -1 for points in the cardioid or the bulb, otherwise 0.
+ * @param count The number of points.
+ * @param values The iteration values.
+ * @return The number of iterations the interior check saved.
+ */
+static long cpu_iterate(const cpu_backend_t * cpu, const cpu_frame_t * frame,
+		float * c_real, float * c_imaginary, int * interior, const int count,
+		long * values) {
+#ifdef CPU_BACKEND_X86
+	//the vector paths count in 32 bit lanes
+	if (frame->itr <= 0x7FFFFFFF && cpu->lanes > 1) {
+		for (int l = count; l % cpu->lanes != 0; ++l) {
+			c_real[l] = 0;
+			c_imaginary[l] = 0;
+			interior[l] = -1;
+		}
+
+		if (cpu->lanes == 16) {
+			return cpu_iterate_avx512(frame, c_real, c_imaginary,
+					interior, count, values);
+		}
+		if (cpu->lanes == 8) {
+			return cpu_iterate_avx2(frame, c_real, c_imaginary,
+					interior, count, values);
+		}
+	}
+#endif
+	return cpu_iterate_scalar(frame, c_real, c_imaginary, interior, count,
+			values);
+}
+
+/**
+ * Calculates the iterations of a part of a row.
+ *
+ * @param cpu The backend.
+ * @param y The row, counted from the top.
+ * @param x0 The first position in the row.
+ * @param x1 The position after the last one.
+ * @param values The iteration values, x1 - x0 of them.
+ * @return The number of iterations the interior check saved.
+ */
+static long cpu_iterate_row(const cpu_backend_t * cpu, const long y,
+		const long x0, const long x1, long * values) {
+	float c_real[CPU_BACKEND_TILE_WIDTH + CPU_BACKEND_MAX_LANES];
+	float c_imaginary[CPU_BACKEND_TILE_WIDTH + CPU_BACKEND_MAX_LANES];
+	int interior[CPU_BACKEND_TILE_WIDTH + CPU_BACKEND_MAX_LANES];
+	int count = (int) (x1 - x0);
+
+	float row_imaginary = cpu_row_imaginary(&cpu->frame, y);
+	cpu_row_reals(&cpu->frame, x0, count, c_real);
+	for (int l = 0; l < count; ++l) {
+		c_imaginary[l] = row_imaginary;
+	}
+	cpu_points_interior(&cpu->frame, c_real, c_imaginary, count, interior);
+
+	return cpu_iterate(cpu, &cpu->frame, c_real, c_imaginary, interior,
+			count, values);
+}
+
+/**
+ * Calculates the iteration values of one tile of a list of points.
+ *
+ * @param cpu The backend.
+ * @param tile The number of the tile.
+ * @return The number of iterations the interior check saved.
+ */
+static long cpu_render_points_tile(const cpu_backend_t * cpu,
+		const long tile) {
+	const cpu_frame_t * frame = &cpu->frame;
+	float c_real[CPU_BACKEND_TILE_WIDTH + CPU_BACKEND_MAX_LANES];
+	float c_imaginary[CPU_BACKEND_TILE_WIDTH + CPU_BACKEND_MAX_LANES];
+	int interior[CPU_BACKEND_TILE_WIDTH + CPU_BACKEND_MAX_LANES];
+	long saved = 0;
+
+	long p0 = tile * CPU_BACKEND_POINTS_PER_TILE;
+	long p1 = p0 + CPU_BACKEND_POINTS_PER_TILE;
+	if (p1 > frame->number_points) {
+		p1 = frame->number_points;
+	}
+
+	for (long p = p0; p < p1; p += CPU_BACKEND_TILE_WIDTH) {
+		int count = (int) ((p1 - p < CPU_BACKEND_TILE_WIDTH) ?
+				p1 - p : CPU_BACKEND_TILE_WIDTH);
+
+		for (int l = 0; l < count; ++l) {
+			long x = frame->points[p + l] % frame->x_mon;
+			long y = frame->points[p + l] / frame->x_mon;
+
+			cpu_row_reals(frame, x, 1, c_real + l);
+			c_imaginary[l] = cpu_row_imaginary(frame, y);
+		}
+		cpu_points_interior(frame, c_real, c_imaginary, count, interior);
+
+		saved += cpu_iterate(cpu, frame, c_real, c_imaginary, interior,
+				count, frame->point_values + p);
+	}
+
+	return saved;
+}
+
+/**
+ * Adds two complex numbers. Same as add_complex() in the kernel.
+ *
+ * @param a First complex number.
+ * @param b Second complex number.
+ * @return The result of the addition.
+ */
+static my_complex_t cpu_add_complex(const my_complex_t a,
+		const my_complex_t b) {
+	my_complex_t result;
+
+	result.real = a.real + b.real;
+	result.imaginary = a.imaginary + b.imaginary;
+
+	return result;
+}
+
+/**
+ * Subtracts two complex numbers. Same as sub_complex() in the kernel.
+ *
+ * @param a First complex number.
+ * @param b Second complex number.
+ * @return The result of the subtraction.
+ */
+static my_complex_t cpu_sub_complex(const my_complex_t a,
+		const my_complex_t b) {
+	my_complex_t result;
+
+	result.real = a.real - b.real;
+	result.imaginary = a.imaginary - b.imaginary;
+
+	return result;
+}
+
+/**
+ * Multiplies two complex numbers. Same as mul_complex() in the kernel.
+ *
+ * @param a First complex number.
+ * @param b Second complex number.
+ * @return The result of the multiplication.
+ */
+static my_complex_t cpu_mul_complex(const my_complex_t a,
+		const my_complex_t b) {
+	my_complex_t result;
+
+	result.real = (a.real * b.real) - (a.imaginary * b.imaginary);
+	result.imaginary = (a.real * b.imaginary) + (b.real * a.imaginary);
+
+	return result;
+}
+
+/**
+ * Calculates the absolute value of a complex number. Same as sum_complex()
+ * in the kernel.
+ *
+ * @param a The complex number.
+ * @return Absolute value of the complex number.
+ */
+static float cpu_sum_complex(const my_complex_t a) {
+	return sqrtf(a.real * a.real + a.imaginary * a.imaginary);
+}
+
+/**
+ * Multiplies a complex number with a power of two. Same as scale_complex()
+ * in the kernel.
+ *
+ * @param a The complex number.
+ * @param exponent The exponent of the power of two.
+ * @return a * 2^exponent
+ */
+static my_complex_t cpu_scale_complex(const my_complex_t a,
+		const int exponent) {
+	my_complex_t result;
+
+	result.real = ldexpf(a.real, exponent);
+	result.imaginary = ldexpf(a.imaginary, exponent);
+
+	return result;
+}
+
+/**
+ * Moves the binary exponent of a delta d * 2^e into e. Same as
+ * normalize_delta() in the kernel.
+ *
+ * @param d The mantissa.
+ * @param e The exponent.
+ */
+static void cpu_normalize_delta(my_complex_t * d, int * e) {
+	float m = fmaxf(fabsf(d->real), fabsf(d->imaginary));
+
+	if (m != 0) {
+		int k = ilogbf(m);
+		if (k > CPU_BACKEND_NORMALIZE_EXPONENT
+				|| k < -CPU_BACKEND_NORMALIZE_EXPONENT) {
+			*d = cpu_scale_complex(*d, -k);
+			*e += k;
+		}
+	}
+}
+
+/**
+ * Calculates the iterations of a point c = C + dc near the reference point
+ * of a deep zoom frame. Same as iterate_perturbation() in the kernel.
+ *
+ * @param frame The frame.
+ * @param dc Mantissa of the distance of the point to the reference point.
+ * @param dc_exponent Exponent of the distance.
+ * @param rebases Increased by the number of rebases.
+ * @return The number of iterations for that point.
+ */
+static long cpu_iterate_perturbation(const cpu_frame_t * frame,
+		const my_complex_t dc, const int dc_exponent, long * rebases) {
+	const my_complex_t * orbit = frame->orbit;
+	const long orbit_length = frame->orbit_length;
+	my_complex_t d = { 0, 0 };
+	int e = dc_exponent;
+	long n = 0;
+	long i = 0;
+
+	while (i < frame->itr && e <= CPU_BACKEND_FLOAT_EXPONENT) {
+		my_complex_t t = cpu_mul_complex(orbit[n], d);
+		t = cpu_add_complex(t, t);
+		t = cpu_add_complex(t, cpu_scale_complex(cpu_mul_complex(d, d), e));
+		d = cpu_sub_complex(t, cpu_scale_complex(dc, dc_exponent - e));
+		++n;
+		cpu_normalize_delta(&d, &e);
+
+		my_complex_t z = cpu_add_complex(orbit[n], cpu_scale_complex(d, e));
+		if (!(cpu_sum_complex(z) < frame->abort_value)) {
+			return i;
+		}
+		++i;
+
+		my_complex_t z_scaled = cpu_add_complex(
+				cpu_scale_complex(orbit[n], -e), d);
+		float z_scaled_sum = cpu_sum_complex(z_scaled);
+		if (n == orbit_length - 1 || z_scaled_sum < cpu_sum_complex(d)) {
+			if (isinf(z_scaled_sum)) {
+				d = z;
+				e = 0;
+			} else {
+				d = z_scaled;
+			}
+			cpu_normalize_delta(&d, &e);
+			n = 0;
+			++*rebases;
+		}
+	}
+
+	d = cpu_scale_complex(d, e);
+	my_complex_t dc_float = cpu_scale_complex(dc, dc_exponent);
+
+	while (i < frame->itr) {
+		my_complex_t t = cpu_mul_complex(orbit[n], d);
+		t = cpu_add_complex(t, t);
+		t = cpu_add_complex(t, cpu_mul_complex(d, d));
+		d = cpu_sub_complex(t, dc_float);
+		++n;
+
+		my_complex_t z = cpu_add_complex(orbit[n], d);
+		if (!(cpu_sum_complex(z) < frame->abort_value)) {
+			break;
+		}
+		++i;
+
+		if (n == orbit_length - 1 || cpu_sum_complex(z) < cpu_sum_complex(d)) {
+			d = z;
+			n = 0;
+			++*rebases;
+		}
+	}
+
+	return i;
+}
+
+/**
+ * Calculates the iteration values and colors of one tile of a deep zoom
+ * frame. Same as the kernel calculate_image_perturbation.
+ *
+ * @param cpu The backend.
+ * @param x0 The first position in the rows.
+ * @param y0 The first row.
+ * @param x1 The position after the last one in the rows.
+ * @param y1 The row after the last one.
+ * @return The number of rebases.
+ */
+static long cpu_render_perturbation_tile(const cpu_backend_t * cpu,
+		const long x0, const long y0, const long x1, const long y1) {
+	const cpu_frame_t * frame = &cpu->frame;
+	long rebases = 0;
+
+	for (long y = y0; y < y1; ++y) {
+		for (long x = x0; x < x1; ++x) {
+			long i = y * frame->x_mon + x;
+			my_complex_t dc;
+			dc.real = ((float) x - 0.5f * (float) (frame->x_mon - 1))
+					* frame->spacing;
+			dc.imaginary = (0.5f * (float) (frame->y_mon - 1) - (float) y)
+					* frame->spacing;
+
+			long value = cpu_iterate_perturbation(frame, dc,
+					frame->spacing_exponent, &rebases);
+
+			if (frame->imagevalues != NULL) {
+				frame->imagevalues[i] = value;
+			}
+			frame->image[i * 3] = frame->colors[value * 3];
+			frame->image[i * 3 + 1] = frame->colors[value * 3 + 1];
+			frame->image[i * 3 + 2] = frame->colors[value * 3 + 2];
+		}
+	}
+
+	return rebases;
+}
+
+/**
+ * Calculates the iteration values of one tile of an exponential map. Same
+ * as the kernel calculate_strip_iterations.
+ *
+ * @param cpu The backend.
+ * @param x0 The first column.
+ * @param y0 The first row.
+ * @param x1 The column after the last one.
+ * @param y1 The row after the last one.
+ * @return The number of iterations the interior check saved.
+ */
+static long cpu_render_strip_tile(const cpu_backend_t * cpu, const long x0,
+		const long y0, const long x1, const long y1) {
+	const cpu_frame_t * frame = &cpu->frame;
+	float c_real[CPU_BACKEND_TILE_WIDTH + CPU_BACKEND_MAX_LANES];
+	float c_imaginary[CPU_BACKEND_TILE_WIDTH + CPU_BACKEND_MAX_LANES];
+	int interior[CPU_BACKEND_TILE_WIDTH + CPU_BACKEND_MAX_LANES];
+	int count = (int) (x1 - x0);
+	long saved = 0;
+
+	for (long y = y0; y < y1; ++y) {
+		float radius = expf(frame->rho_min + (float) y * frame->delta_rho);
+		cpu_frame_t row = *frame;
+		row.itr = frame->row_iterations[y];
+
+		float margin = radius * frame->delta_rho;
+		int outside[CPU_BACKEND_TILE_WIDTH];
+
+		for (int l = 0; l < count; ++l) {
+			float angle = (float) (x0 + l) * frame->delta_rho;
+			c_real[l] = frame->center_real + radius * cosf(angle);
+			c_imaginary[l] = frame->center_imaginary + radius * sinf(angle);
+			outside[l] = c_real[l] < frame->x_min - margin
+					|| c_real[l] > frame->x_max + margin
+					|| c_imaginary[l] < frame->y_min - margin
+					|| c_imaginary[l] > frame->y_max + margin;
+		}
+		cpu_points_interior(frame, c_real, c_imaginary, count, interior);
+
+		// Samples outside the first frame are counted as interior points,
+		// which aren't iterated, and stored as 0
+		for (int l = 0; l < count; ++l) {
+			if (outside[l]) {
+				interior[l] = -1;
+			}
+		}
+
+		long * values = frame->strip + y * frame->x_mon + x0;
+		saved += cpu_iterate(cpu, &row, c_real, c_imaginary, interior,
+				count, values);
+		for (int l = 0; l < count; ++l) {
+			if (outside[l]) {
+				saved -= row.itr;
+				values[l] = 0;
+			}
+		}
+	}
+
+	return saved;
+}
+
+/**
+ * Synthesizes the iteration values and colors of one tile of a frame from
+ * an exponential map. Same as the kernel calculate_image_from_strip.
+ *
+ * @param cpu The backend.
+ * @param x0 The first position in the rows.
+ * @param y0 The first row.
+ * @param x1 The position after the last one in the rows.
+ * @param y1 The row after the last one.
+ */
+static void cpu_render_map_tile(const cpu_backend_t * cpu, const long x0,
+		const long y0, const long x1, const long y1) {
+	const cpu_frame_t * frame = &cpu->frame;
+
+	exp_map_resample(frame->map, frame->map_frame, frame->map_strip,
+			frame->map_inner, x0, y0, x1, y1, frame->imagevalues);
+
+	for (long y = y0; y < y1; ++y) {
+		for (long x = x0; x < x1; ++x) {
+			long i = y * frame->x_mon + x;
+			long value = frame->imagevalues[i];
+
+			frame->image[i * 3] = frame->colors[value * 3];
+			frame->image[i * 3 + 1] = frame->colors[value * 3 + 1];
+			frame->image[i * 3 + 2] = frame->colors[value * 3 + 2];
+		}
+	}
+}
+
+/**
+ * Calculates the iteration values and colors of one tile of the frame.
+ *
+ * @param cpu The backend.
+ * @param tile The number of the tile.
+ * @return The number of iterations the interior check saved or, in a deep
+ *         zoom frame, the number of rebases.
+ */
+static long cpu_render_tile(const cpu_backend_t * cpu, const long tile) {
+	const cpu_frame_t * frame = &cpu->frame;
+	long values[CPU_BACKEND_TILE_WIDTH];
+	long saved = 0;
+
+	if (frame->points != NULL) {
+		return cpu_render_points_tile(cpu, tile);
+	}
+
+	long x0 = (tile % frame->tiles_per_row) * CPU_BACKEND_TILE_WIDTH;
+	long y0 = (tile / frame->tiles_per_row) * CPU_BACKEND_TILE_HEIGHT;
+	long x1 = x0 + CPU_BACKEND_TILE_WIDTH;
+	long y1 = y0 + CPU_BACKEND_TILE_HEIGHT;
+	if (x1 > frame->x_mon) {
+		x1 = frame->x_mon;
+	}
+	if (y1 > frame->y_mon) {
+		y1 = frame->y_mon;
+	}
+
+	if (frame->orbit != NULL) {
+		return cpu_render_perturbation_tile(cpu, x0, y0, x1, y1);
+	}
+	if (frame->strip != NULL) {
+		return cpu_render_strip_tile(cpu, x0, y0, x1, y1);
+	}
+	if (frame->map != NULL) {
+		cpu_render_map_tile(cpu, x0, y0, x1, y1);
+		return 0;
+	}
+
+	for (long y = y0; y < y1; ++y) {
+		saved += cpu_iterate_row(cpu, y, x0, x1, values);
+
+		for (long x = x0; x < x1; ++x) {
+			long i = y * frame->x_mon + x;
+			long value = values[x - x0];
+
+			if (frame->imagevalues != NULL) {
+				frame->imagevalues[i] = value;
+			}
+			frame->image[i * 3] = frame->colors[value * 3];
+			frame->image[i * 3 + 1] = frame->colors[value * 3 + 1];
+			frame->image[i * 3 + 2] = frame->colors[value * 3 + 2];
+		}
+	}
+
+	return saved;
+}
+
+/**
+ * Takes the next tile of a worker. If the worker has no tiles left, it
+ * steals the back half of the remaining tiles of another worker.
+ *
+ * @param cpu The backend.
+ * @param index The index of the worker.
+ * @return The number of the tile or -1 if all tiles are taken.
+ */
+static long cpu_next_tile(cpu_backend_t * cpu, const int index) {
+	cpu_worker_t * worker = &cpu->workers[index];
+	long tile = -1;
+
+	pthread_mutex_lock(&worker->lock);
+	if (worker->next_tile < worker->end_tile) {
+		tile = worker->next_tile++;
+	}
+	pthread_mutex_unlock(&worker->lock);
+
+	if (tile >= 0) {
+		return tile;
+	}
+
+	for (int k = 1; k < cpu->number_threads; ++k) {
+		cpu_worker_t * victim = &cpu->workers[(index + k)
+				% cpu->number_threads];
+		long start = -1;
+		long end = -1;
+
+		pthread_mutex_lock(&victim->lock);
+		long remaining = victim->end_tile - victim->next_tile;
+		if (remaining > 0) {
+			long steal = (remaining + 1) / 2;
+			end = victim->end_tile;
+			victim->end_tile -= steal;
+			start = victim->end_tile;
+		}
+		pthread_mutex_unlock(&victim->lock);
+
+		if (start >= 0) {
+			pthread_mutex_lock(&worker->lock);
+			worker->next_tile = start + 1;
+			worker->end_tile = end;
+			pthread_mutex_unlock(&worker->lock);
+
+			return start;
+		}
+	}
+
+	return -1;
+}
+
+/**
+ * Renders the tiles of each frame, first its own ones and then stolen ones.
+ *
+ * @param arg The worker.
+ * @return NULL.
+ */
+static void * cpu_worker_thread(void * arg) {
+	cpu_worker_t * worker = (cpu_worker_t *) arg;
+	cpu_backend_t * cpu = worker->cpu;
+	long generation = 0;
+
+	while (1) {
+		pthread_mutex_lock(&cpu->lock);
+		while (cpu->generation == generation && !cpu->closing) {
+			pthread_cond_wait(&cpu->frame_started, &cpu->lock);
+		}
+		if (cpu->closing) {
+			pthread_mutex_unlock(&cpu->lock);
+			break;
+		}
+		generation = cpu->generation;
+		pthread_mutex_unlock(&cpu->lock);
+
+		long tile;
+		while ((tile = cpu_next_tile(cpu, worker->index)) >= 0) {
+			worker->saved_iterations += cpu_render_tile(cpu, tile);
+		}
+
+		pthread_mutex_lock(&cpu->lock);
+		cpu->running_workers--;
+		if (cpu->running_workers == 0) {
+			pthread_cond_signal(&cpu->frame_finished);
+		}
+		pthread_mutex_unlock(&cpu->lock);
+	}
+
+	return NULL;
+}
+
+/**
+ * Starts the CPU backend with a pool of render threads.
+ *
+ * The backend calculates the same iteration values and colors as the
+ * OpenCL kernels on devices that round divisions and square roots
+ * correctly. The frame is split into tiles which are spread evenly over
+ * the threads; a thread that is done steals tiles from the others. Each
+ * row of a tile is calculated with AVX-512 or AVX2 if the CPU supports it.
+ *
+ * @param cpu The backend.
+ * @param number_threads The number of render threads, 0 for one per CPU.
+ * @param interior_check 1 to skip points that can't escape.
+ * @return 0 on success, otherwise -1.
+ */
+int cpu_backend_init(cpu_backend_t * cpu, int number_threads,
+		const int interior_check) {
+	if (number_threads <= 0) {
+		number_threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	if (number_threads < 1) {
+		number_threads = 1;
+	}
+	if (number_threads > CPU_BACKEND_MAX_THREADS) {
+		number_threads = CPU_BACKEND_MAX_THREADS;
+	}
+
+	cpu->isa = "scalar";
+	cpu->lanes = 1;
+#ifdef CPU_BACKEND_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f")) {
+		cpu->isa = "AVX-512";
+		cpu->lanes = 16;
+	} else if (__builtin_cpu_supports("avx2")) {
+		cpu->isa = "AVX2";
+		cpu->lanes = 8;
+	}
+#endif
+
+	cpu->number_threads = 0;
+	cpu->generation = 0;
+	cpu->running_workers = 0;
+	cpu->closing = 0;
+	cpu->colors = NULL;
+	cpu->colors_itr = -1;
+	cpu->interior_check = interior_check;
+	cpu->saved_iterations = 0;
+	cpu->rebases = 0;
+
+	pthread_mutex_init(&cpu->lock, NULL);
+	pthread_cond_init(&cpu->frame_started, NULL);
+	pthread_cond_init(&cpu->frame_finished, NULL);
+
+	for (int i = 0; i < number_threads; ++i) {
+		cpu->workers[i].cpu = cpu;
+		cpu->workers[i].index = i;
+		cpu->workers[i].next_tile = 0;
+		cpu->workers[i].end_tile = 0;
+		cpu->workers[i].saved_iterations = 0;
+		pthread_mutex_init(&cpu->workers[i].lock, NULL);
+
+		if (pthread_create(&cpu->threads[i], NULL, cpu_worker_thread,
+				&cpu->workers[i]) != 0) {
+			pthread_mutex_destroy(&cpu->workers[i].lock);
+			cpu_backend_close(cpu);
+			return -1;
+		}
+		cpu->number_threads++;
+	}
+
+	printf("CPU backend with %d threads, %s\n", cpu->number_threads,
+			cpu->isa);
+
+	return 0;
+}
+
+/**
+ * Calculates the color table for a number of iterations. Same as
+ * calculate_color in the kernel.
+ *
+ * @param colors 3 bytes for each iteration value 0..itr.
+ * @param itr The number of required iterations.
+ */
+static void cpu_calculate_colors(unsigned char * colors, const long itr) {
+	float color_steps = 255.0f / (float) itr;
+
+	for (long iterations = 0; iterations <= itr; ++iterations) {
+		long value = itr - iterations;
+		float steps = (float) value * color_steps;
+
+		float myred = steps / 1.1f;
+		float mygreen = steps / 1.05f;
+		float myblue = steps;
+
+		if (myred > 255.0f) {
+			myred = 255;
+		}
+		if (mygreen > 255.0f) {
+			mygreen = 255;
+		}
+		if (myblue > 255.0f) {
+			myblue = 255;
+		}
+
+		colors[iterations * 3] = (unsigned char) myred;
+		colors[iterations * 3 + 1] = (unsigned char) mygreen;
+		colors[iterations * 3 + 2] = (unsigned char) myblue;
+	}
+}
+
+/**
+ * Updates the color table if the number of iterations changed.
+ *
+ * @param cpu The backend.
+ * @param itr The number of required iterations.
+ * @return 0 on success, otherwise -1.
+ */
+static int cpu_update_colors(cpu_backend_t * cpu, const long itr) {
+	if (cpu->colors_itr != itr) {
+		unsigned char * colors = (unsigned char *) realloc(cpu->colors,
+				(itr + 1) * 3);
+		if (colors == NULL) {
+			return -1;
+		}
+		cpu->colors = colors;
+		cpu->colors_itr = itr;
+		cpu_calculate_colors(cpu->colors, itr);
+	}
+
+	return 0;
+}
+
+/**
+ * Sets the plane section and resolution of the next frame.
+ *
+ * @param cpu The backend.
+ * @param x_min Smallest X-value of the plane section.
+ * @param x_max Greatest X-value of the plane section.
+ * @param y_min Smallest Y-value of the plane section.
+ * @param y_max Greatest Y-value of the plane section.
+ * @param x_mon Resolution of the monitor on the horizontal axis.
+ * @param y_mon Resolution of the monitor on the vertical axis.
+ * @param abort_value The value of the abort condition. Normally 2.
+ * @param itr The number of required iterations.
+ */
+static void cpu_set_frame(cpu_backend_t * cpu, const float x_min,
+		const float x_max, const float y_min, const float y_max,
+		const long x_mon, const long y_mon, const float abort_value,
+		const long itr) {
+	cpu_frame_t * frame = &cpu->frame;
+	frame->x_min = x_min;
+	frame->x_max = x_max;
+	frame->y_min = y_min;
+	frame->y_max = y_max;
+	frame->x_mon = x_mon;
+	frame->y_mon = y_mon;
+	frame->abort_value = abort_value;
+	frame->itr = itr;
+	frame->interior_check = cpu->interior_check;
+	frame->imagevalues = NULL;
+	frame->image = NULL;
+	frame->colors = cpu->colors;
+	frame->points = NULL;
+	frame->point_values = NULL;
+	frame->number_points = 0;
+	frame->orbit = NULL;
+	frame->orbit_length = 0;
+	frame->strip = NULL;
+	frame->map = NULL;
+}
+
+/**
+ * Spreads the tiles of the frame over the render threads and waits until
+ * they are done.
+ *
+ * @param cpu The backend.
+ */
+static void cpu_run_frame(cpu_backend_t * cpu) {
+	cpu_frame_t * frame = &cpu->frame;
+
+	//spread the tiles evenly, the threads balance the rest by stealing
+	for (int i = 0; i < cpu->number_threads; ++i) {
+		pthread_mutex_lock(&cpu->workers[i].lock);
+		cpu->workers[i].next_tile = frame->number_tiles * i
+				/ cpu->number_threads;
+		cpu->workers[i].end_tile = frame->number_tiles * (i + 1)
+				/ cpu->number_threads;
+		cpu->workers[i].saved_iterations = 0;
+		pthread_mutex_unlock(&cpu->workers[i].lock);
+	}
+
+	pthread_mutex_lock(&cpu->lock);
+	cpu->running_workers = cpu->number_threads;
+	cpu->generation++;
+	pthread_cond_broadcast(&cpu->frame_started);
+	while (cpu->running_workers > 0) {
+		pthread_cond_wait(&cpu->frame_finished, &cpu->lock);
+	}
+	pthread_mutex_unlock(&cpu->lock);
+
+	cpu->saved_iterations = 0;
+	for (int i = 0; i < cpu->number_threads; ++i) {
+		cpu->saved_iterations += cpu->workers[i].saved_iterations;
+	}
+}
+
+/**
+ * Calculates a whole colored Mandelbrot image. Same as the kernel
+ * calculate_image_pixels. The number of iterations the interior check saved
+ * is left in saved_iterations.
+ *
+ * @param cpu The backend.
+ * @param x_min Smallest X-value of the plane section.
+ * @param x_max Greatest X-value of the plane section.
+ * @param y_min Smallest Y-value of the plane section.
+ * @param y_max Greatest Y-value of the plane section.
+ * @param x_mon Resolution of the monitor on the horizontal axis.
+ * @param y_mon Resolution of the monitor on the vertical axis.
+ * @param abort_value The value of the abort condition. Normally 2.
+ * @param itr The number of required iterations.
+ * @param imagevalues The iteration values or NULL if they aren't needed.
+ * @param image The final image, 3 bytes per pixel.
+ * @return 0 on success, otherwise -1.
+ */
+int cpu_backend_render(cpu_backend_t * cpu, const float x_min,
+		const float x_max, const float y_min, const float y_max,
+		const long x_mon, const long y_mon, const float abort_value,
+		const long itr, long * imagevalues, unsigned char * image) {
+	if (cpu_update_colors(cpu, itr) != 0) {
+		return -1;
+	}
+
+	cpu_set_frame(cpu, x_min, x_max, y_min, y_max, x_mon, y_mon, abort_value,
+			itr);
+
+	cpu_frame_t * frame = &cpu->frame;
+	frame->imagevalues = imagevalues;
+	frame->image = image;
+	frame->tiles_per_row = (x_mon + CPU_BACKEND_TILE_WIDTH - 1)
+			/ CPU_BACKEND_TILE_WIDTH;
+	frame->number_tiles = frame->tiles_per_row
+			* ((y_mon + CPU_BACKEND_TILE_HEIGHT - 1) / CPU_BACKEND_TILE_HEIGHT);
+
+	cpu_run_frame(cpu);
+
+	return 0;
+}
+
+/**
+ * Calculates the iteration values of a list of points of an image. Same as
+ * the kernel calculate_points_iterations. The number of iterations the
+ * interior check saved is left in saved_iterations.
+ *
+ * @param cpu The backend.
+ * @param x_min Smallest X-value of the plane section.
+ * @param x_max Greatest X-value of the plane section.
+ * @param y_min Smallest Y-value of the plane section.
+ * @param y_max Greatest Y-value of the plane section.
+ * @param x_mon Resolution of the monitor on the horizontal axis.
+ * @param y_mon Resolution of the monitor on the vertical axis.
+ * @param abort_value The value of the abort condition. Normally 2.
+ * @param itr The number of required iterations.
+ * @param points The positions y * x_mon + x of the points.
+ * @param number_points The number of points.
+ * @param values The iteration values, in the order of the points.
+ */
+void cpu_backend_render_points(cpu_backend_t * cpu, const float x_min,
+		const float x_max, const float y_min, const float y_max,
+		const long x_mon, const long y_mon, const float abort_value,
+		const long itr, const int * points, const long number_points,
+		long * values) {
+	cpu_set_frame(cpu, x_min, x_max, y_min, y_max, x_mon, y_mon, abort_value,
+			itr);
+
+	cpu_frame_t * frame = &cpu->frame;
+	frame->points = points;
+	frame->point_values = values;
+	frame->number_points = number_points;
+	frame->number_tiles = (number_points + CPU_BACKEND_POINTS_PER_TILE - 1)
+			/ CPU_BACKEND_POINTS_PER_TILE;
+
+	cpu_run_frame(cpu);
+}
+
+/**
+ * Calculates a whole colored image of a deep zoom, centered on the
+ * reference point of the orbit. Same as the kernel
+ * calculate_image_perturbation. The number of rebases is left in rebases.
+ *
+ * @param cpu The backend.
+ * @param x_mon Resolution of the monitor on the horizontal axis.
+ * @param y_mon Resolution of the monitor on the vertical axis.
+ * @param spacing Mantissa of the distance between two pixels.
+ * @param spacing_exponent Exponent of the distance between two pixels.
+ * @param abort_value The value of the abort condition. Normally 2.
+ * @param itr The number of required iterations.
+ * @param orbit The reference orbit of the center.
+ * @param orbit_length The number of values of the reference orbit.
+ * @param imagevalues The iteration values or NULL if they aren't needed.
+ * @param image The final image, 3 bytes per pixel.
+ * @return 0 on success, otherwise -1.
+ */
+int cpu_backend_render_perturbation(cpu_backend_t * cpu, const long x_mon,
+		const long y_mon, const float spacing, const int spacing_exponent,
+		const float abort_value, const long itr, const my_complex_t * orbit,
+		const long orbit_length, long * imagevalues, unsigned char * image) {
+	if (cpu_update_colors(cpu, itr) != 0) {
+		return -1;
+	}
+
+	cpu_set_frame(cpu, 0, 0, 0, 0, x_mon, y_mon, abort_value, itr);
+
+	cpu_frame_t * frame = &cpu->frame;
+	frame->imagevalues = imagevalues;
+	frame->image = image;
+	frame->orbit = orbit;
+	frame->orbit_length = orbit_length;
+	frame->spacing = spacing;
+	frame->spacing_exponent = spacing_exponent;
+	frame->tiles_per_row = (x_mon + CPU_BACKEND_TILE_WIDTH - 1)
+			/ CPU_BACKEND_TILE_WIDTH;
+	frame->number_tiles = frame->tiles_per_row
+			* ((y_mon + CPU_BACKEND_TILE_HEIGHT - 1) / CPU_BACKEND_TILE_HEIGHT);
+
+	cpu_run_frame(cpu);
+
+	cpu->rebases = cpu->saved_iterations;
+	cpu->saved_iterations = 0;
+
+	return 0;
+}
+
+/**
+ * Calculates the iteration values of an exponential map around a center.
+ * Same as the kernel calculate_strip_iterations. The number of iterations
+ * the interior check saved is left in saved_iterations.
+ *
+ * @param cpu The backend.
+ * @param center_real Real part of the center.
+ * @param center_imaginary Imaginary part of the center.
+ * @param rho_min Logarithm of the radius of the first row.
+ * @param delta_rho Distance between two rows and two columns.
+ * @param columns The number of samples of a row.
+ * @param rows The number of rows.
+ * @param x_min Smallest X-value of the first frame.
+ * @param x_max Greatest X-value of the first frame.
+ * @param y_min Smallest Y-value of the first frame.
+ * @param y_max Greatest Y-value of the first frame.
+ * @param abort_value The value of the abort condition. Normally 2.
+ * @param row_iterations The number of required iterations of each row.
+ * @param strip The iteration values, row after row.
+ */
+void cpu_backend_render_strip(cpu_backend_t * cpu, const float center_real,
+		const float center_imaginary, const float rho_min,
+		const float delta_rho, const long columns, const long rows,
+		const float x_min, const float x_max, const float y_min,
+		const float y_max, const float abort_value,
+		const long * row_iterations, long * strip) {
+	cpu_set_frame(cpu, x_min, x_max, y_min, y_max, columns, rows,
+			abort_value, 0);
+
+	cpu_frame_t * frame = &cpu->frame;
+	frame->strip = strip;
+	frame->row_iterations = row_iterations;
+	frame->center_real = center_real;
+	frame->center_imaginary = center_imaginary;
+	frame->rho_min = rho_min;
+	frame->delta_rho = delta_rho;
+	frame->tiles_per_row = (columns + CPU_BACKEND_TILE_WIDTH - 1)
+			/ CPU_BACKEND_TILE_WIDTH;
+	frame->number_tiles = frame->tiles_per_row
+			* ((rows + CPU_BACKEND_TILE_HEIGHT - 1) / CPU_BACKEND_TILE_HEIGHT);
+
+	cpu_run_frame(cpu);
+}
+
+/**
+ * Synthesizes a whole colored image from an exponential map. Same as the
+ * kernel calculate_image_from_strip.
+ *
+ * @param cpu The backend.
+ * @param map The map.
+ * @param map_frame The parameters of the frame.
+ * @param strip The iteration values of the map.
+ * @param inner The iteration values of the last frame.
+ * @param imagevalues The iteration values of the frame.
+ * @param image The final image, 3 bytes per pixel.
+ * @return 0 on success, otherwise -1.
+ */
+int cpu_backend_render_from_map(cpu_backend_t * cpu, const exp_map_t * map,
+		const exp_map_frame_t * map_frame, const long * strip,
+		const long * inner, long * imagevalues, unsigned char * image) {
+	if (cpu_update_colors(cpu, map_frame->itr) != 0) {
+		return -1;
+	}
+
+	cpu_set_frame(cpu, 0, 0, 0, 0, map->x_mon, map->y_mon, 0,
+			map_frame->itr);
+
+	cpu_frame_t * frame = &cpu->frame;
+	frame->imagevalues = imagevalues;
+	frame->image = image;
+	frame->map = map;
+	frame->map_frame = map_frame;
+	frame->map_strip = strip;
+	frame->map_inner = inner;
+	frame->tiles_per_row = (map->x_mon + CPU_BACKEND_TILE_WIDTH - 1)
+			/ CPU_BACKEND_TILE_WIDTH;
+	frame->number_tiles = frame->tiles_per_row
+			* ((map->y_mon + CPU_BACKEND_TILE_HEIGHT - 1)
+					/ CPU_BACKEND_TILE_HEIGHT);
+
+	cpu_run_frame(cpu);
+
+	return 0;
+}
+
+/**
+ * Calculates the colors of an image from its iteration values. Same as the
+ * kernel calculate_image_colors.
+ *
+ * @param cpu The backend.
+ * @param x_mon Resolution of the monitor on the horizontal axis.
+ * @param y_mon Resolution of the monitor on the vertical axis.
+ * @param itr The number of required iterations.
+ * @param imagevalues The iteration values.
+ * @param image The final image, 3 bytes per pixel.
+ * @return 0 on success, otherwise -1.
+ */
+int cpu_backend_colorize(cpu_backend_t * cpu, const long x_mon,
+		const long y_mon, const long itr, const long * imagevalues,
+		unsigned char * image) {
+	if (cpu_update_colors(cpu, itr) != 0) {
+		return -1;
+	}
+
+	for (long i = 0; i < x_mon * y_mon; ++i) {
+		image[i * 3] = cpu->colors[imagevalues[i] * 3];
+		image[i * 3 + 1] = cpu->colors[imagevalues[i] * 3 + 1];
+		image[i * 3 + 2] = cpu->colors[imagevalues[i] * 3 + 2];
+	}
+
+	return 0;
+}
+
+/**
+ * Stops the render threads and frees the backend.
+ *
+ * @param cpu The backend.
+ */
+void cpu_backend_close(cpu_backend_t * cpu) {
+	pthread_mutex_lock(&cpu->lock);
+	cpu->closing = 1;
+	pthread_cond_broadcast(&cpu->frame_started);
+	pthread_mutex_unlock(&cpu->lock);
+
+	for (int i = 0; i < cpu->number_threads; ++i) {
+		pthread_join(cpu->threads[i], NULL);
+		pthread_mutex_destroy(&cpu->workers[i].lock);
+	}
+	cpu->number_threads = 0;
+
+	free(cpu->colors);
+	cpu->colors = NULL;
+
+	pthread_mutex_destroy(&cpu->lock);
+	pthread_cond_destroy(&cpu->frame_started);
+	pthread_cond_destroy(&cpu->frame_finished);
+}
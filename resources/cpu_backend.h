@@ -0,0 +1,127 @@
+/*
+ * cpu_backend.h
+ *
+ *      Author: Felix Paetow
+ */
+
+#ifndef CPU_BACKEND_H_
+#define CPU_BACKEND_H_
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "exp_map.h"
+#include "my_complex.h"
+
+//maximum number of render threads
+#define CPU_BACKEND_MAX_THREADS 256
+
+//size of the tiles the image is split into
+#define CPU_BACKEND_TILE_WIDTH 64
+#define CPU_BACKEND_TILE_HEIGHT 8
+
+//number of points of a tile when a list of points is calculated
+#define CPU_BACKEND_POINTS_PER_TILE \
+		(CPU_BACKEND_TILE_WIDTH * CPU_BACKEND_TILE_HEIGHT)
+
+struct cpu_backend;
+
+typedef struct cpu_worker {
+	struct cpu_backend * cpu;
+	int index;
+	pthread_mutex_t lock;
+	long next_tile;
+	long end_tile;
+	long saved_iterations;
+} cpu_worker_t;
+
+typedef struct cpu_frame {
+	float x_min;
+	float x_max;
+	float y_min;
+	float y_max;
+	long x_mon;
+	long y_mon;
+	float abort_value;
+	long itr;
+	int interior_check;
+	long * imagevalues;
+	unsigned char * image;
+	unsigned char * colors;
+	const int * points;
+	long * point_values;
+	long number_points;
+	const my_complex_t * orbit;
+	long orbit_length;
+	float spacing;
+	int spacing_exponent;
+	long * strip;
+	const long * row_iterations;
+	float center_real;
+	float center_imaginary;
+	float rho_min;
+	float delta_rho;
+	const exp_map_t * map;
+	const exp_map_frame_t * map_frame;
+	const long * map_strip;
+	const long * map_inner;
+	long tiles_per_row;
+	long number_tiles;
+} cpu_frame_t;
+
+typedef struct cpu_backend {
+	int number_threads;
+	pthread_t threads[CPU_BACKEND_MAX_THREADS];
+	cpu_worker_t workers[CPU_BACKEND_MAX_THREADS];
+
+	pthread_mutex_t lock;
+	pthread_cond_t frame_started;
+	pthread_cond_t frame_finished;
+	long generation;
+	int running_workers;
+	int closing;
+
+	cpu_frame_t frame;
+	unsigned char * colors;
+	long colors_itr;
+
+	const char * isa;
+	int lanes;
+
+	int interior_check;
+	long saved_iterations;
+	long rebases;
+} cpu_backend_t;
+
+int cpu_backend_init(cpu_backend_t * cpu, int number_threads,
+		const int interior_check);
+int cpu_backend_render(cpu_backend_t * cpu, const float x_min,
+		const float x_max, const float y_min, const float y_max,
+		const long x_mon, const long y_mon, const float abort_value,
+		const long itr, long * imagevalues, unsigned char * image);
+void cpu_backend_render_points(cpu_backend_t * cpu, const float x_min,
+		const float x_max, const float y_min, const float y_max,
+		const long x_mon, const long y_mon, const float abort_value,
+		const long itr, const int * points, const long number_points,
+		long * values);
+int cpu_backend_render_perturbation(cpu_backend_t * cpu, const long x_mon,
+		const long y_mon, const float spacing, const int spacing_exponent,
+		const float abort_value, const long itr, const my_complex_t * orbit,
+		const long orbit_length, long * imagevalues, unsigned char * image);
+void cpu_backend_render_strip(cpu_backend_t * cpu, const float center_real,
+		const float center_imaginary, const float rho_min,
+		const float delta_rho, const long columns, const long rows,
+		const float x_min, const float x_max, const float y_min,
+		const float y_max, const float abort_value,
+		const long * row_iterations, long * strip);
+int cpu_backend_render_from_map(cpu_backend_t * cpu, const exp_map_t * map,
+		const exp_map_frame_t * map_frame, const long * strip,
+		const long * inner, long * imagevalues, unsigned char * image);
+int cpu_backend_colorize(cpu_backend_t * cpu, const long x_mon,
+		const long y_mon, const long itr, const long * imagevalues,
+		unsigned char * image);
+void cpu_backend_close(cpu_backend_t * cpu);
+
+#endif /* CPU_BACKEND_H_ */
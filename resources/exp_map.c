@@ -0,0 +1,267 @@
+/*
+ * exp_map.c
+ *
+ *      Author: Felix Paetow
+ */
+
+#include "exp_map.h"
+
+/**
+ * Initializes an exponential map for a video. The plane sections and
+ * iterations of all frames have to be filled in before it is planned.
+ *
+ * @param map The map.
+ * @param number_frames The number of frames.
+ * @return 0 on success, otherwise -1.
+ */
+int exp_map_init(exp_map_t * map, const long number_frames) {
+	map->number_frames = number_frames;
+	map->planes = (double *) malloc(sizeof(double) * 4 * number_frames);
+	map->iterations = (long *) malloc(sizeof(long) * number_frames);
+	map->row_iterations = NULL;
+
+	if (map->planes == NULL || map->iterations == NULL) {
+		exp_map_release(map);
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * Returns the distance from the center of the map to the farthest corner of
+ * a frame.
+ *
+ * @param map The map.
+ * @param n The number of the frame.
+ * @return The distance.
+ */
+static double exp_map_far_radius(const exp_map_t * map, const long n) {
+	const double * plane = map->planes + n * 4;
+	double dx = fmax(fabs(plane[0] - map->center_real),
+			fabs(plane[1] - map->center_real));
+	double dy = fmax(fabs(plane[2] - map->center_imaginary),
+			fabs(plane[3] - map->center_imaginary));
+
+	return sqrt(dx * dx + dy * dy);
+}
+
+/**
+ * Plans the exponential map of a zoom video.
+ *
+ * The frames of a zoom into a dot show the same points again and again,
+ * each time a bit larger. Instead of calculating every frame, the points
+ * around the dot are calculated once on an exponential map: circles around
+ * the dot whose radius grows by a constant factor. Its samples are about
+ * square at every radius, so the map holds every frame at the same
+ * resolution with fewer points than the frames together, the slower the
+ * zoom the fewer.
+ *
+ * Close to the dot the circles would need more samples than any frame has
+ * pixels. That part is covered by the last frame, which is calculated
+ * completely, so the map only spans from the last frame up to the corner
+ * farthest away from the dot.
+ *
+ * @param map The map.
+ * @param x_mon Resolution of the monitor on the horizontal axis.
+ * @param y_mon Resolution of the monitor on the vertical axis.
+ * @param dot The dot the video zooms into.
+ * @return 0 on success, -1 if the map would be too large.
+ */
+int exp_map_plan(exp_map_t * map, const long x_mon, const long y_mon,
+		const my_complex_t dot) {
+	const long number_frames = map->number_frames;
+	const double * last = map->planes + (number_frames - 1) * 4;
+	double density = 0;
+	double radius_max = 0;
+
+	map->center_real = dot.real;
+	map->center_imaginary = dot.imaginary;
+	map->x_mon = x_mon;
+	map->y_mon = y_mon;
+	map->itr = map->iterations[number_frames - 1];
+
+	// Pixels per radian the map needs to be as fine as each frame at its
+	// corners
+	for (long n = 0; n < number_frames; ++n) {
+		const double * plane = map->planes + n * 4;
+		double delta_x = (plane[1] - plane[0]) / (double) (x_mon - 1);
+		double delta_y = (plane[3] - plane[2]) / (double) (y_mon - 1);
+		double radius = exp_map_far_radius(map, n);
+
+		density = fmax(density, radius / fmin(delta_x, delta_y));
+		radius_max = fmax(radius_max, radius);
+	}
+
+	// The map starts at the circle that fits into the last frame
+	double radius_min = fmin(
+			fmin(map->center_real - last[0], last[1] - map->center_real),
+			fmin(map->center_imaginary - last[2],
+					last[3] - map->center_imaginary));
+	double delta_last = (last[1] - last[0]) / (double) (x_mon - 1);
+	if (radius_min < delta_last) {
+		radius_min = delta_last;
+	}
+
+	map->columns = (long) ceil(2 * M_PI * density);
+	if (map->columns > EXP_MAP_MAX_COLUMNS) {
+		return -1;
+	}
+	map->delta_rho = 2 * M_PI / (double) map->columns;
+	map->rho_min = log(radius_min) - map->delta_rho;
+	map->rows = (long) ceil((log(radius_max) - map->rho_min) / map->delta_rho)
+			+ 2;
+	if (map->rows * map->columns > EXP_MAP_MAX_SAMPLES) {
+		return -1;
+	}
+
+	map->row_iterations = (long *) malloc(sizeof(long) * map->rows);
+	if (map->row_iterations == NULL) {
+		return -1;
+	}
+
+	// A row needs the iterations of the last frame whose farthest corner
+	// reaches it, rounded to the nearest row
+	for (long j = 0; j < map->rows; ++j) {
+		double radius = exp(map->rho_min + (double) (j - 1) * map->delta_rho);
+		long n = number_frames - 1;
+
+		while (n > 0 && exp_map_far_radius(map, n) < radius) {
+			--n;
+		}
+		map->row_iterations[j] = map->iterations[n];
+	}
+
+	map->inner_x_min = last[0];
+	map->inner_x_max = last[1];
+	map->inner_y_min = last[2];
+	map->inner_y_max = last[3];
+
+	// The first frame is calculated as well, it finds the dot
+	map->samples = map->columns * map->rows + 2 * x_mon * y_mon;
+	map->saved_iterations = 0;
+	map->frame_samples = number_frames * x_mon * y_mon;
+
+	return 0;
+}
+
+/**
+ * Calculates how a frame is taken from the map.
+ *
+ * @param map The map.
+ * @param n The number of the frame.
+ * @param frame The parameters of the frame.
+ */
+void exp_map_frame(const exp_map_t * map, const long n,
+		exp_map_frame_t * frame) {
+	const double * plane = map->planes + n * 4;
+	double delta_x = (plane[1] - plane[0]) / (double) (map->x_mon - 1);
+	double delta_y = (plane[3] - plane[2]) / (double) (map->y_mon - 1);
+	double inner_delta_x = (map->inner_x_max - map->inner_x_min)
+			/ (double) (map->x_mon - 1);
+	double inner_delta_y = (map->inner_y_max - map->inner_y_min)
+			/ (double) (map->y_mon - 1);
+
+	frame->offset_real = (float) (plane[0] - map->center_real);
+	frame->offset_imaginary = (float) (plane[3] - map->center_imaginary);
+	frame->delta_x = (float) delta_x;
+	frame->delta_y = (float) delta_y;
+	frame->inner_x = (float) ((plane[0] - map->inner_x_min) / inner_delta_x);
+	frame->inner_y = (float) ((map->inner_y_max - plane[3]) / inner_delta_y);
+	frame->inner_delta_x = (float) (delta_x / inner_delta_x);
+	frame->inner_delta_y = (float) (delta_y / inner_delta_y);
+	frame->itr = map->iterations[n];
+}
+
+/**
+ * Synthesizes the iteration values of a rectangle of a frame from the map.
+ * Same as the kernel calculate_image_from_strip.
+ *
+ * @param map The map.
+ * @param frame The parameters of the frame.
+ * @param strip The iteration values of the map.
+ * @param inner The iteration values of the last frame.
+ * @param x0 The first position in the rows.
+ * @param y0 The first row.
+ * @param x1 The position after the last one in the rows.
+ * @param y1 The row after the last one.
+ * @param imagevalues The iteration values of the frame.
+ */
+void exp_map_resample(const exp_map_t * map, const exp_map_frame_t * frame,
+		const long * strip, const long * inner, const long x0, const long y0,
+		const long x1, const long y1, long * imagevalues) {
+	const float rho_min = (float) map->rho_min;
+	const float delta_rho = (float) map->delta_rho;
+
+	for (long y = y0; y < y1; ++y) {
+		long iy = (long) floorf(
+				frame->inner_y + (float) y * frame->inner_delta_y + 0.5f);
+		float w_imaginary = frame->offset_imaginary
+				- (float) y * frame->delta_y;
+
+		for (long x = x0; x < x1; ++x) {
+			long value;
+			long ix = (long) floorf(
+					frame->inner_x + (float) x * frame->inner_delta_x + 0.5f);
+
+			if (ix >= 0 && ix < map->x_mon && iy >= 0 && iy < map->y_mon) {
+				value = inner[iy * map->x_mon + ix];
+			} else {
+				float w_real = frame->offset_real + (float) x * frame->delta_x;
+
+				float rho = 0.5f
+						* logf(w_real * w_real + w_imaginary * w_imaginary);
+				float angle = atan2f(w_imaginary, w_real);
+				if (angle < 0) {
+					angle += 2 * (float) M_PI;
+				}
+
+				long j = (long) floorf((rho - rho_min) / delta_rho + 0.5f);
+				long k = (long) floorf(angle / delta_rho + 0.5f);
+				if (j < 0) {
+					j = 0;
+				}
+				if (j > map->rows - 1) {
+					j = map->rows - 1;
+				}
+				if (k >= map->columns) {
+					k -= map->columns;
+				}
+
+				value = strip[j * map->columns + k];
+			}
+
+			imagevalues[y * map->x_mon + x] =
+					(value < frame->itr) ? value : frame->itr;
+		}
+	}
+}
+
+/**
+ * Prints how many points the map needed compared to calculating every
+ * frame.
+ *
+ * @param map The map.
+ */
+void exp_map_print_stats(const exp_map_t * map) {
+	printf("Exponential map: %ld x %ld samples and the last frame, "
+			"%ld points instead of %ld (%.1fx less), %ld iterations saved\n",
+			map->columns, map->rows, map->samples, map->frame_samples,
+			(double) map->frame_samples / (double) map->samples,
+			map->saved_iterations);
+}
+
+/**
+ * Frees the memory of the map.
+ *
+ * @param map The map.
+ */
+void exp_map_release(exp_map_t * map) {
+	free(map->planes);
+	free(map->iterations);
+	free(map->row_iterations);
+
+	map->planes = NULL;
+	map->iterations = NULL;
+	map->row_iterations = NULL;
+}
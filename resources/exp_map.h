@@ -0,0 +1,83 @@
+/*
+ * exp_map.h
+ *
+ *      Author: Felix Paetow
+ */
+
+#ifndef EXP_MAP_H_
+#define EXP_MAP_H_
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "my_complex.h"
+
+//greatest number of samples of a row of the map
+#define EXP_MAP_MAX_COLUMNS 16384
+
+//greatest number of samples of the map, 512 MB of iteration values
+#define EXP_MAP_MAX_SAMPLES (1L << 26)
+
+typedef struct exp_map {
+	//plane sections x_min, x_max, y_min, y_max and iterations of the frames
+	double * planes;
+	long * iterations;
+	long number_frames;
+
+	//center of the map, the zoom dot
+	double center_real;
+	double center_imaginary;
+
+	//sample (row j, column k) lies at
+	//center + e^(rho_min + j * delta_rho) * e^(i * k * delta_rho)
+	double rho_min;
+	double delta_rho;
+	long columns;
+	long rows;
+
+	//plane section of the last frame, which is calculated completely
+	double inner_x_min;
+	double inner_x_max;
+	double inner_y_min;
+	double inner_y_max;
+	long x_mon;
+	long y_mon;
+
+	//iterations of the last frame, and of each row the iterations of the
+	//last frame that reaches it
+	long itr;
+	long * row_iterations;
+
+	//points calculated for the map and if every frame was calculated
+	long samples;
+	long frame_samples;
+
+	//iterations the interior check saved calculating the map
+	long saved_iterations;
+} exp_map_t;
+
+//how to synthesize one frame from the map
+typedef struct exp_map_frame {
+	float offset_real;
+	float offset_imaginary;
+	float delta_x;
+	float delta_y;
+	float inner_x;
+	float inner_y;
+	float inner_delta_x;
+	float inner_delta_y;
+	long itr;
+} exp_map_frame_t;
+
+int exp_map_init(exp_map_t * map, const long number_frames);
+int exp_map_plan(exp_map_t * map, const long x_mon, const long y_mon,
+		const my_complex_t dot);
+void exp_map_frame(const exp_map_t * map, const long n,
+		exp_map_frame_t * frame);
+void exp_map_resample(const exp_map_t * map, const exp_map_frame_t * frame,
+		const long * strip, const long * inner, const long x0, const long y0,
+		const long x1, const long y1, long * imagevalues);
+void exp_map_print_stats(const exp_map_t * map);
+void exp_map_release(exp_map_t * map);
+
+#endif /* EXP_MAP_H_ */
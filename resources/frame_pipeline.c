@@ -0,0 +1,155 @@
+/*
+ * frame_pipeline.c
+ *
+ *      Author: Felix Paetow
+ */
+
+#include "frame_pipeline.h"
+
+/**
+ * Initializes a pipeline with empty slots.
+ *
+ * Each slot holds one frame in flight: the frame is computed on the device,
+ * read back asynchronously and handed to the output once its read event
+ * completed. While the host writes a finished frame, the device already
+ * works on the following ones.
+ *
+ * @param pipeline The pipeline.
+ * @param depth The number of frames in flight, clamped to
+ *              1..FRAME_PIPELINE_MAX_DEPTH.
+ */
+void frame_pipeline_init(frame_pipeline_t * pipeline, int depth) {
+	if (depth < 1) {
+		depth = 1;
+	}
+	if (depth > FRAME_PIPELINE_MAX_DEPTH) {
+		depth = FRAME_PIPELINE_MAX_DEPTH;
+	}
+
+	pipeline->depth = depth;
+	pipeline->next_to_retire = 0;
+
+	for (int i = 0; i < FRAME_PIPELINE_MAX_DEPTH; ++i) {
+		pipeline->slots[i].index = i;
+		pipeline->slots[i].frame = -1;
+		pipeline->slots[i].d_image_pixel = NULL;
+		pipeline->slots[i].h_image_pixel = NULL;
+		pipeline->slots[i].d_saved_iterations = NULL;
+		pipeline->slots[i].saved_iterations = 0;
+		pipeline->slots[i].precision = 0;
+		pipeline->slots[i].persistent = 0;
+		pipeline->slots[i].compute_ms = -1;
+		pipeline->slots[i].computed = NULL;
+		pipeline->slots[i].read = NULL;
+	}
+}
+
+/**
+ * Returns the index of the slot a frame is rendered in.
+ *
+ * @param pipeline The pipeline.
+ * @param frame The number of the frame.
+ * @return The index of the slot.
+ */
+int frame_pipeline_slot_index(const frame_pipeline_t * pipeline,
+		const long frame) {
+	return (int) (frame % pipeline->depth);
+}
+
+/**
+ * Returns the slot a frame is rendered in.
+ *
+ * If the slot still holds an earlier frame, that frame has to be retired
+ * with frame_pipeline_wait before the slot is used again.
+ *
+ * @param pipeline The pipeline.
+ * @param frame The number of the frame.
+ * @return The slot.
+ */
+frame_slot_t * frame_pipeline_slot(frame_pipeline_t * pipeline,
+		const long frame) {
+	return &pipeline->slots[frame_pipeline_slot_index(pipeline, frame)];
+}
+
+/**
+ * Marks a slot as in flight after the commands of its frame were enqueued.
+ * The computed and read events of the slot must be set by the caller.
+ *
+ * @param slot The slot.
+ * @param frame The number of the frame.
+ */
+void frame_pipeline_submit(frame_slot_t * slot, const long frame) {
+	slot->frame = frame;
+}
+
+/**
+ * Returns the slot of the oldest frame in flight.
+ *
+ * @param pipeline The pipeline.
+ * @return The slot or NULL if no frame is in flight.
+ */
+frame_slot_t * frame_pipeline_oldest(frame_pipeline_t * pipeline) {
+	frame_slot_t * slot = frame_pipeline_slot(pipeline,
+			pipeline->next_to_retire);
+
+	if (slot->frame != pipeline->next_to_retire) {
+		return NULL;
+	}
+
+	return slot;
+}
+
+/**
+ * Waits until the frame of a slot has been read back and releases its
+ * events. Afterwards the host image of the slot can be used.
+ *
+ * If the queue profiles its commands, compute_ms is set to the device time
+ * of the kernel that finished the frame, otherwise to -1.
+ *
+ * @param slot The slot.
+ * @return CL_SUCCESS or the error code of clWaitForEvents.
+ */
+cl_int frame_pipeline_wait(frame_slot_t * slot) {
+	cl_int err = CL_SUCCESS;
+
+	if (slot->read != NULL) {
+		err = clWaitForEvents(1, &slot->read);
+		clReleaseEvent(slot->read);
+		slot->read = NULL;
+	}
+
+	slot->compute_ms = -1;
+	if (slot->computed != NULL && err == CL_SUCCESS) {
+		cl_ulong start;
+		cl_ulong end;
+
+		if (clGetEventProfilingInfo(slot->computed,
+				CL_PROFILING_COMMAND_START, sizeof(start), &start, NULL)
+				== CL_SUCCESS
+				&& clGetEventProfilingInfo(slot->computed,
+						CL_PROFILING_COMMAND_END, sizeof(end), &end, NULL)
+						== CL_SUCCESS) {
+			slot->compute_ms = (double) (end - start) / 1e6;
+		}
+	}
+	if (slot->computed != NULL) {
+		clReleaseEvent(slot->computed);
+		slot->computed = NULL;
+	}
+
+	return err;
+}
+
+/**
+ * Frees a slot after its frame has been written, so it can take the next
+ * frame.
+ *
+ * @param pipeline The pipeline.
+ * @param slot The slot.
+ */
+void frame_pipeline_retire(frame_pipeline_t * pipeline, frame_slot_t * slot) {
+	if (slot->frame == pipeline->next_to_retire) {
+		pipeline->next_to_retire++;
+	}
+	slot->frame = -1;
+}
@@ -0,0 +1,52 @@
+/*
+ * frame_pipeline.h
+ *
+ *      Author: Felix Paetow
+ */
+
+#ifndef FRAME_PIPELINE_H_
+#define FRAME_PIPELINE_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#ifdef __APPLE__
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+//maximum number of frames in flight
+#define FRAME_PIPELINE_MAX_DEPTH 8
+
+typedef struct frame_slot {
+	//position of the slot in the pipeline, which picks its frame buffers
+	int index;
+	long frame;
+	cl_mem d_image_pixel;
+	unsigned char * h_image_pixel;
+	cl_mem d_saved_iterations;
+	cl_ulong saved_iterations;
+	int precision;
+	int persistent;
+	double compute_ms;
+	cl_event computed;
+	cl_event read;
+} frame_slot_t;
+
+typedef struct frame_pipeline {
+	int depth;
+	long next_to_retire;
+	frame_slot_t slots[FRAME_PIPELINE_MAX_DEPTH];
+} frame_pipeline_t;
+
+void frame_pipeline_init(frame_pipeline_t * pipeline, int depth);
+frame_slot_t * frame_pipeline_slot(frame_pipeline_t * pipeline,
+		const long frame);
+int frame_pipeline_slot_index(const frame_pipeline_t * pipeline,
+		const long frame);
+void frame_pipeline_submit(frame_slot_t * slot, const long frame);
+frame_slot_t * frame_pipeline_oldest(frame_pipeline_t * pipeline);
+cl_int frame_pipeline_wait(frame_slot_t * slot);
+void frame_pipeline_retire(frame_pipeline_t * pipeline, frame_slot_t * slot);
+
+#endif /* FRAME_PIPELINE_H_ */
@@ -0,0 +1,252 @@
+/*
+ * image_writer.c
+ *
+ *      Author: Felix Paetow
+ */
+
+#include "image_writer.h"
+
+/**
+ * Returns the number of the calling I/O thread.
+ *
+ * @param writer The writer.
+ * @return The number of the thread, from 0.
+ */
+static int image_writer_thread_index(const image_writer_t * writer) {
+	for (int i = 0; i < writer->number_threads; ++i) {
+		if (pthread_equal(writer->threads[i], pthread_self())) {
+			return i;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Writes the encoded images of the queue to their files until the writer is
+ * closed and the queue is empty.
+ *
+ * @param arg The writer.
+ * @return NULL.
+ */
+static void * image_writer_thread(void * arg) {
+	image_writer_t * writer = (image_writer_t *) arg;
+
+	while (1) {
+		pthread_mutex_lock(&writer->lock);
+		while (writer->count == 0 && !writer->closing) {
+			pthread_cond_wait(&writer->job_available, &writer->lock);
+		}
+		if (writer->count == 0) {
+			pthread_mutex_unlock(&writer->lock);
+			break;
+		}
+
+		image_writer_job_t job = writer->jobs[writer->head];
+		writer->head = (writer->head + 1) % writer->number_jobs;
+		writer->count--;
+		pthread_mutex_unlock(&writer->lock);
+
+		//the whole file with one write
+		double start = trace_begin(writer->trace);
+		int failed = 0;
+		FILE * f = fopen(job.name, "wb");
+		if (f == NULL) {
+			failed = 1;
+		} else {
+			if (fwrite(job.buffer, 1, job.size, f) != (size_t) job.size) {
+				failed = 1;
+			}
+			if (fclose(f) != 0) {
+				failed = 1;
+			}
+		}
+		if (failed) {
+			fprintf(stderr, "Error: Failed to write %s\n", job.name);
+		}
+		if (writer->trace != NULL) {
+			trace_host_span(writer->trace, job.name, -1,
+					TRACE_TRACK_WRITER + image_writer_thread_index(writer),
+					start);
+		}
+
+		pthread_mutex_lock(&writer->lock);
+		writer->free_jobs[writer->number_free++] = job;
+		if (failed) {
+			writer->errors++;
+		} else {
+			writer->written++;
+		}
+		pthread_cond_signal(&writer->job_free);
+		pthread_mutex_unlock(&writer->lock);
+	}
+
+	return NULL;
+}
+
+/**
+ * Starts a writer which writes images to bmp files in background threads.
+ *
+ * Submitted images are encoded into a buffer of the writer and queued. The
+ * I/O threads take the images from the queue and write each of them with
+ * one single write. If queue_capacity images are waiting already, submitting
+ * blocks until a thread finished an image, so the queue can't grow without
+ * bounds when the disk is slower than the renderer.
+ *
+ * @param writer The writer.
+ * @param number_threads The number of I/O threads,
+ *                       1..IMAGE_WRITER_MAX_THREADS.
+ * @param queue_capacity The number of images that may wait to be written.
+ * @return 0 on success, otherwise -1.
+ */
+int image_writer_init(image_writer_t * writer, int number_threads,
+		int queue_capacity) {
+	if (number_threads < 1) {
+		number_threads = 1;
+	}
+	if (number_threads > IMAGE_WRITER_MAX_THREADS) {
+		number_threads = IMAGE_WRITER_MAX_THREADS;
+	}
+	if (queue_capacity < 1) {
+		queue_capacity = 1;
+	}
+
+	//one job per waiting image and one per image being written
+	int total = queue_capacity + number_threads;
+
+	writer->number_threads = 0;
+	writer->queue_capacity = queue_capacity;
+	writer->number_jobs = total;
+	writer->head = 0;
+	writer->count = 0;
+	writer->number_free = total;
+	writer->closing = 0;
+	writer->written = 0;
+	writer->errors = 0;
+	writer->stalls = 0;
+	writer->trace = NULL;
+
+	writer->jobs = (image_writer_job_t *) calloc(total,
+			sizeof(image_writer_job_t));
+	writer->free_jobs = (image_writer_job_t *) calloc(total,
+			sizeof(image_writer_job_t));
+	if (writer->jobs == NULL || writer->free_jobs == NULL) {
+		free(writer->jobs);
+		free(writer->free_jobs);
+		return -1;
+	}
+
+	pthread_mutex_init(&writer->lock, NULL);
+	pthread_cond_init(&writer->job_available, NULL);
+	pthread_cond_init(&writer->job_free, NULL);
+
+	for (int i = 0; i < number_threads; ++i) {
+		if (pthread_create(&writer->threads[i], NULL, image_writer_thread,
+				writer) != 0) {
+			image_writer_close(writer);
+			return -1;
+		}
+		writer->number_threads++;
+	}
+
+	return 0;
+}
+
+/**
+ * Encodes an image as bmp file and queues it for writing. Blocks while the
+ * queue is full.
+ *
+ * The image can be reused as soon as the function returns.
+ *
+ * @param writer The writer.
+ * @param x_mon Resolution of the monitor on the horizontal axis.
+ * @param y_mon Resolution of the monitor on the vertical axis.
+ * @param image The image values.
+ * @param name The name for the bmp file.
+ * @return 0 on success, otherwise -1.
+ */
+int image_writer_submit(image_writer_t * writer, const long x_mon,
+		const long y_mon, const unsigned char * image, const char * name) {
+	image_writer_job_t job;
+
+	pthread_mutex_lock(&writer->lock);
+	if (writer->number_free == 0) {
+		writer->stalls++;
+	}
+	while (writer->number_free == 0) {
+		pthread_cond_wait(&writer->job_free, &writer->lock);
+	}
+	job = writer->free_jobs[--writer->number_free];
+	pthread_mutex_unlock(&writer->lock);
+
+	job.size = calculate_bmp_buffersize(x_mon, y_mon);
+	if (job.capacity < job.size) {
+		unsigned char * buffer = (unsigned char *) realloc(job.buffer,
+				job.size);
+		if (buffer == NULL) {
+			pthread_mutex_lock(&writer->lock);
+			writer->free_jobs[writer->number_free++] = job;
+			pthread_cond_signal(&writer->job_free);
+			pthread_mutex_unlock(&writer->lock);
+			return -1;
+		}
+		job.buffer = buffer;
+		job.capacity = job.size;
+	}
+
+	encode_image_to_bmp(x_mon, y_mon, image, job.buffer);
+	snprintf(job.name, sizeof(job.name), "%s", name);
+
+	pthread_mutex_lock(&writer->lock);
+	writer->jobs[(writer->head + writer->count) % writer->number_jobs] = job;
+	writer->count++;
+	pthread_cond_signal(&writer->job_available);
+	pthread_mutex_unlock(&writer->lock);
+
+	return 0;
+}
+
+/**
+ * Lets the I/O threads record each file they write as span on a track of
+ * their own. Has to be called before the first image is submitted.
+ *
+ * @param writer The writer.
+ * @param trace The trace or NULL.
+ */
+void image_writer_set_trace(image_writer_t * writer, trace_t * trace) {
+	char name[32];
+
+	writer->trace = trace;
+	for (int i = 0; i < writer->number_threads; ++i) {
+		snprintf(name, sizeof(name), "image writer %d", i);
+		trace_name_track(trace, TRACE_TRACK_WRITER + i, name);
+	}
+}
+
+/**
+ * Writes all queued images, stops the I/O threads and frees the writer.
+ *
+ * @param writer The writer.
+ */
+void image_writer_close(image_writer_t * writer) {
+	pthread_mutex_lock(&writer->lock);
+	writer->closing = 1;
+	pthread_cond_broadcast(&writer->job_available);
+	pthread_mutex_unlock(&writer->lock);
+
+	for (int i = 0; i < writer->number_threads; ++i) {
+		pthread_join(writer->threads[i], NULL);
+	}
+
+	for (int i = 0; i < writer->number_free; ++i) {
+		free(writer->free_jobs[i].buffer);
+	}
+	free(writer->jobs);
+	free(writer->free_jobs);
+	writer->jobs = NULL;
+	writer->free_jobs = NULL;
+
+	pthread_mutex_destroy(&writer->lock);
+	pthread_cond_destroy(&writer->job_available);
+	pthread_cond_destroy(&writer->job_free);
+}
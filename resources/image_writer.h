@@ -0,0 +1,62 @@
+/*
+ * image_writer.h
+ *
+ *      Author: Felix Paetow
+ */
+
+#ifndef IMAGE_WRITER_H_
+#define IMAGE_WRITER_H_
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mybmpwriter.h"
+#include "trace.h"
+
+//maximum number of I/O threads
+#define IMAGE_WRITER_MAX_THREADS 16
+
+typedef struct image_writer_job {
+	char name[64];
+	unsigned char * buffer;
+	long size;
+	long capacity;
+} image_writer_job_t;
+
+typedef struct image_writer {
+	pthread_t threads[IMAGE_WRITER_MAX_THREADS];
+	int number_threads;
+
+	//queue of encoded images waiting to be written
+	image_writer_job_t * jobs;
+	int queue_capacity;
+	int number_jobs;
+	int head;
+	int count;
+
+	//encoded images not in use, reused for the next submitted images
+	image_writer_job_t * free_jobs;
+	int number_free;
+
+	pthread_mutex_t lock;
+	pthread_cond_t job_available;
+	pthread_cond_t job_free;
+	int closing;
+
+	long written;
+	long errors;
+	long stalls;
+
+	//trace the I/O threads record their writes in, or NULL
+	trace_t * trace;
+} image_writer_t;
+
+int image_writer_init(image_writer_t * writer, int number_threads,
+		int queue_capacity);
+int image_writer_submit(image_writer_t * writer, const long x_mon,
+		const long y_mon, const unsigned char * image, const char * name);
+void image_writer_set_trace(image_writer_t * writer, trace_t * trace);
+void image_writer_close(image_writer_t * writer);
+
+#endif /* IMAGE_WRITER_H_ */
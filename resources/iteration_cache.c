@@ -0,0 +1,476 @@
+/*
+ * iteration_cache.c
+ *
+ *      Author: Felix Paetow
+ */
+
+#include "iteration_cache.h"
+
+//first bytes of a cache file
+static const char iteration_cache_magic[8] = { 'M', 'B', 'I', 'T', 'C',
+		'A', 'C', '1' };
+
+//a cache file found in the directory
+typedef struct iteration_cache_file {
+	char name[64];
+	long long size;
+	time_t used;
+} iteration_cache_file_t;
+
+/**
+ * Builds the path of the cache file of a key.
+ *
+ * @param cache The cache.
+ * @param key The key.
+ * @param path The path.
+ * @param size The size of path in bytes.
+ */
+static void iteration_cache_path(const iteration_cache_t * cache,
+		const char * key, char * path, const size_t size) {
+	uint64_t hash = program_cache_hash(14695981039346656037ULL, key,
+			strlen(key));
+
+	snprintf(path, size, "%s/%016llx.itc", cache->directory,
+			(unsigned long long) hash);
+}
+
+/**
+ * Lists the cache files of the directory.
+ *
+ * @param cache The cache.
+ * @param files Set to the files, which have to be freed.
+ * @param bytes Set to the size of all files.
+ * @return The number of files.
+ */
+static long iteration_cache_list(const iteration_cache_t * cache,
+		iteration_cache_file_t ** files, long long * bytes) {
+	char path[PROGRAM_CACHE_PATH_LENGTH + 80];
+	DIR * dir = opendir(cache->directory);
+	struct dirent * entry;
+	long count = 0;
+	long capacity = 0;
+
+	*files = NULL;
+	*bytes = 0;
+	if (dir == NULL) {
+		return 0;
+	}
+
+	while ((entry = readdir(dir)) != NULL) {
+		size_t length = strlen(entry->d_name);
+		struct stat info;
+
+		if (length < 5 || length >= sizeof((*files)->name)
+				|| strcmp(entry->d_name + length - 4, ".itc") != 0) {
+			continue;
+		}
+		snprintf(path, sizeof(path), "%s/%s", cache->directory,
+				entry->d_name);
+		if (stat(path, &info) != 0) {
+			continue;
+		}
+
+		if (count == capacity) {
+			capacity = (capacity == 0) ? 64 : capacity * 2;
+			iteration_cache_file_t * grown = (iteration_cache_file_t *)
+					realloc(*files, capacity * sizeof(**files));
+			if (grown == NULL) {
+				break;
+			}
+			*files = grown;
+		}
+		snprintf((*files)[count].name, sizeof((*files)[count].name), "%s",
+				entry->d_name);
+		(*files)[count].size = info.st_size;
+		(*files)[count].used = info.st_mtime;
+		*bytes += info.st_size;
+		count++;
+	}
+	closedir(dir);
+
+	return count;
+}
+
+/**
+ * Orders cache files from the least to the most recently used.
+ *
+ * @param a The first file.
+ * @param b The second file.
+ * @return A negative value if a was used before b, otherwise a positive
+ *         value or 0.
+ */
+static int iteration_cache_compare(const void * a, const void * b) {
+	time_t used_a = ((const iteration_cache_file_t *) a)->used;
+	time_t used_b = ((const iteration_cache_file_t *) b)->used;
+
+	return (used_a > used_b) - (used_a < used_b);
+}
+
+/**
+ * Removes the least recently used files until the cache is below its size.
+ * The times of the files only have seconds, so the file stored last is kept
+ * even if others were used in the same second.
+ *
+ * @param cache The cache.
+ * @param keep The path of the file stored last.
+ */
+static void iteration_cache_trim(iteration_cache_t * cache,
+		const char * keep) {
+	char path[PROGRAM_CACHE_PATH_LENGTH + 80];
+	iteration_cache_file_t * files;
+	long count = iteration_cache_list(cache, &files, &cache->bytes);
+
+	qsort(files, count, sizeof(*files), iteration_cache_compare);
+	for (long i = 0; i < count && cache->bytes > cache->max_bytes; ++i) {
+		snprintf(path, sizeof(path), "%s/%s", cache->directory,
+				files[i].name);
+		if (strcmp(path, keep) != 0 && remove(path) == 0) {
+			cache->bytes -= files[i].size;
+			cache->evictions++;
+		}
+	}
+	free(files);
+}
+
+/**
+ * Appends a number as 7 bit groups, the lowest first, each with the top bit
+ * set if more groups follow.
+ *
+ * @param out The next free byte, moved past the number.
+ * @param value The number.
+ */
+static void iteration_cache_put(unsigned char ** out, uint64_t value) {
+	while (value >= 0x80) {
+		*(*out)++ = (unsigned char) (value | 0x80);
+		value >>= 7;
+	}
+	*(*out)++ = (unsigned char) value;
+}
+
+/**
+ * Reads a number written by iteration_cache_put.
+ *
+ * @param in The next byte, moved past the number.
+ * @param end The end of the bytes.
+ * @param value Set to the number.
+ * @return 0 on success, -1 if the bytes end in the number.
+ */
+static int iteration_cache_get(const unsigned char ** in,
+		const unsigned char * end, uint64_t * value) {
+	*value = 0;
+	for (int shift = 0; shift < 64; shift += 7) {
+		if (*in == end) {
+			return -1;
+		}
+		unsigned char byte = *(*in)++;
+		*value |= (uint64_t) (byte & 0x7F) << shift;
+		if ((byte & 0x80) == 0) {
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+/**
+ * Compresses iteration values.
+ *
+ * Neighbouring points mostly have the same or nearly the same iterations.
+ * Each run of values equal to the one before is stored as its length, each
+ * other value as its difference to the one before, both as variable length
+ * numbers with the lowest bit telling them apart. The inside of the set and
+ * the smooth outside shrink to a few bytes per row.
+ *
+ * @param values The iteration values.
+ * @param bits The width of the values.
+ * @param count The number of values.
+ * @param size Set to the size of the compressed values in bytes.
+ * @return The compressed values, which have to be freed, or NULL if there
+ *         is no memory.
+ */
+static unsigned char * iteration_cache_compress(const void * values,
+		const int bits, const long count, long * size) {
+	// A value takes at most 10 bytes
+	unsigned char * data = (unsigned char *) malloc(count * 10 + 10);
+	unsigned char * out = data;
+	long previous = 0;
+	long i = 0;
+
+	if (data == NULL) {
+		return NULL;
+	}
+
+	while (i < count) {
+		long value = iteration_values_get(values, bits, i);
+
+		if (value == previous) {
+			long run = 1;
+			while (i + run < count
+					&& iteration_values_get(values, bits, i + run)
+							== previous) {
+				run++;
+			}
+			iteration_cache_put(&out, ((uint64_t) run << 1) | 1);
+			i += run;
+		} else {
+			int64_t difference = value - previous;
+			uint64_t zigzag = ((uint64_t) difference << 1)
+					^ (uint64_t) (difference >> 63);
+			iteration_cache_put(&out, zigzag << 1);
+			previous = value;
+			i++;
+		}
+	}
+	*size = out - data;
+
+	return data;
+}
+
+/**
+ * Decompresses iteration values written by iteration_cache_compress.
+ *
+ * @param data The compressed values.
+ * @param size The size of data in bytes.
+ * @param values The iteration values.
+ * @param bits The width of the values.
+ * @param count The number of values.
+ * @return 0 on success, -1 if the data is damaged.
+ */
+static int iteration_cache_decompress(const unsigned char * data,
+		const long size, void * values, const int bits, const long count) {
+	const unsigned char * in = data;
+	const unsigned char * end = data + size;
+	long previous = 0;
+	long i = 0;
+
+	while (i < count) {
+		uint64_t token;
+
+		if (iteration_cache_get(&in, end, &token) != 0) {
+			return -1;
+		}
+		if (token & 1) {
+			uint64_t run = token >> 1;
+			if (run == 0 || run > (uint64_t) (count - i)) {
+				return -1;
+			}
+			for (uint64_t j = 0; j < run; ++j) {
+				iteration_values_set(values, bits, i++, previous);
+			}
+		} else {
+			uint64_t zigzag = token >> 1;
+			int64_t difference = (int64_t) (zigzag >> 1)
+					^ -(int64_t) (zigzag & 1);
+			previous += difference;
+			iteration_values_set(values, bits, i++, previous);
+		}
+	}
+
+	return (in == end) ? 0 : -1;
+}
+
+/**
+ * Initializes the on-disk cache of iteration values.
+ *
+ * The cache keeps the iteration values of whole frames, so frames already
+ * rendered by this or an earlier run are only colored. If the directory
+ * can't be created, the cache is disabled.
+ *
+ * @param cache The cache.
+ * @param directory The cache directory.
+ * @param max_bytes The size the cache files may take together.
+ */
+void iteration_cache_init(iteration_cache_t * cache, const char * directory,
+		const long long max_bytes) {
+	iteration_cache_file_t * files;
+
+	snprintf(cache->directory, sizeof(cache->directory), "%s", directory);
+	cache->enabled = (program_cache_mkdirs(cache->directory) == 0);
+	cache->bytes = 0;
+	cache->max_bytes = max_bytes;
+	cache->hits = 0;
+	cache->misses = 0;
+	cache->stores = 0;
+	cache->evictions = 0;
+
+	if (cache->enabled) {
+		iteration_cache_list(cache, &files, &cache->bytes);
+		free(files);
+	}
+}
+
+/**
+ * Builds the key of a frame from everything its iteration values depend
+ * on. The coordinates are written as hexadecimal floats, so only exactly
+ * the same plane section has the same key.
+ *
+ * @param x_min Smallest X-value of the plane section.
+ * @param x_max Greatest X-value of the plane section.
+ * @param y_min Smallest Y-value of the plane section.
+ * @param y_max Greatest Y-value of the plane section.
+ * @param x_mon Resolution of the monitor on the horizontal axis.
+ * @param y_mon Resolution of the monitor on the vertical axis.
+ * @param itr The number of required iterations.
+ * @param abort_value The value of the abort condition.
+ * @param variant_options The build options of the kernel variant.
+ * @param key The key, ITERATION_CACHE_KEY_LENGTH bytes.
+ */
+void iteration_cache_key(const double x_min, const double x_max,
+		const double y_min, const double y_max, const long x_mon,
+		const long y_mon, const long itr, const float abort_value,
+		const char * variant_options, char * key) {
+	snprintf(key, ITERATION_CACHE_KEY_LENGTH, "%a|%a|%a|%a|%ldx%ld|%ld|%a|%s",
+			x_min, x_max, y_min, y_max, x_mon, y_mon, itr,
+			(double) abort_value, variant_options);
+}
+
+/**
+ * Loads the iteration values of a frame from its cache file.
+ *
+ * @param cache The cache.
+ * @param key The key of the frame.
+ * @param values The iteration values.
+ * @param bits The width of the values.
+ * @param count The number of values.
+ * @return 0 if the values were loaded, otherwise -1.
+ */
+int iteration_cache_load(iteration_cache_t * cache, const char * key,
+		void * values, const int bits, const long count) {
+	char path[PROGRAM_CACHE_PATH_LENGTH + 32];
+	char stored_key[ITERATION_CACHE_KEY_LENGTH];
+	char magic[8];
+	uint32_t key_length = 0;
+	uint32_t stored_bits = 0;
+	uint64_t stored_count = 0;
+	uint64_t size = 0;
+	struct stat info;
+	int result = -1;
+
+	if (!cache->enabled) {
+		return -1;
+	}
+
+	iteration_cache_path(cache, key, path, sizeof(path));
+	FILE * f = fopen(path, "rb");
+	if (f != NULL) {
+		if (fread(magic, 1, 8, f) == 8
+				&& memcmp(magic, iteration_cache_magic, 8) == 0
+				&& fread(&key_length, sizeof(key_length), 1, f) == 1
+				&& key_length == strlen(key)
+				&& fread(stored_key, 1, key_length, f) == key_length
+				&& memcmp(stored_key, key, key_length) == 0
+				&& fread(&stored_bits, sizeof(stored_bits), 1, f) == 1
+				&& stored_bits == (uint32_t) bits
+				&& fread(&stored_count, sizeof(stored_count), 1, f) == 1
+				&& stored_count == (uint64_t) count
+				&& fread(&size, sizeof(size), 1, f) == 1
+				&& size <= stored_count * 10 + 10
+				&& fstat(fileno(f), &info) == 0
+				&& (uint64_t) info.st_size == (uint64_t) ftell(f) + size) {
+			// The size is checked against the file and against the largest
+			// compressed frame, so a damaged file can't ask for any memory
+			unsigned char * data = (unsigned char *) malloc(size);
+
+			if (data != NULL && fread(data, 1, size, f) == size) {
+				result = iteration_cache_decompress(data, (long) size,
+						values, bits, count);
+			}
+			free(data);
+		}
+		fclose(f);
+	}
+
+	if (result == 0) {
+		// The time of the last use decides what is evicted
+		utime(path, NULL);
+		cache->hits++;
+	} else {
+		cache->misses++;
+	}
+
+	return result;
+}
+
+/**
+ * Stores the iteration values of a frame in its cache file and evicts the
+ * least recently used files if the cache grew beyond its size. The file is
+ * written under a temporary name and renamed, so concurrent runs never see
+ * a half written file.
+ *
+ * @param cache The cache.
+ * @param key The key of the frame.
+ * @param values The iteration values.
+ * @param bits The width of the values.
+ * @param count The number of values.
+ * @return 0 if the values were stored, otherwise -1.
+ */
+int iteration_cache_store(iteration_cache_t * cache, const char * key,
+		const void * values, const int bits, const long count) {
+	char path[PROGRAM_CACHE_PATH_LENGTH + 32];
+	char temporary[PROGRAM_CACHE_PATH_LENGTH + 64];
+	struct stat info;
+	long size;
+	int ok = 0;
+
+	if (!cache->enabled) {
+		return -1;
+	}
+
+	unsigned char * data = iteration_cache_compress(values, bits, count,
+			&size);
+	if (data == NULL) {
+		return -1;
+	}
+
+	iteration_cache_path(cache, key, path, sizeof(path));
+	snprintf(temporary, sizeof(temporary), "%s.%ld.tmp", path,
+			(long) getpid());
+
+	FILE * f = fopen(temporary, "wb");
+	if (f != NULL) {
+		uint32_t key_length = (uint32_t) strlen(key);
+		uint32_t stored_bits = (uint32_t) bits;
+		uint64_t stored_count = (uint64_t) count;
+		uint64_t stored_size = (uint64_t) size;
+
+		ok = fwrite(iteration_cache_magic, 1, 8, f) == 8
+				&& fwrite(&key_length, sizeof(key_length), 1, f) == 1
+				&& fwrite(key, 1, key_length, f) == key_length
+				&& fwrite(&stored_bits, sizeof(stored_bits), 1, f) == 1
+				&& fwrite(&stored_count, sizeof(stored_count), 1, f) == 1
+				&& fwrite(&stored_size, sizeof(stored_size), 1, f) == 1
+				&& fwrite(data, 1, size, f) == (size_t) size;
+
+		// A file of the same key is replaced, so its size no longer counts
+		long long replaced = (stat(path, &info) == 0) ? info.st_size : 0;
+		if (fclose(f) == 0 && ok && rename(temporary, path) == 0) {
+			cache->bytes -= replaced;
+			cache->bytes += 8 + sizeof(key_length) + key_length
+					+ sizeof(stored_bits) + sizeof(stored_count)
+					+ sizeof(stored_size) + size;
+			cache->stores++;
+		} else {
+			remove(temporary);
+			ok = 0;
+		}
+	}
+	free(data);
+
+	if (cache->bytes > cache->max_bytes) {
+		iteration_cache_trim(cache, path);
+	}
+
+	return ok ? 0 : -1;
+}
+
+/**
+ * Prints how the frames were found and what the cache holds.
+ *
+ * @param cache The cache.
+ */
+void iteration_cache_print_stats(const iteration_cache_t * cache) {
+	printf("Iteration cache %s: %ld hits, %ld misses, %ld stores, "
+			"%ld evictions, %.1f of %.1f MB\n", cache->directory,
+			cache->hits, cache->misses, cache->stores, cache->evictions,
+			cache->bytes / 1048576.0, cache->max_bytes / 1048576.0);
+}
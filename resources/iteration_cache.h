@@ -0,0 +1,52 @@
+/*
+ * iteration_cache.h
+ *
+ *      Author: Felix Paetow
+ */
+
+#ifndef ITERATION_CACHE_H_
+#define ITERATION_CACHE_H_
+
+#include <dirent.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <utime.h>
+#include "iteration_values.h"
+#include "program_cache.h"
+
+//maximum length of the key of a frame
+#define ITERATION_CACHE_KEY_LENGTH 768
+
+typedef struct iteration_cache {
+	char directory[PROGRAM_CACHE_PATH_LENGTH];
+	int enabled;
+
+	//bytes of all cache files, kept below max_bytes by evicting the least
+	//recently used files
+	long long bytes;
+	long long max_bytes;
+
+	long hits;
+	long misses;
+	long stores;
+	long evictions;
+} iteration_cache_t;
+
+void iteration_cache_init(iteration_cache_t * cache, const char * directory,
+		const long long max_bytes);
+void iteration_cache_key(const double x_min, const double x_max,
+		const double y_min, const double y_max, const long x_mon,
+		const long y_mon, const long itr, const float abort_value,
+		const char * variant_options, char * key);
+int iteration_cache_load(iteration_cache_t * cache, const char * key,
+		void * values, const int bits, const long count);
+int iteration_cache_store(iteration_cache_t * cache, const char * key,
+		const void * values, const int bits, const long count);
+void iteration_cache_print_stats(const iteration_cache_t * cache);
+
+#endif /* ITERATION_CACHE_H_ */
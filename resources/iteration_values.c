@@ -0,0 +1,114 @@
+/*
+ * iteration_values.c
+ *
+ *      Author: Felix Paetow
+ */
+
+#include "iteration_values.h"
+
+/**
+ * Picks the narrowest width that holds every iteration value of a frame.
+ * The values of a frame are at most itr.
+ *
+ * @param itr The number of required iterations.
+ * @return ITERATION_VALUES_16, ITERATION_VALUES_32 or ITERATION_VALUES_LONG.
+ */
+int iteration_values_bits(const long itr) {
+	if (itr <= UINT16_MAX) {
+		return ITERATION_VALUES_16;
+	}
+	if (itr <= UINT32_MAX) {
+		return ITERATION_VALUES_32;
+	}
+	return ITERATION_VALUES_LONG;
+}
+
+/**
+ * Returns the size of one iteration value.
+ *
+ * @param bits The width of the values.
+ * @return The size in bytes.
+ */
+size_t iteration_values_size(const int bits) {
+	return (size_t) bits / 8;
+}
+
+/**
+ * Returns the OpenCL C type of iteration values, for the VALUE_T define of
+ * the kernels.
+ *
+ * @param bits The width of the values.
+ * @return The name of the type.
+ */
+const char * iteration_values_type(const int bits) {
+	return bits == ITERATION_VALUES_16 ? "ushort" :
+			bits == ITERATION_VALUES_32 ? "uint" : "long";
+}
+
+/**
+ * Reads one iteration value.
+ *
+ * @param values The iteration values.
+ * @param bits The width of the values.
+ * @param i The index of the value.
+ * @return The value.
+ */
+long iteration_values_get(const void * values, const int bits, const long i) {
+	switch (bits) {
+	case ITERATION_VALUES_16:
+		return ((const uint16_t *) values)[i];
+	case ITERATION_VALUES_32:
+		return ((const uint32_t *) values)[i];
+	default:
+		return ((const long *) values)[i];
+	}
+}
+
+/**
+ * Writes one iteration value.
+ *
+ * @param values The iteration values.
+ * @param bits The width of the values.
+ * @param i The index of the value.
+ * @param value The value, at most the greatest value of the width.
+ */
+void iteration_values_set(void * values, const int bits, const long i,
+		const long value) {
+	switch (bits) {
+	case ITERATION_VALUES_16:
+		((uint16_t *) values)[i] = (uint16_t) value;
+		break;
+	case ITERATION_VALUES_32:
+		((uint32_t *) values)[i] = (uint32_t) value;
+		break;
+	default:
+		((long *) values)[i] = value;
+	}
+}
+
+/**
+ * Narrows long iteration values to a width in place, so they can be handed
+ * to kernels that read that width. Each value is written at or before the
+ * place it is read from, so the front of the buffer ends up with the
+ * narrow values.
+ *
+ * @param values The iteration values, all at most the greatest value of the
+ *        width.
+ * @param bits The width to narrow to.
+ * @param count The number of values.
+ */
+void iteration_values_pack(long * values, const int bits, const long count) {
+	unsigned char * narrow = (unsigned char *) values;
+
+	if (bits == ITERATION_VALUES_16) {
+		for (long i = 0; i < count; ++i) {
+			uint16_t value = (uint16_t) values[i];
+			memcpy(narrow + i * sizeof(value), &value, sizeof(value));
+		}
+	} else if (bits == ITERATION_VALUES_32) {
+		for (long i = 0; i < count; ++i) {
+			uint32_t value = (uint32_t) values[i];
+			memcpy(narrow + i * sizeof(value), &value, sizeof(value));
+		}
+	}
+}
@@ -0,0 +1,29 @@
+/*
+ * iteration_values.h
+ *
+ *      Author: Felix Paetow
+ */
+
+#ifndef ITERATION_VALUES_H_
+#define ITERATION_VALUES_H_
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+//widths of stored iteration values in bits; the host keeps its own values
+//in long, which is 64 bit like long in OpenCL C
+#define ITERATION_VALUES_16 16
+#define ITERATION_VALUES_32 32
+#define ITERATION_VALUES_LONG 64
+
+int iteration_values_bits(const long itr);
+size_t iteration_values_size(const int bits);
+const char * iteration_values_type(const int bits);
+long iteration_values_get(const void * values, const int bits, const long i);
+void iteration_values_set(void * values, const int bits, const long i,
+		const long value);
+void iteration_values_pack(long * values, const int bits, const long count);
+
+#endif /* ITERATION_VALUES_H_ */
@@ -0,0 +1,76 @@
+/*
+ * kernel_source.c
+ *
+ *      Author: Felix Paetow
+ */
+
+#include "kernel_source.h"
+
+/*
+ * The kernel source is embedded into the binary by the assembler when the
+ * program is built, so the program doesn't depend on the directory it is
+ * started from. Compile with -DNO_EMBEDDED_KERNEL to read the source from
+ * KERNEL_SOURCE_PATH at runtime instead.
+ */
+#if !defined(NO_EMBEDDED_KERNEL) && defined(__GNUC__)
+#define EMBEDDED_KERNEL 1
+
+#define KERNEL_SOURCE_STRINGIFY(x) #x
+#define KERNEL_SOURCE_STRING(x) KERNEL_SOURCE_STRINGIFY(x)
+
+#ifdef __APPLE__
+#define KERNEL_SOURCE_SECTION ".const_data"
+#define KERNEL_SOURCE_SYMBOL "_embedded_kernel_source"
+#else
+#define KERNEL_SOURCE_SECTION ".section .rodata"
+#define KERNEL_SOURCE_SYMBOL "embedded_kernel_source"
+#endif
+
+__asm__(KERNEL_SOURCE_SECTION "\n"
+		".global " KERNEL_SOURCE_SYMBOL "\n"
+		KERNEL_SOURCE_SYMBOL ":\n"
+		".incbin " KERNEL_SOURCE_STRING(KERNEL_SOURCE_PATH) "\n"
+		".byte 0\n"
+		".text\n");
+
+extern const char embedded_kernel_source[];
+#endif
+
+/**
+ * Returns the source of the kernels.
+ *
+ * @return A copy of the source which has to be freed by the caller, or NULL
+ *         if the source couldn't be read.
+ */
+char * kernel_source_load(void) {
+#ifdef EMBEDDED_KERNEL
+	size_t program_size = strlen(embedded_kernel_source);
+	char * source_str = (char *) malloc(program_size + 1);
+	if (source_str != NULL) {
+		memcpy(source_str, embedded_kernel_source, program_size + 1);
+	}
+
+	return source_str;
+#else
+	FILE *fp;
+	char *source_str;
+	long program_size;
+
+	fp = fopen(KERNEL_SOURCE_PATH, "r");
+	if (!fp) {
+		return NULL;
+	}
+
+	fseek(fp, 0, SEEK_END);
+	program_size = ftell(fp);
+	rewind(fp);
+	source_str = (char*) malloc(program_size + 1);
+	if (source_str != NULL) {
+		program_size = fread(source_str, sizeof(char), program_size, fp);
+		source_str[program_size] = '\0';
+	}
+	fclose(fp);
+
+	return source_str;
+#endif
+}
@@ -0,0 +1,22 @@
+/*
+ * kernel_source.h
+ *
+ *      Author: Felix Paetow
+ */
+
+#ifndef KERNEL_SOURCE_H_
+#define KERNEL_SOURCE_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//path of the kernel source, relative to the directory the program is built
+//and run from
+#ifndef KERNEL_SOURCE_PATH
+#define KERNEL_SOURCE_PATH "kernel/calculate_iterations.cl"
+#endif
+
+char * kernel_source_load(void);
+
+#endif /* KERNEL_SOURCE_H_ */
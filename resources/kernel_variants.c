@@ -0,0 +1,261 @@
+/*
+ * kernel_variants.c
+ *
+ *      Author: Felix Paetow
+ */
+
+#include "kernel_variants.h"
+
+//  define VERBOSE if you want to print the options of every variant built
+//#define  VERBOSE 1
+
+/**
+ * Initializes an empty cache of kernel variants.
+ *
+ * Each variant is the kernel source built with its own -D defines, so the
+ * compiler can specialise the iteration loop for it. Every variant is built
+ * once and kept with its kernels until the cache is released, or until it is
+ * the least used one of a full cache and another variant takes its place.
+ * Built binaries are also kept on disk by the program cache, so later runs
+ * don't have to compile them again.
+ *
+ * @param variants The cache.
+ * @param cache The program binary cache or NULL.
+ * @param context The context the programs are built in.
+ * @param device_id The device the programs are built for.
+ * @param source The kernel source.
+ * @param base_options Build options every variant is built with.
+ */
+void kernel_variants_init(kernel_variants_t * variants,
+		program_cache_t * cache, cl_context context, cl_device_id device_id,
+		const char * source, const char * base_options) {
+	variants->cache = cache;
+	variants->context = context;
+	variants->device_id = device_id;
+	variants->source = source;
+	variants->base_options = base_options;
+	variants->count = 0;
+}
+
+/**
+ * Picks the variant for a job.
+ *
+ * The escape radius is always compiled in. The iteration counter is 32 bit
+ * as long as the number of iterations fits into it, and the iteration values
+ * of an image are stored in the narrowest type that holds them.
+ *
+ * @param variant The selected variant.
+ * @param abort_value The value of the abort condition. Normally 2.
+ * @param itr The number of required iterations.
+ * @param unroll The number of iterations between two branches.
+ * @param magnitude_squared 1 to test |z|^2 instead of |z|.
+ * @param interior_check 1 to skip points that can't escape.
+ * @param precision The precision tier of the frame.
+ */
+void kernel_variant_select(kernel_variant_t * variant,
+		const float abort_value, const long itr, const int unroll,
+		const int magnitude_squared, const int interior_check,
+		const int precision) {
+	variant->escape_radius = abort_value;
+	variant->iteration_bits = (itr <= INT_MAX) ? 32 : 64;
+	variant->value_bits = iteration_values_bits(itr);
+	variant->unroll = (unroll < 1) ? 1 : unroll;
+	variant->magnitude_squared = magnitude_squared;
+	variant->interior_check = interior_check;
+	variant->precision = precision;
+}
+
+/**
+ * Writes the build options of a variant.
+ *
+ * The escape radius is written as hexadecimal float, so the kernel gets
+ * exactly the same value as the host.
+ *
+ * @param variant The variant.
+ * @param base_options Build options every variant is built with.
+ * @param options The build options.
+ * @param size The size of options in bytes.
+ */
+void kernel_variant_options(const kernel_variant_t * variant,
+		const char * base_options, char * options, const size_t size) {
+	snprintf(options, size,
+			"%s -D ESCAPE_RADIUS=%af -D ITER_T=%s -D VALUE_T=%s -D UNROLL=%d"
+			"%s%s%s", base_options, (double) variant->escape_radius,
+			variant->iteration_bits == 32 ? "int" : "long",
+			iteration_values_type(variant->value_bits), variant->unroll,
+			variant->magnitude_squared ? " -D MAGNITUDE_SQUARED" : "",
+			variant->interior_check ? " -D INTERIOR_CHECK" : "",
+			variant->precision == PRECISION_DOUBLE ? " -D PRECISION_DOUBLE" :
+			variant->precision == PRECISION_DF64 ? " -D PRECISION_DF64" : "");
+}
+
+/**
+ * Releases the kernels of a variant that were created and its program.
+ *
+ * @param p The program of the variant.
+ */
+static void kernel_variants_release_program(kernel_program_t * p) {
+	cl_kernel kernels[] = { p->ko_calculate_image_iterations,
+			p->ko_calculate_image_colors, p->ko_calculate_image_pixels,
+			p->ko_calculate_image_pixels_persistent,
+			p->ko_calculate_image_pixels_progressive,
+			p->ko_calculate_points_iterations,
+			p->ko_calculate_image_perturbation,
+			p->ko_calculate_strip_iterations,
+			p->ko_calculate_image_from_strip, p->ko_convert_image_to_yuv,
+			p->ko_calculate_image_smooth, p->ko_calculate_histogram,
+			p->ko_calculate_palette, p->ko_calculate_image_colors_lut,
+			p->ko_calculate_image_pixels_precise };
+
+	for (size_t i = 0; i < sizeof(kernels) / sizeof(kernels[0]); ++i) {
+		if (kernels[i] != NULL) {
+			clReleaseKernel(kernels[i]);
+		}
+	}
+	if (p->program != NULL) {
+		clReleaseProgram(p->program);
+	}
+	memset(p, 0, sizeof(*p));
+}
+
+/**
+ * Returns the program and kernels of a variant. The variant is built the
+ * first time it is asked for. If the cache is full, the least used variant
+ * is released to make room, so the program of a variant is only valid
+ * until the next call.
+ *
+ * @param variants The cache.
+ * @param variant The variant.
+ * @param err Set to CL_SUCCESS or the error code of the failed OpenCL call.
+ * @return The program or NULL on error.
+ */
+kernel_program_t * kernel_variants_get(kernel_variants_t * variants,
+		const kernel_variant_t * variant, cl_int * err) {
+	char options[KERNEL_VARIANTS_OPTIONS_LENGTH];
+
+	kernel_variant_options(variant, variants->base_options, options,
+			sizeof(options));
+
+	for (int i = 0; i < variants->count; ++i) {
+		if (strcmp(variants->programs[i].options, options) == 0) {
+			variants->programs[i].uses++;
+			*err = CL_SUCCESS;
+			return &variants->programs[i];
+		}
+	}
+
+	// A full cache makes room by releasing its least used variant. The last
+	// variant takes its place, so the built variants stay at the front.
+	if (variants->count == KERNEL_VARIANTS_MAX) {
+		int least_used = 0;
+		for (int i = 1; i < variants->count; ++i) {
+			if (variants->programs[i].uses
+					< variants->programs[least_used].uses) {
+				least_used = i;
+			}
+		}
+		kernel_variants_release_program(&variants->programs[least_used]);
+		variants->count--;
+		variants->programs[least_used] =
+				variants->programs[variants->count];
+	}
+
+	kernel_program_t * p = &variants->programs[variants->count];
+	memset(p, 0, sizeof(*p));
+
+	// Load the program from the binary cache or build it from source
+	p->program = program_cache_build(variants->cache, variants->context,
+			variants->device_id, variants->source, options, err);
+	if (p->program == NULL) {
+		return NULL;
+	}
+
+	// Create the compute kernels from the program
+	p->ko_calculate_image_iterations = clCreateKernel(p->program,
+			"calculate_image_iterations", err);
+	if (*err == CL_SUCCESS) {
+		p->ko_calculate_image_colors = clCreateKernel(p->program,
+				"calculate_image_colors", err);
+	}
+	if (*err == CL_SUCCESS) {
+		p->ko_calculate_image_pixels = clCreateKernel(p->program,
+				"calculate_image_pixels", err);
+	}
+	if (*err == CL_SUCCESS) {
+		p->ko_calculate_image_pixels_persistent = clCreateKernel(p->program,
+				"calculate_image_pixels_persistent", err);
+	}
+	if (*err == CL_SUCCESS) {
+		p->ko_calculate_image_pixels_progressive = clCreateKernel(p->program,
+				"calculate_image_pixels_progressive", err);
+	}
+	if (*err == CL_SUCCESS) {
+		p->ko_calculate_points_iterations = clCreateKernel(p->program,
+				"calculate_points_iterations", err);
+	}
+	if (*err == CL_SUCCESS) {
+		p->ko_calculate_image_perturbation = clCreateKernel(p->program,
+				"calculate_image_perturbation", err);
+	}
+	if (*err == CL_SUCCESS) {
+		p->ko_calculate_strip_iterations = clCreateKernel(p->program,
+				"calculate_strip_iterations", err);
+	}
+	if (*err == CL_SUCCESS) {
+		p->ko_calculate_image_from_strip = clCreateKernel(p->program,
+				"calculate_image_from_strip", err);
+	}
+	if (*err == CL_SUCCESS) {
+		p->ko_convert_image_to_yuv = clCreateKernel(p->program,
+				"convert_image_to_yuv", err);
+	}
+	if (*err == CL_SUCCESS) {
+		p->ko_calculate_image_smooth = clCreateKernel(p->program,
+				"calculate_image_smooth", err);
+	}
+	if (*err == CL_SUCCESS) {
+		p->ko_calculate_histogram = clCreateKernel(p->program,
+				"calculate_histogram", err);
+	}
+	if (*err == CL_SUCCESS) {
+		p->ko_calculate_palette = clCreateKernel(p->program,
+				"calculate_palette", err);
+	}
+	if (*err == CL_SUCCESS) {
+		p->ko_calculate_image_colors_lut = clCreateKernel(p->program,
+				"calculate_image_colors_lut", err);
+	}
+
+	// Only the variants of the precise tiers have the precise kernel
+	if (*err == CL_SUCCESS && variant->precision != PRECISION_FLOAT) {
+		p->ko_calculate_image_pixels_precise = clCreateKernel(p->program,
+				"calculate_image_pixels_precise", err);
+	}
+	if (*err != CL_SUCCESS) {
+		kernel_variants_release_program(p);
+		return NULL;
+	}
+
+	snprintf(p->options, sizeof(p->options), "%s", options);
+	p->uses = 1;
+	variants->count++;
+
+#ifdef VERBOSE
+	printf("Built kernel variant with options %s\n",
+			options + strspn(options, " "));
+#endif
+
+	return p;
+}
+
+/**
+ * Releases the programs and kernels of all variants.
+ *
+ * @param variants The cache.
+ */
+void kernel_variants_release(kernel_variants_t * variants) {
+	for (int i = 0; i < variants->count; ++i) {
+		kernel_variants_release_program(&variants->programs[i]);
+	}
+	variants->count = 0;
+}
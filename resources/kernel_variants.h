@@ -0,0 +1,83 @@
+/*
+ * kernel_variants.h
+ *
+ *      Author: Felix Paetow
+ */
+
+#ifndef KERNEL_VARIANTS_H_
+#define KERNEL_VARIANTS_H_
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __APPLE__
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+#include "iteration_values.h"
+#include "precision.h"
+#include "program_cache.h"
+
+//maximum number of variants built at the same time
+#define KERNEL_VARIANTS_MAX 16
+
+//maximum length of the build options of a variant
+#define KERNEL_VARIANTS_OPTIONS_LENGTH 512
+
+typedef struct kernel_variant {
+	float escape_radius;
+	int iteration_bits;
+	int value_bits;
+	int unroll;
+	int magnitude_squared;
+	int interior_check;
+	int precision;
+} kernel_variant_t;
+
+typedef struct kernel_program {
+	char options[KERNEL_VARIANTS_OPTIONS_LENGTH];
+	cl_program program;
+	cl_kernel ko_calculate_image_iterations;
+	cl_kernel ko_calculate_image_colors;
+	cl_kernel ko_calculate_image_pixels;
+	cl_kernel ko_calculate_image_pixels_persistent;
+	cl_kernel ko_calculate_image_pixels_progressive;
+	cl_kernel ko_calculate_points_iterations;
+	cl_kernel ko_calculate_image_perturbation;
+	cl_kernel ko_calculate_strip_iterations;
+	cl_kernel ko_calculate_image_from_strip;
+	cl_kernel ko_convert_image_to_yuv;
+	cl_kernel ko_calculate_image_smooth;
+	cl_kernel ko_calculate_histogram;
+	cl_kernel ko_calculate_palette;
+	cl_kernel ko_calculate_image_colors_lut;
+	cl_kernel ko_calculate_image_pixels_precise;
+	long uses;
+} kernel_program_t;
+
+typedef struct kernel_variants {
+	program_cache_t * cache;
+	cl_context context;
+	cl_device_id device_id;
+	const char * source;
+	const char * base_options;
+	int count;
+	kernel_program_t programs[KERNEL_VARIANTS_MAX];
+} kernel_variants_t;
+
+void kernel_variants_init(kernel_variants_t * variants,
+		program_cache_t * cache, cl_context context, cl_device_id device_id,
+		const char * source, const char * base_options);
+void kernel_variant_select(kernel_variant_t * variant,
+		const float abort_value, const long itr, const int unroll,
+		const int magnitude_squared, const int interior_check,
+		const int precision);
+void kernel_variant_options(const kernel_variant_t * variant,
+		const char * base_options, char * options, const size_t size);
+kernel_program_t * kernel_variants_get(kernel_variants_t * variants,
+		const kernel_variant_t * variant, cl_int * err);
+void kernel_variants_release(kernel_variants_t * variants);
+
+#endif /* KERNEL_VARIANTS_H_ */
@@ -0,0 +1,91 @@
+/*
+ * mapped_bmp.c
+ *
+ *      Author: Felix Paetow
+ */
+
+#include "mapped_bmp.h"
+
+/**
+ * Initializes a bmp file that isn't mapped.
+ *
+ * @param bmp The file.
+ */
+void mapped_bmp_init(mapped_bmp_t * bmp) {
+	bmp->fd = -1;
+	bmp->map = NULL;
+	bmp->size = 0;
+	bmp->pixels = NULL;
+	bmp->row_pitch = 0;
+}
+
+/**
+ * Creates a bmp file in its final size and maps it into memory, so the
+ * image can be read back from the device straight into the page cache.
+ *
+ * The header is written and the padding of the rows is already zero, so
+ * only the rows of the image are left to fill, row_pitch bytes apart. The
+ * file is the same safe_image_to_bmp writes.
+ *
+ * @param bmp The file, not mapped.
+ * @param name The name for the bmp file.
+ * @param x_mon Resolution of the monitor on the horizontal axis.
+ * @param y_mon Resolution of the monitor on the vertical axis.
+ * @return 0 on success, otherwise -1.
+ */
+int mapped_bmp_create(mapped_bmp_t * bmp, const char * name,
+		const long x_mon, const long y_mon) {
+	size_t size = calculate_bmp_buffersize(x_mon, y_mon);
+
+	bmp->fd = open(name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (bmp->fd < 0) {
+		return -1;
+	}
+
+	// A new file is all zeros up to its size, padding included
+	if (ftruncate(bmp->fd, size) != 0) {
+		close(bmp->fd);
+		bmp->fd = -1;
+		return -1;
+	}
+
+	void * map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, bmp->fd,
+			0);
+	if (map == MAP_FAILED) {
+		close(bmp->fd);
+		bmp->fd = -1;
+		return -1;
+	}
+
+	bmp->map = (unsigned char *) map;
+	bmp->size = size;
+	bmp->pixels = bmp->map + 54;
+	bmp->row_pitch = (size - 54) / y_mon;
+
+	calcute_bmpfileheader(bmp->map, calculate_filesize(y_mon, x_mon));
+	calculate_bmpinfoheader(bmp->map + 14, x_mon, y_mon);
+
+	return 0;
+}
+
+/**
+ * Unmaps and closes a bmp file. Its pages are left to the kernel to write
+ * back.
+ *
+ * @param bmp The file. Nothing is done if it isn't mapped.
+ * @return 0 on success, otherwise -1.
+ */
+int mapped_bmp_close(mapped_bmp_t * bmp) {
+	int failed = 0;
+
+	if (bmp->map != NULL && munmap(bmp->map, bmp->size) != 0) {
+		failed = 1;
+	}
+	if (bmp->fd >= 0 && close(bmp->fd) != 0) {
+		failed = 1;
+	}
+
+	mapped_bmp_init(bmp);
+
+	return failed ? -1 : 0;
+}
@@ -0,0 +1,34 @@
+/*
+ * mapped_bmp.h
+ *
+ *      Author: Felix Paetow
+ */
+
+#ifndef MAPPED_BMP_H_
+#define MAPPED_BMP_H_
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "mybmpwriter.h"
+
+typedef struct mapped_bmp {
+	int fd;
+	unsigned char * map;
+	size_t size;
+
+	//first row of the image in the file and the bytes from one row to the
+	//next, with the padding
+	unsigned char * pixels;
+	size_t row_pitch;
+} mapped_bmp_t;
+
+void mapped_bmp_init(mapped_bmp_t * bmp);
+int mapped_bmp_create(mapped_bmp_t * bmp, const char * name,
+		const long x_mon, const long y_mon);
+int mapped_bmp_close(mapped_bmp_t * bmp);
+
+#endif /* MAPPED_BMP_H_ */
@@ -0,0 +1,565 @@
+/*
+ * multi_device.c
+ *
+ *      Author: Felix Paetow
+ */
+
+#include "multi_device.h"
+
+/**
+ * Adds a device or sub-device with its own context, command queue and
+ * kernel variants. A sub-device belongs to the renderer once it was added;
+ * if it can't be added, the caller still has to release it.
+ *
+ * @param md The renderer.
+ * @param device_id The device.
+ * @param sub_device 1 if the device was created by clCreateSubDevices.
+ * @param cache The program binary cache or NULL.
+ * @param source The kernel source.
+ * @return CL_SUCCESS or the error code of the failed OpenCL call.
+ */
+static cl_int multi_device_add(multi_device_t * md, cl_device_id device_id,
+		const int sub_device, program_cache_t * cache, const char * source) {
+	multi_device_unit_t * unit = &md->units[md->count];
+	cl_device_fp_config fp_config = 0;
+	cl_int err;
+
+	memset(unit, 0, sizeof(*unit));
+	unit->device_id = device_id;
+	unit->sub_device = sub_device;
+
+	err = clGetDeviceInfo(device_id, CL_DEVICE_NAME, sizeof(unit->name),
+			unit->name, NULL);
+	err |= clGetDeviceInfo(device_id, CL_DEVICE_MAX_COMPUTE_UNITS,
+			sizeof(cl_uint), &unit->compute_units, NULL);
+	err |= clGetDeviceInfo(device_id, CL_DEVICE_SINGLE_FP_CONFIG,
+			sizeof(fp_config), &fp_config, NULL);
+	if (err != CL_SUCCESS) {
+		return err;
+	}
+
+	// Same values as the single device path, if the device supports that
+	unit->correctly_rounded =
+			(fp_config & CL_FP_CORRECTLY_ROUNDED_DIVIDE_SQRT) != 0;
+	if (unit->correctly_rounded) {
+		snprintf(unit->build_options, sizeof(unit->build_options), "%s",
+				"-cl-fp32-correctly-rounded-divide-sqrt");
+	}
+
+	unit->context = clCreateContext(0, 1, &device_id, NULL, NULL, &err);
+	if (err != CL_SUCCESS) {
+		return err;
+	}
+
+	// The kernels are profiled to measure the throughput of the device
+	unit->commands = clCreateCommandQueue(unit->context, device_id,
+			CL_QUEUE_PROFILING_ENABLE, &err);
+	if (err != CL_SUCCESS) {
+		clReleaseContext(unit->context);
+		return err;
+	}
+
+	kernel_variants_init(&unit->variants, cache, unit->context, device_id,
+			source, unit->build_options);
+
+	// Until a frame has been measured, the compute units are the weight
+	unit->weight = unit->compute_units > 0 ? unit->compute_units : 1;
+
+	md->count++;
+
+	return CL_SUCCESS;
+}
+
+/**
+ * Adds a device, split into sub-devices if asked for. A device that can't
+ * be split is added as a whole.
+ *
+ * @param md The renderer.
+ * @param device_id The device.
+ * @param split MULTI_DEVICE_SPLIT_NONE, MULTI_DEVICE_SPLIT_NUMA or the
+ *        number of compute units of each sub-device.
+ * @param cache The program binary cache or NULL.
+ * @param source The kernel source.
+ * @return CL_SUCCESS or the error code of the failed OpenCL call.
+ */
+static cl_int multi_device_split(multi_device_t * md, cl_device_id device_id,
+		const int split, program_cache_t * cache, const char * source) {
+	cl_device_partition_property properties[3];
+	cl_uint number_sub_devices = 0;
+	cl_int err;
+
+	if (split == MULTI_DEVICE_SPLIT_NONE) {
+		return multi_device_add(md, device_id, 0, cache, source);
+	}
+
+	if (split == MULTI_DEVICE_SPLIT_NUMA) {
+		properties[0] = CL_DEVICE_PARTITION_BY_AFFINITY_DOMAIN;
+		properties[1] = CL_DEVICE_AFFINITY_DOMAIN_NUMA;
+	} else {
+		properties[0] = CL_DEVICE_PARTITION_EQUALLY;
+		properties[1] = split;
+	}
+	properties[2] = 0;
+
+	err = clCreateSubDevices(device_id, properties, 0, NULL,
+			&number_sub_devices);
+	if (err != CL_SUCCESS || number_sub_devices < 2) {
+		printf("Device can't be split, using it as a whole\n");
+		return multi_device_add(md, device_id, 0, cache, source);
+	}
+
+	// The partition always creates all its sub-devices, so they are all
+	// taken and the ones beyond MULTI_DEVICE_MAX released again
+	cl_device_id * sub_devices = (cl_device_id *) malloc(
+			sizeof(cl_device_id) * number_sub_devices);
+	if (sub_devices == NULL) {
+		return CL_OUT_OF_HOST_MEMORY;
+	}
+	err = clCreateSubDevices(device_id, properties, number_sub_devices,
+			sub_devices, NULL);
+	if (err != CL_SUCCESS) {
+		free(sub_devices);
+		return err;
+	}
+
+	int first = md->count;
+	for (cl_uint i = 0; i < number_sub_devices; ++i) {
+		if (err != CL_SUCCESS || md->count == MULTI_DEVICE_MAX) {
+			clReleaseDevice(sub_devices[i]);
+			continue;
+		}
+		err = multi_device_add(md, sub_devices[i], 1, cache, source);
+		if (err != CL_SUCCESS) {
+			clReleaseDevice(sub_devices[i]);
+		}
+	}
+	free(sub_devices);
+
+	if (err == CL_SUCCESS && md->count - first < (int) number_sub_devices) {
+		printf("Using %d of %u sub-devices, at most %d devices render a "
+				"frame\n", md->count - first, number_sub_devices,
+				MULTI_DEVICE_MAX);
+	}
+
+	return err;
+}
+
+/**
+ * Finds the devices of all platforms and prepares each of them to render
+ * a share of every frame.
+ *
+ * @param md The renderer.
+ * @param split MULTI_DEVICE_SPLIT_NONE, MULTI_DEVICE_SPLIT_NUMA or the
+ *        number of compute units of each sub-device.
+ * @param cache The program binary cache or NULL.
+ * @param source The kernel source.
+ * @return CL_SUCCESS or the error code of the failed OpenCL call.
+ */
+cl_int multi_device_init(multi_device_t * md, const int split,
+		program_cache_t * cache, const char * source) {
+	cl_uint number_platforms = 0;
+	cl_int err;
+
+	md->count = 0;
+	md->owners = NULL;
+	md->events = NULL;
+	md->number_tiles = 0;
+	md->frames = 0;
+
+	err = clGetPlatformIDs(0, NULL, &number_platforms);
+	if (err != CL_SUCCESS) {
+		return err;
+	}
+	if (number_platforms == 0) {
+		return CL_DEVICE_NOT_FOUND;
+	}
+
+	cl_platform_id platforms[number_platforms];
+	err = clGetPlatformIDs(number_platforms, platforms, NULL);
+	if (err != CL_SUCCESS) {
+		return err;
+	}
+
+	for (cl_uint p = 0; p < number_platforms; ++p) {
+		cl_device_id devices[MULTI_DEVICE_MAX];
+		cl_uint number_devices = 0;
+
+		if (clGetDeviceIDs(platforms[p], CL_DEVICE_TYPE_ALL, MULTI_DEVICE_MAX,
+				devices, &number_devices) != CL_SUCCESS) {
+			continue;
+		}
+		if (number_devices > MULTI_DEVICE_MAX) {
+			number_devices = MULTI_DEVICE_MAX;
+		}
+
+		for (cl_uint d = 0; d < number_devices && md->count < MULTI_DEVICE_MAX;
+				++d) {
+			err = multi_device_split(md, devices[d], split, cache, source);
+			if (err != CL_SUCCESS) {
+				return err;
+			}
+		}
+	}
+
+	if (md->count == 0) {
+		return CL_DEVICE_NOT_FOUND;
+	}
+
+	int inexact = 0;
+	for (int u = 0; u < md->count; ++u) {
+		printf("Device %d: %s, %u compute units%s%s\n", u, md->units[u].name,
+				md->units[u].compute_units,
+				md->units[u].sub_device ? " (sub-device)" : "",
+				md->units[u].correctly_rounded ?
+						"" : ", divisions and square roots not correctly "
+								"rounded");
+		inexact |= !md->units[u].correctly_rounded;
+	}
+	if (inexact) {
+		printf("The tiles of devices without correctly rounded divisions and "
+				"square roots may differ in the last bit from those of the "
+				"other devices and the CPU backend\n");
+	}
+
+	return CL_SUCCESS;
+}
+
+/**
+ * Makes sure the frame buffers of a unit hold a whole image. The iteration
+ * values get room for the widest values.
+ *
+ * @param unit The device.
+ * @param pixels The number of pixels of the image.
+ * @return CL_SUCCESS or the error code of the failed OpenCL call.
+ */
+static cl_int multi_device_buffers(multi_device_unit_t * unit,
+		const size_t pixels) {
+	cl_int err = CL_SUCCESS;
+
+	if (unit->pixels == pixels) {
+		return CL_SUCCESS;
+	}
+
+	if (unit->pixels > 0) {
+		clReleaseMemObject(unit->d_image);
+		clReleaseMemObject(unit->d_image_pixel);
+		clReleaseMemObject(unit->d_saved_iterations);
+		unit->pixels = 0;
+	}
+
+	unit->d_image = clCreateBuffer(unit->context, CL_MEM_WRITE_ONLY,
+			sizeof(long) * pixels, NULL, &err);
+	if (err != CL_SUCCESS) {
+		return err;
+	}
+	unit->d_image_pixel = clCreateBuffer(unit->context, CL_MEM_WRITE_ONLY,
+			sizeof(unsigned char) * pixels * 3, NULL, &err);
+	if (err != CL_SUCCESS) {
+		clReleaseMemObject(unit->d_image);
+		return err;
+	}
+	unit->d_saved_iterations = clCreateBuffer(unit->context,
+			CL_MEM_READ_WRITE, sizeof(cl_ulong), NULL, &err);
+	if (err != CL_SUCCESS) {
+		clReleaseMemObject(unit->d_image);
+		clReleaseMemObject(unit->d_image_pixel);
+		return err;
+	}
+
+	unit->pixels = pixels;
+
+	return CL_SUCCESS;
+}
+
+/**
+ * Hands the tiles of a frame to the devices in proportion to their weight.
+ *
+ * The smooth weighted round robin interleaves the tiles, so every device
+ * gets tiles from all over the image. Its tiles cost about as much as the
+ * others, and its time per tile measures the device, not the part of the
+ * image it got.
+ *
+ * @param md The renderer.
+ */
+static void multi_device_assign(multi_device_t * md) {
+	double total_weight = 0;
+
+	for (int u = 0; u < md->count; ++u) {
+		total_weight += md->units[u].weight;
+		md->units[u].current = 0;
+		md->units[u].tiles = 0;
+		md->units[u].busy_ms = 0;
+	}
+
+	for (long t = 0; t < md->number_tiles; ++t) {
+		int best = 0;
+
+		for (int u = 0; u < md->count; ++u) {
+			md->units[u].current += md->units[u].weight;
+			if (md->units[u].current > md->units[best].current) {
+				best = u;
+			}
+		}
+
+		md->units[best].current -= total_weight;
+		md->units[best].tiles++;
+		md->owners[t] = best;
+	}
+}
+
+/**
+ * Sets the weight of each device to its measured throughput, averaged with
+ * the frames before.
+ *
+ * @param md The renderer.
+ */
+static void multi_device_measure(multi_device_t * md) {
+	for (long t = 0; t < md->number_tiles; ++t) {
+		cl_ulong start = 0;
+		cl_ulong end = 0;
+
+		if (clGetEventProfilingInfo(md->events[t], CL_PROFILING_COMMAND_START,
+				sizeof(start), &start, NULL) == CL_SUCCESS
+				&& clGetEventProfilingInfo(md->events[t],
+						CL_PROFILING_COMMAND_END, sizeof(end), &end, NULL)
+						== CL_SUCCESS && end > start) {
+			md->units[md->owners[t]].busy_ms += (double) (end - start) / 1e6;
+		}
+		clReleaseEvent(md->events[t]);
+	}
+
+	for (int u = 0; u < md->count; ++u) {
+		multi_device_unit_t * unit = &md->units[u];
+
+		unit->total_tiles += unit->tiles;
+		unit->total_busy_ms += unit->busy_ms;
+
+		if (unit->tiles > 0 && unit->busy_ms > 0) {
+			double throughput = (double) unit->tiles / unit->busy_ms;
+			unit->weight = (md->frames == 0) ?
+					throughput : 0.5 * (unit->weight + throughput);
+		}
+	}
+}
+
+/**
+ * Calculates a whole colored Mandelbrot image on all devices. Same as the
+ * kernel calculate_image_pixels on one device.
+ *
+ * The frame is split into tiles of MULTI_DEVICE_TILE_ROWS rows. Each device
+ * calculates its tiles with a global offset into its own frame buffer, and
+ * only their rows are read back. The time each device needed sets its share
+ * of the next frame.
+ *
+ * @param md The renderer.
+ * @param x_min Smallest X-value of the plane section.
+ * @param x_max Greatest X-value of the plane section.
+ * @param y_min Smallest Y-value of the plane section.
+ * @param y_max Greatest Y-value of the plane section.
+ * @param x_mon Resolution of the monitor on the horizontal axis.
+ * @param y_mon Resolution of the monitor on the vertical axis.
+ * @param abort_value The value of the abort condition. Normally 2.
+ * @param itr The number of required iterations.
+ * @param variant The kernel variant of the frame.
+ * @param imagevalues The iteration values or NULL if they aren't needed,
+ *        as wide as variant->value_bits.
+ * @param image The final image, 3 bytes per pixel.
+ * @param saved_iterations Set to the iterations the interior check saved.
+ * @return CL_SUCCESS or the error code of the failed OpenCL call.
+ */
+cl_int multi_device_render(multi_device_t * md, const float x_min,
+		const float x_max, const float y_min, const float y_max,
+		const long x_mon, const long y_mon, const float abort_value,
+		const long itr, const kernel_variant_t * variant,
+		void * imagevalues, unsigned char * image,
+		cl_ulong * saved_iterations) {
+	size_t value_size = iteration_values_size(variant->value_bits);
+	cl_kernel kernels[MULTI_DEVICE_MAX];
+	cl_ulong saved[MULTI_DEVICE_MAX];
+	int export_values = (imagevalues != NULL);
+	cl_ulong zero = 0;
+	cl_int err = CL_SUCCESS;
+
+	long number_tiles = (y_mon + MULTI_DEVICE_TILE_ROWS - 1)
+			/ MULTI_DEVICE_TILE_ROWS;
+	if (number_tiles != md->number_tiles) {
+		int * owners = (int *) realloc(md->owners,
+				sizeof(int) * number_tiles);
+		if (owners == NULL) {
+			return CL_OUT_OF_HOST_MEMORY;
+		}
+		md->owners = owners;
+
+		cl_event * events = (cl_event *) realloc(md->events,
+				sizeof(cl_event) * number_tiles);
+		if (events == NULL) {
+			return CL_OUT_OF_HOST_MEMORY;
+		}
+		md->events = events;
+		md->number_tiles = number_tiles;
+	}
+
+	for (int u = 0; u < md->count; ++u) {
+		multi_device_unit_t * unit = &md->units[u];
+
+		err = multi_device_buffers(unit, (size_t) (x_mon * y_mon));
+		if (err != CL_SUCCESS) {
+			return err;
+		}
+
+		kernel_program_t * program = kernel_variants_get(&unit->variants,
+				variant, &err);
+		if (program == NULL) {
+			return err;
+		}
+		kernels[u] = program->ko_calculate_image_pixels;
+
+		err = clSetKernelArg(kernels[u], 0, sizeof(float), &x_min);
+		err |= clSetKernelArg(kernels[u], 1, sizeof(float), &x_max);
+		err |= clSetKernelArg(kernels[u], 2, sizeof(float), &y_min);
+		err |= clSetKernelArg(kernels[u], 3, sizeof(float), &y_max);
+		err |= clSetKernelArg(kernels[u], 4, sizeof(long), &x_mon);
+		err |= clSetKernelArg(kernels[u], 5, sizeof(long), &y_mon);
+		err |= clSetKernelArg(kernels[u], 6, sizeof(float), &abort_value);
+		err |= clSetKernelArg(kernels[u], 7, sizeof(long), &itr);
+		err |= clSetKernelArg(kernels[u], 8, sizeof(int), &export_values);
+		err |= clSetKernelArg(kernels[u], 9, sizeof(cl_mem), &unit->d_image);
+		err |= clSetKernelArg(kernels[u], 10, sizeof(cl_mem),
+				&unit->d_image_pixel);
+		err |= clSetKernelArg(kernels[u], 11, sizeof(cl_mem),
+				&unit->d_saved_iterations);
+		if (err != CL_SUCCESS) {
+			return err;
+		}
+
+		err = clEnqueueFillBuffer(unit->commands, unit->d_saved_iterations,
+				&zero, sizeof(zero), 0, sizeof(zero), 0, NULL, NULL);
+		if (err != CL_SUCCESS) {
+			return err;
+		}
+	}
+
+	multi_device_assign(md);
+
+	// Each tile is its rows of the image, the global offset keeps the
+	// coordinates of the pixels the same as on one device
+	long enqueued = 0;
+	for (long t = 0; t < md->number_tiles && err == CL_SUCCESS; ++t) {
+		multi_device_unit_t * unit = &md->units[md->owners[t]];
+		long y0 = t * MULTI_DEVICE_TILE_ROWS;
+		long rows = (y_mon - y0 < MULTI_DEVICE_TILE_ROWS) ?
+				y_mon - y0 : MULTI_DEVICE_TILE_ROWS;
+		size_t offset[2] = { 0, (size_t) y0 };
+		size_t global[2] = { (size_t) x_mon, (size_t) rows };
+		size_t first = (size_t) (y0 * x_mon);
+		size_t pixels = (size_t) (rows * x_mon);
+
+		err = clEnqueueNDRangeKernel(unit->commands, kernels[md->owners[t]],
+				2, offset, global, NULL, 0, NULL, &md->events[t]);
+		if (err != CL_SUCCESS) {
+			break;
+		}
+		enqueued++;
+
+		err = clEnqueueReadBuffer(unit->commands, unit->d_image_pixel,
+				CL_FALSE, first * 3, pixels * 3, image + first * 3, 0, NULL,
+				NULL);
+		if (export_values) {
+			err |= clEnqueueReadBuffer(unit->commands, unit->d_image,
+					CL_FALSE, first * value_size, pixels * value_size,
+					(unsigned char *) imagevalues + first * value_size, 0,
+					NULL, NULL);
+		}
+	}
+
+	for (int u = 0; u < md->count && err == CL_SUCCESS; ++u) {
+		err = clEnqueueReadBuffer(md->units[u].commands,
+				md->units[u].d_saved_iterations, CL_FALSE, 0,
+				sizeof(cl_ulong), &saved[u], 0, NULL, NULL);
+		err |= clFlush(md->units[u].commands);
+	}
+
+	// Every device is waited for, also after an error, so no read back is
+	// left writing into the image or the counters
+	for (int u = 0; u < md->count; ++u) {
+		cl_int finished = clFinish(md->units[u].commands);
+		if (err == CL_SUCCESS) {
+			err = finished;
+		}
+	}
+	if (err != CL_SUCCESS) {
+		for (long t = 0; t < enqueued; ++t) {
+			clReleaseEvent(md->events[t]);
+		}
+		return err;
+	}
+
+	*saved_iterations = 0;
+	for (int u = 0; u < md->count; ++u) {
+		*saved_iterations += saved[u];
+	}
+
+	multi_device_measure(md);
+	md->frames++;
+
+	return CL_SUCCESS;
+}
+
+/**
+ * Prints the share of the tiles, the device time and the throughput of
+ * each device.
+ *
+ * @param md The renderer.
+ */
+void multi_device_print_stats(const multi_device_t * md) {
+	long total_tiles = 0;
+
+	for (int u = 0; u < md->count; ++u) {
+		total_tiles += md->units[u].total_tiles;
+	}
+
+	printf("Multi-device: %ld frames on %d devices\n", md->frames,
+			md->count);
+	for (int u = 0; u < md->count; ++u) {
+		const multi_device_unit_t * unit = &md->units[u];
+
+		printf("  %d %s: %ld tiles (%.1f%%), %.2f ms busy, %.2f tiles/ms\n",
+				u, unit->name, unit->total_tiles,
+				total_tiles > 0 ?
+						100.0 * unit->total_tiles / total_tiles : 0.0,
+				unit->total_busy_ms,
+				unit->total_busy_ms > 0 ?
+						unit->total_tiles / unit->total_busy_ms : 0.0);
+	}
+}
+
+/**
+ * Releases the buffers, kernels, queues and contexts of all devices.
+ *
+ * @param md The renderer.
+ */
+void multi_device_release(multi_device_t * md) {
+	for (int u = 0; u < md->count; ++u) {
+		multi_device_unit_t * unit = &md->units[u];
+
+		if (unit->pixels > 0) {
+			clReleaseMemObject(unit->d_image);
+			clReleaseMemObject(unit->d_image_pixel);
+			clReleaseMemObject(unit->d_saved_iterations);
+		}
+		kernel_variants_release(&unit->variants);
+		clReleaseCommandQueue(unit->commands);
+		clReleaseContext(unit->context);
+		if (unit->sub_device) {
+			clReleaseDevice(unit->device_id);
+		}
+	}
+
+	free(md->owners);
+	free(md->events);
+
+	md->owners = NULL;
+	md->events = NULL;
+	md->number_tiles = 0;
+	md->count = 0;
+}
@@ -0,0 +1,88 @@
+/*
+ * multi_device.h
+ *
+ *      Author: Felix Paetow
+ */
+
+#ifndef MULTI_DEVICE_H_
+#define MULTI_DEVICE_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __APPLE__
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+#include "kernel_variants.h"
+#include "program_cache.h"
+
+//maximum number of devices and sub-devices a frame is spread over
+#define MULTI_DEVICE_MAX 16
+
+//rows of a tile, the part of a frame handed to one device
+#define MULTI_DEVICE_TILE_ROWS 16
+
+//how devices are split into sub-devices: not at all, by NUMA domain, or
+//into sub-devices of a number of compute units
+#define MULTI_DEVICE_SPLIT_NONE 0
+#define MULTI_DEVICE_SPLIT_NUMA -1
+
+typedef struct multi_device_unit {
+	cl_device_id device_id;
+	int sub_device;
+	char name[128];
+	cl_uint compute_units;
+
+	cl_context context;
+	cl_command_queue commands;
+	kernel_variants_t variants;
+	char build_options[64];
+
+	//1 if the device rounds divisions and square roots correctly, so its
+	//tiles have the same values as those of the CPU backend
+	int correctly_rounded;
+
+	//frame buffers of the whole image, of which the unit fills its tiles
+	cl_mem d_image;
+	cl_mem d_image_pixel;
+	cl_mem d_saved_iterations;
+	size_t pixels;
+
+	//share of the tiles and the smooth weighted round robin that hands
+	//them out
+	double weight;
+	double current;
+
+	//tiles and device time of the current frame and of all frames
+	long tiles;
+	double busy_ms;
+	long total_tiles;
+	double total_busy_ms;
+} multi_device_unit_t;
+
+typedef struct multi_device {
+	int count;
+	multi_device_unit_t units[MULTI_DEVICE_MAX];
+
+	//unit and kernel event of each tile of the current frame
+	int * owners;
+	cl_event * events;
+	long number_tiles;
+
+	long frames;
+} multi_device_t;
+
+cl_int multi_device_init(multi_device_t * md, const int split,
+		program_cache_t * cache, const char * source);
+cl_int multi_device_render(multi_device_t * md, const float x_min,
+		const float x_max, const float y_min, const float y_max,
+		const long x_mon, const long y_mon, const float abort_value,
+		const long itr, const kernel_variant_t * variant,
+		void * imagevalues, unsigned char * image,
+		cl_ulong * saved_iterations);
+void multi_device_print_stats(const multi_device_t * md);
+void multi_device_release(multi_device_t * md);
+
+#endif /* MULTI_DEVICE_H_ */
@@ -101,3 +101,45 @@ void safe_image_to_bmp(const long x_mon, const long y_mon,
 
 	fclose(f);
 }
+
+/**
+ * Calculates the number of bytes of a whole bmp file including the padding
+ * of the rows.
+ *
+ * @param width The width.
+ * @param height The height.
+ * @return The number of bytes of the file.
+ */
+long calculate_bmp_buffersize(const long width, const long height) {
+	long rowsize = width * 3 + (4 - (width * 3) % 4) % 4;
+
+	return 54 + rowsize * height;
+}
+
+/**
+ * Encodes an image as a whole bmp file in memory, so it can be written with
+ * one single write. The file is the same safe_image_to_bmp writes.
+ *
+ * @param x_mon Resolution of the monitor on the horizontal axis.
+ * @param y_mon Resolution of the monitor on the vertical axis.
+ * @param image The image values.
+ * @param buffer Buffer of calculate_bmp_buffersize(x_mon, y_mon) bytes.
+ */
+void encode_image_to_bmp(const long x_mon, const long y_mon,
+		const unsigned char * image, unsigned char * buffer) {
+	long padding = (4 - (x_mon * 3) % 4) % 4;
+	long filesize = calculate_filesize(y_mon, x_mon);
+
+	//set header
+	calcute_bmpfileheader(buffer, filesize);
+	calculate_bmpinfoheader(buffer + 14, x_mon, y_mon);
+	buffer += 54;
+
+	//Passing through the lines
+	for (long i = 0; i < y_mon; ++i) {
+		memcpy(buffer, image + (i * x_mon * 3), x_mon * 3);
+		buffer += x_mon * 3;
+		memset(buffer, 0, padding);
+		buffer += padding;
+	}
+}
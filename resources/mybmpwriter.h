@@ -10,6 +10,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 long calculate_filesize(const long width, const long height);
 void calcute_bmpfileheader(unsigned char * bmpfileheader, const long filesize);
@@ -17,5 +18,8 @@ void calculate_bmpinfoheader(unsigned char * bmpinfoheader, const long width,
 		const long height);
 void safe_image_to_bmp(const long x_mon, const long y_mon,
 		unsigned char * image, char * name);
+long calculate_bmp_buffersize(const long width, const long height);
+void encode_image_to_bmp(const long x_mon, const long y_mon,
+		const unsigned char * image, unsigned char * buffer);
 
 #endif /* MYBMPWRITER_H_ */
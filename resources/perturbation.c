@@ -0,0 +1,186 @@
+/*
+ * perturbation.c
+ *
+ *      Author: Felix Paetow
+ */
+
+#include "perturbation.h"
+
+/**
+ * Initializes a deep zoom around a point.
+ *
+ * Deep zoom frames are calculated with perturbation: only the center of the
+ * image, the reference point, is iterated in full precision. Every pixel
+ * then only iterates its small distance to the reference orbit, which
+ * float can hold at any zoom depth.
+ *
+ * @param p The deep zoom.
+ * @param center_real Real part of the center.
+ * @param center_imaginary Imaginary part of the center.
+ * @param spacing The distance between two pixels.
+ */
+void perturbation_init(perturbation_t * p, const float center_real,
+		const float center_imaginary, const double spacing) {
+	int exponent;
+
+	bigfloat_set_double(&p->center_real, center_real, BIGFLOAT_MAX_LIMBS);
+	bigfloat_set_double(&p->center_imaginary, center_imaginary,
+			BIGFLOAT_MAX_LIMBS);
+
+	p->spacing_mantissa = frexp(spacing, &exponent);
+	p->spacing_exponent = exponent;
+
+	p->orbit = NULL;
+	p->orbit_length = 0;
+	p->orbit_capacity = 0;
+	p->limbs = 0;
+	p->escaped = 0;
+}
+
+/**
+ * Sets the center from a text like "1.75487766624669276004950889635852869,0",
+ * real and imaginary part in decimal notation with as many digits as
+ * needed. The map is z^2 - c, so the set is mirrored against the usual
+ * pictures; that example is the mirrored center of the period-3 minibrot,
+ * which stays in the set at any depth.
+ *
+ * @param p The deep zoom.
+ * @param center The center.
+ * @return 0 on success, -1 if the text isn't a point.
+ */
+int perturbation_set_center(perturbation_t * p, const char * center) {
+	const char * end;
+
+	if (bigfloat_parse(&p->center_real, center, BIGFLOAT_MAX_LIMBS, &end) != 0
+			|| *end != ',') {
+		return -1;
+	}
+	if (bigfloat_parse(&p->center_imaginary, end + 1, BIGFLOAT_MAX_LIMBS,
+			&end) != 0 || *end != '\0') {
+		return -1;
+	}
+
+	p->orbit_length = 0;
+
+	return 0;
+}
+
+/**
+ * Zooms into the center by reducing the spacing of the pixels.
+ *
+ * @param p The deep zoom.
+ * @param reduction The zoom speed in percentage.
+ */
+void perturbation_zoom(perturbation_t * p, const float reduction) {
+	int exponent;
+
+	p->spacing_mantissa = frexp(
+			p->spacing_mantissa * (1.0 - reduction / 100.0), &exponent);
+	p->spacing_exponent += exponent;
+}
+
+/**
+ * Calculates the reference orbit Z(n+1) = Z(n)^2 - c of the center.
+ *
+ * The precision follows the pixel spacing. As long as it doesn't change, an
+ * orbit that didn't escape is only continued up to the new number of
+ * iterations.
+ *
+ * @param p The deep zoom.
+ * @param itr The number of required iterations.
+ * @param abort_value The value of the abort condition. Normally 2.
+ * @return 0 on success, -1 if there is no memory for the orbit.
+ */
+int perturbation_reference_orbit(perturbation_t * p, const long itr,
+		const float abort_value) {
+	long bits = PERTURBATION_GUARD_BITS - p->spacing_exponent;
+	int limbs = (int) (1 + (bits + 31) / 32);
+	if (limbs > BIGFLOAT_MAX_LIMBS) {
+		limbs = BIGFLOAT_MAX_LIMBS;
+	}
+
+	// The capacity doubles, so the device buffer of the orbit only has to
+	// grow now and then while the number of iterations rises every frame
+	if (p->orbit_capacity < itr + 1) {
+		long capacity = 2 * p->orbit_capacity;
+		if (capacity < itr + 1) {
+			capacity = itr + 1;
+		}
+		my_complex_t * orbit = (my_complex_t *) realloc(p->orbit,
+				sizeof(my_complex_t) * capacity);
+		if (orbit == NULL) {
+			return -1;
+		}
+		p->orbit = orbit;
+		p->orbit_capacity = capacity;
+	}
+
+	// Start again if the precision changed
+	if (limbs != p->limbs || p->orbit_length == 0) {
+		p->limbs = limbs;
+		p->escaped = 0;
+		p->orbit_length = 1;
+		p->orbit[0].real = 0;
+		p->orbit[0].imaginary = 0;
+		bigfloat_set_double(&p->z_real, 0, limbs);
+		bigfloat_set_double(&p->z_imaginary, 0, limbs);
+	}
+
+	bigfloat_t c_real = p->center_real;
+	bigfloat_t c_imaginary = p->center_imaginary;
+	bigfloat_set_precision(&c_real, limbs);
+	bigfloat_set_precision(&c_imaginary, limbs);
+
+	bigfloat_t rr, ii, ri;
+
+	while (!p->escaped && p->orbit_length <= itr) {
+		bigfloat_mul(&rr, &p->z_real, &p->z_real);
+		bigfloat_mul(&ii, &p->z_imaginary, &p->z_imaginary);
+		bigfloat_mul(&ri, &p->z_real, &p->z_imaginary);
+
+		bigfloat_sub(&p->z_real, &rr, &ii);
+		bigfloat_sub(&p->z_real, &p->z_real, &c_real);
+		bigfloat_add(&p->z_imaginary, &ri, &ri);
+		bigfloat_sub(&p->z_imaginary, &p->z_imaginary, &c_imaginary);
+
+		double real = bigfloat_to_double(&p->z_real);
+		double imaginary = bigfloat_to_double(&p->z_imaginary);
+
+		my_complex_t * z = &p->orbit[p->orbit_length++];
+		z->real = (float) real;
+		z->imaginary = (float) imaginary;
+
+		// The escaped value is kept, the pixels are rebased before they
+		// would need the one after it
+		if (sqrt(real * real + imaginary * imaginary) >= abort_value) {
+			p->escaped = 1;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Returns the pixel spacing as float mantissa and exponent for the kernel.
+ *
+ * @param p The deep zoom.
+ * @param mantissa Set to the mantissa, 0.5 <= mantissa < 1.
+ * @param exponent Set to the exponent.
+ */
+void perturbation_spacing(const perturbation_t * p, float * mantissa,
+		int * exponent) {
+	*mantissa = (float) p->spacing_mantissa;
+	*exponent = (int) p->spacing_exponent;
+}
+
+/**
+ * Frees the reference orbit.
+ *
+ * @param p The deep zoom.
+ */
+void perturbation_release(perturbation_t * p) {
+	free(p->orbit);
+	p->orbit = NULL;
+	p->orbit_length = 0;
+	p->orbit_capacity = 0;
+}
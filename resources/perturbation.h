@@ -0,0 +1,52 @@
+/*
+ * perturbation.h
+ *
+ *      Author: Felix Paetow
+ */
+
+#ifndef PERTURBATION_H_
+#define PERTURBATION_H_
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "bigfloat.h"
+#include "my_complex.h"
+
+//fractional bits of the reference point beyond the pixel spacing
+#define PERTURBATION_GUARD_BITS 64
+
+typedef struct perturbation {
+	//center of the image, which is the reference point
+	bigfloat_t center_real;
+	bigfloat_t center_imaginary;
+
+	//distance between two pixels: spacing_mantissa * 2^spacing_exponent
+	//with 0.5 <= spacing_mantissa < 1
+	double spacing_mantissa;
+	long spacing_exponent;
+
+	//reference orbit Z(0) = 0 ... Z(orbit_length - 1) in float
+	my_complex_t * orbit;
+	long orbit_length;
+	long orbit_capacity;
+
+	//last value of the orbit in full precision, so a longer orbit with the
+	//same precision continues from there
+	bigfloat_t z_real;
+	bigfloat_t z_imaginary;
+	int limbs;
+	int escaped;
+} perturbation_t;
+
+void perturbation_init(perturbation_t * p, const float center_real,
+		const float center_imaginary, const double spacing);
+int perturbation_set_center(perturbation_t * p, const char * center);
+void perturbation_zoom(perturbation_t * p, const float reduction);
+int perturbation_reference_orbit(perturbation_t * p, const long itr,
+		const float abort_value);
+void perturbation_spacing(const perturbation_t * p, float * mantissa,
+		int * exponent);
+void perturbation_release(perturbation_t * p);
+
+#endif /* PERTURBATION_H_ */
@@ -0,0 +1,176 @@
+/*
+ * precision.c
+ *
+ *      Author: Felix Paetow
+ */
+
+#include "precision.h"
+
+/**
+ * Tests if a device calculates in double.
+ *
+ * @param device_id The device.
+ * @return 1 if the device supports cl_khr_fp64, otherwise 0.
+ */
+int precision_device_has_double(cl_device_id device_id) {
+	cl_device_fp_config fp_config = 0;
+
+	if (clGetDeviceInfo(device_id, CL_DEVICE_DOUBLE_FP_CONFIG,
+			sizeof(fp_config), &fp_config, NULL) != CL_SUCCESS) {
+		return 0;
+	}
+
+	return fp_config != 0;
+}
+
+/**
+ * Reads the name of a precision tier.
+ *
+ * @param name auto, float, df64 or double.
+ * @return The tier or -2 if the name is unknown.
+ */
+int precision_parse(const char * name) {
+	if (strcmp(name, "auto") == 0) {
+		return PRECISION_AUTO;
+	}
+	for (int precision = 0; precision < PRECISION_TIERS; ++precision) {
+		if (strcmp(name, precision_name(precision)) == 0) {
+			return precision;
+		}
+	}
+	return -2;
+}
+
+/**
+ * Returns the name of a precision tier.
+ *
+ * @param precision The tier.
+ * @return The name.
+ */
+const char * precision_name(const int precision) {
+	switch (precision) {
+	case PRECISION_FLOAT:
+		return "float";
+	case PRECISION_DF64:
+		return "df64";
+	case PRECISION_DOUBLE:
+		return "double";
+	default:
+		return "auto";
+	}
+}
+
+/**
+ * Picks the fastest precision tier that can still tell the pixels of a
+ * plane section apart.
+ *
+ * A tier is good enough if its mantissa holds the bits of the greatest
+ * coordinate down to the pixel spacing, plus some guard bits. Double-float
+ * (df64) emulates about 48 bits with two floats and runs on every device.
+ * Devices with native double use it instead of df64.
+ *
+ * @param x_min Smallest X-value of the plane section.
+ * @param x_max Greatest X-value of the plane section.
+ * @param y_min Smallest Y-value of the plane section.
+ * @param y_max Greatest Y-value of the plane section.
+ * @param x_mon Resolution of the monitor on the horizontal axis.
+ * @param y_mon Resolution of the monitor on the vertical axis.
+ * @param has_double 1 if the device supports double.
+ * @param requested The tier set by the user or PRECISION_AUTO.
+ * @return The tier.
+ */
+int precision_select(const double x_min, const double x_max,
+		const double y_min, const double y_max, const long x_mon,
+		const long y_mon, const int has_double, const int requested) {
+	if (requested == PRECISION_DOUBLE && !has_double) {
+		return PRECISION_DF64;
+	}
+	if (requested != PRECISION_AUTO) {
+		return requested;
+	}
+
+	double spacing = fmin((x_max - x_min) / (double) (x_mon - 1),
+			(y_max - y_min) / (double) (y_mon - 1));
+	double magnitude = fmax(fmax(fabs(x_min), fabs(x_max)),
+			fmax(fabs(y_min), fabs(y_max)));
+	double bits = log2(magnitude / spacing) + PRECISION_GUARD_BITS;
+
+	if (bits <= PRECISION_FLOAT_BITS) {
+		return PRECISION_FLOAT;
+	}
+	if (has_double) {
+		return PRECISION_DOUBLE;
+	}
+	return PRECISION_DF64;
+}
+
+/**
+ * Sets a coordinate argument of a kernel in the format of a precision tier:
+ * a double or, for df64, a float2 with the rounded value and the rest.
+ *
+ * @param kernel The kernel.
+ * @param index The index of the argument.
+ * @param value The coordinate.
+ * @param precision The tier the kernel was built for.
+ * @return CL_SUCCESS or the error code of clSetKernelArg.
+ */
+cl_int precision_set_coordinate(cl_kernel kernel, const cl_uint index,
+		const double value, const int precision) {
+	if (precision == PRECISION_DOUBLE) {
+		cl_double d = value;
+		return clSetKernelArg(kernel, index, sizeof(cl_double), &d);
+	}
+
+	cl_float2 f;
+	f.s[0] = (float) value;
+	f.s[1] = (float) (value - (double) f.s[0]);
+	return clSetKernelArg(kernel, index, sizeof(cl_float2), &f);
+}
+
+/**
+ * Initializes empty precision statistics.
+ *
+ * @param stats The statistics.
+ */
+void precision_stats_init(precision_stats_t * stats) {
+	memset(stats, 0, sizeof(*stats));
+	stats->last = PRECISION_AUTO;
+}
+
+/**
+ * Counts a frame for its precision tier.
+ *
+ * @param stats The statistics.
+ * @param precision The tier of the frame.
+ * @param compute_ms The time the device needed for the frame or a negative
+ *        value if it isn't known.
+ */
+void precision_stats_add(precision_stats_t * stats, const int precision,
+		const double compute_ms) {
+	if (stats->last != PRECISION_AUTO && stats->last != precision) {
+		stats->switches++;
+	}
+	stats->last = precision;
+
+	stats->frames[precision]++;
+	if (compute_ms > 0) {
+		stats->compute_ms[precision] += compute_ms;
+	}
+}
+
+/**
+ * Prints how many frames each tier rendered and what they cost on average.
+ *
+ * @param stats The statistics.
+ */
+void precision_print_stats(const precision_stats_t * stats) {
+	printf("Precision tiers (%ld switches):", stats->switches);
+	for (int precision = 0; precision < PRECISION_TIERS; ++precision) {
+		if (stats->frames[precision] > 0) {
+			printf(" %s %ld frames %.2f ms/frame", precision_name(precision),
+					stats->frames[precision],
+					stats->compute_ms[precision] / stats->frames[precision]);
+		}
+	}
+	printf("\n");
+}
@@ -0,0 +1,55 @@
+/*
+ * precision.h
+ *
+ *      Author: Felix Paetow
+ */
+
+#ifndef PRECISION_H_
+#define PRECISION_H_
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#ifdef __APPLE__
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+//precision tiers of the kernels, from the fastest to the most precise
+#define PRECISION_AUTO -1
+#define PRECISION_FLOAT 0
+#define PRECISION_DF64 1
+#define PRECISION_DOUBLE 2
+#define PRECISION_TIERS 3
+
+//bits of the coordinates beyond the pixel spacing, so rounding errors don't
+//show up after many iterations
+#define PRECISION_GUARD_BITS 6
+
+//mantissa bits of each tier
+#define PRECISION_FLOAT_BITS 24
+#define PRECISION_DF64_BITS 48
+#define PRECISION_DOUBLE_BITS 53
+
+typedef struct precision_stats {
+	long frames[PRECISION_TIERS];
+	double compute_ms[PRECISION_TIERS];
+	long switches;
+	int last;
+} precision_stats_t;
+
+int precision_device_has_double(cl_device_id device_id);
+int precision_parse(const char * name);
+const char * precision_name(const int precision);
+int precision_select(const double x_min, const double x_max,
+		const double y_min, const double y_max, const long x_mon,
+		const long y_mon, const int has_double, const int requested);
+cl_int precision_set_coordinate(cl_kernel kernel, const cl_uint index,
+		const double value, const int precision);
+void precision_stats_init(precision_stats_t * stats);
+void precision_stats_add(precision_stats_t * stats, const int precision,
+		const double compute_ms);
+void precision_print_stats(const precision_stats_t * stats);
+
+#endif /* PRECISION_H_ */
@@ -0,0 +1,337 @@
+/*
+ * program_cache.c
+ *
+ *      Author: Felix Paetow
+ */
+
+#include "program_cache.h"
+
+//first bytes of a cache file
+static const char program_cache_magic[8] = { 'M', 'B', 'P', 'C', 'A', 'C',
+		'H', '1' };
+
+/**
+ * Creates a directory and all missing parent directories.
+ *
+ * @param path The directory.
+ * @return 0 if the directory exists afterwards, otherwise -1.
+ */
+int program_cache_mkdirs(const char * path) {
+	char partial[PROGRAM_CACHE_PATH_LENGTH];
+	size_t length = strlen(path);
+
+	if (length == 0 || length >= sizeof(partial)) {
+		return -1;
+	}
+
+	memcpy(partial, path, length + 1);
+	for (size_t i = 1; i <= length; ++i) {
+		if (partial[i] == '/' || partial[i] == '\0') {
+			char c = partial[i];
+			partial[i] = '\0';
+			if (mkdir(partial, 0755) != 0 && errno != EEXIST) {
+				return -1;
+			}
+			partial[i] = c;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Initializes the cache of program binaries.
+ *
+ * Without a directory, MANDELBROT_CACHE_DIR is used, then
+ * $XDG_CACHE_HOME/mandelbrot and then $HOME/.cache/mandelbrot. If no
+ * directory can be created, the cache is disabled and every program is
+ * built from source.
+ *
+ * @param cache The cache.
+ * @param directory The cache directory or NULL for the default one.
+ */
+void program_cache_init(program_cache_t * cache, const char * directory) {
+	const char * base;
+
+	cache->enabled = 0;
+	cache->hits = 0;
+	cache->misses = 0;
+	cache->directory[0] = '\0';
+
+	if (directory != NULL) {
+		snprintf(cache->directory, sizeof(cache->directory), "%s", directory);
+	} else if ((base = getenv("MANDELBROT_CACHE_DIR")) != NULL) {
+		snprintf(cache->directory, sizeof(cache->directory), "%s", base);
+	} else if ((base = getenv("XDG_CACHE_HOME")) != NULL) {
+		snprintf(cache->directory, sizeof(cache->directory), "%s/mandelbrot",
+				base);
+	} else if ((base = getenv("HOME")) != NULL) {
+		snprintf(cache->directory, sizeof(cache->directory),
+				"%s/.cache/mandelbrot", base);
+	}
+
+	if (cache->directory[0] != '\0'
+			&& program_cache_mkdirs(cache->directory) == 0) {
+		cache->enabled = 1;
+	}
+}
+
+/**
+ * Continues a 64 bit FNV-1a hash over some bytes.
+ *
+ * @param hash The hash so far, 14695981039346656037 for the first bytes.
+ * @param data The bytes.
+ * @param size The number of bytes.
+ * @return The new hash.
+ */
+uint64_t program_cache_hash(uint64_t hash, const void * data,
+		const size_t size) {
+	const unsigned char * bytes = (const unsigned char *) data;
+
+	for (size_t i = 0; i < size; ++i) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+/**
+ * Builds the key of a program: the device, its driver version, the source
+ * and the build options.
+ *
+ * @param device_id The device.
+ * @param source The source.
+ * @param options The build options.
+ * @param key The key.
+ * @param size The size of key in bytes.
+ * @return The hash of the key.
+ */
+static uint64_t program_cache_key(cl_device_id device_id, const char * source,
+		const char * options, char * key, const size_t size) {
+	char device_name[256] = { 0 };
+	char vendor_name[256] = { 0 };
+	char driver_version[256] = { 0 };
+	char device_version[256] = { 0 };
+
+	clGetDeviceInfo(device_id, CL_DEVICE_NAME, sizeof(device_name) - 1,
+			device_name, NULL);
+	clGetDeviceInfo(device_id, CL_DEVICE_VENDOR, sizeof(vendor_name) - 1,
+			vendor_name, NULL);
+	clGetDeviceInfo(device_id, CL_DRIVER_VERSION, sizeof(driver_version) - 1,
+			driver_version, NULL);
+	clGetDeviceInfo(device_id, CL_DEVICE_VERSION, sizeof(device_version) - 1,
+			device_version, NULL);
+
+	uint64_t source_hash = program_cache_hash(14695981039346656037ULL, source,
+			strlen(source));
+
+	snprintf(key, size, "%s|%s|%s|%s|%016llx|%s", device_name, vendor_name,
+			driver_version, device_version, (unsigned long long) source_hash,
+			options);
+
+	return program_cache_hash(14695981039346656037ULL, key, strlen(key));
+}
+
+/**
+ * Loads a program binary from its cache file.
+ *
+ * @param path The cache file.
+ * @param key The key the binary must have been stored with.
+ * @param size Set to the size of the binary.
+ * @return The binary, which has to be freed, or NULL if there is none.
+ */
+static unsigned char * program_cache_load(const char * path, const char * key,
+		size_t * size) {
+	FILE * f = fopen(path, "rb");
+	if (f == NULL) {
+		return NULL;
+	}
+
+	char magic[8];
+	uint32_t key_length = 0;
+	uint64_t binary_size = 0;
+	unsigned char * binary = NULL;
+
+	if (fread(magic, 1, 8, f) == 8
+			&& memcmp(magic, program_cache_magic, 8) == 0
+			&& fread(&key_length, sizeof(key_length), 1, f) == 1
+			&& key_length == strlen(key)) {
+		char * stored_key = (char *) malloc(key_length + 1);
+
+		if (stored_key != NULL
+				&& fread(stored_key, 1, key_length, f) == key_length
+				&& memcmp(stored_key, key, key_length) == 0
+				&& fread(&binary_size, sizeof(binary_size), 1, f) == 1
+				&& binary_size > 0) {
+			binary = (unsigned char *) malloc(binary_size);
+			if (binary != NULL
+					&& fread(binary, 1, binary_size, f) != binary_size) {
+				free(binary);
+				binary = NULL;
+			}
+		}
+		free(stored_key);
+	}
+
+	fclose(f);
+	*size = (size_t) binary_size;
+
+	return binary;
+}
+
+/**
+ * Stores the binary of a built program in its cache file. The file is
+ * written under a temporary name and renamed, so concurrent runs never see
+ * a half written file.
+ *
+ * @param path The cache file.
+ * @param key The key of the program.
+ * @param program The built program.
+ */
+static void program_cache_store(const char * path, const char * key,
+		cl_program program) {
+	size_t binary_size = 0;
+	cl_int err = clGetProgramInfo(program, CL_PROGRAM_BINARY_SIZES,
+			sizeof(size_t), &binary_size, NULL);
+	if (err != CL_SUCCESS || binary_size == 0) {
+		return;
+	}
+
+	unsigned char * binary = (unsigned char *) malloc(binary_size);
+	if (binary == NULL) {
+		return;
+	}
+
+	err = clGetProgramInfo(program, CL_PROGRAM_BINARIES,
+			sizeof(unsigned char *), &binary, NULL);
+	// A truncated name could be renamed onto another file, so the program
+	// isn't stored then
+	char temporary[PROGRAM_CACHE_PATH_LENGTH + 32];
+	int length = snprintf(temporary, sizeof(temporary), "%s.%ld.tmp", path,
+			(long) getpid());
+	if (err == CL_SUCCESS && length > 0
+			&& (size_t) length < sizeof(temporary)) {
+		FILE * f = fopen(temporary, "wb");
+		if (f != NULL) {
+			uint32_t key_length = (uint32_t) strlen(key);
+			uint64_t size = binary_size;
+			int ok = fwrite(program_cache_magic, 1, 8, f) == 8
+					&& fwrite(&key_length, sizeof(key_length), 1, f) == 1
+					&& fwrite(key, 1, key_length, f) == key_length
+					&& fwrite(&size, sizeof(size), 1, f) == 1
+					&& fwrite(binary, 1, binary_size, f) == binary_size;
+
+			if (fclose(f) == 0 && ok) {
+				rename(temporary, path);
+			} else {
+				remove(temporary);
+			}
+		}
+	}
+
+	free(binary);
+}
+
+/**
+ * Prints the build log of a program.
+ *
+ * @param program The program.
+ * @param device_id The device the program was built for.
+ */
+void program_cache_print_log(cl_program program, cl_device_id device_id) {
+	// Determine the size of the log
+	size_t log_size = 0;
+	clGetProgramBuildInfo(program, device_id, CL_PROGRAM_BUILD_LOG, 0, NULL,
+			&log_size);
+
+	// Allocate memory for the log
+	char *log = (char *) malloc(log_size + 1);
+	if (log == NULL) {
+		return;
+	}
+
+	// Get the log
+	clGetProgramBuildInfo(program, device_id, CL_PROGRAM_BUILD_LOG, log_size,
+			log, NULL);
+	log[log_size] = '\0';
+
+	// Print the log
+	printf("%s\n", log);
+	free(log);
+}
+
+/**
+ * Returns a built program for a device.
+ *
+ * If the cache holds a binary for the device, its driver version, the
+ * source and the build options, the program is created from that binary.
+ * Otherwise it is built from source and its binary is stored in the cache.
+ *
+ * @param cache The cache or NULL to always build from source.
+ * @param context The context.
+ * @param device_id The device.
+ * @param source The source.
+ * @param options The build options.
+ * @param err Set to CL_SUCCESS or the error code of the failed OpenCL call.
+ * @return The program or NULL on error.
+ */
+cl_program program_cache_build(program_cache_t * cache, cl_context context,
+		cl_device_id device_id, const char * source, const char * options,
+		cl_int * err) {
+	char key[2048];
+	char path[PROGRAM_CACHE_PATH_LENGTH + 32];
+	cl_program program;
+
+	if (cache != NULL && cache->enabled) {
+		uint64_t hash = program_cache_key(device_id, source, options, key,
+				sizeof(key));
+		snprintf(path, sizeof(path), "%s/%016llx.bin", cache->directory,
+				(unsigned long long) hash);
+
+		size_t binary_size = 0;
+		unsigned char * binary = program_cache_load(path, key, &binary_size);
+		if (binary != NULL) {
+			cl_int binary_status;
+			program = clCreateProgramWithBinary(context, 1, &device_id,
+					&binary_size, (const unsigned char **) &binary,
+					&binary_status, err);
+			free(binary);
+
+			if (*err == CL_SUCCESS && binary_status == CL_SUCCESS) {
+				*err = clBuildProgram(program, 1, &device_id, options, NULL,
+						NULL);
+				if (*err == CL_SUCCESS) {
+					cache->hits++;
+					return program;
+				}
+			}
+			// The binary is stale, build from source and replace it
+			if (program != NULL) {
+				clReleaseProgram(program);
+			}
+		}
+		cache->misses++;
+	}
+
+	// Create the compute program from the source buffer
+	program = clCreateProgramWithSource(context, 1, &source, NULL, err);
+	if (*err != CL_SUCCESS) {
+		return NULL;
+	}
+
+	// Build the program
+	*err = clBuildProgram(program, 1, &device_id, options, NULL, NULL);
+	if (*err != CL_SUCCESS) {
+		printf("Error: Failed to build program with options %s\n", options);
+		program_cache_print_log(program, device_id);
+		clReleaseProgram(program);
+		return NULL;
+	}
+
+	if (cache != NULL && cache->enabled) {
+		program_cache_store(path, key, program);
+	}
+
+	return program;
+}
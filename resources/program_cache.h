@@ -0,0 +1,43 @@
+/*
+ * program_cache.h
+ *
+ *      Author: Felix Paetow
+ */
+
+#ifndef PROGRAM_CACHE_H_
+#define PROGRAM_CACHE_H_
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#ifdef __APPLE__
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+//maximum length of the path of a cache file
+#define PROGRAM_CACHE_PATH_LENGTH 1024
+
+typedef struct program_cache {
+	char directory[PROGRAM_CACHE_PATH_LENGTH];
+	int enabled;
+	long hits;
+	long misses;
+} program_cache_t;
+
+int program_cache_mkdirs(const char * path);
+void program_cache_init(program_cache_t * cache, const char * directory);
+uint64_t program_cache_hash(uint64_t hash, const void * data,
+		const size_t size);
+cl_program program_cache_build(program_cache_t * cache, cl_context context,
+		cl_device_id device_id, const char * source, const char * options,
+		cl_int * err);
+void program_cache_print_log(cl_program program, cl_device_id device_id);
+
+#endif /* PROGRAM_CACHE_H_ */
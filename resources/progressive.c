@@ -0,0 +1,133 @@
+/*
+ * progressive.c
+ *
+ *      Author: Felix Paetow
+ */
+
+#include "progressive.h"
+
+/**
+ * Returns the time of a monotonic clock.
+ *
+ * @return The time in milliseconds.
+ */
+static double progressive_now_ms(void) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec * 1000.0 + now.tv_nsec / 1000000.0;
+}
+
+/**
+ * Initializes the statistics of the progressive renderer.
+ *
+ * @param stats The statistics.
+ */
+void progressive_stats_init(progressive_stats_t * stats) {
+	stats->frames = 0;
+	stats->first_preview_ms = 0;
+	stats->last_preview_ms = 0;
+}
+
+/**
+ * Renders a frame coarse to fine.
+ *
+ * The passes calculate every PROGRESSIVE_FIRST_STEP-th pixel first and halve
+ * the step down to 1, skipping the pixels of the passes before. Each pass
+ * but the last is read back into preview and handed to the sink before the
+ * next one is enqueued, so the first preview is ready after 1/16 of the
+ * work. The last pass completes the image on the device and isn't waited
+ * for; it is read back like a frame of the fused kernel.
+ *
+ * @param job The frame and the kernel calculate_image_pixels_progressive.
+ * @param preview Host memory for a colored image.
+ * @param sink Takes the previews.
+ * @param context Given to the sink.
+ * @param stats The statistics.
+ * @param computed Set to the event of the last pass.
+ * @return CL_SUCCESS or the error code of the failed OpenCL call.
+ */
+cl_int progressive_render(const progressive_job_t * job,
+		unsigned char * preview, progressive_sink_t sink, void * context,
+		progressive_stats_t * stats, cl_event * computed) {
+	double start = progressive_now_ms();
+	int step = PROGRESSIVE_FIRST_STEP;
+	cl_int err;
+
+	err = clSetKernelArg(job->kernel, 0, sizeof(float), &job->x_min);
+	err |= clSetKernelArg(job->kernel, 1, sizeof(float), &job->x_max);
+	err |= clSetKernelArg(job->kernel, 2, sizeof(float), &job->y_min);
+	err |= clSetKernelArg(job->kernel, 3, sizeof(float), &job->y_max);
+	err |= clSetKernelArg(job->kernel, 4, sizeof(long), &job->x_mon);
+	err |= clSetKernelArg(job->kernel, 5, sizeof(long), &job->y_mon);
+	err |= clSetKernelArg(job->kernel, 6, sizeof(float), &job->abort_value);
+	err |= clSetKernelArg(job->kernel, 7, sizeof(long), &job->itr);
+	err |= clSetKernelArg(job->kernel, 10, sizeof(int), &job->export_values);
+	err |= clSetKernelArg(job->kernel, 11, sizeof(cl_mem), &job->d_image);
+	err |= clSetKernelArg(job->kernel, 12, sizeof(cl_mem),
+			&job->d_image_pixel);
+	err |= clSetKernelArg(job->kernel, 13, sizeof(cl_mem),
+			&job->d_saved_iterations);
+	if (err != CL_SUCCESS) {
+		return err;
+	}
+
+	/*__kernel void calculate_image_pixels_progressive(const float x_min,
+	 const float x_max, const float y_min, const float y_max,
+	 const long x_mon, const long y_mon, const float abort_value,
+	 const long itr, const int step, const int first_pass,
+	 const int export_values, __global VALUE_T * imagevalues,
+	 __global unsigned char * image, __global ulong * saved_iterations)*/
+
+	for (int pass = 0; pass < PROGRESSIVE_PASSES; ++pass) {
+		int first_pass = (pass == 0);
+		int last_pass = (pass == PROGRESSIVE_PASSES - 1);
+		size_t global[2] = { (job->x_mon + step - 1) / step, (job->y_mon
+				+ step - 1) / step };
+
+		err = clSetKernelArg(job->kernel, 8, sizeof(int), &step);
+		err |= clSetKernelArg(job->kernel, 9, sizeof(int), &first_pass);
+		err |= clEnqueueNDRangeKernel(job->commands, job->kernel, 2, NULL,
+				global, NULL, 0, NULL, last_pass ? computed : NULL);
+		if (err != CL_SUCCESS || last_pass) {
+			break;
+		}
+
+		// The in-order queue reads the preview after the pass
+		err = clEnqueueReadBuffer(job->commands, job->d_image_pixel, CL_TRUE,
+				0, job->x_mon * job->y_mon * 3, preview, 0, NULL, NULL);
+		if (err != CL_SUCCESS) {
+			break;
+		}
+
+		double elapsed = progressive_now_ms() - start;
+		if (first_pass) {
+			stats->first_preview_ms += elapsed;
+		}
+		if (pass == PROGRESSIVE_PASSES - 2) {
+			stats->last_preview_ms += elapsed;
+		}
+		sink(context, pass, step, preview, elapsed);
+
+		step /= 2;
+	}
+	stats->frames++;
+
+	return err;
+}
+
+/**
+ * Prints how long the previews took on average.
+ *
+ * @param stats The statistics.
+ */
+void progressive_print_stats(const progressive_stats_t * stats) {
+	if (stats->frames == 0) {
+		return;
+	}
+
+	printf("Progressive rendering: first preview after %.2f ms, last after "
+			"%.2f ms on average\n", stats->first_preview_ms / stats->frames,
+			stats->last_preview_ms / stats->frames);
+}
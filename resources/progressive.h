@@ -0,0 +1,65 @@
+/*
+ * progressive.h
+ *
+ *      Author: Felix Paetow
+ */
+
+#ifndef PROGRESSIVE_H_
+#define PROGRESSIVE_H_
+
+#include <stdio.h>
+#include <time.h>
+#ifdef __APPLE__
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+//distance of the pixels of the first pass. Each pass halves it, so the
+//passes calculate 1/16, 1/4 and all of the pixels.
+#define PROGRESSIVE_FIRST_STEP 4
+#define PROGRESSIVE_PASSES 3
+
+/**
+ * Takes the preview of a pass as soon as it has been read back.
+ *
+ * @param context The context given to progressive_render.
+ * @param pass The number of the pass, from 0.
+ * @param step The distance of the calculated pixels of the preview.
+ * @param image The preview, valid until the function returns.
+ * @param elapsed_ms The time since the frame was started.
+ */
+typedef void (*progressive_sink_t)(void * context, const int pass,
+		const int step, const unsigned char * image, const double elapsed_ms);
+
+typedef struct progressive_job {
+	float x_min;
+	float x_max;
+	float y_min;
+	float y_max;
+	long x_mon;
+	long y_mon;
+	float abort_value;
+	long itr;
+	int export_values;
+
+	cl_command_queue commands;
+	cl_kernel kernel;
+	cl_mem d_image;
+	cl_mem d_image_pixel;
+	cl_mem d_saved_iterations;
+} progressive_job_t;
+
+typedef struct progressive_stats {
+	long frames;
+	double first_preview_ms;
+	double last_preview_ms;
+} progressive_stats_t;
+
+void progressive_stats_init(progressive_stats_t * stats);
+cl_int progressive_render(const progressive_job_t * job,
+		unsigned char * preview, progressive_sink_t sink, void * context,
+		progressive_stats_t * stats, cl_event * computed);
+void progressive_print_stats(const progressive_stats_t * stats);
+
+#endif /* PROGRESSIVE_H_ */
@@ -0,0 +1,2169 @@
+/*
+ * renderer.c
+ *
+ *      Author: Felix Paetow
+ */
+
+#include "renderer.h"
+
+//slots of the frame buffers in the buffer pool, one pixel buffer per frame
+//in flight
+#define SLOT_IMAGE 0
+#define SLOT_IMAGE_PIXEL 1
+#define SLOT_SAVED_ITERATIONS (SLOT_IMAGE_PIXEL + FRAME_PIPELINE_MAX_DEPTH)
+#define SLOT_POINTS (SLOT_SAVED_ITERATIONS + FRAME_PIPELINE_MAX_DEPTH)
+#define SLOT_POINT_VALUES (SLOT_POINTS + 1)
+#define SLOT_BRUTE_FORCE (SLOT_POINT_VALUES + 1)
+#define SLOT_ORBIT (SLOT_BRUTE_FORCE + 1)
+#define SLOT_STRIP (SLOT_ORBIT + 1)
+#define SLOT_INNER (SLOT_STRIP + 1)
+#define SLOT_STRIP_SAVED (SLOT_INNER + 1)
+#define SLOT_STRIP_ITERATIONS (SLOT_STRIP_SAVED + 1)
+#define SLOT_TILE_COUNTER (SLOT_STRIP_ITERATIONS + 1)
+#define SLOT_GROUP_WORK (SLOT_TILE_COUNTER + 1)
+#define SLOT_YUV (SLOT_GROUP_WORK + 1)
+#define SLOT_FRACTIONS (SLOT_YUV + FRAME_PIPELINE_MAX_DEPTH)
+#define SLOT_PREVIEW (SLOT_FRACTIONS + 1)
+#define SLOT_CACHED_VALUES (SLOT_PREVIEW + 1)
+#define SLOT_BRUTE_FORCE_SAVED (SLOT_CACHED_VALUES + FRAME_PIPELINE_MAX_DEPTH)
+#define SLOT_INNER_PIXEL (SLOT_BRUTE_FORCE_SAVED + 1)
+
+//plane section of a frame and where its points are calculated, for the
+//subdivision
+typedef struct renderer_points {
+	float x_min;
+	float x_max;
+	float y_min;
+	float y_max;
+	long x_mon;
+	long y_mon;
+	float abort_value;
+	long itr;
+	unsigned long saved_iterations;
+
+	cpu_backend_t * cpu;
+
+	cl_command_queue commands;
+	cl_kernel kernel;
+	cl_mem d_points;
+	cl_mem d_values;
+	cl_mem d_saved_iterations;
+} renderer_points_t;
+
+//iteration values of a frame in flight, stored in the iteration cache once
+//they have been read back
+typedef struct cached_frame {
+	int store;
+	char key[ITERATION_CACHE_KEY_LENGTH];
+	void * values;
+	int value_bits;
+	long count;
+	cl_event read;
+} cached_frame_t;
+
+//a frame while its commands are enqueued: its kernels and buffers
+typedef struct frame_job {
+	renderer_frame_t * frame;
+	frame_slot_t * slot;
+	kernel_program_t * kernels;
+	size_t global[2];
+
+	//the plane section rounded to float, for the float kernels
+	float x_min;
+	float x_max;
+	float y_min;
+	float y_max;
+
+	//1 if the kernels keep the iteration values in d_image
+	int store_values;
+	int value_bits;
+
+	cl_mem d_image;
+	cl_mem d_image_pixel;
+	cl_mem d_saved_iterations;
+	cl_mem d_fractions;
+	long * h_image;
+} frame_job_t;
+
+struct renderer {
+	renderer_options_t options;
+
+	//the backends other than one OpenCL device, set up for their option
+	cpu_backend_t cpu;
+	int cpu_ready;
+	multi_device_t md;
+	int md_ready;
+
+	cl_device_id device_id;
+	cl_context context;
+	cl_command_queue commands;
+	cl_command_queue transfers;
+	char * source;
+	const char * build_options;
+	int has_double;
+	program_cache_t program_cache;
+	kernel_variants_t variants;
+	int variants_ready;
+
+	//frame buffers, allocated once per resolution
+	buffer_pool_t pool;
+	int pool_ready;
+
+	//the trace of the options or a disabled one
+	trace_t * trace;
+	trace_t no_trace;
+
+	//state of the modes, kept from frame to frame
+	coloring_t colorer;
+	subdivision_t subdivision;
+	int subdivision_ready;
+	long differences;
+	tile_scheduler_t scheduler;
+	cl_mem d_tile_counter;
+	cl_mem d_group_work;
+	iteration_cache_t iteration_cache;
+	cached_frame_t cached_frames[FRAME_PIPELINE_MAX_DEPTH];
+	int tier_notice;
+
+	//1 for the frames in flight whose precision tier is counted
+	int tiered[FRAME_PIPELINE_MAX_DEPTH];
+	precision_stats_t precision_stats;
+	progressive_stats_t progressive_stats;
+
+	//render calls are served one at a time
+	pthread_mutex_t lock;
+
+	long frames;
+	double render_ms;
+};
+
+/**
+ * Returns the time of a monotonic clock.
+ *
+ * @return The time in milliseconds.
+ */
+static double renderer_now_ms(void) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec * 1000.0 + now.tv_nsec / 1000000.0;
+}
+
+/**
+ * Calculates the iteration values of a list of points with the CPU backend.
+ *
+ * @param context The renderer_points_t of the frame.
+ * @param points The positions y * x_mon + x of the points.
+ * @param count The number of points.
+ * @param values The iteration values, in the order of the points.
+ * @return CL_SUCCESS.
+ */
+static cl_int renderer_evaluate_points_cpu(void * context,
+		const cl_int * points, const long count, long * values) {
+	renderer_points_t * job = (renderer_points_t *) context;
+
+	cpu_backend_render_points(job->cpu, job->x_min, job->x_max, job->y_min,
+			job->y_max, job->x_mon, job->y_mon, job->abort_value, job->itr,
+			points, count, values);
+	job->saved_iterations += (unsigned long) job->cpu->saved_iterations;
+
+	return CL_SUCCESS;
+}
+
+/**
+ * Calculates the iteration values of a list of points with the kernel
+ * calculate_points_iterations and waits for them.
+ *
+ * @param context The renderer_points_t of the frame.
+ * @param points The positions y * x_mon + x of the points.
+ * @param count The number of points.
+ * @param values The iteration values, in the order of the points.
+ * @return CL_SUCCESS or the error code of the failed OpenCL call.
+ */
+static cl_int renderer_evaluate_points(void * context, const cl_int * points,
+		const long count, long * values) {
+	renderer_points_t * job = (renderer_points_t *) context;
+	size_t global = (size_t) count;
+	cl_int err;
+
+	err = clEnqueueWriteBuffer(job->commands, job->d_points, CL_FALSE, 0,
+			sizeof(cl_int) * count, points, 0, NULL, NULL);
+
+	err |= clSetKernelArg(job->kernel, 0, sizeof(float), &job->x_min);
+	err |= clSetKernelArg(job->kernel, 1, sizeof(float), &job->x_max);
+	err |= clSetKernelArg(job->kernel, 2, sizeof(float), &job->y_min);
+	err |= clSetKernelArg(job->kernel, 3, sizeof(float), &job->y_max);
+	err |= clSetKernelArg(job->kernel, 4, sizeof(long), &job->x_mon);
+	err |= clSetKernelArg(job->kernel, 5, sizeof(long), &job->y_mon);
+	err |= clSetKernelArg(job->kernel, 6, sizeof(float), &job->abort_value);
+	err |= clSetKernelArg(job->kernel, 7, sizeof(long), &job->itr);
+	err |= clSetKernelArg(job->kernel, 8, sizeof(cl_mem), &job->d_points);
+	err |= clSetKernelArg(job->kernel, 9, sizeof(cl_mem), &job->d_values);
+	err |= clSetKernelArg(job->kernel, 10, sizeof(cl_mem),
+			&job->d_saved_iterations);
+	if (err != CL_SUCCESS) {
+		return err;
+	}
+
+	/*__kernel void calculate_points_iterations(const float x_min,
+	 const float x_max, const float y_min, const float y_max,
+	 const long x_mon, const long y_mon, const float abort_value,
+	 const long itr, __global const int * points, __global long * values,
+	 __global ulong * saved_iterations)*/
+
+	err = clEnqueueNDRangeKernel(job->commands, job->kernel, 1, NULL, &global,
+			NULL, 0, NULL, NULL);
+	if (err != CL_SUCCESS) {
+		return err;
+	}
+
+	return clEnqueueReadBuffer(job->commands, job->d_values, CL_TRUE, 0,
+			sizeof(long) * count, values, 0, NULL, NULL);
+}
+
+/**
+ * Stores the iteration values of a finished frame in the iteration cache, if
+ * they were read back for it.
+ *
+ * @param cache The iteration cache.
+ * @param frame The values of the frame.
+ */
+static void renderer_store_values(iteration_cache_t * cache,
+		cached_frame_t * frame) {
+	if (!frame->store) {
+		return;
+	}
+
+	if (clWaitForEvents(1, &frame->read) == CL_SUCCESS) {
+		iteration_cache_store(cache, frame->key, frame->values,
+				frame->value_bits, frame->count);
+	}
+	clReleaseEvent(frame->read);
+	frame->store = 0;
+}
+
+/**
+ * Makes the subdivision fit the resolution of a frame. The statistics of
+ * the earlier frames are kept.
+ *
+ * @param renderer The renderer.
+ * @param x_mon Resolution of the monitor on the horizontal axis.
+ * @param y_mon Resolution of the monitor on the vertical axis.
+ * @return CL_SUCCESS or CL_OUT_OF_HOST_MEMORY.
+ */
+static cl_int renderer_reserve_subdivision(renderer_t * renderer,
+		const long x_mon, const long y_mon) {
+	subdivision_t * subdivision = &renderer->subdivision;
+	long evaluated = subdivision->total_evaluated;
+	long filled = subdivision->total_filled;
+
+	if (renderer->subdivision_ready && subdivision->x_mon == x_mon
+			&& subdivision->y_mon == y_mon) {
+		return CL_SUCCESS;
+	}
+
+	if (renderer->subdivision_ready) {
+		subdivision_release(subdivision);
+		renderer->subdivision_ready = 0;
+	}
+	if (subdivision_init(subdivision, x_mon, y_mon) != 0) {
+		return CL_OUT_OF_HOST_MEMORY;
+	}
+	subdivision->total_evaluated = evaluated;
+	subdivision->total_filled = filled;
+	renderer->subdivision_ready = 1;
+
+	return CL_SUCCESS;
+}
+
+/**
+ * Secures a device of a type from the first platform that has one.
+ *
+ * @param device_type The type of the device, like CL_DEVICE_TYPE_GPU.
+ * @param err Set to CL_SUCCESS or the error code of the last OpenCL call.
+ * @return The device or NULL if there is no platform or device.
+ */
+cl_device_id renderer_find_device(const cl_device_type device_type,
+		cl_int * err) {
+	cl_uint numPlatforms = 0;
+	cl_device_id device_id = NULL;
+
+	// Find number of platforms
+	*err = clGetPlatformIDs(0, NULL, &numPlatforms);
+	if (*err != CL_SUCCESS || numPlatforms == 0) {
+		if (*err == CL_SUCCESS) {
+			*err = CL_DEVICE_NOT_FOUND;
+		}
+		return NULL;
+	}
+
+	// Get all platforms
+	cl_platform_id Platform[numPlatforms];
+	*err = clGetPlatformIDs(numPlatforms, Platform, NULL);
+	if (*err != CL_SUCCESS) {
+		return NULL;
+	}
+
+	// Secure a GPU
+	for (cl_uint i = 0; i < numPlatforms; i++) {
+		*err = clGetDeviceIDs(Platform[i], device_type, 1, &device_id, NULL);
+		if (*err == CL_SUCCESS) {
+			return device_id;
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * Sets the options of a renderer to the defaults of the video program.
+ *
+ * @param options The options.
+ */
+void renderer_options_init(renderer_options_t * options) {
+	options->backend = RENDERER_BACKEND_OPENCL;
+	options->sub_devices = MULTI_DEVICE_SPLIT_NONE;
+	options->device_id = NULL;
+	options->device_type = CL_DEVICE_TYPE_DEFAULT;
+	options->abort_value = 2;
+	options->unroll = 4;
+	options->magnitude_squared = 0;
+	options->interior_check = 1;
+	options->precision = PRECISION_AUTO;
+	options->use_program_cache = 1;
+	options->program_cache_dir = NULL;
+	options->fused_kernel = 1;
+	options->subdivide = 0;
+	options->brute_force = 0;
+	options->persistent = 0;
+	options->progressive = 0;
+	options->coloring = COLORING_LINEAR;
+	options->iteration_cache_dir = NULL;
+	options->iteration_cache_bytes = 0;
+	options->trace = NULL;
+}
+
+/**
+ * Sets up the CPU backend or the devices of the multi-device renderer. Both
+ * only use the host buffers of the pool.
+ *
+ * @param renderer The renderer.
+ * @return CL_SUCCESS or the error code of the failed call.
+ */
+static cl_int renderer_create_backend(renderer_t * renderer) {
+	renderer_options_t * options = &renderer->options;
+
+	// The modes of the single device renderer fall back to plain frames
+	options->persistent = 0;
+	options->progressive = 0;
+	options->coloring = COLORING_LINEAR;
+	options->iteration_cache_dir = NULL;
+
+	buffer_pool_init(&renderer->pool, NULL);
+	renderer->pool_ready = 1;
+
+	if (options->backend == RENDERER_BACKEND_CPU) {
+		if (cpu_backend_init(&renderer->cpu, 0, options->interior_check)
+				!= 0) {
+			return CL_OUT_OF_HOST_MEMORY;
+		}
+		renderer->cpu_ready = 1;
+
+		return CL_SUCCESS;
+	}
+
+	//Get the kernel source embedded at build time
+	renderer->source = kernel_source_load();
+	if (renderer->source == NULL) {
+		return CL_OUT_OF_HOST_MEMORY;
+	}
+	if (options->use_program_cache) {
+		program_cache_init(&renderer->program_cache,
+				options->program_cache_dir);
+	}
+
+	// The devices set up before a failure are released with the renderer
+	renderer->md_ready = 1;
+	return multi_device_init(&renderer->md, options->sub_devices,
+			options->use_program_cache ? &renderer->program_cache : NULL,
+			renderer->source);
+}
+
+/**
+ * Creates a renderer: finds the device, creates its context and command
+ * queues and prepares the kernel variants and the state of the modes of
+ * the options, so that every later frame only pays for its kernels.
+ * Variants are built the first time a frame needs them, or loaded from the
+ * program cache. The CPU backend starts its threads instead, the
+ * multi-device renderer sets up all devices.
+ *
+ * @param options The options.
+ * @param err Set to CL_SUCCESS or the error code of the failed OpenCL call.
+ * @return The renderer or NULL on error.
+ */
+renderer_t * renderer_create(const renderer_options_t * options,
+		cl_int * err) {
+	renderer_t * renderer = (renderer_t *) calloc(1, sizeof(renderer_t));
+	if (renderer == NULL) {
+		*err = CL_OUT_OF_HOST_MEMORY;
+		return NULL;
+	}
+	renderer->options = *options;
+	renderer->build_options = "";
+	renderer->trace = (options->trace != NULL) ?
+			options->trace : &renderer->no_trace;
+	pthread_mutex_init(&renderer->lock, NULL);
+	precision_stats_init(&renderer->precision_stats);
+	progressive_stats_init(&renderer->progressive_stats);
+
+	if (options->backend != RENDERER_BACKEND_OPENCL) {
+		*err = renderer_create_backend(renderer);
+		if (*err != CL_SUCCESS) {
+			renderer_release(renderer);
+			return NULL;
+		}
+
+		return renderer;
+	}
+
+	renderer->device_id = options->device_id;
+	if (renderer->device_id == NULL) {
+		renderer->device_id = renderer_find_device(options->device_type,
+				err);
+		if (renderer->device_id == NULL) {
+			renderer_release(renderer);
+			return NULL;
+		}
+	}
+
+	// Create a compute context
+	renderer->context = clCreateContext(0, 1, &renderer->device_id, NULL,
+			NULL, err);
+	if (*err != CL_SUCCESS) {
+		renderer->context = NULL;
+		renderer_release(renderer);
+		return NULL;
+	}
+
+	// Create a command queue, which profiles the kernels so the cost of the
+	// precision tiers can be logged
+	renderer->commands = clCreateCommandQueue(renderer->context,
+			renderer->device_id, CL_QUEUE_PROFILING_ENABLE, err);
+	if (*err != CL_SUCCESS) {
+		renderer->commands = NULL;
+		renderer_release(renderer);
+		return NULL;
+	}
+
+	// Create a second command queue, so frames can be read back while the
+	// next ones are computed. It only profiles the read backs for the trace.
+	renderer->transfers = clCreateCommandQueue(renderer->context,
+			renderer->device_id,
+			renderer->trace->enabled ? CL_QUEUE_PROFILING_ENABLE : 0, err);
+	if (*err != CL_SUCCESS) {
+		renderer->transfers = NULL;
+		renderer_release(renderer);
+		return NULL;
+	}
+
+	//Get the kernel source embedded at build time
+	renderer->source = kernel_source_load();
+	if (renderer->source == NULL) {
+		*err = CL_OUT_OF_HOST_MEMORY;
+		renderer_release(renderer);
+		return NULL;
+	}
+
+	// Divisions and square roots have to be correctly rounded to get the
+	// same values as the CPU backend. Devices that can't do that are used
+	// anyway, without that promise.
+	cl_device_fp_config fp_config = 0;
+	*err = clGetDeviceInfo(renderer->device_id, CL_DEVICE_SINGLE_FP_CONFIG,
+			sizeof(fp_config), &fp_config, NULL);
+	if (*err != CL_SUCCESS) {
+		renderer_release(renderer);
+		return NULL;
+	}
+	if (fp_config & CL_FP_CORRECTLY_ROUNDED_DIVIDE_SQRT) {
+		renderer->build_options = "-cl-fp32-correctly-rounded-divide-sqrt";
+	} else {
+		printf("The device doesn't round divisions and square roots "
+				"correctly, its frames may differ in the last bit from "
+				"those of the CPU backend\n");
+	}
+
+	// Without double the precise frames are calculated with df64
+	renderer->has_double = precision_device_has_double(renderer->device_id);
+
+	// Each kernel variant is built the first time a frame needs it
+	if (options->use_program_cache) {
+		program_cache_init(&renderer->program_cache,
+				options->program_cache_dir);
+	}
+	kernel_variants_init(&renderer->variants,
+			options->use_program_cache ? &renderer->program_cache : NULL,
+			renderer->context, renderer->device_id, renderer->source,
+			renderer->build_options);
+	renderer->variants_ready = 1;
+
+	// The pool keeps the frame buffers of the previous frame, so they are
+	// only allocated once per resolution and reused for every frame.
+	buffer_pool_init(&renderer->pool, renderer->context);
+	renderer->pool_ready = 1;
+
+	// The histogram, its lookup table and the palette stay on the device
+	// for all frames
+	*err = coloring_init(&renderer->colorer, options->coloring,
+			renderer->context, renderer->device_id);
+	if (*err != CL_SUCCESS) {
+		renderer_release(renderer);
+		return NULL;
+	}
+
+	// The persistent kernel keeps its tile counter and the work of its
+	// groups for all frames
+	if (options->persistent) {
+		tile_scheduler_t * scheduler = &renderer->scheduler;
+		cl_ulong zero = 0;
+
+		*err = tile_scheduler_init(scheduler, renderer->device_id);
+		if (*err == CL_SUCCESS) {
+			renderer->d_tile_counter = buffer_pool_device_buffer(
+					&renderer->pool, SLOT_TILE_COUNTER, CL_MEM_READ_WRITE,
+					sizeof(cl_int), err);
+		}
+		if (*err == CL_SUCCESS) {
+			renderer->d_group_work = buffer_pool_device_buffer(
+					&renderer->pool, SLOT_GROUP_WORK, CL_MEM_READ_WRITE,
+					sizeof(cl_ulong) * TILE_SCHEDULER_GROUP_COUNTERS
+							* scheduler->groups, err);
+		}
+		if (*err == CL_SUCCESS) {
+			*err = clEnqueueFillBuffer(renderer->commands,
+					renderer->d_group_work, &zero, sizeof(zero), 0,
+					sizeof(cl_ulong) * TILE_SCHEDULER_GROUP_COUNTERS
+							* scheduler->groups, 0, NULL, NULL);
+		}
+		if (*err != CL_SUCCESS) {
+			renderer_release(renderer);
+			return NULL;
+		}
+	}
+
+	if (options->iteration_cache_dir != NULL) {
+		iteration_cache_init(&renderer->iteration_cache,
+				options->iteration_cache_dir, options->iteration_cache_bytes);
+		if (!renderer->iteration_cache.enabled) {
+			printf("Failed to create the iteration cache %s, rendering "
+					"every frame\n", options->iteration_cache_dir);
+		}
+	}
+
+	return renderer;
+}
+
+/**
+ * Enqueues the reference orbit of a deep zoom and the perturbation kernel,
+ * which calculates the deltas to it.
+ *
+ * @param renderer The renderer.
+ * @param job The frame.
+ * @return CL_SUCCESS or the error code of the failed call.
+ */
+static cl_int renderer_enqueue_perturbation(renderer_t * renderer,
+		frame_job_t * job) {
+	renderer_frame_t * frame = job->frame;
+	perturbation_t * perturbation = frame->perturbation;
+	float abort_value = renderer->options.abort_value;
+	float spacing;
+	int spacing_exponent;
+	cl_int err;
+
+	if (perturbation_reference_orbit(perturbation, frame->itr, abort_value)
+			!= 0) {
+		return CL_OUT_OF_HOST_MEMORY;
+	}
+	perturbation_spacing(perturbation, &spacing, &spacing_exponent);
+
+	cl_mem d_orbit = buffer_pool_device_buffer(&renderer->pool, SLOT_ORBIT,
+			CL_MEM_READ_ONLY,
+			sizeof(my_complex_t) * perturbation->orbit_capacity, &err);
+	if (err != CL_SUCCESS) {
+		return err;
+	}
+
+	// The orbit is extended for the next frame, so it is copied before the
+	// call returns
+	err = clEnqueueWriteBuffer(renderer->commands, d_orbit, CL_TRUE, 0,
+			sizeof(my_complex_t) * perturbation->orbit_length,
+			perturbation->orbit, 0, NULL, NULL);
+	if (err != CL_SUCCESS) {
+		return err;
+	}
+
+	cl_kernel kernel = job->kernels->ko_calculate_image_perturbation;
+
+	err = clSetKernelArg(kernel, 0, sizeof(long), &frame->x_mon);
+	err |= clSetKernelArg(kernel, 1, sizeof(long), &frame->y_mon);
+	err |= clSetKernelArg(kernel, 2, sizeof(float), &spacing);
+	err |= clSetKernelArg(kernel, 3, sizeof(int), &spacing_exponent);
+	err |= clSetKernelArg(kernel, 4, sizeof(float), &abort_value);
+	err |= clSetKernelArg(kernel, 5, sizeof(long), &frame->itr);
+	err |= clSetKernelArg(kernel, 6, sizeof(cl_mem), &d_orbit);
+	err |= clSetKernelArg(kernel, 7, sizeof(long),
+			&perturbation->orbit_length);
+	err |= clSetKernelArg(kernel, 8, sizeof(int), &job->store_values);
+	err |= clSetKernelArg(kernel, 9, sizeof(cl_mem), &job->d_image);
+	err |= clSetKernelArg(kernel, 10, sizeof(cl_mem), &job->d_image_pixel);
+	err |= clSetKernelArg(kernel, 11, sizeof(cl_mem),
+			&job->d_saved_iterations);
+	if (err != CL_SUCCESS) {
+		return err;
+	}
+
+	/*__kernel void calculate_image_perturbation(const long x_mon,
+	 const long y_mon, const float spacing, const int spacing_exponent,
+	 const float abort_value, const long itr,
+	 __global const my_complex_t * orbit, const long orbit_length,
+	 const int export_values, __global VALUE_T * imagevalues,
+	 __global unsigned char * image, __global ulong * rebases)*/
+
+	return clEnqueueNDRangeKernel(renderer->commands, kernel, 2, NULL,
+			job->global, NULL, 0, NULL, &job->slot->computed);
+}
+
+/**
+ * Enqueues the kernel that takes a frame from the exponential map.
+ *
+ * @param renderer The renderer.
+ * @param job The frame.
+ * @param value_bits The width of the values of the inner frame.
+ * @return CL_SUCCESS or the error code of the failed OpenCL call.
+ */
+static cl_int renderer_enqueue_from_map(renderer_t * renderer,
+		frame_job_t * job, const int value_bits) {
+	renderer_frame_t * frame = job->frame;
+	const exp_map_t * map = frame->map;
+	exp_map_frame_t map_frame;
+	cl_int err;
+
+	exp_map_frame(map, frame->number, &map_frame);
+
+	cl_mem d_strip = buffer_pool_device_buffer(&renderer->pool, SLOT_STRIP,
+			CL_MEM_READ_WRITE, sizeof(long) * map->columns * map->rows,
+			&err);
+	if (err != CL_SUCCESS) {
+		return err;
+	}
+	cl_mem d_inner = buffer_pool_device_buffer(&renderer->pool, SLOT_INNER,
+			CL_MEM_READ_WRITE, iteration_values_size(value_bits)
+					* frame->x_mon * frame->y_mon, &err);
+	if (err != CL_SUCCESS) {
+		return err;
+	}
+
+	cl_kernel kernel = job->kernels->ko_calculate_image_from_strip;
+	float rho_min = (float) map->rho_min;
+	float delta_rho = (float) map->delta_rho;
+
+	err = clSetKernelArg(kernel, 0, sizeof(float), &map_frame.offset_real);
+	err |= clSetKernelArg(kernel, 1, sizeof(float),
+			&map_frame.offset_imaginary);
+	err |= clSetKernelArg(kernel, 2, sizeof(float), &map_frame.delta_x);
+	err |= clSetKernelArg(kernel, 3, sizeof(float), &map_frame.delta_y);
+	err |= clSetKernelArg(kernel, 4, sizeof(float), &map_frame.inner_x);
+	err |= clSetKernelArg(kernel, 5, sizeof(float), &map_frame.inner_y);
+	err |= clSetKernelArg(kernel, 6, sizeof(float),
+			&map_frame.inner_delta_x);
+	err |= clSetKernelArg(kernel, 7, sizeof(float),
+			&map_frame.inner_delta_y);
+	err |= clSetKernelArg(kernel, 8, sizeof(float), &rho_min);
+	err |= clSetKernelArg(kernel, 9, sizeof(float), &delta_rho);
+	err |= clSetKernelArg(kernel, 10, sizeof(long), &map->columns);
+	err |= clSetKernelArg(kernel, 11, sizeof(long), &map->rows);
+	err |= clSetKernelArg(kernel, 12, sizeof(long), &frame->x_mon);
+	err |= clSetKernelArg(kernel, 13, sizeof(long), &frame->y_mon);
+	err |= clSetKernelArg(kernel, 14, sizeof(long), &frame->itr);
+	err |= clSetKernelArg(kernel, 15, sizeof(cl_mem), &d_strip);
+	err |= clSetKernelArg(kernel, 16, sizeof(cl_mem), &d_inner);
+	err |= clSetKernelArg(kernel, 17, sizeof(cl_mem), &job->d_image_pixel);
+	if (err != CL_SUCCESS) {
+		return err;
+	}
+
+	/*__kernel void calculate_image_from_strip(const float offset_real,
+	 const float offset_imaginary, const float delta_x,
+	 const float delta_y, const float inner_x, const float inner_y,
+	 const float inner_delta_x, const float inner_delta_y,
+	 const float rho_min, const float delta_rho, const long columns,
+	 const long rows, const long x_mon, const long y_mon,
+	 const long itr, __global const long * strip,
+	 __global const VALUE_T * inner, __global unsigned char * image)*/
+
+	return clEnqueueNDRangeKernel(renderer->commands, kernel, 2, NULL,
+			job->global, NULL, 0, NULL, &job->slot->computed);
+}
+
+/**
+ * Enqueues the kernel that calculates iterations and colors in df64 or
+ * double.
+ *
+ * @param renderer The renderer.
+ * @param job The frame.
+ * @param tier PRECISION_DF64 or PRECISION_DOUBLE.
+ * @return CL_SUCCESS or the error code of the failed OpenCL call.
+ */
+static cl_int renderer_enqueue_precise(renderer_t * renderer,
+		frame_job_t * job, const int tier) {
+	renderer_frame_t * frame = job->frame;
+	cl_kernel kernel = job->kernels->ko_calculate_image_pixels_precise;
+	cl_int err;
+
+	// The spacing of the pixels only needs float
+	float delta_x = (float) ((frame->x_max - frame->x_min)
+			/ (double) (frame->x_mon - 1));
+	float delta_y = (float) ((frame->y_max - frame->y_min)
+			/ (double) (frame->y_mon - 1));
+
+	err = precision_set_coordinate(kernel, 0, frame->x_min, tier);
+	err |= precision_set_coordinate(kernel, 1, frame->y_max, tier);
+	err |= clSetKernelArg(kernel, 2, sizeof(float), &delta_x);
+	err |= clSetKernelArg(kernel, 3, sizeof(float), &delta_y);
+	err |= clSetKernelArg(kernel, 4, sizeof(long), &frame->x_mon);
+	err |= clSetKernelArg(kernel, 5, sizeof(float),
+			&renderer->options.abort_value);
+	err |= clSetKernelArg(kernel, 6, sizeof(long), &frame->itr);
+	err |= clSetKernelArg(kernel, 7, sizeof(int), &job->store_values);
+	err |= clSetKernelArg(kernel, 8, sizeof(cl_mem), &job->d_image);
+	err |= clSetKernelArg(kernel, 9, sizeof(cl_mem), &job->d_image_pixel);
+	err |= clSetKernelArg(kernel, 10, sizeof(cl_mem),
+			&job->d_saved_iterations);
+	if (err != CL_SUCCESS) {
+		return err;
+	}
+
+	/*__kernel void calculate_image_pixels_precise(const precise_t x_min,
+	 const precise_t y_max, const float delta_x, const float delta_y,
+	 const long x_mon, const float abort_value, const long itr,
+	 const int export_values, __global VALUE_T * imagevalues,
+	 __global unsigned char * image, __global ulong * saved_iterations)*/
+
+	return clEnqueueNDRangeKernel(renderer->commands, kernel, 2, NULL,
+			job->global, NULL, 0, NULL, &job->slot->computed);
+}
+
+/**
+ * Sets the arguments of the kernel calculate_image_iterations, which all
+ * float frames calculated point by point share.
+ *
+ * @param renderer The renderer.
+ * @param job The frame.
+ * @param d_values The iteration values.
+ * @param d_saved_iterations The counter of the saved iterations.
+ * @return CL_SUCCESS or the error code of the failed OpenCL call.
+ */
+static cl_int renderer_set_iterations_args(renderer_t * renderer,
+		frame_job_t * job, cl_mem d_values, cl_mem d_saved_iterations) {
+	cl_kernel kernel = job->kernels->ko_calculate_image_iterations;
+	cl_int err;
+
+	err = clSetKernelArg(kernel, 0, sizeof(float), &job->x_min);
+	err |= clSetKernelArg(kernel, 1, sizeof(float), &job->x_max);
+	err |= clSetKernelArg(kernel, 2, sizeof(float), &job->y_min);
+	err |= clSetKernelArg(kernel, 3, sizeof(float), &job->y_max);
+	err |= clSetKernelArg(kernel, 4, sizeof(long), &job->frame->x_mon);
+	err |= clSetKernelArg(kernel, 5, sizeof(long), &job->frame->y_mon);
+	err |= clSetKernelArg(kernel, 6, sizeof(float),
+			&renderer->options.abort_value);
+	err |= clSetKernelArg(kernel, 7, sizeof(long), &job->frame->itr);
+	err |= clSetKernelArg(kernel, 8, sizeof(cl_mem), &d_values);
+	err |= clSetKernelArg(kernel, 9, sizeof(cl_mem), &d_saved_iterations);
+
+	/*__kernel void calculate_image_iterations(const float x_min, const float x_max,
+	 const float y_min, const float y_max, const long x_mon, const long y_mon,
+	 const float abort_value, const long itr, __global VALUE_T * image,
+	 __global ulong * saved_iterations)*/
+
+	return err;
+}
+
+/**
+ * Calculates the iterations of the rectangle borders of the subdivision and
+ * writes the iteration values to the device. With brute force every point
+ * is calculated as well and compared with them.
+ *
+ * @param renderer The renderer.
+ * @param job The frame.
+ * @return CL_SUCCESS or the error code of the failed call.
+ */
+static cl_int renderer_enqueue_subdivided(renderer_t * renderer,
+		frame_job_t * job) {
+	renderer_frame_t * frame = job->frame;
+	buffer_pool_t * pool = &renderer->pool;
+	const long pixels = frame->x_mon * frame->y_mon;
+	renderer_points_t points;
+	cl_int err;
+
+	err = renderer_reserve_subdivision(renderer, frame->x_mon, frame->y_mon);
+	if (err != CL_SUCCESS) {
+		return err;
+	}
+
+	points.x_min = job->x_min;
+	points.x_max = job->x_max;
+	points.y_min = job->y_min;
+	points.y_max = job->y_max;
+	points.x_mon = frame->x_mon;
+	points.y_mon = frame->y_mon;
+	points.abort_value = renderer->options.abort_value;
+	points.itr = frame->itr;
+	points.commands = renderer->commands;
+	points.kernel = job->kernels->ko_calculate_points_iterations;
+	points.d_saved_iterations = job->d_saved_iterations;
+
+	points.d_points = buffer_pool_device_buffer(pool, SLOT_POINTS,
+			CL_MEM_READ_ONLY, sizeof(cl_int) * pixels, &err);
+	if (err != CL_SUCCESS) {
+		return err;
+	}
+	points.d_values = buffer_pool_device_buffer(pool, SLOT_POINT_VALUES,
+			CL_MEM_WRITE_ONLY, sizeof(long) * pixels, &err);
+	if (err != CL_SUCCESS) {
+		return err;
+	}
+
+	err = subdivision_render(&renderer->subdivision, job->h_image,
+			renderer_evaluate_points, &points);
+	if (err != CL_SUCCESS) {
+		return err;
+	}
+
+	if (renderer->options.brute_force) {
+		size_t brute_force_size = iteration_values_size(job->value_bits)
+				* pixels;
+		cl_mem d_brute_force = buffer_pool_device_buffer(pool,
+				SLOT_BRUTE_FORCE, CL_MEM_WRITE_ONLY, brute_force_size, &err);
+		if (err != CL_SUCCESS) {
+			return err;
+		}
+
+		// The comparison counts into a scratch counter, the frame's counter
+		// only holds the saved iterations of the subdivision
+		cl_mem d_brute_force_saved = buffer_pool_device_buffer(pool,
+				SLOT_BRUTE_FORCE_SAVED, CL_MEM_READ_WRITE, sizeof(cl_ulong),
+				&err);
+		if (err != CL_SUCCESS) {
+			return err;
+		}
+
+		void* h_brute_force = buffer_pool_host_buffer(pool, SLOT_BRUTE_FORCE,
+				brute_force_size);
+		if (h_brute_force == NULL) {
+			return CL_OUT_OF_HOST_MEMORY;
+		}
+
+		err = renderer_set_iterations_args(renderer, job, d_brute_force,
+				d_brute_force_saved);
+		if (err == CL_SUCCESS) {
+			err = clEnqueueNDRangeKernel(renderer->commands,
+					job->kernels->ko_calculate_image_iterations, 2, NULL,
+					job->global, NULL, 0, NULL, NULL);
+		}
+		if (err == CL_SUCCESS) {
+			err = clEnqueueReadBuffer(renderer->commands, d_brute_force,
+					CL_TRUE, 0, brute_force_size, h_brute_force, 0, NULL,
+					NULL);
+		}
+		if (err != CL_SUCCESS) {
+			return err;
+		}
+
+		renderer->differences += subdivision_compare_brute_force(
+				frame->number, job->h_image, h_brute_force, job->value_bits,
+				pixels);
+	}
+
+	// The color kernel works on the iteration values on the device,
+	// narrowed to the width it reads
+	iteration_values_pack(job->h_image, job->value_bits, pixels);
+	return clEnqueueWriteBuffer(renderer->commands, job->d_image, CL_TRUE, 0,
+			iteration_values_size(job->value_bits) * pixels, job->h_image, 0,
+			NULL, NULL);
+}
+
+/**
+ * Enqueues the persistent kernel, whose work-groups calculate iterations
+ * and colors of the tiles they take from the tile counter.
+ *
+ * @param renderer The renderer.
+ * @param job The frame.
+ * @return CL_SUCCESS or the error code of the failed OpenCL call.
+ */
+static cl_int renderer_enqueue_persistent(renderer_t * renderer,
+		frame_job_t * job) {
+	renderer_frame_t * frame = job->frame;
+	tile_scheduler_t * scheduler = &renderer->scheduler;
+	cl_kernel kernel = job->kernels->ko_calculate_image_pixels_persistent;
+	cl_int zero = 0;
+	cl_int err;
+
+	err = clEnqueueFillBuffer(renderer->commands, renderer->d_tile_counter,
+			&zero, sizeof(zero), 0, sizeof(zero), 0, NULL, NULL);
+	if (err != CL_SUCCESS) {
+		return err;
+	}
+
+	err = clSetKernelArg(kernel, 0, sizeof(float), &job->x_min);
+	err |= clSetKernelArg(kernel, 1, sizeof(float), &job->x_max);
+	err |= clSetKernelArg(kernel, 2, sizeof(float), &job->y_min);
+	err |= clSetKernelArg(kernel, 3, sizeof(float), &job->y_max);
+	err |= clSetKernelArg(kernel, 4, sizeof(long), &frame->x_mon);
+	err |= clSetKernelArg(kernel, 5, sizeof(long), &frame->y_mon);
+	err |= clSetKernelArg(kernel, 6, sizeof(float),
+			&renderer->options.abort_value);
+	err |= clSetKernelArg(kernel, 7, sizeof(long), &frame->itr);
+	err |= clSetKernelArg(kernel, 8, sizeof(int), &job->store_values);
+	err |= clSetKernelArg(kernel, 9, sizeof(cl_mem), &job->d_image);
+	err |= clSetKernelArg(kernel, 10, sizeof(cl_mem), &job->d_image_pixel);
+	err |= clSetKernelArg(kernel, 11, sizeof(cl_mem),
+			&job->d_saved_iterations);
+	err |= clSetKernelArg(kernel, 12, sizeof(cl_mem),
+			&renderer->d_tile_counter);
+	err |= clSetKernelArg(kernel, 13, sizeof(cl_mem),
+			&renderer->d_group_work);
+	if (err != CL_SUCCESS) {
+		return err;
+	}
+
+	/*__kernel void calculate_image_pixels_persistent(const float x_min,
+	 const float x_max, const float y_min, const float y_max,
+	 const long x_mon, const long y_mon, const float abort_value,
+	 const long itr, const int export_values,
+	 __global VALUE_T * imagevalues, __global unsigned char * image,
+	 __global ulong * saved_iterations, __global int * next_tile,
+	 __global ulong * group_work)*/
+
+	// Only as many work-items as the compute units run at once
+	err = clEnqueueNDRangeKernel(renderer->commands, kernel, 1, NULL,
+			&scheduler->global_size, &scheduler->local_size, 0, NULL,
+			&job->slot->computed);
+	if (err == CL_SUCCESS) {
+		job->slot->persistent = 1;
+	}
+
+	return err;
+}
+
+/**
+ * Calculates a frame coarse to fine. The previews are waited for and handed
+ * to the preview sink of the frame, the last pass is read back like any
+ * other frame.
+ *
+ * @param renderer The renderer.
+ * @param job The frame.
+ * @return CL_SUCCESS or the error code of the failed call.
+ */
+static cl_int renderer_enqueue_progressive(renderer_t * renderer,
+		frame_job_t * job) {
+	renderer_frame_t * frame = job->frame;
+	progressive_job_t pass_job = { job->x_min, job->x_max, job->y_min,
+			job->y_max, frame->x_mon, frame->y_mon,
+			renderer->options.abort_value, frame->itr, frame->export_values,
+			renderer->commands,
+			job->kernels->ko_calculate_image_pixels_progressive, job->d_image,
+			job->d_image_pixel, job->d_saved_iterations };
+
+	unsigned char * preview = (unsigned char *) buffer_pool_host_buffer(
+			&renderer->pool, SLOT_PREVIEW,
+			sizeof(unsigned char) * frame->x_mon * frame->y_mon * 3);
+	if (preview == NULL) {
+		return CL_OUT_OF_HOST_MEMORY;
+	}
+
+	return progressive_render(&pass_job, preview, frame->preview,
+			frame->preview_context, &renderer->progressive_stats,
+			&job->slot->computed);
+}
+
+/**
+ * Enqueues the kernel that calculates the iterations with their fractional
+ * part, for the palette coloring.
+ *
+ * @param renderer The renderer.
+ * @param job The frame.
+ * @return CL_SUCCESS or the error code of the failed OpenCL call.
+ */
+static cl_int renderer_enqueue_smooth(renderer_t * renderer,
+		frame_job_t * job) {
+	renderer_frame_t * frame = job->frame;
+	cl_kernel kernel = job->kernels->ko_calculate_image_smooth;
+	cl_int err;
+
+	job->d_fractions = buffer_pool_device_buffer(&renderer->pool,
+			SLOT_FRACTIONS, CL_MEM_READ_WRITE,
+			sizeof(cl_float) * frame->x_mon * frame->y_mon, &err);
+	if (err != CL_SUCCESS) {
+		return err;
+	}
+
+	err = clSetKernelArg(kernel, 0, sizeof(float), &job->x_min);
+	err |= clSetKernelArg(kernel, 1, sizeof(float), &job->x_max);
+	err |= clSetKernelArg(kernel, 2, sizeof(float), &job->y_min);
+	err |= clSetKernelArg(kernel, 3, sizeof(float), &job->y_max);
+	err |= clSetKernelArg(kernel, 4, sizeof(long), &frame->x_mon);
+	err |= clSetKernelArg(kernel, 5, sizeof(long), &frame->y_mon);
+	err |= clSetKernelArg(kernel, 6, sizeof(float),
+			&renderer->options.abort_value);
+	err |= clSetKernelArg(kernel, 7, sizeof(long), &frame->itr);
+	err |= clSetKernelArg(kernel, 8, sizeof(cl_mem), &job->d_image);
+	err |= clSetKernelArg(kernel, 9, sizeof(cl_mem), &job->d_fractions);
+	err |= clSetKernelArg(kernel, 10, sizeof(cl_mem),
+			&job->d_saved_iterations);
+	if (err != CL_SUCCESS) {
+		return err;
+	}
+
+	/*__kernel void calculate_image_smooth(const float x_min, const float x_max,
+	 const float y_min, const float y_max, const long x_mon,
+	 const long y_mon, const float abort_value, const long itr,
+	 __global VALUE_T * imagevalues, __global float * fractions,
+	 __global ulong * saved_iterations)*/
+
+	return clEnqueueNDRangeKernel(renderer->commands, kernel, 2, NULL,
+			job->global, NULL, 0, NULL, &job->slot->computed);
+}
+
+/**
+ * Enqueues the fused kernel, which calculates iterations and colors in one
+ * pass.
+ *
+ * @param renderer The renderer.
+ * @param job The frame.
+ * @return CL_SUCCESS or the error code of the failed OpenCL call.
+ */
+static cl_int renderer_enqueue_pixels(renderer_t * renderer,
+		frame_job_t * job) {
+	renderer_frame_t * frame = job->frame;
+	cl_kernel kernel = job->kernels->ko_calculate_image_pixels;
+	cl_int err;
+
+	err = clSetKernelArg(kernel, 0, sizeof(float), &job->x_min);
+	err |= clSetKernelArg(kernel, 1, sizeof(float), &job->x_max);
+	err |= clSetKernelArg(kernel, 2, sizeof(float), &job->y_min);
+	err |= clSetKernelArg(kernel, 3, sizeof(float), &job->y_max);
+	err |= clSetKernelArg(kernel, 4, sizeof(long), &frame->x_mon);
+	err |= clSetKernelArg(kernel, 5, sizeof(long), &frame->y_mon);
+	err |= clSetKernelArg(kernel, 6, sizeof(float),
+			&renderer->options.abort_value);
+	err |= clSetKernelArg(kernel, 7, sizeof(long), &frame->itr);
+	err |= clSetKernelArg(kernel, 8, sizeof(int), &job->store_values);
+	err |= clSetKernelArg(kernel, 9, sizeof(cl_mem), &job->d_image);
+	err |= clSetKernelArg(kernel, 10, sizeof(cl_mem), &job->d_image_pixel);
+	err |= clSetKernelArg(kernel, 11, sizeof(cl_mem),
+			&job->d_saved_iterations);
+	if (err != CL_SUCCESS) {
+		return err;
+	}
+
+	/*__kernel void calculate_image_pixels(const float x_min, const float x_max,
+	 const float y_min, const float y_max, const long x_mon, const long y_mon,
+	 const float abort_value, const long itr, const int export_values,
+	 __global VALUE_T * imagevalues, __global unsigned char * image,
+	 __global ulong * saved_iterations)*/
+
+	return clEnqueueNDRangeKernel(renderer->commands, kernel, 2, NULL,
+			job->global, NULL, 0, NULL, &job->slot->computed);
+}
+
+/**
+ * Enqueues the kernel that only calculates the iteration values, which the
+ * color kernel colors afterwards.
+ *
+ * @param renderer The renderer.
+ * @param job The frame.
+ * @return CL_SUCCESS or the error code of the failed OpenCL call.
+ */
+static cl_int renderer_enqueue_iterations(renderer_t * renderer,
+		frame_job_t * job) {
+	cl_event iterated = NULL;
+	cl_int err;
+
+	err = renderer_set_iterations_args(renderer, job, job->d_image,
+			job->d_saved_iterations);
+	if (err != CL_SUCCESS) {
+		return err;
+	}
+
+	err = clEnqueueNDRangeKernel(renderer->commands,
+			job->kernels->ko_calculate_image_iterations, 2, NULL,
+			job->global, NULL, 0, NULL,
+			renderer->trace->enabled ? &iterated : NULL);
+	trace_device_event(renderer->trace, "iterations", job->frame->number,
+			TRACE_TRACK_COMMANDS, iterated);
+	if (iterated != NULL) {
+		clReleaseEvent(iterated);
+	}
+
+	return err;
+}
+
+/**
+ * Enqueues the color kernel, which colors the iteration values on the
+ * device.
+ *
+ * @param renderer The renderer.
+ * @param job The frame.
+ * @return CL_SUCCESS or the error code of the failed OpenCL call.
+ */
+static cl_int renderer_enqueue_colors(renderer_t * renderer,
+		frame_job_t * job) {
+	cl_kernel kernel = job->kernels->ko_calculate_image_colors;
+	cl_int err;
+
+	err = clSetKernelArg(kernel, 0, sizeof(long), &job->frame->x_mon);
+	err |= clSetKernelArg(kernel, 1, sizeof(long), &job->frame->itr);
+	err |= clSetKernelArg(kernel, 2, sizeof(cl_mem), &job->d_image);
+	err |= clSetKernelArg(kernel, 3, sizeof(cl_mem), &job->d_image_pixel);
+	if (err != CL_SUCCESS) {
+		return err;
+	}
+
+	/*__kernel void calculate_image_colors(const long x_mon, const long itr,
+	 __global VALUE_T * imagevalues, __global unsigned char * image)*/
+
+	// The in-order queue runs the color kernel after the iterations
+	return clEnqueueNDRangeKernel(renderer->commands, kernel, 2, NULL,
+			job->global, NULL, 0, NULL, &job->slot->computed);
+}
+
+/**
+ * Enqueues the conversion of a frame to YUV 4:2:0 for the video stream.
+ *
+ * @param renderer The renderer.
+ * @param job The frame.
+ * @param d_yuv The converted frame.
+ * @param converted Set to the event of the conversion.
+ * @return CL_SUCCESS or the error code of the failed OpenCL call.
+ */
+static cl_int renderer_enqueue_yuv(renderer_t * renderer, frame_job_t * job,
+		cl_mem d_yuv, cl_event * converted) {
+	renderer_frame_t * frame = job->frame;
+	cl_kernel kernel = job->kernels->ko_convert_image_to_yuv;
+	size_t blocks[2] = { (frame->x_mon + 1) / 2, (frame->y_mon + 1) / 2 };
+	cl_int err;
+
+	err = clSetKernelArg(kernel, 0, sizeof(long), &frame->x_mon);
+	err |= clSetKernelArg(kernel, 1, sizeof(long), &frame->y_mon);
+	err |= clSetKernelArg(kernel, 2, sizeof(cl_mem), &job->d_image_pixel);
+	err |= clSetKernelArg(kernel, 3, sizeof(cl_mem), &d_yuv);
+	if (err != CL_SUCCESS) {
+		return err;
+	}
+
+	/*__kernel void convert_image_to_yuv(const long x_mon, const long y_mon,
+	 __global const unsigned char * image, __global unsigned char * yuv)*/
+
+	return clEnqueueNDRangeKernel(renderer->commands, kernel, 2, NULL, blocks,
+			NULL, 0, NULL, converted);
+}
+
+/**
+ * Renders a frame with the CPU backend, see renderer_enqueue_frame. The
+ * frame is done when the call returns, in the host buffer of its slot.
+ *
+ * @param renderer The renderer.
+ * @param frame The frame.
+ * @param slot The slot of the frame.
+ * @param h_image The iteration values of the frame.
+ * @param h_image_pixel The colored image of the frame.
+ * @return CL_SUCCESS, CL_OUT_OF_HOST_MEMORY or CL_INVALID_VALUE if the CPU
+ *         backend failed.
+ */
+static cl_int renderer_render_cpu(renderer_t * renderer,
+		renderer_frame_t * frame, frame_slot_t * slot, long * h_image,
+		unsigned char * h_image_pixel) {
+	const renderer_options_t * options = &renderer->options;
+	cpu_backend_t * cpu = &renderer->cpu;
+	float abort_value = options->abort_value;
+	const long x_mon = frame->x_mon;
+	const long y_mon = frame->y_mon;
+	const long pixels = x_mon * y_mon;
+	cl_int err;
+
+	if (frame->perturbation != NULL) {
+		perturbation_t * perturbation = frame->perturbation;
+		float spacing;
+		int spacing_exponent;
+
+		if (perturbation_reference_orbit(perturbation, frame->itr,
+				abort_value) != 0) {
+			return CL_OUT_OF_HOST_MEMORY;
+		}
+		perturbation_spacing(perturbation, &spacing, &spacing_exponent);
+
+		if (cpu_backend_render_perturbation(cpu, x_mon, y_mon, spacing,
+				spacing_exponent, abort_value, frame->itr,
+				perturbation->orbit, perturbation->orbit_length, NULL,
+				h_image_pixel) != 0) {
+			return CL_INVALID_VALUE;
+		}
+		slot->saved_iterations = (cl_ulong) cpu->rebases;
+	} else if (frame->map != NULL) {
+		const exp_map_t * map = frame->map;
+		exp_map_frame_t map_frame;
+
+		// The strip and the last frame stay in the pool from
+		// renderer_render_exp_map
+		long * h_strip = (long *) buffer_pool_host_buffer(&renderer->pool,
+				SLOT_STRIP, sizeof(long) * map->columns * map->rows);
+		long * h_inner = (long *) buffer_pool_host_buffer(&renderer->pool,
+				SLOT_INNER, sizeof(long) * map->x_mon * map->y_mon);
+		if (h_strip == NULL || h_inner == NULL) {
+			return CL_OUT_OF_HOST_MEMORY;
+		}
+
+		exp_map_frame(map, frame->number, &map_frame);
+		if (cpu_backend_render_from_map(cpu, map, &map_frame, h_strip,
+				h_inner, h_image, h_image_pixel) != 0) {
+			return CL_INVALID_VALUE;
+		}
+		slot->saved_iterations = 0;
+	} else if (options->subdivide) {
+		renderer_points_t points;
+
+		err = renderer_reserve_subdivision(renderer, x_mon, y_mon);
+		if (err != CL_SUCCESS) {
+			return err;
+		}
+
+		points.x_min = (float) frame->x_min;
+		points.x_max = (float) frame->x_max;
+		points.y_min = (float) frame->y_min;
+		points.y_max = (float) frame->y_max;
+		points.x_mon = x_mon;
+		points.y_mon = y_mon;
+		points.abort_value = abort_value;
+		points.itr = frame->itr;
+		points.saved_iterations = 0;
+		points.cpu = cpu;
+
+		subdivision_render(&renderer->subdivision, h_image,
+				renderer_evaluate_points_cpu, &points);
+		slot->saved_iterations = points.saved_iterations;
+
+		// The colors of the brute-force image are replaced below
+		if (options->brute_force) {
+			long * h_brute_force = (long *) buffer_pool_host_buffer(
+					&renderer->pool, SLOT_BRUTE_FORCE, sizeof(long) * pixels);
+			if (h_brute_force == NULL) {
+				return CL_OUT_OF_HOST_MEMORY;
+			}
+			if (cpu_backend_render(cpu, (float) frame->x_min,
+					(float) frame->x_max, (float) frame->y_min,
+					(float) frame->y_max, x_mon, y_mon, abort_value,
+					frame->itr, h_brute_force, h_image_pixel) != 0) {
+				return CL_INVALID_VALUE;
+			}
+			renderer->differences += subdivision_compare_brute_force(
+					frame->number, h_image, h_brute_force,
+					ITERATION_VALUES_LONG, pixels);
+		}
+
+		if (cpu_backend_colorize(cpu, x_mon, y_mon, frame->itr, h_image,
+				h_image_pixel) != 0) {
+			return CL_INVALID_VALUE;
+		}
+	} else {
+		if (cpu_backend_render(cpu, (float) frame->x_min,
+				(float) frame->x_max, (float) frame->y_min,
+				(float) frame->y_max, x_mon, y_mon, abort_value, frame->itr,
+				frame->export_values ? h_image : NULL, h_image_pixel) != 0) {
+			return CL_INVALID_VALUE;
+		}
+		slot->saved_iterations = (cl_ulong) cpu->saved_iterations;
+	}
+
+	frame->value_bits = ITERATION_VALUES_LONG;
+
+	return CL_SUCCESS;
+}
+
+/**
+ * Renders a frame on all devices of the multi-device renderer, see
+ * renderer_enqueue_frame. The frame is done when the call returns, in the
+ * host buffer of its slot.
+ *
+ * @param renderer The renderer.
+ * @param frame The frame.
+ * @param slot The slot of the frame.
+ * @param h_image The iteration values of the frame.
+ * @param h_image_pixel The colored image of the frame.
+ * @return CL_SUCCESS or the error code of the failed OpenCL call.
+ */
+static cl_int renderer_render_multi_device(renderer_t * renderer,
+		renderer_frame_t * frame, frame_slot_t * slot, long * h_image,
+		unsigned char * h_image_pixel) {
+	const renderer_options_t * options = &renderer->options;
+	kernel_variant_t variant;
+
+	kernel_variant_select(&variant, options->abort_value, frame->itr,
+			options->unroll, options->magnitude_squared,
+			options->interior_check, PRECISION_FLOAT);
+	frame->value_bits = variant.value_bits;
+
+	return multi_device_render(&renderer->md, (float) frame->x_min,
+			(float) frame->x_max, (float) frame->y_min, (float) frame->y_max,
+			frame->x_mon, frame->y_mon, options->abort_value, frame->itr,
+			&variant, frame->export_values ? h_image : NULL, h_image_pixel,
+			&slot->saved_iterations);
+}
+
+/**
+ * Renders a frame with the CPU backend or the multi-device renderer into
+ * the host buffer of its slot, see renderer_enqueue_frame. The lock of the
+ * renderer has to be held.
+ *
+ * @param renderer The renderer.
+ * @param frame The frame.
+ * @param slot The slot of the frame.
+ * @return CL_SUCCESS or the error code of the failed call.
+ */
+static cl_int renderer_render_host(renderer_t * renderer,
+		renderer_frame_t * frame, frame_slot_t * slot) {
+	buffer_pool_t * pool = &renderer->pool;
+	const long pixels = frame->x_mon * frame->y_mon;
+	cl_int err;
+
+	long * h_image = (long *) buffer_pool_host_buffer(pool, SLOT_IMAGE,
+			sizeof(long) * pixels);
+	unsigned char * h_image_pixel = frame->image;
+	if (h_image_pixel == NULL) {
+		h_image_pixel = (unsigned char *) buffer_pool_host_buffer(pool,
+				SLOT_IMAGE_PIXEL + slot->index,
+				sizeof(unsigned char) * pixels * 3);
+	}
+	if (h_image == NULL || h_image_pixel == NULL) {
+		return CL_OUT_OF_HOST_MEMORY;
+	}
+
+	// Only float frames, whose colors are converted on the host
+	slot->d_image_pixel = NULL;
+	slot->h_image_pixel = h_image_pixel;
+	slot->d_saved_iterations = NULL;
+	slot->saved_iterations = 0;
+	slot->precision = PRECISION_FLOAT;
+	slot->persistent = 0;
+	renderer->tiered[slot->index] = 0;
+
+	if (renderer->options.backend == RENDERER_BACKEND_CPU) {
+		err = renderer_render_cpu(renderer, frame, slot, h_image,
+				h_image_pixel);
+	} else {
+		err = renderer_render_multi_device(renderer, frame, slot, h_image,
+				h_image_pixel);
+	}
+	if (err == CL_SUCCESS && frame->export_values) {
+		frame->values = h_image;
+	}
+
+	return err;
+}
+
+/**
+ * Enqueues all commands of a frame and its read back, see
+ * renderer_enqueue_frame. The lock of the renderer has to be held.
+ *
+ * @param renderer The renderer.
+ * @param frame The frame.
+ * @param slot The slot of the frame.
+ * @return CL_SUCCESS or the error code of the failed call.
+ */
+static cl_int renderer_enqueue(renderer_t * renderer,
+		renderer_frame_t * frame, frame_slot_t * slot) {
+	const renderer_options_t * options = &renderer->options;
+	buffer_pool_t * pool = &renderer->pool;
+	trace_t * trace = renderer->trace;
+	cached_frame_t * cached_frame = &renderer->cached_frames[slot->index];
+	const long x_mon = frame->x_mon;
+	const long y_mon = frame->y_mon;
+	const long pixels = x_mon * y_mon;
+	kernel_variant_t variant;
+	frame_job_t job;
+	cl_int err;
+
+	if (x_mon < 2 || y_mon < 2 || frame->itr < 1) {
+		return CL_INVALID_VALUE;
+	}
+	if (renderer->options.backend != RENDERER_BACKEND_OPENCL) {
+		return renderer_render_host(renderer, frame, slot);
+	}
+
+	job.frame = frame;
+	job.slot = slot;
+	job.global[0] = x_mon;
+	job.global[1] = y_mon;
+	job.d_fractions = NULL;
+
+	//Get memory for image
+	// The iteration values are stored as narrow as itr allows
+	job.value_bits = iteration_values_bits(frame->itr);
+	job.d_image = buffer_pool_device_buffer(pool, SLOT_IMAGE,
+			CL_MEM_READ_WRITE, iteration_values_size(job.value_bits) * pixels,
+			&err);
+	if (err != CL_SUCCESS) {
+		return err;
+	}
+
+	job.d_image_pixel = buffer_pool_device_buffer(pool,
+			SLOT_IMAGE_PIXEL + slot->index, CL_MEM_WRITE_ONLY,
+			sizeof(unsigned char) * pixels * 3, &err);
+	if (err != CL_SUCCESS) {
+		return err;
+	}
+
+	job.d_saved_iterations = buffer_pool_device_buffer(pool,
+			SLOT_SAVED_ITERATIONS + slot->index, CL_MEM_READ_WRITE,
+			sizeof(cl_ulong), &err);
+	if (err != CL_SUCCESS) {
+		return err;
+	}
+
+	// The frame is read into the mapped file, the memory of the caller or
+	// the host buffer of its slot
+	job.h_image = (long*) buffer_pool_host_buffer(pool, SLOT_IMAGE,
+			sizeof(long) * pixels);
+	unsigned char* h_image_pixel = frame->image;
+	if (h_image_pixel == NULL && frame->output == NULL) {
+		h_image_pixel = (unsigned char*) buffer_pool_host_buffer(pool,
+				SLOT_IMAGE_PIXEL + slot->index,
+				sizeof(unsigned char) * pixels * 3);
+	}
+	if (job.h_image == NULL
+			|| (h_image_pixel == NULL && frame->output == NULL)) {
+		return CL_OUT_OF_HOST_MEMORY;
+	}
+
+	slot->d_image_pixel = job.d_image_pixel;
+	slot->h_image_pixel = h_image_pixel;
+	slot->d_saved_iterations = job.d_saved_iterations;
+
+	// The kernels add the iterations the interior check saved, or the
+	// rebases of a deep zoom
+	cl_ulong zero = 0;
+	err = clEnqueueFillBuffer(renderer->commands, job.d_saved_iterations,
+			&zero, sizeof(zero), 0, sizeof(zero), 0, NULL, NULL);
+	if (err != CL_SUCCESS) {
+		return err;
+	}
+
+	// Pick the precision tier from the pixel spacing of the frame. Deep
+	// zooms and the exponential map have their own precision.
+	int tiered = (frame->perturbation == NULL && frame->map == NULL);
+	int tier = PRECISION_FLOAT;
+	if (tiered) {
+		tier = precision_select(frame->x_min, frame->x_max, frame->y_min,
+				frame->y_max, x_mon, y_mon, renderer->has_double,
+				options->precision);
+	}
+	renderer->tiered[slot->index] = tiered;
+	slot->precision = tier;
+	slot->persistent = 0;
+
+	// The df64 and double kernels only color linearly, whole frames
+	if (tier != PRECISION_FLOAT && !renderer->tier_notice
+			&& (options->subdivide || options->persistent
+					|| options->progressive
+					|| options->coloring != COLORING_LINEAR)) {
+		printf("Frames in %s precision can't use --subdivide, "
+				"--persistent, --progressive or --coloring, rendering "
+				"them whole and coloring linearly\n", precision_name(tier));
+		renderer->tier_notice = 1;
+	}
+
+	// The float kernels get the plane section rounded to float
+	job.x_min = (float) frame->x_min;
+	job.x_max = (float) frame->x_max;
+	job.y_min = (float) frame->y_min;
+	job.y_max = (float) frame->y_max;
+
+	// Pick the kernel variant specialised for this frame. Frames from the
+	// map read its last frame, stored as wide as the map needs.
+	kernel_variant_select(&variant, options->abort_value,
+			frame->map != NULL ? frame->map->itr : frame->itr,
+			options->unroll, options->magnitude_squared,
+			options->interior_check, tier);
+	double built = trace_begin(trace);
+	job.kernels = kernel_variants_get(&renderer->variants, &variant, &err);
+	if (job.kernels == NULL) {
+		return err;
+	}
+	trace_host_span(trace, "get kernel variant", frame->number,
+			TRACE_TRACK_HOST, built);
+
+	// The iteration values are only needed to find the zoom dot and for the
+	// palette coloring, which also uses their fractional part
+	job.store_values = frame->export_values
+			|| options->coloring != COLORING_LINEAR;
+
+	// Frames of the plain renderer found in the iteration cache are only
+	// colored, the others are read back for it
+	int cached = 0;
+	if (renderer->iteration_cache.enabled && tiered && !options->subdivide
+			&& !options->persistent && !options->progressive
+			&& options->coloring == COLORING_LINEAR) {
+		char variant_options[KERNEL_VARIANTS_OPTIONS_LENGTH];
+
+		kernel_variant_options(&variant, renderer->build_options,
+				variant_options, sizeof(variant_options));
+		iteration_cache_key(frame->x_min, frame->x_max, frame->y_min,
+				frame->y_max, x_mon, y_mon, frame->itr, options->abort_value,
+				variant_options, cached_frame->key);
+		cached_frame->value_bits = variant.value_bits;
+		cached_frame->count = pixels;
+		cached_frame->values = buffer_pool_host_buffer(pool,
+				SLOT_CACHED_VALUES + slot->index,
+				iteration_values_size(variant.value_bits) * pixels);
+		if (cached_frame->values == NULL) {
+			return CL_OUT_OF_HOST_MEMORY;
+		}
+
+		double loaded = trace_begin(trace);
+		cached = (iteration_cache_load(&renderer->iteration_cache,
+				cached_frame->key, cached_frame->values, variant.value_bits,
+				cached_frame->count) == 0);
+		trace_host_span(trace, "load from iteration cache", frame->number,
+				TRACE_TRACK_HOST, loaded);
+		cached_frame->store = !cached;
+		job.store_values = 1;
+	}
+
+	if (cached) {
+		// Take the iteration values from the iteration cache
+		cl_event uploaded = NULL;
+
+		err = clEnqueueWriteBuffer(renderer->commands, job.d_image, CL_FALSE,
+				0, iteration_values_size(variant.value_bits) * pixels,
+				cached_frame->values, 0, NULL,
+				trace->enabled ? &uploaded : NULL);
+		trace_device_event(trace, "write cached values", frame->number,
+				TRACE_TRACK_COMMANDS, uploaded);
+		if (uploaded != NULL) {
+			clReleaseEvent(uploaded);
+		}
+	} else if (frame->perturbation != NULL) {
+		err = renderer_enqueue_perturbation(renderer, &job);
+	} else if (frame->map != NULL) {
+		err = renderer_enqueue_from_map(renderer, &job, variant.value_bits);
+	} else if (tier != PRECISION_FLOAT) {
+		err = renderer_enqueue_precise(renderer, &job, tier);
+	} else if (options->subdivide) {
+		err = renderer_enqueue_subdivided(renderer, &job);
+	} else if (options->persistent) {
+		err = renderer_enqueue_persistent(renderer, &job);
+	} else if (options->progressive && frame->preview != NULL) {
+		err = renderer_enqueue_progressive(renderer, &job);
+	} else if (options->coloring != COLORING_LINEAR) {
+		err = renderer_enqueue_smooth(renderer, &job);
+	} else if (options->fused_kernel) {
+		err = renderer_enqueue_pixels(renderer, &job);
+	} else {
+		err = renderer_enqueue_iterations(renderer, &job);
+	}
+	if (err != CL_SUCCESS) {
+		return err;
+	}
+
+	if (cached || (tier == PRECISION_FLOAT && tiered
+			&& options->coloring == COLORING_LINEAR
+			&& (options->subdivide
+					|| (!options->fused_kernel && !options->persistent)))) {
+		err = renderer_enqueue_colors(renderer, &job);
+		if (err != CL_SUCCESS) {
+			return err;
+		}
+	}
+
+	// The kernel that finished the frame, whose time is logged with it
+	trace_device_event(trace, "compute frame", frame->number,
+			TRACE_TRACK_COMMANDS, slot->computed);
+
+	// The in-order queue reads the values before the next frame overwrites
+	// them
+	if (cached_frame->store) {
+		err = clEnqueueReadBuffer(renderer->commands, job.d_image, CL_FALSE,
+				0, iteration_values_size(variant.value_bits) * pixels,
+				cached_frame->values, 0, NULL, &cached_frame->read);
+		if (err != CL_SUCCESS) {
+			cached_frame->store = 0;
+			return err;
+		}
+		trace_device_event(trace, "read values for the cache", frame->number,
+				TRACE_TRACK_COMMANDS, cached_frame->read);
+	}
+
+	cl_mem d_frame = job.d_image_pixel;
+	size_t frame_size = sizeof(unsigned char) * pixels * 3;
+	cl_event ready = slot->computed;
+	cl_event colored = NULL;
+	cl_event converted = NULL;
+
+	if (options->coloring != COLORING_LINEAR) {
+		// The colors of the iteration kernels are overwritten, so the
+		// colored image never leaves the device before the read back
+		err = coloring_enqueue(&renderer->colorer, renderer->commands,
+				job.kernels, x_mon, y_mon, frame->itr, job.d_image,
+				job.d_fractions, job.d_image_pixel, &colored);
+		if (err != CL_SUCCESS) {
+			return err;
+		}
+		trace_device_event(trace, "coloring", frame->number,
+				TRACE_TRACK_COMMANDS, colored);
+
+		// The subdivision only fills in the iteration values, so its frame
+		// is computed once it is colored
+		if (slot->computed == NULL) {
+			slot->computed = colored;
+			colored = NULL;
+		}
+		ready = (colored != NULL) ? colored : slot->computed;
+	}
+
+	if (frame->yuv) {
+		// Only the half as big YUV frame is read back, into the pixel
+		// buffer of the slot
+		frame_size = y4m_frame_size(x_mon, y_mon);
+		d_frame = buffer_pool_device_buffer(pool, SLOT_YUV + slot->index,
+				CL_MEM_WRITE_ONLY, frame_size, &err);
+		if (err == CL_SUCCESS) {
+			err = renderer_enqueue_yuv(renderer, &job, d_frame, &converted);
+		}
+		if (err != CL_SUCCESS) {
+			if (colored != NULL) {
+				clReleaseEvent(colored);
+			}
+			return err;
+		}
+		trace_device_event(trace, "convert to yuv", frame->number,
+				TRACE_TRACK_COMMANDS, converted);
+		ready = converted;
+	}
+
+	// Read back the image on the transfer queue as soon as it has been
+	// computed, without blocking the host. The in-order queue finishes the
+	// counter before the image, so the read event covers both.
+	err = clEnqueueReadBuffer(renderer->transfers, job.d_saved_iterations,
+			CL_FALSE, 0, sizeof(cl_ulong), &slot->saved_iterations, 1,
+			&slot->computed, NULL);
+	if (frame->output != NULL) {
+		// The rows go into the file between its padding, so the frame is
+		// copied once, from the device into the page cache
+		size_t origin[3] = { 0, 0, 0 };
+		size_t region[3] = { x_mon * 3, y_mon, 1 };
+		err |= clEnqueueReadBufferRect(renderer->transfers, d_frame,
+				CL_FALSE, origin, origin, region, x_mon * 3, 0,
+				frame->output->row_pitch, 0, frame->output->pixels, 1, &ready,
+				&slot->read);
+	} else {
+		err |= clEnqueueReadBuffer(renderer->transfers, d_frame, CL_FALSE, 0,
+				frame_size, h_image_pixel, 1, &ready, &slot->read);
+	}
+	if (colored != NULL) {
+		clReleaseEvent(colored);
+	}
+	if (converted != NULL) {
+		clReleaseEvent(converted);
+	}
+	if (err != CL_SUCCESS) {
+		return err;
+	}
+	trace_device_event(trace, "read frame", frame->number,
+			TRACE_TRACK_TRANSFERS, slot->read);
+
+	err = clFlush(renderer->commands);
+	err |= clFlush(renderer->transfers);
+	if (err != CL_SUCCESS) {
+		return err;
+	}
+
+	// The zoom dot is the only value of a frame the following frames
+	// depend on, so only those frames are waited for
+	if (frame->export_values) {
+		err = clEnqueueReadBuffer(renderer->commands, job.d_image, CL_TRUE,
+				0, iteration_values_size(job.value_bits) * pixels,
+				job.h_image, 0, NULL, NULL);
+		frame->values = job.h_image;
+		frame->value_bits = job.value_bits;
+	}
+
+	return err;
+}
+
+/**
+ * Enqueues a frame without waiting for it: its kernels on the command
+ * queue of the renderer and its read back on the transfer queue. The
+ * precision tier and the path of the frame follow from the frame and the
+ * modes of the options.
+ *
+ * The buffers of the frame are picked by the index of its slot, so the
+ * frames of the other slots can still be read back. The slot gets the
+ * computed and the read event and the counter of the frame, which are
+ * valid once renderer_wait_frame returned. The CPU backend and the
+ * multi-device renderer finish the frame before the call returns.
+ *
+ * @param renderer The renderer.
+ * @param frame The frame. With export_values its values are set.
+ * @param slot The slot of the frame, free of any earlier frame.
+ * @return CL_SUCCESS or the error code of the failed call.
+ */
+cl_int renderer_enqueue_frame(renderer_t * renderer,
+		renderer_frame_t * frame, frame_slot_t * slot) {
+	pthread_mutex_lock(&renderer->lock);
+	cl_int err = renderer_enqueue(renderer, frame, slot);
+	pthread_mutex_unlock(&renderer->lock);
+
+	return err;
+}
+
+/**
+ * Waits for the frame of a slot, see renderer_wait_frame. The lock of the
+ * renderer has to be held.
+ *
+ * @param renderer The renderer.
+ * @param slot The slot of the frame.
+ * @return CL_SUCCESS or the error code of clWaitForEvents.
+ */
+static cl_int renderer_wait(renderer_t * renderer, frame_slot_t * slot) {
+	cl_int err = frame_pipeline_wait(slot);
+	if (err != CL_SUCCESS) {
+		return err;
+	}
+
+	renderer_store_values(&renderer->iteration_cache,
+			&renderer->cached_frames[slot->index]);
+
+	if (slot->persistent) {
+		tile_scheduler_add_frame(&renderer->scheduler, slot->compute_ms);
+	}
+	if (renderer->tiered[slot->index]) {
+		precision_stats_add(&renderer->precision_stats, slot->precision,
+				slot->compute_ms);
+	}
+
+	return CL_SUCCESS;
+}
+
+/**
+ * Waits until the frame of a slot has been read back, stores its iteration
+ * values in the iteration cache and counts its device time for its
+ * precision tier or the persistent kernel. Afterwards the image of the
+ * frame can be written.
+ *
+ * @param renderer The renderer.
+ * @param slot The slot of the frame.
+ * @return CL_SUCCESS or the error code of clWaitForEvents.
+ */
+cl_int renderer_wait_frame(renderer_t * renderer, frame_slot_t * slot) {
+	pthread_mutex_lock(&renderer->lock);
+	cl_int err = renderer_wait(renderer, slot);
+	pthread_mutex_unlock(&renderer->lock);
+
+	return err;
+}
+
+/**
+ * Renders a frame into host memory and waits for it. The frame takes the
+ * same path as the frames of renderer_enqueue_frame, without previews.
+ *
+ * It may be called from several threads; the frames are rendered one after
+ * the other.
+ *
+ * @param renderer The renderer.
+ * @param x_min Smallest X-value of the plane section.
+ * @param x_max Greatest X-value of the plane section.
+ * @param y_min Smallest Y-value of the plane section.
+ * @param y_max Greatest Y-value of the plane section.
+ * @param x_mon Resolution of the monitor on the horizontal axis.
+ * @param y_mon Resolution of the monitor on the vertical axis.
+ * @param itr The number of required iterations.
+ * @param image Set to the colored image, x_mon * y_mon * 3 bytes.
+ * @return CL_SUCCESS or the error code of the failed call.
+ */
+cl_int renderer_render(renderer_t * renderer, const double x_min,
+		const double x_max, const double y_min, const double y_max,
+		const long x_mon, const long y_mon, const long itr,
+		unsigned char * image) {
+	renderer_frame_t frame;
+	frame_slot_t slot;
+	cl_int err;
+
+	memset(&frame, 0, sizeof(frame));
+	memset(&slot, 0, sizeof(slot));
+	frame.x_min = x_min;
+	frame.x_max = x_max;
+	frame.y_min = y_min;
+	frame.y_max = y_max;
+	frame.x_mon = x_mon;
+	frame.y_mon = y_mon;
+	frame.itr = itr;
+	frame.image = image;
+	slot.frame = -1;
+
+	pthread_mutex_lock(&renderer->lock);
+	double start = renderer_now_ms();
+
+	frame.number = renderer->frames;
+	err = renderer_enqueue(renderer, &frame, &slot);
+	if (err == CL_SUCCESS) {
+		err = renderer_wait(renderer, &slot);
+	} else {
+		// Only releases the events of the commands that were enqueued
+		frame_pipeline_wait(&slot);
+	}
+	if (err == CL_SUCCESS) {
+		renderer->frames++;
+		renderer->render_ms += renderer_now_ms() - start;
+	}
+	pthread_mutex_unlock(&renderer->lock);
+
+	return err;
+}
+
+/**
+ * Calculates the exponential map and its last frame with the CPU backend,
+ * see renderer_render_exp_map. Both stay in the host buffers of the pool.
+ *
+ * @param renderer The renderer.
+ * @param map The planned map.
+ * @return CL_SUCCESS, CL_OUT_OF_HOST_MEMORY or CL_INVALID_VALUE if the CPU
+ *         backend failed.
+ */
+static cl_int renderer_render_exp_map_cpu(renderer_t * renderer,
+		exp_map_t * map) {
+	buffer_pool_t * pool = &renderer->pool;
+	cpu_backend_t * cpu = &renderer->cpu;
+	float abort_value = renderer->options.abort_value;
+
+	long * h_strip = (long *) buffer_pool_host_buffer(pool, SLOT_STRIP,
+			sizeof(long) * map->columns * map->rows);
+	long * h_inner = (long *) buffer_pool_host_buffer(pool, SLOT_INNER,
+			sizeof(long) * map->x_mon * map->y_mon);
+	unsigned char * h_inner_pixel = (unsigned char *) buffer_pool_host_buffer(
+			pool, SLOT_INNER_PIXEL,
+			sizeof(unsigned char) * map->x_mon * map->y_mon * 3);
+	if (h_strip == NULL || h_inner == NULL || h_inner_pixel == NULL) {
+		return CL_OUT_OF_HOST_MEMORY;
+	}
+
+	cpu_backend_render_strip(cpu, (float) map->center_real,
+			(float) map->center_imaginary, (float) map->rho_min,
+			(float) map->delta_rho, map->columns, map->rows, map->planes[0],
+			map->planes[1], map->planes[2], map->planes[3], abort_value,
+			map->row_iterations, h_strip);
+	map->saved_iterations = cpu->saved_iterations;
+
+	// The last frame is calculated completely, it covers the dot
+	if (cpu_backend_render(cpu, map->inner_x_min, map->inner_x_max,
+			map->inner_y_min, map->inner_y_max, map->x_mon, map->y_mon,
+			abort_value, map->itr, h_inner, h_inner_pixel) != 0) {
+		return CL_INVALID_VALUE;
+	}
+	map->saved_iterations += cpu->saved_iterations;
+
+	return CL_SUCCESS;
+}
+
+/**
+ * Calculates the exponential map and the last frame, which the following
+ * frames are taken from, and waits for them. The number of iterations the
+ * interior check saved is left in the map.
+ *
+ * @param renderer The renderer.
+ * @param map The planned map.
+ * @return CL_SUCCESS or the error code of the failed OpenCL call.
+ */
+cl_int renderer_render_exp_map(renderer_t * renderer, exp_map_t * map) {
+	const renderer_options_t * options = &renderer->options;
+	buffer_pool_t * pool = &renderer->pool;
+	cl_command_queue commands = renderer->commands;
+	float abort_value = options->abort_value;
+	kernel_variant_t variant;
+	kernel_program_t * kernels;
+	cl_int err;
+	size_t global[2];
+
+	// The devices of the multi-device renderer only share plain frames
+	if (options->backend == RENDERER_BACKEND_MULTI_DEVICE) {
+		return CL_INVALID_OPERATION;
+	}
+
+	pthread_mutex_lock(&renderer->lock);
+
+	if (options->backend == RENDERER_BACKEND_CPU) {
+		err = renderer_render_exp_map_cpu(renderer, map);
+		pthread_mutex_unlock(&renderer->lock);
+		return err;
+	}
+
+	// The map needs the iterations of the last frame
+	kernel_variant_select(&variant, abort_value, map->itr, options->unroll,
+			options->magnitude_squared, options->interior_check,
+			PRECISION_FLOAT);
+	kernels = kernel_variants_get(&renderer->variants, &variant, &err);
+	if (kernels == NULL) {
+		pthread_mutex_unlock(&renderer->lock);
+		return err;
+	}
+
+	cl_mem d_strip = buffer_pool_device_buffer(pool, SLOT_STRIP,
+			CL_MEM_READ_WRITE, sizeof(long) * map->columns * map->rows, &err);
+	cl_mem d_inner = NULL;
+	cl_mem d_saved_iterations = NULL;
+	cl_mem d_row_iterations = NULL;
+	if (err == CL_SUCCESS) {
+		d_inner = buffer_pool_device_buffer(pool, SLOT_INNER,
+				CL_MEM_READ_WRITE, iteration_values_size(variant.value_bits)
+						* map->x_mon * map->y_mon, &err);
+	}
+	if (err == CL_SUCCESS) {
+		d_saved_iterations = buffer_pool_device_buffer(pool,
+				SLOT_STRIP_SAVED, CL_MEM_READ_WRITE, sizeof(cl_ulong), &err);
+	}
+	if (err == CL_SUCCESS) {
+		d_row_iterations = buffer_pool_device_buffer(pool,
+				SLOT_STRIP_ITERATIONS, CL_MEM_READ_ONLY,
+				sizeof(long) * map->rows, &err);
+	}
+	if (err != CL_SUCCESS) {
+		pthread_mutex_unlock(&renderer->lock);
+		return err;
+	}
+
+	cl_ulong saved_iterations = 0;
+	err = clEnqueueWriteBuffer(commands, d_saved_iterations, CL_FALSE, 0,
+			sizeof(saved_iterations), &saved_iterations, 0, NULL, NULL);
+	err |= clEnqueueWriteBuffer(commands, d_row_iterations, CL_FALSE, 0,
+			sizeof(long) * map->rows, map->row_iterations, 0, NULL, NULL);
+
+	cl_kernel ko_calculate_strip_iterations =
+			kernels->ko_calculate_strip_iterations;
+	float center_real = (float) map->center_real;
+	float center_imaginary = (float) map->center_imaginary;
+	float rho_min = (float) map->rho_min;
+	float delta_rho = (float) map->delta_rho;
+
+	// Only samples inside the first frame are calculated
+	float bounds[4];
+	for (int i = 0; i < 4; ++i) {
+		bounds[i] = (float) map->planes[i];
+	}
+
+	err |= clSetKernelArg(ko_calculate_strip_iterations, 0, sizeof(float),
+			&center_real);
+	err |= clSetKernelArg(ko_calculate_strip_iterations, 1, sizeof(float),
+			&center_imaginary);
+	err |= clSetKernelArg(ko_calculate_strip_iterations, 2, sizeof(float),
+			&rho_min);
+	err |= clSetKernelArg(ko_calculate_strip_iterations, 3, sizeof(float),
+			&delta_rho);
+	err |= clSetKernelArg(ko_calculate_strip_iterations, 4, sizeof(long),
+			&map->columns);
+	err |= clSetKernelArg(ko_calculate_strip_iterations, 5, sizeof(float),
+			&bounds[0]);
+	err |= clSetKernelArg(ko_calculate_strip_iterations, 6, sizeof(float),
+			&bounds[1]);
+	err |= clSetKernelArg(ko_calculate_strip_iterations, 7, sizeof(float),
+			&bounds[2]);
+	err |= clSetKernelArg(ko_calculate_strip_iterations, 8, sizeof(float),
+			&bounds[3]);
+	err |= clSetKernelArg(ko_calculate_strip_iterations, 9, sizeof(float),
+			&abort_value);
+	err |= clSetKernelArg(ko_calculate_strip_iterations, 10, sizeof(cl_mem),
+			&d_row_iterations);
+	err |= clSetKernelArg(ko_calculate_strip_iterations, 11, sizeof(cl_mem),
+			&d_strip);
+	err |= clSetKernelArg(ko_calculate_strip_iterations, 12, sizeof(cl_mem),
+			&d_saved_iterations);
+
+	global[0] = map->columns;
+	global[1] = map->rows;
+	if (err == CL_SUCCESS) {
+		err = clEnqueueNDRangeKernel(commands, ko_calculate_strip_iterations,
+				2, NULL, global, NULL, 0, NULL, NULL);
+	}
+
+	// The last frame is calculated completely, it covers the dot
+	cl_kernel ko_calculate_image_iterations =
+			kernels->ko_calculate_image_iterations;
+	float x_min = (float) map->inner_x_min;
+	float x_max = (float) map->inner_x_max;
+	float y_min = (float) map->inner_y_min;
+	float y_max = (float) map->inner_y_max;
+
+	err |= clSetKernelArg(ko_calculate_image_iterations, 0, sizeof(float),
+			&x_min);
+	err |= clSetKernelArg(ko_calculate_image_iterations, 1, sizeof(float),
+			&x_max);
+	err |= clSetKernelArg(ko_calculate_image_iterations, 2, sizeof(float),
+			&y_min);
+	err |= clSetKernelArg(ko_calculate_image_iterations, 3, sizeof(float),
+			&y_max);
+	err |= clSetKernelArg(ko_calculate_image_iterations, 4, sizeof(long),
+			&map->x_mon);
+	err |= clSetKernelArg(ko_calculate_image_iterations, 5, sizeof(long),
+			&map->y_mon);
+	err |= clSetKernelArg(ko_calculate_image_iterations, 6, sizeof(float),
+			&abort_value);
+	err |= clSetKernelArg(ko_calculate_image_iterations, 7, sizeof(long),
+			&map->itr);
+	err |= clSetKernelArg(ko_calculate_image_iterations, 8, sizeof(cl_mem),
+			&d_inner);
+	err |= clSetKernelArg(ko_calculate_image_iterations, 9, sizeof(cl_mem),
+			&d_saved_iterations);
+
+	global[0] = map->x_mon;
+	global[1] = map->y_mon;
+	if (err == CL_SUCCESS) {
+		err = clEnqueueNDRangeKernel(commands, ko_calculate_image_iterations,
+				2, NULL, global, NULL, 0, NULL, NULL);
+	}
+	if (err == CL_SUCCESS) {
+		err = clEnqueueReadBuffer(commands, d_saved_iterations, CL_TRUE, 0,
+				sizeof(saved_iterations), &saved_iterations, 0, NULL, NULL);
+		map->saved_iterations = (long) saved_iterations;
+	}
+	pthread_mutex_unlock(&renderer->lock);
+
+	return err;
+}
+
+/**
+ * Names what a renderer renders with: the OpenCL device, the instruction
+ * set and threads of the CPU backend, or the number of devices and
+ * sub-devices of the multi-device renderer.
+ *
+ * @param renderer The renderer.
+ * @param name Set to the name.
+ * @param size The size of name in bytes.
+ */
+void renderer_device_name(renderer_t * renderer, char * name,
+		const size_t size) {
+	if (size == 0) {
+		return;
+	}
+	name[0] = '\0';
+
+	if (renderer->options.backend == RENDERER_BACKEND_CPU) {
+		snprintf(name, size, "%s, %d threads", renderer->cpu.isa,
+				renderer->cpu.number_threads);
+	} else if (renderer->options.backend == RENDERER_BACKEND_MULTI_DEVICE) {
+		snprintf(name, size, "%d devices", renderer->md.count);
+	} else if (clGetDeviceInfo(renderer->device_id, CL_DEVICE_NAME, size - 1,
+			name, NULL) != CL_SUCCESS) {
+		name[0] = '\0';
+	}
+	name[size - 1] = '\0';
+}
+
+/**
+ * Prints the statistics of the modes of a renderer, its buffers, its frames
+ * and the hits of its program cache.
+ *
+ * @param renderer The renderer.
+ */
+void renderer_print_stats(renderer_t * renderer) {
+	const renderer_options_t * options = &renderer->options;
+	const precision_stats_t * precision_stats = &renderer->precision_stats;
+
+	pthread_mutex_lock(&renderer->lock);
+
+	if (options->backend == RENDERER_BACKEND_MULTI_DEVICE) {
+		multi_device_print_stats(&renderer->md);
+	}
+	if (options->subdivide) {
+		subdivision_print_stats(&renderer->subdivision);
+	}
+	if (options->brute_force) {
+		printf("Brute force comparison: %ld points differ\n",
+				renderer->differences);
+	}
+	for (int i = 0; i < PRECISION_TIERS; ++i) {
+		if (precision_stats->frames[i] > 0) {
+			precision_print_stats(precision_stats);
+			break;
+		}
+	}
+	if (options->persistent
+			&& clEnqueueReadBuffer(renderer->commands,
+					renderer->d_group_work, CL_TRUE, 0,
+					sizeof(cl_ulong) * TILE_SCHEDULER_GROUP_COUNTERS
+							* renderer->scheduler.groups,
+					renderer->scheduler.group_work, 0, NULL, NULL)
+					== CL_SUCCESS) {
+		tile_scheduler_print_stats(&renderer->scheduler);
+	}
+	progressive_print_stats(&renderer->progressive_stats);
+	if (renderer->iteration_cache.enabled) {
+		iteration_cache_print_stats(&renderer->iteration_cache);
+	}
+	buffer_pool_print_stats(&renderer->pool);
+
+	if (renderer->frames > 0) {
+		printf("Renderer: %ld frames in %.2f ms on average\n",
+				renderer->frames, renderer->render_ms / renderer->frames);
+	}
+	if (options->use_program_cache
+			&& options->backend != RENDERER_BACKEND_CPU) {
+		printf("Program cache %s: %ld hits, %ld misses\n",
+				renderer->program_cache.directory,
+				renderer->program_cache.hits, renderer->program_cache.misses);
+	}
+
+	pthread_mutex_unlock(&renderer->lock);
+}
+
+/**
+ * Releases the kernel variants, the buffers, the command queues and the
+ * context of a renderer and the renderer itself.
+ *
+ * @param renderer The renderer or NULL.
+ */
+void renderer_release(renderer_t * renderer) {
+	if (renderer == NULL) {
+		return;
+	}
+
+	for (int i = 0; i < FRAME_PIPELINE_MAX_DEPTH; ++i) {
+		if (renderer->cached_frames[i].store) {
+			clReleaseEvent(renderer->cached_frames[i].read);
+		}
+	}
+	if (renderer->subdivision_ready) {
+		subdivision_release(&renderer->subdivision);
+	}
+	if (renderer->cpu_ready) {
+		cpu_backend_close(&renderer->cpu);
+	}
+	if (renderer->md_ready) {
+		multi_device_release(&renderer->md);
+	}
+	coloring_release(&renderer->colorer);
+	if (renderer->pool_ready) {
+		buffer_pool_release(&renderer->pool);
+	}
+	if (renderer->variants_ready) {
+		kernel_variants_release(&renderer->variants);
+	}
+	if (renderer->transfers != NULL) {
+		clReleaseCommandQueue(renderer->transfers);
+	}
+	if (renderer->commands != NULL) {
+		clReleaseCommandQueue(renderer->commands);
+	}
+	if (renderer->context != NULL) {
+		clReleaseContext(renderer->context);
+	}
+	free(renderer->source);
+	pthread_mutex_destroy(&renderer->lock);
+	free(renderer);
+}
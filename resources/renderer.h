@@ -0,0 +1,152 @@
+/*
+ * renderer.h
+ *
+ *      Author: Felix Paetow
+ */
+
+#ifndef RENDERER_H_
+#define RENDERER_H_
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef __APPLE__
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+#include "buffer_pool.h"
+#include "coloring.h"
+#include "cpu_backend.h"
+#include "exp_map.h"
+#include "frame_pipeline.h"
+#include "iteration_cache.h"
+#include "kernel_source.h"
+#include "kernel_variants.h"
+#include "mapped_bmp.h"
+#include "multi_device.h"
+#include "perturbation.h"
+#include "precision.h"
+#include "program_cache.h"
+#include "progressive.h"
+#include "subdivision.h"
+#include "tile_scheduler.h"
+#include "trace.h"
+#include "y4m_writer.h"
+
+//what a renderer renders with: one OpenCL device, the CPU backend, or all
+//OpenCL devices and sub-devices at once
+#define RENDERER_BACKEND_OPENCL 0
+#define RENDERER_BACKEND_CPU 1
+#define RENDERER_BACKEND_MULTI_DEVICE 2
+
+//a device, its context and its built kernel variants, kept warm for any
+//number of frames. The fields are private to renderer.c.
+typedef struct renderer renderer_t;
+
+typedef struct renderer_options {
+	//RENDERER_BACKEND_OPENCL, RENDERER_BACKEND_CPU or
+	//RENDERER_BACKEND_MULTI_DEVICE, whose devices are split as sub_devices
+	//says, see multi_device_init
+	int backend;
+	int sub_devices;
+
+	//the device to render on, or NULL for the first device of device_type
+	cl_device_id device_id;
+	cl_device_type device_type;
+
+	float abort_value;
+	int unroll;
+	int magnitude_squared;
+	int interior_check;
+
+	//PRECISION_AUTO to pick the tier of each frame from its pixel spacing,
+	//otherwise the tier of all frames
+	int precision;
+
+	//1 to keep the built programs on disk, in program_cache_dir or the
+	//directory program_cache_init chooses if it is NULL
+	int use_program_cache;
+	const char * program_cache_dir;
+
+	//how the float frames are calculated: iterations and colors in one
+	//kernel, with the subdivision (and brute force next to it), with the
+	//persistent kernel, or coarse to fine with previews
+	int fused_kernel;
+	int subdivide;
+	int brute_force;
+	int persistent;
+	int progressive;
+
+	//COLORING_LINEAR or a palette coloring of the iteration values
+	int coloring;
+
+	//directory of the iteration cache and its size, or NULL for no cache
+	const char * iteration_cache_dir;
+	long long iteration_cache_bytes;
+
+	//timeline the commands of the frames are traced into, or NULL
+	trace_t * trace;
+} renderer_options_t;
+
+//a frame for renderer_enqueue_frame: what is calculated and where it goes
+typedef struct renderer_frame {
+	//number of the frame, for the trace and the previews
+	long number;
+
+	double x_min;
+	double x_max;
+	double y_min;
+	double y_max;
+	long x_mon;
+	long y_mon;
+	long itr;
+
+	//the deep zoom the frame is calculated around, or NULL
+	perturbation_t * perturbation;
+
+	//the calculated exponential map the frame is taken from, or NULL
+	const exp_map_t * map;
+
+	//1 to convert the frame to YUV 4:2:0 for a video stream. Only the
+	//OpenCL backend converts, the others always leave the colors.
+	int yuv;
+
+	//where the frame is read back to: the mapped bmp file, the memory of
+	//the caller, or the host buffer of its slot if both are NULL
+	mapped_bmp_t * output;
+	unsigned char * image;
+
+	//takes the previews of a progressive frame. Without it the frame is
+	//calculated at once.
+	progressive_sink_t preview;
+	void * preview_context;
+
+	//1 to read back the iteration values, which are left in values until
+	//the next frame is enqueued
+	int export_values;
+	const void * values;
+	int value_bits;
+} renderer_frame_t;
+
+cl_device_id renderer_find_device(const cl_device_type device_type,
+		cl_int * err);
+void renderer_options_init(renderer_options_t * options);
+renderer_t * renderer_create(const renderer_options_t * options,
+		cl_int * err);
+cl_int renderer_enqueue_frame(renderer_t * renderer,
+		renderer_frame_t * frame, frame_slot_t * slot);
+cl_int renderer_wait_frame(renderer_t * renderer, frame_slot_t * slot);
+cl_int renderer_render(renderer_t * renderer, const double x_min,
+		const double x_max, const double y_min, const double y_max,
+		const long x_mon, const long y_mon, const long itr,
+		unsigned char * image);
+cl_int renderer_render_exp_map(renderer_t * renderer, exp_map_t * map);
+void renderer_device_name(renderer_t * renderer, char * name,
+		const size_t size);
+void renderer_print_stats(renderer_t * renderer);
+void renderer_release(renderer_t * renderer);
+
+#endif /* RENDERER_H_ */
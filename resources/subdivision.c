@@ -0,0 +1,316 @@
+/*
+ * subdivision.c
+ *
+ *      Author: Felix Paetow
+ */
+
+#include "subdivision.h"
+
+//iteration value of a point that hasn't been calculated yet
+#define SUBDIVISION_UNKNOWN -1
+
+//iteration value of a point that is calculated in the current pass
+#define SUBDIVISION_PENDING -2
+
+/**
+ * Initializes the subdivision renderer for a resolution.
+ *
+ * @param subdivision The renderer.
+ * @param x_mon Resolution of the monitor on the horizontal axis.
+ * @param y_mon Resolution of the monitor on the vertical axis.
+ * @return 0 on success, otherwise -1.
+ */
+int subdivision_init(subdivision_t * subdivision, const long x_mon,
+		const long y_mon) {
+	subdivision->x_mon = x_mon;
+	subdivision->y_mon = y_mon;
+
+	// The rectangles of a pass don't overlap and have at least 2 x 2 pixels
+	// up to their right and bottom border
+	subdivision->capacity = x_mon * y_mon / 4 + 1;
+
+	subdivision->points = (cl_int *) malloc(sizeof(cl_int) * x_mon * y_mon);
+	subdivision->values = (long *) malloc(sizeof(long) * x_mon * y_mon);
+	subdivision->rects = (subdivision_rect_t *) malloc(
+			sizeof(subdivision_rect_t) * subdivision->capacity);
+	subdivision->next_rects = (subdivision_rect_t *) malloc(
+			sizeof(subdivision_rect_t) * subdivision->capacity);
+
+	subdivision->evaluated = 0;
+	subdivision->filled = 0;
+	subdivision->passes = 0;
+	subdivision->total_evaluated = 0;
+	subdivision->total_filled = 0;
+
+	if (subdivision->points == NULL || subdivision->values == NULL
+			|| subdivision->rects == NULL || subdivision->next_rects == NULL) {
+		subdivision_release(subdivision);
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * Adds a point to the points of the current pass, if it hasn't been
+ * calculated or added yet.
+ *
+ * @param subdivision The renderer.
+ * @param imagevalues The iteration values.
+ * @param count The number of points of the pass.
+ * @param x The position in the row.
+ * @param y The row, counted from the top.
+ */
+static void subdivision_add_point(subdivision_t * subdivision,
+		long * imagevalues, long * count, const long x, const long y) {
+	long i = y * subdivision->x_mon + x;
+
+	if (imagevalues[i] == SUBDIVISION_UNKNOWN) {
+		imagevalues[i] = SUBDIVISION_PENDING;
+		subdivision->points[(*count)++] = (cl_int) i;
+	}
+}
+
+/**
+ * Tests if a rectangle is too small to be split again.
+ *
+ * @param r The rectangle.
+ * @return 1 if all its points are calculated, otherwise 0.
+ */
+static int subdivision_is_small(const subdivision_rect_t * r) {
+	return r->x1 - r->x0 < SUBDIVISION_MIN_SIZE
+			|| r->y1 - r->y0 < SUBDIVISION_MIN_SIZE;
+}
+
+/**
+ * Returns the iteration value all border points of a rectangle share.
+ *
+ * @param subdivision The renderer.
+ * @param imagevalues The iteration values.
+ * @param r The rectangle.
+ * @return The iteration value or -1 if the border isn't uniform.
+ */
+static long subdivision_border_value(const subdivision_t * subdivision,
+		const long * imagevalues, const subdivision_rect_t * r) {
+	const long x_mon = subdivision->x_mon;
+	long value = imagevalues[r->y0 * x_mon + r->x0];
+
+	for (long x = r->x0; x <= r->x1; ++x) {
+		if (imagevalues[r->y0 * x_mon + x] != value
+				|| imagevalues[r->y1 * x_mon + x] != value) {
+			return -1;
+		}
+	}
+	for (long y = r->y0 + 1; y < r->y1; ++y) {
+		if (imagevalues[y * x_mon + r->x0] != value
+				|| imagevalues[y * x_mon + r->x1] != value) {
+			return -1;
+		}
+	}
+
+	return value;
+}
+
+/**
+ * Calculates the iteration values of a frame with the Mariani-Silver
+ * algorithm.
+ *
+ * The Mandelbrot set and the bands of equal iteration values around it are
+ * connected, so a rectangle whose border has only one iteration value has
+ * that value inside as well. Starting with the whole image, only the borders
+ * of the rectangles are calculated. A rectangle with a uniform border is
+ * filled, any other is split into four which share their inner borders.
+ * Small rectangles are calculated completely.
+ *
+ * Each pass hands the points of all rectangles of one level to evaluate in
+ * a single batch, so a device gets enough work-items per launch.
+ *
+ * @param subdivision The renderer.
+ * @param imagevalues The iteration values, x_mon * y_mon of them.
+ * @param evaluate Calculates the iteration values of a list of points.
+ * @param context Passed on to evaluate.
+ * @return CL_SUCCESS or the error code of evaluate.
+ */
+cl_int subdivision_render(subdivision_t * subdivision, long * imagevalues,
+		subdivision_evaluate_t evaluate, void * context) {
+	const long x_mon = subdivision->x_mon;
+	const long y_mon = subdivision->y_mon;
+	long number_rects = 1;
+	cl_int err = CL_SUCCESS;
+
+	for (long i = 0; i < x_mon * y_mon; ++i) {
+		imagevalues[i] = SUBDIVISION_UNKNOWN;
+	}
+
+	subdivision->rects[0].x0 = 0;
+	subdivision->rects[0].y0 = 0;
+	subdivision->rects[0].x1 = x_mon - 1;
+	subdivision->rects[0].y1 = y_mon - 1;
+
+	subdivision->evaluated = 0;
+	subdivision->filled = 0;
+	subdivision->passes = 0;
+
+	while (number_rects > 0) {
+		long count = 0;
+		long number_next_rects = 0;
+
+		// Collect the points of this level
+		for (long r = 0; r < number_rects; ++r) {
+			const subdivision_rect_t * rect = &subdivision->rects[r];
+
+			for (long x = rect->x0; x <= rect->x1; ++x) {
+				subdivision_add_point(subdivision, imagevalues, &count, x,
+						rect->y0);
+				subdivision_add_point(subdivision, imagevalues, &count, x,
+						rect->y1);
+			}
+			for (long y = rect->y0 + 1; y < rect->y1; ++y) {
+				subdivision_add_point(subdivision, imagevalues, &count,
+						rect->x0, y);
+				subdivision_add_point(subdivision, imagevalues, &count,
+						rect->x1, y);
+			}
+
+			if (subdivision_is_small(rect)) {
+				for (long y = rect->y0 + 1; y < rect->y1; ++y) {
+					for (long x = rect->x0 + 1; x < rect->x1; ++x) {
+						subdivision_add_point(subdivision, imagevalues, &count,
+								x, y);
+					}
+				}
+			}
+		}
+
+		if (count > 0) {
+			err = evaluate(context, subdivision->points, count,
+					subdivision->values);
+			if (err != CL_SUCCESS) {
+				return err;
+			}
+
+			for (long p = 0; p < count; ++p) {
+				imagevalues[subdivision->points[p]] = subdivision->values[p];
+			}
+			subdivision->evaluated += count;
+		}
+
+		// Fill or split the rectangles
+		for (long r = 0; r < number_rects; ++r) {
+			const subdivision_rect_t * rect = &subdivision->rects[r];
+
+			if (subdivision_is_small(rect)) {
+				continue;
+			}
+
+			long value = subdivision_border_value(subdivision, imagevalues,
+					rect);
+			if (value >= 0) {
+				for (long y = rect->y0 + 1; y < rect->y1; ++y) {
+					for (long x = rect->x0 + 1; x < rect->x1; ++x) {
+						imagevalues[y * x_mon + x] = value;
+					}
+				}
+				subdivision->filled += (rect->x1 - rect->x0 - 1)
+						* (rect->y1 - rect->y0 - 1);
+				continue;
+			}
+
+			long x_mid = (rect->x0 + rect->x1) / 2;
+			long y_mid = (rect->y0 + rect->y1) / 2;
+			subdivision_rect_t * next =
+					&subdivision->next_rects[number_next_rects];
+
+			next[0] = *rect;
+			next[0].x1 = x_mid;
+			next[0].y1 = y_mid;
+
+			next[1] = *rect;
+			next[1].x0 = x_mid;
+			next[1].y1 = y_mid;
+
+			next[2] = *rect;
+			next[2].x1 = x_mid;
+			next[2].y0 = y_mid;
+
+			next[3] = *rect;
+			next[3].x0 = x_mid;
+			next[3].y0 = y_mid;
+
+			number_next_rects += 4;
+		}
+
+		subdivision_rect_t * rects = subdivision->rects;
+		subdivision->rects = subdivision->next_rects;
+		subdivision->next_rects = rects;
+		number_rects = number_next_rects;
+
+		subdivision->passes++;
+	}
+
+	subdivision->total_evaluated += subdivision->evaluated;
+	subdivision->total_filled += subdivision->filled;
+
+	return CL_SUCCESS;
+}
+
+/**
+ * Compares the iteration values of a frame with the ones of the brute-force
+ * renderer and prints how many differ.
+ *
+ * @param frame The number of the frame.
+ * @param imagevalues The iteration values of the frame.
+ * @param brute_force The iteration values of every point calculated.
+ * @param value_bits The width of the brute-force values.
+ * @param size The number of points.
+ * @return The number of points that differ.
+ */
+long subdivision_compare_brute_force(const long frame,
+		const long * imagevalues, const void * brute_force,
+		const int value_bits, const long size) {
+	long differences = 0;
+
+	for (long i = 0; i < size; ++i) {
+		if (imagevalues[i]
+				!= iteration_values_get(brute_force, value_bits, i)) {
+			differences++;
+		}
+	}
+
+	if (differences > 0) {
+		printf("Frame %ld: %ld of %ld points differ from brute force\n",
+				frame + 1, differences, size);
+	}
+
+	return differences;
+}
+
+/**
+ * Prints how many points were calculated and how many were filled.
+ *
+ * @param subdivision The renderer.
+ */
+void subdivision_print_stats(const subdivision_t * subdivision) {
+	long total = subdivision->total_evaluated + subdivision->total_filled;
+
+	printf("Subdivision: %ld points calculated, %ld filled (%.1f%% saved)\n",
+			subdivision->total_evaluated, subdivision->total_filled,
+			total > 0 ? 100.0 * subdivision->total_filled / total : 0.0);
+}
+
+/**
+ * Frees the memory of the renderer.
+ *
+ * @param subdivision The renderer.
+ */
+void subdivision_release(subdivision_t * subdivision) {
+	free(subdivision->points);
+	free(subdivision->values);
+	free(subdivision->rects);
+	free(subdivision->next_rects);
+
+	subdivision->points = NULL;
+	subdivision->values = NULL;
+	subdivision->rects = NULL;
+	subdivision->next_rects = NULL;
+}
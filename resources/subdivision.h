@@ -0,0 +1,71 @@
+/*
+ * subdivision.h
+ *
+ *      Author: Felix Paetow
+ */
+
+#ifndef SUBDIVISION_H_
+#define SUBDIVISION_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#ifdef __APPLE__
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+#include "iteration_values.h"
+
+//rectangles with less than this many pixels between two borders are
+//calculated completely instead of being split again
+#define SUBDIVISION_MIN_SIZE 4
+
+/**
+ * Calculates the iteration values of a list of points.
+ *
+ * @param context The context given to subdivision_render.
+ * @param points The positions y * x_mon + x of the points.
+ * @param count The number of points.
+ * @param values The iteration values, in the order of the points.
+ * @return CL_SUCCESS or an error code.
+ */
+typedef cl_int (*subdivision_evaluate_t)(void * context,
+		const cl_int * points, const long count, long * values);
+
+typedef struct subdivision_rect {
+	long x0;
+	long y0;
+	long x1;
+	long y1;
+} subdivision_rect_t;
+
+typedef struct subdivision {
+	long x_mon;
+	long y_mon;
+	cl_int * points;
+	long * values;
+	subdivision_rect_t * rects;
+	subdivision_rect_t * next_rects;
+	long capacity;
+
+	//statistics of the last frame
+	long evaluated;
+	long filled;
+	int passes;
+
+	//statistics of all frames
+	long total_evaluated;
+	long total_filled;
+} subdivision_t;
+
+int subdivision_init(subdivision_t * subdivision, const long x_mon,
+		const long y_mon);
+cl_int subdivision_render(subdivision_t * subdivision, long * imagevalues,
+		subdivision_evaluate_t evaluate, void * context);
+long subdivision_compare_brute_force(const long frame,
+		const long * imagevalues, const void * brute_force,
+		const int value_bits, const long size);
+void subdivision_print_stats(const subdivision_t * subdivision);
+void subdivision_release(subdivision_t * subdivision);
+
+#endif /* SUBDIVISION_H_ */
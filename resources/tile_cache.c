@@ -0,0 +1,287 @@
+/*
+ * tile_cache.c
+ *
+ *      Author: Felix Paetow
+ */
+
+#include "tile_cache.h"
+
+/**
+ * Returns the bucket of a tile in the hash table.
+ *
+ * @param cache The cache.
+ * @param key The tile.
+ * @return The index of the bucket.
+ */
+static long tile_cache_bucket(const tile_cache_t * cache,
+		const tile_key_t * key) {
+	unsigned long hash = (unsigned long) key->zoom;
+
+	hash = hash * 1000003UL ^ (unsigned long) key->x;
+	hash = hash * 1000003UL ^ (unsigned long) key->y;
+	hash = hash * 1000003UL ^ (unsigned long) key->itr;
+	hash ^= hash >> 29;
+
+	return (long) (hash % (unsigned long) cache->number_buckets);
+}
+
+/**
+ * Compares two tiles.
+ *
+ * @param a The first tile.
+ * @param b The second tile.
+ * @return 1 if they are the same tile, otherwise 0.
+ */
+static int tile_key_equal(const tile_key_t * a, const tile_key_t * b) {
+	return a->zoom == b->zoom && a->x == b->x && a->y == b->y
+			&& a->itr == b->itr;
+}
+
+/**
+ * Takes a finished tile out of the least recently used list.
+ *
+ * @param cache The cache.
+ * @param entry The tile.
+ */
+static void tile_cache_unlink(tile_cache_t * cache, tile_entry_t * entry) {
+	if (entry->newer != NULL) {
+		entry->newer->older = entry->older;
+	} else {
+		cache->newest = entry->older;
+	}
+	if (entry->older != NULL) {
+		entry->older->newer = entry->newer;
+	} else {
+		cache->oldest = entry->newer;
+	}
+	entry->newer = NULL;
+	entry->older = NULL;
+}
+
+/**
+ * Puts a finished tile at the front of the least recently used list.
+ *
+ * @param cache The cache.
+ * @param entry The tile.
+ */
+static void tile_cache_push(tile_cache_t * cache, tile_entry_t * entry) {
+	entry->newer = NULL;
+	entry->older = cache->newest;
+	if (cache->newest != NULL) {
+		cache->newest->newer = entry;
+	} else {
+		cache->oldest = entry;
+	}
+	cache->newest = entry;
+}
+
+/**
+ * Takes a tile out of the cache. It is freed as soon as no caller holds it
+ * any more.
+ *
+ * @param cache The cache.
+ * @param entry The tile.
+ */
+static void tile_cache_remove(tile_cache_t * cache, tile_entry_t * entry) {
+	tile_entry_t ** link = &cache->buckets[tile_cache_bucket(cache,
+			&entry->key)];
+
+	while (*link != entry) {
+		link = &(*link)->next_in_bucket;
+	}
+	*link = entry->next_in_bucket;
+
+	// Only finished tiles are in the list
+	if (entry->data != NULL) {
+		tile_cache_unlink(cache, entry);
+	}
+	entry->detached = 1;
+	cache->count--;
+
+	if (entry->users == 0) {
+		free(entry->data);
+		free(entry);
+	}
+}
+
+/**
+ * Initializes an empty cache of encoded tiles.
+ *
+ * The cache holds up to capacity tiles and evicts the least recently used
+ * one for a new tile. A tile that is rendered right now is in the cache as
+ * well, so callers asking for it wait for it instead of rendering it again.
+ *
+ * @param cache The cache.
+ * @param capacity The number of tiles the cache holds.
+ * @return 0 on success, otherwise -1.
+ */
+int tile_cache_init(tile_cache_t * cache, const long capacity) {
+	cache->capacity = (capacity < 1) ? 1 : capacity;
+	cache->number_buckets = cache->capacity * 2 + 1;
+	cache->buckets = (tile_entry_t **) calloc(cache->number_buckets,
+			sizeof(tile_entry_t *));
+	if (cache->buckets == NULL) {
+		return -1;
+	}
+
+	cache->count = 0;
+	cache->newest = NULL;
+	cache->oldest = NULL;
+	cache->hits = 0;
+	cache->misses = 0;
+	cache->shared = 0;
+	cache->evictions = 0;
+
+	pthread_mutex_init(&cache->lock, NULL);
+	pthread_cond_init(&cache->filled, NULL);
+
+	return 0;
+}
+
+/**
+ * Looks up a tile and holds it until tile_cache_release_entry.
+ *
+ * If the tile isn't in the cache, an empty entry is added for it and the
+ * caller has to render the tile and hand it over with tile_cache_fill. If
+ * another caller is rendering the tile, this call waits for it.
+ *
+ * @param cache The cache.
+ * @param key The tile.
+ * @param found Set to TILE_CACHE_HIT, TILE_CACHE_MISS or TILE_CACHE_SHARED.
+ * @return The entry, whose data is NULL if rendering the tile failed, or
+ *         NULL if there is no memory for a new entry.
+ */
+tile_entry_t * tile_cache_acquire(tile_cache_t * cache,
+		const tile_key_t * key, int * found) {
+	long bucket = tile_cache_bucket(cache, key);
+	tile_entry_t * entry;
+
+	pthread_mutex_lock(&cache->lock);
+
+	for (entry = cache->buckets[bucket]; entry != NULL;
+			entry = entry->next_in_bucket) {
+		if (tile_key_equal(&entry->key, key)) {
+			break;
+		}
+	}
+
+	if (entry != NULL) {
+		entry->users++;
+		if (entry->pending) {
+			while (entry->pending) {
+				pthread_cond_wait(&cache->filled, &cache->lock);
+			}
+			*found = TILE_CACHE_SHARED;
+			cache->shared++;
+		} else {
+			tile_cache_unlink(cache, entry);
+			tile_cache_push(cache, entry);
+			*found = TILE_CACHE_HIT;
+			cache->hits++;
+		}
+		pthread_mutex_unlock(&cache->lock);
+		return entry;
+	}
+
+	// Tiles being rendered aren't in the list, so they stay
+	while (cache->count >= cache->capacity && cache->oldest != NULL) {
+		tile_cache_remove(cache, cache->oldest);
+		cache->evictions++;
+	}
+
+	entry = (tile_entry_t *) calloc(1, sizeof(tile_entry_t));
+	if (entry != NULL) {
+		entry->key = *key;
+		entry->pending = 1;
+		entry->users = 1;
+		entry->next_in_bucket = cache->buckets[bucket];
+		cache->buckets[bucket] = entry;
+		cache->count++;
+		cache->misses++;
+		*found = TILE_CACHE_MISS;
+	}
+
+	pthread_mutex_unlock(&cache->lock);
+
+	return entry;
+}
+
+/**
+ * Hands over a rendered tile and wakes the callers waiting for it.
+ *
+ * @param cache The cache.
+ * @param entry The entry of the tile, acquired with TILE_CACHE_MISS.
+ * @param data The encoded tile, owned by the cache from now on, or NULL if
+ *        rendering failed. A failed tile is taken out of the cache, so the
+ *        next caller tries again.
+ * @param size The size of data in bytes.
+ */
+void tile_cache_fill(tile_cache_t * cache, tile_entry_t * entry,
+		unsigned char * data, const long size) {
+	pthread_mutex_lock(&cache->lock);
+
+	entry->data = data;
+	entry->size = (data != NULL) ? size : 0;
+	entry->pending = 0;
+	if (data != NULL) {
+		tile_cache_push(cache, entry);
+	} else {
+		tile_cache_remove(cache, entry);
+	}
+
+	pthread_cond_broadcast(&cache->filled);
+	pthread_mutex_unlock(&cache->lock);
+}
+
+/**
+ * Lets go of a tile acquired with tile_cache_acquire.
+ *
+ * @param cache The cache.
+ * @param entry The entry of the tile.
+ */
+void tile_cache_release_entry(tile_cache_t * cache, tile_entry_t * entry) {
+	pthread_mutex_lock(&cache->lock);
+
+	entry->users--;
+	if (entry->detached && entry->users == 0) {
+		free(entry->data);
+		free(entry);
+	}
+
+	pthread_mutex_unlock(&cache->lock);
+}
+
+/**
+ * Prints how the tiles were found.
+ *
+ * @param cache The cache.
+ */
+void tile_cache_print_stats(const tile_cache_t * cache) {
+	printf("Tile cache: %ld hits, %ld misses, %ld shared, %ld evictions, "
+			"%ld of %ld tiles\n", cache->hits, cache->misses, cache->shared,
+			cache->evictions, cache->count, cache->capacity);
+}
+
+/**
+ * Frees all tiles of the cache. No caller may hold a tile any more.
+ *
+ * @param cache The cache.
+ */
+void tile_cache_release(tile_cache_t * cache) {
+	for (long i = 0; i < cache->number_buckets; ++i) {
+		tile_entry_t * entry = cache->buckets[i];
+
+		while (entry != NULL) {
+			tile_entry_t * next = entry->next_in_bucket;
+			free(entry->data);
+			free(entry);
+			entry = next;
+		}
+	}
+	free(cache->buckets);
+	cache->buckets = NULL;
+	cache->count = 0;
+
+	pthread_mutex_destroy(&cache->lock);
+	pthread_cond_destroy(&cache->filled);
+}
@@ -0,0 +1,73 @@
+/*
+ * tile_cache.h
+ *
+ *      Author: Felix Paetow
+ */
+
+#ifndef TILE_CACHE_H_
+#define TILE_CACHE_H_
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+//what tile_cache_acquire found: the encoded tile, nothing so the caller
+//renders it, or a tile another caller rendered while this one waited
+#define TILE_CACHE_HIT 0
+#define TILE_CACHE_MISS 1
+#define TILE_CACHE_SHARED 2
+
+typedef struct tile_key {
+	int zoom;
+	long x;
+	long y;
+	long itr;
+} tile_key_t;
+
+typedef struct tile_entry {
+	tile_key_t key;
+
+	//encoded tile, NULL while it is rendered or if rendering failed
+	unsigned char * data;
+	long size;
+	int pending;
+
+	//callers holding the entry, which is only freed once they are done
+	int users;
+	int detached;
+
+	//bucket of the hash table and least recently used list
+	struct tile_entry * next_in_bucket;
+	struct tile_entry * newer;
+	struct tile_entry * older;
+} tile_entry_t;
+
+typedef struct tile_cache {
+	tile_entry_t ** buckets;
+	long number_buckets;
+	long capacity;
+	long count;
+
+	//the most and the least recently used finished tiles
+	tile_entry_t * newest;
+	tile_entry_t * oldest;
+
+	pthread_mutex_t lock;
+	pthread_cond_t filled;
+
+	long hits;
+	long misses;
+	long shared;
+	long evictions;
+} tile_cache_t;
+
+int tile_cache_init(tile_cache_t * cache, const long capacity);
+tile_entry_t * tile_cache_acquire(tile_cache_t * cache,
+		const tile_key_t * key, int * found);
+void tile_cache_fill(tile_cache_t * cache, tile_entry_t * entry,
+		unsigned char * data, const long size);
+void tile_cache_release_entry(tile_cache_t * cache, tile_entry_t * entry);
+void tile_cache_print_stats(const tile_cache_t * cache);
+void tile_cache_release(tile_cache_t * cache);
+
+#endif /* TILE_CACHE_H_ */
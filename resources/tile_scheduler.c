@@ -0,0 +1,136 @@
+/*
+ * tile_scheduler.c
+ *
+ *      Author: Felix Paetow
+ */
+
+#include "tile_scheduler.h"
+
+/**
+ * Sizes the persistent kernel for a device.
+ *
+ * The persistent kernel isn't launched with one work-item per pixel. It
+ * starts just enough work-groups to fill the compute units, and each
+ * work-group takes small tiles from a global tile counter until the image
+ * is done. A group that got rows through the set takes fewer tiles than
+ * one that got rows escaping at once, so no compute unit idles while
+ * another still works through slow tiles.
+ *
+ * @param scheduler The scheduler.
+ * @param device_id The device.
+ * @return CL_SUCCESS or the error code of clGetDeviceInfo.
+ */
+cl_int tile_scheduler_init(tile_scheduler_t * scheduler,
+		cl_device_id device_id) {
+	cl_int err = clGetDeviceInfo(device_id, CL_DEVICE_MAX_COMPUTE_UNITS,
+			sizeof(cl_uint), &scheduler->compute_units, NULL);
+	if (err != CL_SUCCESS) {
+		return err;
+	}
+	if (scheduler->compute_units == 0) {
+		scheduler->compute_units = 1;
+	}
+	if (scheduler->compute_units > TILE_SCHEDULER_MAX_GROUPS) {
+		scheduler->compute_units = TILE_SCHEDULER_MAX_GROUPS;
+	}
+
+	scheduler->groups = scheduler->compute_units
+			* TILE_SCHEDULER_GROUPS_PER_UNIT;
+	if (scheduler->groups > TILE_SCHEDULER_MAX_GROUPS) {
+		scheduler->groups = TILE_SCHEDULER_MAX_GROUPS;
+	}
+	scheduler->local_size = TILE_SCHEDULER_TILE_WIDTH
+			* TILE_SCHEDULER_TILE_HEIGHT;
+	scheduler->global_size = scheduler->groups * scheduler->local_size;
+
+	memset(scheduler->group_work, 0, sizeof(scheduler->group_work));
+	scheduler->frames = 0;
+	scheduler->compute_ms = 0;
+
+	return CL_SUCCESS;
+}
+
+/**
+ * Counts a frame calculated with the persistent kernel.
+ *
+ * @param scheduler The scheduler.
+ * @param compute_ms The device time of the frame or a negative value if it
+ *        isn't known.
+ */
+void tile_scheduler_add_frame(tile_scheduler_t * scheduler,
+		const double compute_ms) {
+	scheduler->frames++;
+	if (compute_ms >= 0) {
+		scheduler->compute_ms += compute_ms;
+	}
+}
+
+/**
+ * Prints how the work was spread over the work-groups: the iterations each
+ * group calculated and the tiles it took, as the kernel counted them.
+ *
+ * OpenCL doesn't say which compute unit runs a work-group, and the kernel
+ * has no clock, so there is no busy time per compute unit. The imbalance
+ * is that of the iterations of the groups, the time is that of the whole
+ * kernel.
+ *
+ * @param scheduler The scheduler, with the work of the groups read back.
+ */
+void tile_scheduler_print_stats(const tile_scheduler_t * scheduler) {
+	cl_ulong max_work = 0;
+	cl_ulong min_work = 0;
+	cl_ulong max_tiles = 0;
+	cl_ulong min_tiles = 0;
+	double total_work = 0;
+	double total_tiles = 0;
+
+	if (scheduler->frames == 0) {
+		return;
+	}
+
+	for (size_t g = 0; g < scheduler->groups; ++g) {
+		cl_ulong work = scheduler->group_work[
+				g * TILE_SCHEDULER_GROUP_COUNTERS];
+		cl_ulong tiles = scheduler->group_work[
+				g * TILE_SCHEDULER_GROUP_COUNTERS + 1];
+
+		if (g == 0 || work > max_work) {
+			max_work = work;
+		}
+		if (g == 0 || work < min_work) {
+			min_work = work;
+		}
+		if (g == 0 || tiles > max_tiles) {
+			max_tiles = tiles;
+		}
+		if (g == 0 || tiles < min_tiles) {
+			min_tiles = tiles;
+		}
+		total_work += (double) work;
+		total_tiles += (double) tiles;
+	}
+
+	double mean_work = total_work / scheduler->groups;
+
+	printf("Tile scheduler: %ld frames, %zu work-groups on %u compute units, "
+			"%.2f ms\n", scheduler->frames, scheduler->groups,
+			scheduler->compute_units, scheduler->compute_ms);
+
+	if (scheduler->groups <= TILE_SCHEDULER_PRINT_GROUPS) {
+		for (size_t g = 0; g < scheduler->groups; ++g) {
+			printf("  work-group %zu: %llu tiles, %llu iterations\n", g,
+					(unsigned long long) scheduler->group_work[
+							g * TILE_SCHEDULER_GROUP_COUNTERS + 1],
+					(unsigned long long) scheduler->group_work[
+							g * TILE_SCHEDULER_GROUP_COUNTERS]);
+		}
+	}
+
+	printf("  tiles per work-group min %llu, max %llu, mean %.1f\n",
+			(unsigned long long) min_tiles, (unsigned long long) max_tiles,
+			total_tiles / scheduler->groups);
+	printf("  iterations per work-group min %llu, max %llu, imbalance %.3f "
+			"(max / mean)\n", (unsigned long long) min_work,
+			(unsigned long long) max_work,
+			mean_work > 0 ? (double) max_work / mean_work : 1.0);
+}
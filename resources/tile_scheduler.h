@@ -0,0 +1,59 @@
+/*
+ * tile_scheduler.h
+ *
+ *      Author: Felix Paetow
+ */
+
+#ifndef TILE_SCHEDULER_H_
+#define TILE_SCHEDULER_H_
+
+#include <stdio.h>
+#include <string.h>
+#ifdef __APPLE__
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+//size of the tiles the persistent kernel takes from the tile counter, one
+//work-item per pixel; same as PERSISTENT_TILE_WIDTH and _HEIGHT in the
+//kernel
+#define TILE_SCHEDULER_TILE_WIDTH 8
+#define TILE_SCHEDULER_TILE_HEIGHT 8
+
+//work-groups started per compute unit, so a unit has other groups to run
+//while one waits for memory
+#define TILE_SCHEDULER_GROUPS_PER_UNIT 4
+
+//greatest number of work-groups
+#define TILE_SCHEDULER_MAX_GROUPS 1024
+
+//greatest number of work-groups printed one by one
+#define TILE_SCHEDULER_PRINT_GROUPS 16
+
+//counters of each work-group in group_work: its iterations, then the tiles
+//it took
+#define TILE_SCHEDULER_GROUP_COUNTERS 2
+
+typedef struct tile_scheduler {
+	cl_uint compute_units;
+	size_t groups;
+	size_t local_size;
+	size_t global_size;
+
+	//iterations each work-group calculated and tiles it took, summed over
+	//all frames
+	cl_ulong group_work[TILE_SCHEDULER_GROUP_COUNTERS
+			* TILE_SCHEDULER_MAX_GROUPS];
+
+	long frames;
+	double compute_ms;
+} tile_scheduler_t;
+
+cl_int tile_scheduler_init(tile_scheduler_t * scheduler,
+		cl_device_id device_id);
+void tile_scheduler_add_frame(tile_scheduler_t * scheduler,
+		const double compute_ms);
+void tile_scheduler_print_stats(const tile_scheduler_t * scheduler);
+
+#endif /* TILE_SCHEDULER_H_ */
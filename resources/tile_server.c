@@ -0,0 +1,427 @@
+/*
+ * tile_server.c
+ *
+ *      Author: Felix Paetow
+ */
+
+#include "tile_server.h"
+
+typedef struct tile_connection {
+	tile_server_t * server;
+	int fd;
+} tile_connection_t;
+
+/**
+ * Returns the time of a monotonic clock.
+ *
+ * @return The time in milliseconds.
+ */
+static double tile_server_now_ms(void) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec * 1000.0 + now.tv_nsec / 1000000.0;
+}
+
+/**
+ * Sends all bytes of a reply.
+ *
+ * @param fd The connection.
+ * @param data The bytes.
+ * @param size The number of bytes.
+ * @return 0 on success, otherwise -1.
+ */
+static int tile_server_send(const int fd, const void * data,
+		const long size) {
+	const char * bytes = (const char *) data;
+	long sent = 0;
+
+	while (sent < size) {
+		ssize_t n = send(fd, bytes + sent, size - sent, MSG_NOSIGNAL);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			return -1;
+		}
+		sent += n;
+	}
+
+	return 0;
+}
+
+/**
+ * Renders a tile with the renderer and waits for it.
+ *
+ * The pixels of a tile are span / TILE_SERVER_SIZE apart, so the tiles of a
+ * level join without sharing their border pixels. The renderer picks the
+ * precision tier from that spacing.
+ *
+ * @param server The server, whose render lock is held.
+ * @param key The tile.
+ * @return CL_SUCCESS or the error code of the failed OpenCL call.
+ */
+static cl_int tile_server_render(tile_server_t * server,
+		const tile_key_t * key) {
+	const long size = TILE_SERVER_SIZE;
+	double span = TILE_SERVER_SPAN / (double) (1L << key->zoom);
+	double spacing = span / size;
+	double x_min = TILE_SERVER_X_MIN + key->x * span;
+	double y_max = TILE_SERVER_Y_MAX - key->y * span;
+	double x_max = x_min + spacing * (size - 1);
+	double y_min = y_max - spacing * (size - 1);
+
+	return renderer_render(server->renderer, x_min, x_max, y_min, y_max,
+			size, size, key->itr, server->image);
+}
+
+/**
+ * Renders a tile and encodes it as bmp file.
+ *
+ * The device renders one tile at a time. Tiles of other connections are
+ * rendered one after the other, while their hits are served meanwhile.
+ *
+ * @param server The server.
+ * @param key The tile.
+ * @param size Set to the size of the encoded tile in bytes.
+ * @return The encoded tile or NULL on error.
+ */
+static unsigned char * tile_server_encode(tile_server_t * server,
+		const tile_key_t * key, long * size) {
+	unsigned char * data;
+
+	*size = calculate_bmp_buffersize(TILE_SERVER_SIZE, TILE_SERVER_SIZE);
+	data = (unsigned char *) malloc(*size);
+	if (data == NULL) {
+		return NULL;
+	}
+
+	pthread_mutex_lock(&server->render_lock);
+	double start = tile_server_now_ms();
+	cl_int err = tile_server_render(server, key);
+	if (err == CL_SUCCESS) {
+		encode_image_to_bmp(TILE_SERVER_SIZE, TILE_SERVER_SIZE,
+				server->image, data);
+		server->rendered++;
+		server->render_ms += tile_server_now_ms() - start;
+	}
+	pthread_mutex_unlock(&server->render_lock);
+
+	if (err != CL_SUCCESS) {
+		fprintf(stderr, "Error: Failed to render tile %d/%ld/%ld: %d\n",
+				key->zoom, key->x, key->y, err);
+		free(data);
+		return NULL;
+	}
+
+	return data;
+}
+
+/**
+ * Answers a TILE request: the tile from the cache, or rendered, or taken
+ * from the connection that renders it already.
+ *
+ * @param server The server.
+ * @param fd The connection.
+ * @param key The tile.
+ * @return 0 on success, -1 if the connection failed.
+ */
+static int tile_server_send_tile(tile_server_t * server, const int fd,
+		const tile_key_t * key) {
+	static const char * found_names[] = { "hit", "miss", "shared" };
+	char header[TILE_SERVER_LINE_LENGTH];
+	int found;
+	int result;
+
+	tile_entry_t * entry = tile_cache_acquire(&server->cache, key, &found);
+	if (entry == NULL) {
+		return tile_server_send(fd, "ERR out of memory\n", 18);
+	}
+
+	if (found == TILE_CACHE_MISS) {
+		long size;
+		unsigned char * data = tile_server_encode(server, key, &size);
+		tile_cache_fill(&server->cache, entry, data, size);
+	}
+
+	if (entry->data == NULL) {
+		result = tile_server_send(fd, "ERR render failed\n", 18);
+	} else {
+		int length = snprintf(header, sizeof(header), "OK %ld %s\n",
+				entry->size, found_names[found]);
+		result = tile_server_send(fd, header, length);
+		if (result == 0) {
+			result = tile_server_send(fd, entry->data, entry->size);
+		}
+	}
+
+	tile_cache_release_entry(&server->cache, entry);
+
+	return result;
+}
+
+/**
+ * Answers one request line.
+ *
+ * @param server The server.
+ * @param fd The connection.
+ * @param line The request.
+ * @return 0 to go on with the connection, otherwise -1.
+ */
+static int tile_server_answer(tile_server_t * server, const int fd,
+		const char * line) {
+	char reply[TILE_SERVER_LINE_LENGTH * 2];
+	tile_key_t key;
+	int length;
+
+	if (sscanf(line, "TILE %d %ld %ld %ld", &key.zoom, &key.x, &key.y,
+			&key.itr) == 4) {
+		if (key.zoom < 0 || key.zoom > TILE_SERVER_MAX_ZOOM || key.x < 0
+				|| key.y < 0 || key.x >= (1L << key.zoom)
+				|| key.y >= (1L << key.zoom) || key.itr < 1
+				|| key.itr > TILE_SERVER_MAX_ITR) {
+			return tile_server_send(fd, "ERR no such tile\n", 17);
+		}
+		return tile_server_send_tile(server, fd, &key);
+	}
+
+	if (strncmp(line, "STATS", 5) == 0) {
+		pthread_mutex_lock(&server->cache.lock);
+		length = snprintf(reply, sizeof(reply),
+				"OK %ld hits %ld misses %ld shared %ld evictions %ld tiles\n",
+				server->cache.hits, server->cache.misses,
+				server->cache.shared, server->cache.evictions,
+				server->cache.count);
+		pthread_mutex_unlock(&server->cache.lock);
+		return tile_server_send(fd, reply, length);
+	}
+
+	if (strncmp(line, "QUIT", 4) == 0) {
+		// Wakes the accept loop, which shuts the other connections down
+		pthread_mutex_lock(&server->lock);
+		server->stopping = 1;
+		pthread_mutex_unlock(&server->lock);
+		shutdown(server->listen_fd, SHUT_RDWR);
+		tile_server_send(fd, "OK\n", 3);
+		return -1;
+	}
+
+	return tile_server_send(fd, "ERR unknown request\n", 20);
+}
+
+/**
+ * Serves the requests of one connection until it is closed.
+ *
+ * @param arg The tile_connection_t, freed by the thread.
+ * @return NULL.
+ */
+static void * tile_server_connection(void * arg) {
+	tile_connection_t * connection = (tile_connection_t *) arg;
+	tile_server_t * server = connection->server;
+	char line[TILE_SERVER_LINE_LENGTH];
+	int fd = connection->fd;
+	FILE * in = fdopen(dup(fd), "r");
+
+	free(connection);
+
+	while (in != NULL && fgets(line, sizeof(line), in) != NULL) {
+		pthread_mutex_lock(&server->lock);
+		server->requests++;
+		pthread_mutex_unlock(&server->lock);
+
+		if (tile_server_answer(server, fd, line) != 0) {
+			break;
+		}
+	}
+	if (in != NULL) {
+		fclose(in);
+	}
+
+	pthread_mutex_lock(&server->lock);
+	for (int i = 0; i < server->number_connections; ++i) {
+		if (server->connections[i] == fd) {
+			server->connections[i] =
+					server->connections[--server->number_connections];
+			break;
+		}
+	}
+	close(fd);
+	pthread_cond_signal(&server->idle);
+	pthread_mutex_unlock(&server->lock);
+
+	return NULL;
+}
+
+/**
+ * Starts a tile server on a unix socket.
+ *
+ * The server renders with a warm renderer, so a tile costs no more than its
+ * kernel. The tiles are addressed by zoom level, column, row and iterations,
+ * like the tiles of a slippy map, and are kept as encoded bmp files in an
+ * LRU cache.
+ *
+ * @param server The server.
+ * @param path The path of the socket, replaced if it exists.
+ * @param renderer The renderer the tiles are rendered with.
+ * @param cache_tiles The number of tiles the cache holds.
+ * @return 0 on success, otherwise -1.
+ */
+int tile_server_init(tile_server_t * server, const char * path,
+		renderer_t * renderer, const long cache_tiles) {
+	const long pixels = TILE_SERVER_SIZE * TILE_SERVER_SIZE;
+	struct sockaddr_un address;
+
+	if (strlen(path) >= sizeof(address.sun_path)) {
+		return -1;
+	}
+	memset(server, 0, sizeof(*server));
+	pthread_mutex_init(&server->lock, NULL);
+	pthread_cond_init(&server->idle, NULL);
+	pthread_mutex_init(&server->render_lock, NULL);
+	server->listen_fd = -1;
+	snprintf(server->path, sizeof(server->path), "%s", path);
+	server->renderer = renderer;
+
+	server->image = (unsigned char *) malloc(pixels * 3);
+	if (server->image == NULL
+			|| tile_cache_init(&server->cache, cache_tiles) != 0) {
+		tile_server_release(server);
+		return -1;
+	}
+
+	server->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (server->listen_fd < 0) {
+		tile_server_release(server);
+		return -1;
+	}
+
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	snprintf(address.sun_path, sizeof(address.sun_path), "%s", path);
+	unlink(path);
+	if (bind(server->listen_fd, (struct sockaddr *) &address,
+			sizeof(address)) != 0 || listen(server->listen_fd, 16) != 0) {
+		tile_server_release(server);
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * Accepts connections, each served by its own thread, until a connection
+ * sends QUIT. Returns once all connections are closed.
+ *
+ * The requests are lines of text:
+ * TILE zoom x y itr, answered with "OK size hit|miss|shared" and the bmp
+ * file of the tile, STATS, answered with the counters of the cache, and
+ * QUIT. Errors are answered with a line starting with ERR.
+ *
+ * @param server The server.
+ * @return 0 after QUIT, otherwise -1.
+ */
+int tile_server_run(tile_server_t * server) {
+	int result = 0;
+
+	printf("Serving %dx%d tiles on %s\n", TILE_SERVER_SIZE, TILE_SERVER_SIZE,
+			server->path);
+	fflush(stdout);
+
+	while (1) {
+		int fd = accept(server->listen_fd, NULL, NULL);
+
+		pthread_mutex_lock(&server->lock);
+		int stopping = server->stopping;
+		pthread_mutex_unlock(&server->lock);
+
+		if (stopping) {
+			if (fd >= 0) {
+				close(fd);
+			}
+			break;
+		}
+		if (fd < 0) {
+			if (errno == EINTR || errno == ECONNABORTED) {
+				continue;
+			}
+			result = -1;
+			break;
+		}
+
+		tile_connection_t * connection = (tile_connection_t *) malloc(
+				sizeof(tile_connection_t));
+		pthread_t thread;
+
+		pthread_mutex_lock(&server->lock);
+		if (connection == NULL
+				|| server->number_connections == TILE_SERVER_MAX_CONNECTIONS) {
+			pthread_mutex_unlock(&server->lock);
+			tile_server_send(fd, "ERR busy\n", 9);
+			close(fd);
+			free(connection);
+			continue;
+		}
+		connection->server = server;
+		connection->fd = fd;
+		if (pthread_create(&thread, NULL, tile_server_connection, connection)
+				!= 0) {
+			pthread_mutex_unlock(&server->lock);
+			close(fd);
+			free(connection);
+			continue;
+		}
+		server->connections[server->number_connections++] = fd;
+		pthread_detach(thread);
+		pthread_mutex_unlock(&server->lock);
+	}
+
+	// The open connections stop at their next read
+	pthread_mutex_lock(&server->lock);
+	for (int i = 0; i < server->number_connections; ++i) {
+		shutdown(server->connections[i], SHUT_RD);
+	}
+	while (server->number_connections > 0) {
+		pthread_cond_wait(&server->idle, &server->lock);
+	}
+	pthread_mutex_unlock(&server->lock);
+
+	return result;
+}
+
+/**
+ * Prints the requests, the rendered tiles and the cache.
+ *
+ * @param server The server.
+ */
+void tile_server_print_stats(tile_server_t * server) {
+	printf("Tile server: %ld requests, %ld tiles rendered", server->requests,
+			server->rendered);
+	if (server->rendered > 0) {
+		printf(" in %.2f ms on average", server->render_ms / server->rendered);
+	}
+	printf("\n");
+	tile_cache_print_stats(&server->cache);
+}
+
+/**
+ * Closes the socket and releases the image and the cache of the server. The
+ * renderer is left to the caller.
+ *
+ * @param server The server.
+ */
+void tile_server_release(tile_server_t * server) {
+	if (server->listen_fd >= 0) {
+		close(server->listen_fd);
+		unlink(server->path);
+		server->listen_fd = -1;
+	}
+	free(server->image);
+	server->image = NULL;
+	if (server->cache.buckets != NULL) {
+		tile_cache_release(&server->cache);
+	}
+	pthread_mutex_destroy(&server->lock);
+	pthread_cond_destroy(&server->idle);
+	pthread_mutex_destroy(&server->render_lock);
+}
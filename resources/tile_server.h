@@ -0,0 +1,85 @@
+/*
+ * tile_server.h
+ *
+ *      Author: Felix Paetow
+ */
+
+#ifndef TILE_SERVER_H_
+#define TILE_SERVER_H_
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __APPLE__
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+#include "mybmpwriter.h"
+#include "renderer.h"
+#include "tile_cache.h"
+
+//edge length of a tile in pixels
+#define TILE_SERVER_SIZE 256
+
+//the tile of zoom level 0 covers this square of the plane, each level
+//splits every tile into 4. The map is z^2 - c, so the square is centered
+//on the mirrored set, which spans -0.25 to 2 on the real axis.
+#define TILE_SERVER_X_MIN -0.875
+#define TILE_SERVER_Y_MAX 2.0
+#define TILE_SERVER_SPAN 4.0
+
+//deepest zoom level, where double still tells the pixels apart
+#define TILE_SERVER_MAX_ZOOM 40
+
+//greatest number of iterations a tile may ask for
+#define TILE_SERVER_MAX_ITR 1000000
+
+//connections served at the same time
+#define TILE_SERVER_MAX_CONNECTIONS 64
+
+//longest request line
+#define TILE_SERVER_LINE_LENGTH 128
+
+//the replies are sent without SIGPIPE if the viewer has gone, where the
+//system can
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+typedef struct tile_server {
+	int listen_fd;
+	char path[108];
+	int stopping;
+
+	//open connections, shut down when the server stops
+	int connections[TILE_SERVER_MAX_CONNECTIONS];
+	int number_connections;
+	pthread_mutex_t lock;
+	pthread_cond_t idle;
+
+	//warm renderer and the image it renders into, used by one connection
+	//at a time
+	renderer_t * renderer;
+	unsigned char * image;
+	pthread_mutex_t render_lock;
+
+	tile_cache_t cache;
+	long rendered;
+	double render_ms;
+	long requests;
+} tile_server_t;
+
+int tile_server_init(tile_server_t * server, const char * path,
+		renderer_t * renderer, const long cache_tiles);
+int tile_server_run(tile_server_t * server);
+void tile_server_print_stats(tile_server_t * server);
+void tile_server_release(tile_server_t * server);
+
+#endif /* TILE_SERVER_H_ */
@@ -0,0 +1,272 @@
+/*
+ * trace.c
+ *
+ *      Author: Felix Paetow
+ */
+
+#include "trace.h"
+
+/**
+ * Returns the time of a monotonic clock.
+ *
+ * @return The time in microseconds.
+ */
+static double trace_now_us(void) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec * 1000000.0 + now.tv_nsec / 1000.0;
+}
+
+/**
+ * Writes a complete event to the trace file.
+ *
+ * @param trace The trace.
+ * @param name The name of the span.
+ * @param category "host" or "device".
+ * @param frame The number of the frame or a negative value for none.
+ * @param track The track of the span.
+ * @param start_us The host time the span started at.
+ * @param end_us The host time the span ended at.
+ */
+static void trace_write_span(trace_t * trace, const char * name,
+		const char * category, const long frame, const int track,
+		const double start_us, const double end_us) {
+	pthread_mutex_lock(&trace->lock);
+	fprintf(trace->file, ",\n{\"name\": \"%s\", \"cat\": \"%s\", "
+			"\"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, "
+			"\"dur\": %.3f", name, category, track, start_us - trace->origin_us,
+			(end_us > start_us) ? end_us - start_us : 0);
+	if (frame >= 0) {
+		fprintf(trace->file, ", \"args\": {\"frame\": %ld}", frame);
+	}
+	fprintf(trace->file, "}");
+	pthread_mutex_unlock(&trace->lock);
+}
+
+/**
+ * Writes a finished device event as span and releases it.
+ *
+ * The device clock is mapped onto the host clock by the first event: it was
+ * queued when clEnqueue... returned, which is taken as the host time of its
+ * CL_PROFILING_COMMAND_QUEUED.
+ *
+ * @param trace The trace.
+ * @param pending The event.
+ */
+static void trace_write_event(trace_t * trace, trace_pending_t * pending) {
+	cl_ulong queued;
+	cl_ulong start;
+	cl_ulong end;
+
+	if (clGetEventProfilingInfo(pending->event, CL_PROFILING_COMMAND_QUEUED,
+			sizeof(queued), &queued, NULL) == CL_SUCCESS
+			&& clGetEventProfilingInfo(pending->event,
+					CL_PROFILING_COMMAND_START, sizeof(start), &start, NULL)
+					== CL_SUCCESS
+			&& clGetEventProfilingInfo(pending->event,
+					CL_PROFILING_COMMAND_END, sizeof(end), &end, NULL)
+					== CL_SUCCESS) {
+		if (!trace->calibrated) {
+			trace->device_offset_us = pending->enqueued_us - queued / 1000.0;
+			trace->calibrated = 1;
+		}
+		trace_write_span(trace, pending->name, "device", pending->frame,
+				pending->track, start / 1000.0 + trace->device_offset_us,
+				end / 1000.0 + trace->device_offset_us);
+		trace->device_spans++;
+	}
+	clReleaseEvent(pending->event);
+}
+
+/**
+ * Opens a trace, which records host spans and OpenCL events of the frames
+ * and writes them as timeline in the JSON array format of the Chrome trace
+ * viewer, which Perfetto reads as well. The array is written as the spans
+ * come in and may lack its closing bracket, which the format allows, so
+ * the timeline of a run that stopped early can still be read.
+ *
+ * Without a path the trace is disabled: no clock is read and every call
+ * returns at once.
+ *
+ * @param trace The trace.
+ * @param path The file to write or NULL to disable the trace.
+ * @return 0 on success, otherwise -1.
+ */
+int trace_init(trace_t * trace, const char * path) {
+	trace->enabled = 0;
+	trace->path = path;
+	trace->file = NULL;
+	trace->calibrated = 0;
+	trace->device_offset_us = 0;
+	trace->number_pending = 0;
+	trace->host_spans = 0;
+	trace->device_spans = 0;
+
+	if (path == NULL) {
+		return 0;
+	}
+
+	trace->file = fopen(path, "w");
+	if (trace->file == NULL) {
+		return -1;
+	}
+	pthread_mutex_init(&trace->lock, NULL);
+	trace->origin_us = trace_now_us();
+	trace->enabled = 1;
+
+	fprintf(trace->file, "[{\"name\": \"process_name\", \"ph\": \"M\", "
+			"\"pid\": 1, \"args\": {\"name\": \"mandelbrot\"}}");
+	trace_name_track(trace, TRACE_TRACK_HOST, "host");
+	trace_name_track(trace, TRACE_TRACK_COMMANDS, "command queue");
+	trace_name_track(trace, TRACE_TRACK_TRANSFERS, "transfer queue");
+
+	return 0;
+}
+
+/**
+ * Names a track of the timeline.
+ *
+ * @param trace The trace or NULL.
+ * @param track The track.
+ * @param name The name.
+ */
+void trace_name_track(trace_t * trace, const int track, const char * name) {
+	if (trace == NULL || !trace->enabled) {
+		return;
+	}
+
+	pthread_mutex_lock(&trace->lock);
+	fprintf(trace->file, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", "
+			"\"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"%s\"}}", track,
+			name);
+	pthread_mutex_unlock(&trace->lock);
+}
+
+/**
+ * Returns the start of a host span.
+ *
+ * @param trace The trace or NULL.
+ * @return The host time in microseconds, 0 if the trace is disabled.
+ */
+double trace_begin(const trace_t * trace) {
+	if (trace == NULL || !trace->enabled) {
+		return 0;
+	}
+
+	return trace_now_us();
+}
+
+/**
+ * Records a host span that ends now. It may be called from any thread.
+ *
+ * @param trace The trace or NULL.
+ * @param name The name of the span, without quotes or backslashes.
+ * @param frame The number of the frame or a negative value for none.
+ * @param track The track of the span.
+ * @param start_us The start returned by trace_begin.
+ */
+void trace_host_span(trace_t * trace, const char * name, const long frame,
+		const int track, const double start_us) {
+	if (trace == NULL || !trace->enabled) {
+		return;
+	}
+
+	trace_write_span(trace, name, "host", frame, track, start_us,
+			trace_now_us());
+
+	pthread_mutex_lock(&trace->lock);
+	trace->host_spans++;
+	pthread_mutex_unlock(&trace->lock);
+}
+
+/**
+ * Records an OpenCL event right after its command was enqueued. The event is
+ * retained, so the caller may release it, and written once it has finished,
+ * by trace_collect. The queue has to profile its commands.
+ *
+ * @param trace The trace.
+ * @param name The name of the span, a string literal.
+ * @param frame The number of the frame.
+ * @param track The track of the queue.
+ * @param event The event or NULL.
+ */
+void trace_device_event(trace_t * trace, const char * name,
+		const long frame, const int track, cl_event event) {
+	if (!trace->enabled || event == NULL) {
+		return;
+	}
+
+	// Too many events in flight: write the oldest one
+	if (trace->number_pending == TRACE_MAX_PENDING) {
+		clWaitForEvents(1, &trace->pending[0].event);
+		trace_write_event(trace, &trace->pending[0]);
+		memmove(&trace->pending[0], &trace->pending[1],
+				sizeof(trace_pending_t) * --trace->number_pending);
+	}
+
+	trace_pending_t * pending = &trace->pending[trace->number_pending++];
+	pending->event = event;
+	pending->name = name;
+	pending->frame = frame;
+	pending->track = track;
+	pending->enqueued_us = trace_now_us();
+	clRetainEvent(event);
+}
+
+/**
+ * Writes the recorded events that have finished, without waiting for the
+ * others.
+ *
+ * @param trace The trace.
+ */
+void trace_collect(trace_t * trace) {
+	int kept = 0;
+
+	if (!trace->enabled) {
+		return;
+	}
+
+	for (int i = 0; i < trace->number_pending; ++i) {
+		cl_int status = CL_QUEUED;
+
+		clGetEventInfo(trace->pending[i].event,
+				CL_EVENT_COMMAND_EXECUTION_STATUS, sizeof(status), &status,
+				NULL);
+		if (status == CL_COMPLETE || status < 0) {
+			trace_write_event(trace, &trace->pending[i]);
+		} else {
+			trace->pending[kept++] = trace->pending[i];
+		}
+	}
+	trace->number_pending = kept;
+}
+
+/**
+ * Waits for the recorded events, writes them, closes the trace file and
+ * prints what it holds. Host spans must not be recorded any more.
+ *
+ * @param trace The trace.
+ */
+void trace_close(trace_t * trace) {
+	if (!trace->enabled) {
+		return;
+	}
+
+	for (int i = 0; i < trace->number_pending; ++i) {
+		clWaitForEvents(1, &trace->pending[i].event);
+		trace_write_event(trace, &trace->pending[i]);
+	}
+	trace->number_pending = 0;
+
+	fprintf(trace->file, "\n]\n");
+	if (fclose(trace->file) != 0) {
+		fprintf(stderr, "Error: Failed to write the trace %s\n", trace->path);
+	}
+	pthread_mutex_destroy(&trace->lock);
+	trace->enabled = 0;
+
+	printf("Trace %s: %ld host spans, %ld device spans\n", trace->path,
+			trace->host_spans, trace->device_spans);
+}
@@ -0,0 +1,68 @@
+/*
+ * trace.h
+ *
+ *      Author: Felix Paetow
+ */
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef __APPLE__
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+//tracks of the timeline, shown as threads of the trace. The I/O threads of
+//the image writer get TRACE_TRACK_WRITER and the tracks after it.
+#define TRACE_TRACK_HOST 1
+#define TRACE_TRACK_COMMANDS 2
+#define TRACE_TRACK_TRANSFERS 3
+#define TRACE_TRACK_WRITER 4
+
+//device events waiting to finish before they are written
+#define TRACE_MAX_PENDING 256
+
+typedef struct trace_pending {
+	cl_event event;
+	const char * name;
+	long frame;
+	int track;
+	double enqueued_us;
+} trace_pending_t;
+
+typedef struct trace {
+	int enabled;
+	const char * path;
+	FILE * file;
+	pthread_mutex_t lock;
+
+	//host time the timeline starts at, and the difference between the host
+	//and the device clock
+	double origin_us;
+	int calibrated;
+	double device_offset_us;
+
+	trace_pending_t pending[TRACE_MAX_PENDING];
+	int number_pending;
+
+	long host_spans;
+	long device_spans;
+} trace_t;
+
+int trace_init(trace_t * trace, const char * path);
+void trace_name_track(trace_t * trace, const int track, const char * name);
+double trace_begin(const trace_t * trace);
+void trace_host_span(trace_t * trace, const char * name, const long frame,
+		const int track, const double start_us);
+void trace_device_event(trace_t * trace, const char * name,
+		const long frame, const int track, cl_event event);
+void trace_collect(trace_t * trace);
+void trace_close(trace_t * trace);
+
+#endif /* TRACE_H_ */
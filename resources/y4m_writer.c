@@ -0,0 +1,192 @@
+/*
+ * y4m_writer.c
+ *
+ *      Author: Felix Paetow
+ */
+
+#include "y4m_writer.h"
+
+/**
+ * Returns the size of a YUV 4:2:0 frame: one luma value per pixel and two
+ * chroma values per 2 x 2 pixels.
+ *
+ * @param width The width of the video.
+ * @param height The height of the video.
+ * @return The size in bytes.
+ */
+long y4m_frame_size(const long width, const long height) {
+	return width * height + 2 * ((width + 1) / 2) * ((height + 1) / 2);
+}
+
+/**
+ * Converts a colored image to a YUV 4:2:0 frame, with the same integer
+ * arithmetic as the kernel convert_image_to_yuv.
+ *
+ * The image has blue, green and red bytes and the bottom row first, as the
+ * bmp files expect it. The frame has the top row first.
+ *
+ * @param width The width of the video.
+ * @param height The height of the video.
+ * @param image The colored image, 3 bytes per pixel.
+ * @param yuv The frame, y4m_frame_size bytes.
+ */
+void y4m_convert(const long width, const long height,
+		const unsigned char * image, unsigned char * yuv) {
+	long chroma_width = (width + 1) / 2;
+	long chroma_height = (height + 1) / 2;
+	unsigned char * plane_u = yuv + width * height;
+	unsigned char * plane_v = plane_u + chroma_width * chroma_height;
+
+	for (long by = 0; by < chroma_height; ++by) {
+		for (long bx = 0; bx < chroma_width; ++bx) {
+			int sum_blue = 0;
+			int sum_green = 0;
+			int sum_red = 0;
+			int count = 0;
+
+			for (long y = 2 * by; y < 2 * by + 2 && y < height; ++y) {
+				const unsigned char * row = image
+						+ (height - 1 - y) * width * 3;
+
+				for (long x = 2 * bx; x < 2 * bx + 2 && x < width; ++x) {
+					int blue = row[x * 3];
+					int green = row[x * 3 + 1];
+					int red = row[x * 3 + 2];
+
+					yuv[y * width + x] = (unsigned char) ((77 * red
+							+ 150 * green + 29 * blue + 128) >> 8);
+					sum_blue += blue;
+					sum_green += green;
+					sum_red += red;
+					count++;
+				}
+			}
+
+			int blue = sum_blue / count;
+			int green = sum_green / count;
+			int red = sum_red / count;
+			int u = (-43 * red - 85 * green + 128 * blue + 32896) >> 8;
+			int v = (128 * red - 107 * green - 21 * blue + 32896) >> 8;
+
+			plane_u[by * chroma_width + bx] = (unsigned char) (
+					u > 255 ? 255 : u);
+			plane_v[by * chroma_width + bx] = (unsigned char) (
+					v > 255 ? 255 : v);
+		}
+	}
+}
+
+/**
+ * Opens a YUV4MPEG2 stream and writes its header. All frames of the video go
+ * into this one stream, which an encoder can read while it is written, like
+ *
+ *     host_main --y4m=- | ffmpeg -i - video.mp4
+ *
+ * If the path is "-", the frames are written to stdout and everything the
+ * program prints goes to stderr instead.
+ *
+ * @param writer The writer.
+ * @param path The file to write or "-" for stdout.
+ * @param width The width of the video.
+ * @param height The height of the video.
+ * @param fps The number of frames per second.
+ * @return 0 on success, otherwise -1.
+ */
+int y4m_writer_open(y4m_writer_t * writer, const char * path,
+		const long width, const long height, const long fps) {
+	writer->to_stdout = (strcmp(path, "-") == 0);
+	writer->width = width;
+	writer->height = height;
+	writer->frame_size = y4m_frame_size(width, height);
+	writer->frame = NULL;
+	writer->frames = 0;
+	writer->errors = 0;
+
+	if (writer->to_stdout) {
+		// Keep the stream on the old stdout, stdout itself becomes stderr
+		fflush(stdout);
+		int fd = dup(STDOUT_FILENO);
+		if (fd < 0) {
+			return -1;
+		}
+		writer->stream = fdopen(fd, "wb");
+		if (writer->stream == NULL) {
+			close(fd);
+			return -1;
+		}
+		dup2(STDERR_FILENO, STDOUT_FILENO);
+	} else {
+		writer->stream = fopen(path, "wb");
+		if (writer->stream == NULL) {
+			return -1;
+		}
+	}
+
+	// Progressive, square pixels, chroma sited like jpeg
+	if (fprintf(writer->stream, "YUV4MPEG2 W%ld H%ld F%ld:1 Ip A1:1 C420jpeg\n",
+			width, height, fps) < 0) {
+		fclose(writer->stream);
+		writer->stream = NULL;
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * Writes a frame that has already been converted to YUV 4:2:0.
+ *
+ * @param writer The writer.
+ * @param yuv The frame, y4m_frame_size bytes.
+ * @return 0 on success, otherwise -1.
+ */
+int y4m_writer_write(y4m_writer_t * writer, const unsigned char * yuv) {
+	if (fputs("FRAME\n", writer->stream) < 0
+			|| fwrite(yuv, 1, writer->frame_size, writer->stream)
+					!= (size_t) writer->frame_size) {
+		writer->errors++;
+		return -1;
+	}
+
+	writer->frames++;
+
+	return 0;
+}
+
+/**
+ * Converts a colored image on the host and writes it as frame. The frame
+ * buffer is allocated once and reused for every image.
+ *
+ * @param writer The writer.
+ * @param image The colored image, 3 bytes per pixel.
+ * @return 0 on success, otherwise -1.
+ */
+int y4m_writer_write_image(y4m_writer_t * writer,
+		const unsigned char * image) {
+	if (writer->frame == NULL) {
+		writer->frame = (unsigned char *) malloc(writer->frame_size);
+		if (writer->frame == NULL) {
+			writer->errors++;
+			return -1;
+		}
+	}
+
+	y4m_convert(writer->width, writer->height, image, writer->frame);
+
+	return y4m_writer_write(writer, writer->frame);
+}
+
+/**
+ * Flushes and closes the stream.
+ *
+ * @param writer The writer.
+ */
+void y4m_writer_close(y4m_writer_t * writer) {
+	if (writer->stream != NULL && fclose(writer->stream) != 0) {
+		writer->errors++;
+	}
+	writer->stream = NULL;
+
+	free(writer->frame);
+	writer->frame = NULL;
+}
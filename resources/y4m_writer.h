@@ -0,0 +1,39 @@
+/*
+ * y4m_writer.h
+ *
+ *      Author: Felix Paetow
+ */
+
+#ifndef Y4M_WRITER_H_
+#define Y4M_WRITER_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+typedef struct y4m_writer {
+	FILE * stream;
+	int to_stdout;
+	long width;
+	long height;
+
+	//frame of the colored images converted on the host
+	unsigned char * frame;
+	long frame_size;
+
+	long frames;
+	long errors;
+} y4m_writer_t;
+
+long y4m_frame_size(const long width, const long height);
+void y4m_convert(const long width, const long height,
+		const unsigned char * image, unsigned char * yuv);
+int y4m_writer_open(y4m_writer_t * writer, const char * path,
+		const long width, const long height, const long fps);
+int y4m_writer_write(y4m_writer_t * writer, const unsigned char * yuv);
+int y4m_writer_write_image(y4m_writer_t * writer,
+		const unsigned char * image);
+void y4m_writer_close(y4m_writer_t * writer);
+
+#endif /* Y4M_WRITER_H_ */
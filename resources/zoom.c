@@ -6,6 +6,21 @@
 
 #include "zoom.h"
 
+// Searches a row from its end for the first value of itr, for one width of
+// the iteration values. Gives the first pixel if no value of the row is itr.
+#define FIND_IN_ROW(name, type) \
+static long name(const type * row, const long width, const long itr) { \
+	long i = width - 1; \
+	while (i > 0 && (long) row[i] != itr) { \
+		--i; \
+	} \
+	return i; \
+}
+
+FIND_IN_ROW(find_in_row_16, uint16_t)
+FIND_IN_ROW(find_in_row_32, uint32_t)
+FIND_IN_ROW(find_in_row_long, long)
+
 /**
  * Finds the point the zoom shall focus on.
  *
@@ -17,27 +32,30 @@
  * @param y_min Smallest Y-value of the plane section.
  * @param y_max Greatest Y-value of the plane section.
  * @param imagevalues The image as a set of iteration values.
+ * @param value_bits The width of the iteration values.
  * @param width The width.
  * @param height The height.
  * @param itr The number of required iterations.
  * @return The point to zoom to.
  */
 my_complex_t find_dot_to_zoom(const float x_min, const float x_max,
-		const float y_min, const float y_max, long * image, const long heigth,
-		const long width, const long itr) {
+		const float y_min, const float y_max, const void * image,
+		const int value_bits, const long heigth, const long width,
+		const long itr) {
 
 	//find zoom point based on iteration values
 	long middle = heigth / 2;
-	long * middle_of_image = image + middle * width;
-
-	short found_dot = 1;
-	long i = width;
-	while (found_dot != 0) {
-		if (*(middle_of_image + i) == itr) {
-			found_dot = 0;
-		} else {
-			--i;
-		}
+	long i;
+
+	if (value_bits == ITERATION_VALUES_16) {
+		i = find_in_row_16((const uint16_t *) image + middle * width, width,
+				itr);
+	} else if (value_bits == ITERATION_VALUES_32) {
+		i = find_in_row_32((const uint32_t *) image + middle * width, width,
+				itr);
+	} else {
+		i = find_in_row_long((const long *) image + middle * width, width,
+				itr);
 	}
 
 	//calculates the value of the zoom point
@@ -58,8 +76,8 @@ my_complex_t find_dot_to_zoom(const float x_min, const float x_max,
  * @param b Second value.
  * @return The absolute distance.
  */
-float calculate_distance_abs(const float a, const float b) {
-	float result = -1;
+double calculate_distance_abs(const double a, const double b) {
+	double result = -1;
 
 	if (a < b) {
 		result = b - a;
@@ -82,13 +100,13 @@ float calculate_distance_abs(const float a, const float b) {
  * @param dot The dot on the line.
  * @param reduction_value The value by which the line is to be reduced.
  */
-void reduce_section_focus_dot(float * const min, float * const max,
-		const float dot, float reduction_value) {
+void reduce_section_focus_dot(double * const min, double * const max,
+		const double dot, double reduction_value) {
 	//If the value is on the line
 	if (dot > *min && dot < *max) {
-		float dot_distance_to_min = calculate_distance_abs(*min, dot);
-		float dot_distance_to_max = calculate_distance_abs(*max, dot);
-		float difference_dot_distances = calculate_distance_abs(
+		double dot_distance_to_min = calculate_distance_abs(*min, dot);
+		double dot_distance_to_max = calculate_distance_abs(*max, dot);
+		double difference_dot_distances = calculate_distance_abs(
 				dot_distance_to_min, dot_distance_to_max);
 
 		//If the line is greater then the reduction value, otherwise wrong
@@ -130,13 +148,13 @@ void reduce_section_focus_dot(float * const min, float * const max,
 	}
 }
 
-void reduce_plane_section_focus_dot(float * const x_min, float * const x_max,
-		float * const y_min, float * const y_max,
+void reduce_plane_section_focus_dot(double * const x_min,
+		double * const x_max, double * const y_min, double * const y_max,
 		float reduction_in_percentage, my_complex_t dot) {
 
-	float reduction_value_x = fabs(
+	double reduction_value_x = fabs(
 			(*x_max - *x_min) * reduction_in_percentage / 100);
-	float reduction_value_y = fabs(
+	double reduction_value_y = fabs(
 			(*y_max - *y_min) * reduction_in_percentage / 100);
 
 	reduce_section_focus_dot(x_min, x_max, dot.real, reduction_value_x);
@@ -0,0 +1,186 @@
+/*
+ * cpu_backend_test.c
+ *
+ *      Author: Felix Paetow
+ */
+
+// Checks that the vector paths of the CPU backend calculate the same
+// iteration values, saved iterations and colors as its scalar path. Every
+// scene is rendered with the scalar path, then with AVX2 and AVX-512 if the
+// CPU has them, with and without the interior check. Paths the CPU lacks
+// are reported as skipped.
+//
+// Built from the root of the repository, like the video program:
+//
+//     gcc -std=gnu99 -O2 test/cpu_backend_test.c resources/*.c -lOpenCL
+//         -lm -lpthread -o cpu_backend_test
+//
+// Exits with failure if any value differs.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../resources/cpu_backend.h"
+
+//a plane section and the iterations it is rendered with. The map is
+//z^2 - c, so the set is mirrored against the usual pictures.
+typedef struct test_scene {
+	const char * name;
+	float x_min;
+	float x_max;
+	float y_min;
+	float y_max;
+	long itr;
+} test_scene_t;
+
+//a path of the backend, given as the lanes of its vectors
+typedef struct test_path {
+	const char * isa;
+	int lanes;
+} test_path_t;
+
+static const test_scene_t scenes[] = {
+		{ "full", -1.0f, 2.0f, -1.125f, 1.125f, 200 },
+		{ "seahorse-valley", 0.7403f, 0.7503f, -0.1165f, -0.1090f, 1000 },
+		{ "interior", 0.0f, 0.3f, -0.1125f, 0.1125f, 500 },
+		{ "boundary", -0.2925f, -0.2725f, -0.0175f, -0.0025f, 2000 } };
+
+static const test_path_t paths[] = { { "AVX2", 8 }, { "AVX-512", 16 } };
+
+#define TEST_COUNT(array) ((int) (sizeof(array) / sizeof((array)[0])))
+
+//odd sizes, so the last vector of a row is padded
+#define TEST_X_MON 203
+#define TEST_Y_MON 117
+
+/**
+ * Renders a scene with a path of the backend.
+ *
+ * @param cpu The backend.
+ * @param lanes The lanes of the path, 1 for the scalar path.
+ * @param scene The scene.
+ * @param imagevalues Set to the iteration values.
+ * @param image Set to the colored image.
+ * @return The number of iterations the interior check saved, or -1 if the
+ *         backend failed.
+ */
+static long test_render(cpu_backend_t * cpu, const int lanes,
+		const test_scene_t * scene, long * imagevalues,
+		unsigned char * image) {
+	cpu->lanes = lanes;
+
+	if (cpu_backend_render(cpu, scene->x_min, scene->x_max, scene->y_min,
+			scene->y_max, TEST_X_MON, TEST_Y_MON, 2, scene->itr, imagevalues,
+			image) != 0) {
+		return -1;
+	}
+
+	return cpu->saved_iterations;
+}
+
+/**
+ * Renders every scene with the scalar path and a vector path and compares
+ * the results.
+ *
+ * @param cpu The backend.
+ * @param path The vector path.
+ * @return The number of scenes that differ, or -1 if the backend failed.
+ */
+static int test_path(cpu_backend_t * cpu, const test_path_t * path) {
+	const long pixels = TEST_X_MON * TEST_Y_MON;
+	long * expected_values = (long *) malloc(sizeof(long) * pixels);
+	long * values = (long *) malloc(sizeof(long) * pixels);
+	unsigned char * expected_image = (unsigned char *) malloc(pixels * 3);
+	unsigned char * image = (unsigned char *) malloc(pixels * 3);
+	int failed = 0;
+
+	if (expected_values == NULL || values == NULL || expected_image == NULL
+			|| image == NULL) {
+		failed = -1;
+	}
+
+	for (int s = 0; s < TEST_COUNT(scenes) && failed >= 0; ++s) {
+		long expected_saved = test_render(cpu, 1, &scenes[s],
+				expected_values, expected_image);
+		long saved = test_render(cpu, path->lanes, &scenes[s], values,
+				image);
+		if (expected_saved < 0 || saved < 0) {
+			failed = -1;
+			break;
+		}
+
+		long differences = 0;
+		for (long i = 0; i < pixels; ++i) {
+			if (values[i] != expected_values[i]) {
+				if (differences == 0) {
+					printf("  %s: pixel %ld has %ld iterations, scalar %ld\n",
+							scenes[s].name, i, values[i],
+							expected_values[i]);
+				}
+				differences++;
+			}
+		}
+		if (differences > 0 || saved != expected_saved
+				|| memcmp(image, expected_image, pixels * 3) != 0) {
+			printf("FAIL %s %s interior check %d: %ld values differ, "
+					"saved %ld, scalar %ld\n", path->isa, scenes[s].name,
+					cpu->interior_check, differences, saved, expected_saved);
+			failed++;
+		} else {
+			printf("ok   %s %s interior check %d\n", path->isa,
+					scenes[s].name, cpu->interior_check);
+		}
+	}
+
+	free(expected_values);
+	free(values);
+	free(expected_image);
+	free(image);
+
+	return failed;
+}
+
+int main(void) {
+	int failed = 0;
+
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+#endif
+
+	for (int interior_check = 0; interior_check <= 1; ++interior_check) {
+		cpu_backend_t cpu;
+
+		if (cpu_backend_init(&cpu, 0, interior_check) != 0) {
+			printf("Failed to start the CPU backend\n");
+			return EXIT_FAILURE;
+		}
+
+		for (int p = 0; p < TEST_COUNT(paths); ++p) {
+			int supported = 0;
+
+#if defined(__x86_64__) || defined(__i386__)
+			if (p == 0) {
+				supported = __builtin_cpu_supports("avx2");
+			} else {
+				supported = __builtin_cpu_supports("avx512f");
+			}
+#endif
+			if (!supported) {
+				printf("skip %s, not supported by the CPU\n", paths[p].isa);
+				continue;
+			}
+
+			int result = test_path(&cpu, &paths[p]);
+			if (result != 0) {
+				failed = 1;
+			}
+		}
+
+		cpu_backend_close(&cpu);
+	}
+
+	printf("%s\n", failed ? "FAILED" : "PASSED");
+
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
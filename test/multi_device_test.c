@@ -0,0 +1,198 @@
+/*
+ * multi_device_test.c
+ *
+ *      Author: Felix Paetow
+ */
+
+// Checks the multi-device renderer on sub-devices: the devices are split
+// into sub-devices, which have to render the same iteration values, saved
+// iterations and colors as the whole devices. A device with more
+// sub-devices than MULTI_DEVICE_MAX has to work as well, with the first
+// ones. Several frames are rendered, so the shares of the tiles move, and
+// the renderer is set up and released more than once.
+//
+// Built from the root of the repository, like the video program:
+//
+//     gcc -std=gnu99 -O2 test/multi_device_test.c resources/*.c -lOpenCL
+//         -lm -lpthread -o multi_device_test
+//
+// Options: --sub-devices=N compute units per sub-device, 1 by default. With
+// pocl, POCL_CPU_MAX_CU_NUM sets the compute units of the CPU device, e.g.
+// 24 for more sub-devices than MULTI_DEVICE_MAX. Exits with failure if any
+// value differs, and skips the test without an OpenCL device that can be
+// split.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../resources/kernel_source.h"
+#include "../resources/multi_device.h"
+
+//frames rendered by each renderer, zooming into the seahorse valley
+#define TEST_FRAMES 4
+
+//odd sizes, so the last tile is cut
+#define TEST_X_MON 317
+#define TEST_Y_MON 203
+
+#define TEST_ITR 500
+
+/**
+ * Renders the test frames.
+ *
+ * @param md The renderer.
+ * @param variant The kernel variant.
+ * @param values Set to the iteration values of all frames.
+ * @param image Set to the colored images of all frames.
+ * @param saved Set to the saved iterations of each frame.
+ * @return CL_SUCCESS or the error code of the failed OpenCL call.
+ */
+static cl_int test_render(multi_device_t * md,
+		const kernel_variant_t * variant, unsigned char * values,
+		unsigned char * image, cl_ulong * saved) {
+	size_t value_size = iteration_values_size(variant->value_bits);
+	const long pixels = TEST_X_MON * TEST_Y_MON;
+	float span = 3.0f;
+
+	for (int f = 0; f < TEST_FRAMES; ++f) {
+		float height = span * TEST_Y_MON / TEST_X_MON;
+		cl_int err = multi_device_render(md, 0.7453f - span / 2,
+				0.7453f + span / 2, -0.1127f - height / 2,
+				-0.1127f + height / 2, TEST_X_MON, TEST_Y_MON, 2, TEST_ITR,
+				variant, values + f * pixels * value_size,
+				image + f * pixels * 3, &saved[f]);
+		if (err != CL_SUCCESS) {
+			return err;
+		}
+		span /= 4;
+	}
+
+	return CL_SUCCESS;
+}
+
+int main(int argc, char *argv[]) {
+	const long pixels = TEST_X_MON * TEST_Y_MON;
+	int split = 1;
+	kernel_variant_t variant;
+	multi_device_t md;
+	cl_ulong expected_saved[TEST_FRAMES];
+	cl_ulong saved[TEST_FRAMES];
+	cl_int err;
+
+	for (int i = 1; i < argc; ++i) {
+		if (strncmp(argv[i], "--sub-devices=", 14) == 0
+				&& atoi(argv[i] + 14) > 0) {
+			split = atoi(argv[i] + 14);
+		} else {
+			printf("Usage: %s [--sub-devices=N]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	char * source = kernel_source_load();
+	if (source == NULL) {
+		printf("Failed to load kernel\n");
+		return EXIT_FAILURE;
+	}
+
+	kernel_variant_select(&variant, 2, TEST_ITR, 4, 0, 1, PRECISION_FLOAT);
+	size_t value_size = iteration_values_size(variant.value_bits);
+	unsigned char * expected_values = (unsigned char *) malloc(
+			TEST_FRAMES * pixels * value_size);
+	unsigned char * values = (unsigned char *) malloc(
+			TEST_FRAMES * pixels * value_size);
+	unsigned char * expected_image = (unsigned char *) malloc(
+			TEST_FRAMES * pixels * 3);
+	unsigned char * image = (unsigned char *) malloc(TEST_FRAMES * pixels * 3);
+	if (expected_values == NULL || values == NULL || expected_image == NULL
+			|| image == NULL) {
+		printf("Failed to allocate the frames\n");
+		free(expected_values);
+		free(values);
+		free(expected_image);
+		free(image);
+		free(source);
+		return EXIT_FAILURE;
+	}
+
+	// The whole devices give the expected frames
+	int failed = 0;
+	int skipped = 0;
+	err = multi_device_init(&md, MULTI_DEVICE_SPLIT_NONE, NULL, source);
+	if (err == CL_SUCCESS) {
+		err = test_render(&md, &variant, expected_values, expected_image,
+				expected_saved);
+	}
+	int whole_devices = md.count;
+	multi_device_release(&md);
+	if (err == CL_DEVICE_NOT_FOUND) {
+		printf("skip, found no OpenCL device\n");
+		skipped = 1;
+	} else if (err != CL_SUCCESS) {
+		printf("FAIL whole devices: %d\n", err);
+		failed = 1;
+	}
+
+	// Twice, so sub-devices released by the first renderer can be created
+	// again
+	for (int round = 0; round < 2 && !failed && !skipped; ++round) {
+		err = multi_device_init(&md, split, NULL, source);
+		if (err == CL_SUCCESS) {
+			err = test_render(&md, &variant, values, image, saved);
+		}
+		int units = md.count;
+		int sub_devices = 0;
+		for (int u = 0; u < md.count; ++u) {
+			sub_devices += md.units[u].sub_device;
+		}
+		multi_device_release(&md);
+
+		if (err != CL_SUCCESS) {
+			printf("FAIL sub-devices of %d compute units: %d\n", split, err);
+			failed = 1;
+			break;
+		}
+		if (sub_devices == 0) {
+			printf("skip, the devices can't be split into sub-devices of %d "
+					"compute units\n", split);
+			break;
+		}
+		if (units > MULTI_DEVICE_MAX) {
+			printf("FAIL %d devices, at most %d\n", units, MULTI_DEVICE_MAX);
+			failed = 1;
+		}
+
+		long differences = 0;
+		for (long i = 0; i < TEST_FRAMES * pixels; ++i) {
+			if (iteration_values_get(values, variant.value_bits, i)
+					!= iteration_values_get(expected_values,
+							variant.value_bits, i)) {
+				differences++;
+			}
+		}
+		if (memcmp(image, expected_image, TEST_FRAMES * pixels * 3) != 0
+				|| memcmp(saved, expected_saved, sizeof(saved)) != 0) {
+			differences++;
+		}
+		if (differences > 0) {
+			printf("FAIL %d units (%d sub-devices) against %d whole devices: "
+					"%ld values differ\n", units, sub_devices, whole_devices,
+					differences);
+			failed = 1;
+		} else {
+			printf("ok   %d units (%d sub-devices) against %d whole devices\n",
+					units, sub_devices, whole_devices);
+		}
+	}
+
+	free(expected_values);
+	free(values);
+	free(expected_image);
+	free(image);
+	free(source);
+
+	printf("%s\n", failed ? "FAILED" : "PASSED");
+
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}